@@ -8,34 +8,118 @@
 
 #include <fcntl.h>
 #include <dirent.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <stdatomic.h>
 
 struct lo_inode
 {
-	struct lo_inode *next;  /* protected by lo->mutex */
-	struct lo_inode *prev;  /* protected by lo->mutex */
+	struct lo_inode *next;  /* 哈希桶中的下一个 inode，protected by shard->lock；移除后用于回收链表 */
 	int fd;
 	ino_t ino;
 	dev_t dev;
-	uint64_t refcount; 		/* protected by lo->mutex */
+	_Atomic(uint64_t) refcount; /* 只在分片的锁内减到 0 */
+	int backing_id;			/* protected by lo->mutex */
+	unsigned backing_refs;	/* protected by lo->mutex */
+	int wd;					/* 目录的 inotify 监视描述符，-1 表示没有监视，加入哈希表之后不再修改 */
+	atomic_uint writers;	/* 通过挂载点以写方式打开的次数，期间文件内容的变化来自守护进程自己 */
+};
+
+// inode 哈希表的分片数量，每个分片有自己的锁，不同分片上的 LOOKUP 和 FORGET 互不阻塞
+#define LO_INODE_SHARDS 64
+// 每个分片初始的桶数量，分片中的 inode 数超过桶数量时翻倍
+#define LO_INODE_BUCKETS 16
+
+// 按 (st_dev, st_ino) 散列的一个分片，对齐到缓存行避免相邻分片的锁互相干扰
+struct lo_inode_shard
+{
+	pthread_mutex_t lock;
+	struct lo_inode **buckets;
+	size_t nbuckets;		// 2 的幂
+	size_t count;
+} __attribute__((aligned(64)));
+
+struct lo_uring;
+static void lo_uring_destroy(struct lo_uring *ring);
+
+// 一个等待组提交的 fsync/fsyncdir 请求
+struct lo_sync_req
+{
+	struct lo_sync_req *next;
+	fuse_req_p req;
+	int fd;
+	dev_t dev;					/* 文件所在的后端文件系统 */
+	int datasync;
+	int close_fd;				/* fd 是临时打开的，回复之后关闭 */
+	int err;					/* 同步的结果，-1 表示所在的文件系统还没有同步 */
 };
 
 struct lo_data
 {
-	pthread_mutex_t mutex; // 循环遍历 lo_inode 的锁
+	pthread_mutex_t mutex; // 保护回收链表以及 inode 的 backing_id
 	char *source;	   	   // 该文件系统被重定向的目标路径
 	double timeout;
-	struct lo_inode root; // 通过上面的 mutex 来控制访问
+	unsigned timeout_sec;  // --timeout 设置的目录项和属性的缓存时间，默认为 0 不缓存
+	struct lo_inode root;  // 根目录不在哈希表中，引用计数不会减到 0
+	struct lo_inode_shard shards[LO_INODE_SHARDS]; // 除根目录以外所有 inode 的哈希表
+	int uring;			   // 是否通过 io_uring 异步执行后端 I/O
+	struct lo_uring *ring; // 在 lo_init() 中创建，创建失败时为 NULL，退回到同步 I/O
+	int passthrough;	   // 是否请求内核 passthrough，由内核直接读写源文件
+	int writeback;		   // 是否请求 writeback cache，小的缓存写在内核中合并后再写回
+	struct lo_inode *reclaim;	 // 引用计数减到 0 等待回收的 inode，通过 next 链接，由 mutex 保护
+	pthread_cond_t reclaim_cond; // 通知回收线程
+	pthread_t reclaim_thread;
+	int reclaim_running;		 // 回收线程是否在运行，为 0 时由 forget 的调用者直接回收
+	int reclaim_stop;
+	int watch;					 // 是否监视源目录的变化，并通知内核失效对应的缓存
+	int watch_fd;				 // inotify 文件描述符，在 lo_init() 中创建，-1 表示没有监视
+	int watch_efd;				 // 通知监视线程退出的 eventfd
+	pthread_t watch_thread;
+	struct fuse_session *se;	 // 监视线程发送通知的会话
+	int no_opendir;				 // 不需要 OPENDIR/RELEASEDIR，READDIR 时临时打开目录
+	int no_group_commit;		 // 在处理线程中直接同步每个文件，不进行组提交
+	unsigned sync_window;		 // 组提交收到第一个请求后等待更多请求的时间，单位为微秒
+	pthread_mutex_t sync_lock;
+	pthread_cond_t sync_cond;	 // 通知同步线程
+	struct lo_sync_req *sync_list; // 等待下一轮同步的请求，由 sync_lock 保护
+	pthread_t sync_thread;
+	int sync_running;			 // 同步线程是否在运行，为 0 时由处理线程直接同步
+	int sync_stop;
 };
 
 static const struct fuse_opt lo_opts[] = {
 	DEFINE_FUSE_OPT("--source=%s", struct lo_data, source),
+	DEFINE_FUSE_OPT("--uring", struct lo_data, uring),
+	DEFINE_FUSE_OPT("--passthrough", struct lo_data, passthrough),
+	DEFINE_FUSE_OPT("--timeout=%u", struct lo_data, timeout_sec),
+	DEFINE_FUSE_OPT("--writeback", struct lo_data, writeback),
+	DEFINE_FUSE_OPT("--watch", struct lo_data, watch),
+	DEFINE_FUSE_OPT("--no_opendir", struct lo_data, no_opendir),
+	DEFINE_FUSE_OPT("--no_group_commit", struct lo_data, no_group_commit),
+	DEFINE_FUSE_OPT("--sync_window=%u", struct lo_data, sync_window),
 	FUSE_OPT_END
 };
 
 void fuse_passthrough_help(){
 	printf("fuse passthrough options: \n");
 	printf("    [--source=%%s]                source directory of the mounted fs (default=/),\n"
-	       "                                 all vfs operations will be redirected to the source directory\n");
+	       "                                 all vfs operations will be redirected to the source directory\n"
+	       "    [--uring]                    submit read/write/lookup/getattr to io_uring and reply on completion,\n"
+	       "                                 works best with --max_inflight\n"
+	       "    [--passthrough]              let the kernel read/write/mmap regular files directly from the source files,\n"
+	       "                                 requires kernel 6.9+ and CAP_SYS_ADMIN\n"
+	       "    [--timeout=%%u]               seconds the kernel caches entries and attributes (default=0),\n"
+	       "                                 a non-zero value lets readdirplus answer the lookups of `ls -l`\n"
+	       "    [--writeback]                enable the kernel writeback cache, buffered writes are merged in the page cache\n"
+	       "                                 and written back in large WRITE requests, ignored with --passthrough\n"
+	       "    [--watch]                    watch the source directory with inotify and invalidate the kernel caches of\n"
+	       "                                 changed entries and inodes, so that a long --timeout is safe\n"
+	       "    [--no_opendir]               read directories without OPENDIR/RELEASEDIR, the kernel caches the listings,\n"
+	       "                                 use with --watch if the source directory is changed by others\n"
+	       "    [--no_group_commit]          fsync every file on its own instead of sharing one syncfs between\n"
+	       "                                 concurrent fsyncs on the same filesystem\n"
+	       "    [--sync_window=%%u]           microseconds a group commit waits for more fsyncs before syncing (default=0)\n");
 }
 
 void free_lo_data(struct lo_data *data, int alloc)
@@ -63,58 +147,267 @@ static int lo_fd(fuse_req_p req, fuse_inode ino)
 	return lo_inode(req, ino)->fd;
 }
 
+static uint64_t lo_inode_hash(dev_t dev, ino_t ino)
+{
+	uint64_t h = ((uint64_t)ino ^ ((uint64_t)dev << 32 | (uint64_t)dev >> 32)) * 0x9e3779b97f4a7c15ULL;
+
+	return h ^ (h >> 29);
+}
+
+// 分片由哈希值的高位决定，桶由低位决定
+static struct lo_inode_shard *lo_shard(struct lo_data *lo, uint64_t hash)
+{
+	return &lo->shards[(hash >> 32) % LO_INODE_SHARDS];
+}
+
+static int lo_inode_table_init(struct lo_data *lo)
+{
+	size_t i;
+
+	for (i = 0; i < LO_INODE_SHARDS; i++)
+	{
+		struct lo_inode_shard *shard = &lo->shards[i];
+
+		pthread_mutex_init(&shard->lock, NULL);
+		shard->count = 0;
+		shard->nbuckets = LO_INODE_BUCKETS;
+		shard->buckets = (struct lo_inode **)calloc(LO_INODE_BUCKETS, sizeof(struct lo_inode *));
+		if (shard->buckets == NULL)
+			return -1;
+	}
+	return 0;
+}
+
+// 在分片中查找 inode，不增加引用计数，需要持有 shard->lock
+static struct lo_inode *lo_find_locked(struct lo_inode_shard *shard, uint64_t hash, dev_t dev, ino_t ino)
+{
+	struct lo_inode *p;
+
+	for (p = shard->buckets[hash & (shard->nbuckets - 1)]; p != NULL; p = p->next)
+	{
+		if (p->ino == ino && p->dev == dev)
+			return p;
+	}
+	return NULL;
+}
+
 static struct lo_inode *lo_find(struct lo_data *lo, struct stat *st)
 {
+	uint64_t hash = lo_inode_hash(st->st_dev, st->st_ino);
+	struct lo_inode_shard *shard = lo_shard(lo, hash);
+	struct lo_inode *ret;
+
+	pthread_mutex_lock(&shard->lock);
+	ret = lo_find_locked(shard, hash, st->st_dev, st->st_ino);
+	if (ret)
+	{
+		assert(atomic_load(&ret->refcount) > 0);
+		atomic_fetch_add(&ret->refcount, 1);
+	}
+	pthread_mutex_unlock(&shard->lock);
+	return ret;
+}
+
+// 桶数量翻倍并重新散列分片中的 inode，需要持有 shard->lock；内存不足时继续使用原来的桶
+static void lo_shard_grow(struct lo_inode_shard *shard)
+{
+	size_t n = shard->nbuckets * 2;
+	struct lo_inode **buckets;
+	struct lo_inode *p, *next;
+	size_t i, idx;
+
+	buckets = (struct lo_inode **)calloc(n, sizeof(struct lo_inode *));
+	if (buckets == NULL)
+		return;
+	for (i = 0; i < shard->nbuckets; i++)
+	{
+		for (p = shard->buckets[i]; p != NULL; p = next)
+		{
+			next = p->next;
+			idx = lo_inode_hash(p->dev, p->ino) & (n - 1);
+			p->next = buckets[idx];
+			buckets[idx] = p;
+		}
+	}
+	free(shard->buckets);
+	shard->buckets = buckets;
+	shard->nbuckets = n;
+}
+
+// 将新的 inode 加入哈希表；并发的 LOOKUP 已经加入了同一个 (dev, ino) 时增加它的引用计数
+// @return 哈希表中的 inode，不是参数 inode 时由调用者释放参数 inode
+static struct lo_inode *lo_inode_insert(struct lo_data *lo, struct lo_inode *inode)
+{
+	uint64_t hash = lo_inode_hash(inode->dev, inode->ino);
+	struct lo_inode_shard *shard = lo_shard(lo, hash);
+	struct lo_inode **bucket;
 	struct lo_inode *p;
-	struct lo_inode *ret = NULL;
+
+	pthread_mutex_lock(&shard->lock);
+	p = lo_find_locked(shard, hash, inode->dev, inode->ino);
+	if (p)
+	{
+		atomic_fetch_add(&p->refcount, 1);
+		pthread_mutex_unlock(&shard->lock);
+		return p;
+	}
+	if (shard->count >= shard->nbuckets)
+		lo_shard_grow(shard);
+	bucket = &shard->buckets[hash & (shard->nbuckets - 1)];
+	inode->next = *bucket;
+	*bucket = inode;
+	shard->count++;
+	pthread_mutex_unlock(&shard->lock);
+	return inode;
+}
+
+// 减少 inode 的引用计数：不会减到 0 时只做一次原子操作，否则在分片的锁内减少并从哈希表中移除；
+// LOOKUP 只在分片的锁内增加引用计数，因此移除之后的 inode 不会再被找到
+// @return 引用计数减到 0 并从哈希表中移除时返回 inode，否则返回 NULL
+static struct lo_inode *lo_inode_unref(struct lo_data *lo, struct lo_inode *inode, uint64_t nlookup)
+{
+	uint64_t ref = atomic_load(&inode->refcount);
+	uint64_t hash;
+	struct lo_inode_shard *shard;
+	struct lo_inode **pp;
+
+	while (ref > nlookup || inode == &lo->root)
+	{
+		assert(ref >= nlookup);
+		if (atomic_compare_exchange_weak(&inode->refcount, &ref, ref - nlookup))
+			return NULL;
+	}
+	hash = lo_inode_hash(inode->dev, inode->ino);
+	shard = lo_shard(lo, hash);
+	pthread_mutex_lock(&shard->lock);
+	ref = atomic_fetch_sub(&inode->refcount, nlookup);
+	assert(ref >= nlookup);
+	if (ref != nlookup)
+	{
+		pthread_mutex_unlock(&shard->lock);
+		return NULL;
+	}
+	for (pp = &shard->buckets[hash & (shard->nbuckets - 1)]; *pp != inode; pp = &(*pp)->next)
+		;
+	*pp = inode->next;
+	shard->count--;
+	pthread_mutex_unlock(&shard->lock);
+	inode->next = NULL;
+	return inode;
+}
+
+// 关闭并释放通过 next 链接的 inode
+static void lo_free_inodes(struct lo_inode *inode)
+{
+	struct lo_inode *next;
+
+	for (; inode != NULL; inode = next)
+	{
+		next = inode->next;
+		close(inode->fd);
+		free(inode);
+	}
+}
+
+// 回收线程：每次取走整个回收链表，在锁外关闭文件描述符并释放，
+// 大量 FORGET 到达时处理线程只在锁内完成链表操作，不会拖慢 LOOKUP
+static void *lo_reclaim_routine(void *data)
+{
+	struct lo_data *lo = (struct lo_data *)data;
+	struct lo_inode *list;
 
 	pthread_mutex_lock(&lo->mutex);
-	for (p = lo->root.next; p != &lo->root; p = p->next)
+	while (1)
 	{
-		if (p->ino == st->st_ino && p->dev == st->st_dev)
-		{
-			assert(p->refcount > 0);
-			ret = p;
-			ret->refcount++;
+		while (lo->reclaim == NULL && !lo->reclaim_stop)
+			pthread_cond_wait(&lo->reclaim_cond, &lo->mutex);
+		list = lo->reclaim;
+		lo->reclaim = NULL;
+		// 停止时先回收完剩余的 inode
+		if (list == NULL)
 			break;
-		}
+		pthread_mutex_unlock(&lo->mutex);
+		lo_free_inodes(list);
+		pthread_mutex_lock(&lo->mutex);
 	}
 	pthread_mutex_unlock(&lo->mutex);
-	return ret;
+	return NULL;
+}
+
+static void lo_reclaim_stop(struct lo_data *lo)
+{
+	if (!lo->reclaim_running)
+		return;
+	pthread_mutex_lock(&lo->mutex);
+	lo->reclaim_stop = 1;
+	pthread_cond_signal(&lo->reclaim_cond);
+	pthread_mutex_unlock(&lo->mutex);
+	pthread_join(lo->reclaim_thread, NULL);
+	lo->reclaim_running = 0;
 }
 
+static void lo_watch_stop(struct lo_data *lo);
+static void lo_sync_stop(struct lo_data *lo);
+
 static void lo_destroy(void *userdata)
 {
 	struct lo_data *lo = (struct lo_data *)userdata;
 
-	while (lo->root.next != &lo->root)
+	lo_uring_destroy(lo->ring);
+	lo->ring = NULL;
+	lo_watch_stop(lo);
+	lo_sync_stop(lo);
+	lo_reclaim_stop(lo);
+}
+
+// 关闭并释放哈希表中剩余的 inode 以及所有的桶
+static void lo_inode_table_destroy(struct lo_data *lo)
+{
+	size_t i, j;
+
+	for (i = 0; i < LO_INODE_SHARDS; i++)
 	{
-		struct lo_inode *next = lo->root.next;
-		lo->root.next = next->next;
-		free(next);
+		struct lo_inode_shard *shard = &lo->shards[i];
+
+		for (j = 0; shard->buckets != NULL && j < shard->nbuckets; j++)
+			lo_free_inodes(shard->buckets[j]);
+		free(shard->buckets);
+		shard->buckets = NULL;
+		shard->count = 0;
+		pthread_mutex_destroy(&shard->lock);
 	}
 }
 
-static int do_lookup(fuse_req_p req, fuse_inode parent, const char *name,
-					 struct fuse_entry_param *e)
+// 监视一个目录，目录中的文件名以及文件内容发生变化时由监视线程通知内核
+// @return inotify 监视描述符，没有开启 --watch 或者不是目录时返回 -1
+static int lo_watch_add(struct lo_data *lo, int fd, mode_t mode)
+{
+	char path[64];
+	int wd;
+
+	if (lo->watch_fd == -1 || !S_ISDIR(mode))
+		return -1;
+	sprintf(path, "/proc/self/fd/%i", fd);
+	wd = inotify_add_watch(lo->watch_fd, path,
+						   IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+						   IN_MODIFY | IN_ATTRIB | IN_ONLYDIR);
+	if (wd == -1)
+		fuse_log(FUSE_LOG_WARNING, "[FUSE_LOG_WARNING] failed to watch directory: %s\n", strerror(errno));
+	return wd;
+}
+
+// 记录 lookup 得到的 inode：inode 已经存在时关闭 newfd 并增加引用计数，否则以 newfd 创建新的 inode；
+// 调用前需要填写好 e->attr
+// @return 0 on success, errno on failure（失败时 newfd 已经被关闭）
+static int lo_add_inode(fuse_req_p req, fuse_inode parent, const char *name, int newfd,
+						struct fuse_entry_param *e)
 {
-	int newfd;
-	int res;
-	int err;
 	struct lo_data *lo = lo_data(req);
 	struct lo_inode *inode;
-	memset(e, 0, sizeof(*e));
+
 	e->attr_timeout = lo->timeout;
 	e->entry_timeout = lo->timeout;
 
-	newfd = openat(lo_fd(req, parent), name, O_PATH | O_NOFOLLOW);
-	if (newfd == -1)
-		goto err_out;
-
-	res = fstatat(newfd, "", &e->attr, AT_EMPTY_PATH | AT_SYMLINK_NOFOLLOW);
-	if (res == -1)
-		goto err_out;
-
 	inode = lo_find(lo_data(req), &e->attr);
 	if (inode)
 	{
@@ -123,25 +416,29 @@ static int do_lookup(fuse_req_p req, fuse_inode parent, const char *name,
 	}
 	else
 	{
-		struct lo_inode *prev, *next;
+		struct lo_inode *found;
 
 		inode = calloc(1, sizeof(struct lo_inode));
 		if (!inode)
-			goto err_out;
+		{
+			close(newfd);
+			return ENOMEM;
+		}
 
-		inode->refcount = 1;
+		atomic_init(&inode->refcount, 1);
 		inode->fd = newfd;
 		inode->ino = e->attr.st_ino;
 		inode->dev = e->attr.st_dev;
+		inode->wd = lo_watch_add(lo, newfd, e->attr.st_mode);
 
-		pthread_mutex_lock(&lo->mutex);
-		prev = &lo->root;
-		next = prev->next;
-		next->prev = inode;
-		inode->next = next;
-		inode->prev = prev;
-		prev->next = inode;
-		pthread_mutex_unlock(&lo->mutex);
+		// 同一个目录的监视描述符相同，并发的 LOOKUP 先加入时不需要移除监视
+		found = lo_inode_insert(lo, inode);
+		if (found != inode)
+		{
+			close(newfd);
+			free(inode);
+			inode = found;
+		}
 	}
 	e->ino = (uintptr_t)inode;
 
@@ -151,6 +448,25 @@ static int do_lookup(fuse_req_p req, fuse_inode parent, const char *name,
 				 (unsigned long long)parent, name, (unsigned long long)e->ino);
 	}
 	return 0;
+}
+
+static int do_lookup(fuse_req_p req, fuse_inode parent, const char *name,
+					 struct fuse_entry_param *e)
+{
+	int newfd;
+	int res;
+	int err;
+	memset(e, 0, sizeof(*e));
+
+	newfd = openat(lo_fd(req, parent), name, O_PATH | O_NOFOLLOW);
+	if (newfd == -1)
+		goto err_out;
+
+	res = fstatat(newfd, "", &e->attr, AT_EMPTY_PATH | AT_SYMLINK_NOFOLLOW);
+	if (res == -1)
+		goto err_out;
+
+	return lo_add_inode(req, parent, name, newfd, e);
 err_out:
 	err = errno;
 	if (newfd != -1)
@@ -158,6 +474,8 @@ err_out:
 	return err;
 }
 
+#include "passthrough_uring.c"
+
 void lo_lookup(fuse_req_p req, fuse_inode parent, const char *name)
 {
 	struct fuse_entry_param e;
@@ -166,6 +484,8 @@ void lo_lookup(fuse_req_p req, fuse_inode parent, const char *name)
 		fuse_log(FUSE_LOG_DEBUG, "[FUSE_LOG_DEBUG] lookup(parent=0x%x, name=%s)\n",
 				 parent, name);
 
+	if (lo_data(req)->ring && lo_uring_lookup(req, parent, name) == 0)
+		return;
 	err = do_lookup(req, parent, name, &e);
 	if (err)
 		send_reply_err(req, err);
@@ -173,42 +493,72 @@ void lo_lookup(fuse_req_p req, fuse_inode parent, const char *name)
 		send_reply_entry(req, &e);
 }
 
-static void forget_one(fuse_req_p req, fuse_inode ino, uint64_t nlookup)
+// 减少 inode 的引用计数，减到 0 时从哈希表中移除
+// @return 需要回收的 inode，没有时返回 NULL
+static struct lo_inode *forget_one_inode(fuse_req_p req, fuse_inode ino, uint64_t nlookup)
 {
 	struct lo_data *lo = lo_data(req);
 	struct lo_inode *inode = lo_inode(req, ino);
 
 	if (inode == NULL)
-		return;
+		return NULL;
 
 	if (req->se->debug)
 	{
 		fuse_log(FUSE_LOG_DEBUG, "[FUSE_LOG_DEBUG] forget 0x%x %llu -%llu\n",
 				 (unsigned long long)ino,
-				 (unsigned long long)inode->refcount,
+				 (unsigned long long)atomic_load(&inode->refcount),
 				 (unsigned long long)nlookup);
 	}
 
-	pthread_mutex_lock(&lo->mutex);
-	assert(inode->refcount >= nlookup);
-	inode->refcount -= nlookup;
-	if (!inode->refcount)
-	{
-		struct lo_inode *prev, *next;
+	inode = lo_inode_unref(lo, inode, nlookup);
+	// 内核已经没有这个目录的缓存，不再需要监视
+	if (inode != NULL && inode->wd != -1)
+		inotify_rm_watch(lo->watch_fd, inode->wd);
+	return inode;
+}
 
-		prev = inode->prev;
-		next = inode->next;
-		next->prev = prev;
-		prev->next = next;
+// 唤醒回收线程，需要持有 lo->mutex；回收线程没有运行时取走回收链表，由调用者在释放锁之后回收
+static struct lo_inode *lo_reclaim_kick(struct lo_data *lo)
+{
+	struct lo_inode *list = NULL;
 
-		pthread_mutex_unlock(&lo->mutex);
-		close(inode->fd);
-		free(inode);
+	if (lo->reclaim == NULL)
+		return NULL;
+	if (lo->reclaim_running)
+	{
+		pthread_cond_signal(&lo->reclaim_cond);
 	}
 	else
 	{
-		pthread_mutex_unlock(&lo->mutex);
+		list = lo->reclaim;
+		lo->reclaim = NULL;
 	}
+	return list;
+}
+
+// 将通过 next 链接的 inode 放入回收链表
+static void lo_reclaim(struct lo_data *lo, struct lo_inode *list)
+{
+	struct lo_inode *next;
+
+	if (list == NULL)
+		return;
+	pthread_mutex_lock(&lo->mutex);
+	for (; list != NULL; list = next)
+	{
+		next = list->next;
+		list->next = lo->reclaim;
+		lo->reclaim = list;
+	}
+	list = lo_reclaim_kick(lo);
+	pthread_mutex_unlock(&lo->mutex);
+	lo_free_inodes(list);
+}
+
+static void forget_one(fuse_req_p req, fuse_inode ino, uint64_t nlookup)
+{
+	lo_reclaim(lo_data(req), forget_one_inode(req, ino, nlookup));
 }
 
 static void lo_forget(fuse_req_p req, fuse_inode ino, uint64_t nlookup)
@@ -217,6 +567,26 @@ static void lo_forget(fuse_req_p req, fuse_inode ino, uint64_t nlookup)
 	send_reply_none(req);
 }
 
+// 整批 FORGET 中需要回收的 inode 只加一次锁放入回收链表
+static void lo_forget_multi(fuse_req_p req, size_t count, struct fuse_forget_data *forgets)
+{
+	struct lo_inode *list = NULL;
+	struct lo_inode *inode;
+	size_t i;
+
+	for (i = 0; i < count; i++)
+	{
+		inode = forget_one_inode(req, forgets[i].ino, forgets[i].nlookup);
+		if (inode != NULL)
+		{
+			inode->next = list;
+			list = inode;
+		}
+	}
+	lo_reclaim(lo_data(req), list);
+	send_reply_none(req);
+}
+
 static void lo_rename(fuse_req_p req, fuse_inode parent, const char *name,
 					  fuse_inode newparent, const char *newname)
 {
@@ -228,9 +598,64 @@ static void lo_rename(fuse_req_p req, fuse_inode parent, const char *name,
 	send_reply_err(req, res == -1 ? errno : 0);
 }
 
+// 内核 passthrough 只用于普通文件
+static int lo_is_passthrough(fuse_req_p req, int fd)
+{
+	struct stat st;
+
+	return req->se->conn.passthrough && fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+// 取得 inode 的 backing_id：同一个 inode 同时打开的所有文件必须共享一个后端文件，
+// 第一次打开时以读写方式重新打开源文件作为后端文件（失败时使用 fd 本身）并注册给内核，之后只增加引用
+// @return backing_id on success, negative errno on failure
+static int lo_backing_get(fuse_req_p req, struct lo_inode *inode, int fd)
+{
+	struct lo_data *lo = lo_data(req);
+	char buf[PATH_MAX];
+	int bfd;
+	int res;
+
+	pthread_mutex_lock(&lo->mutex);
+	if (inode->backing_refs == 0)
+	{
+		// 只读打开的文件之后的写打开也要通过同一个后端文件写入
+		sprintf(buf, "/proc/self/fd/%i", inode->fd);
+		bfd = open(buf, O_RDWR);
+		res = fuse_passthrough_open(req->se, bfd == -1 ? fd : bfd);
+		if (bfd != -1)
+			close(bfd);
+		if (res < 0)
+		{
+			pthread_mutex_unlock(&lo->mutex);
+			return res;
+		}
+		inode->backing_id = res;
+	}
+	inode->backing_refs++;
+	res = inode->backing_id;
+	pthread_mutex_unlock(&lo->mutex);
+	return res;
+}
+
+// 在 release 中释放 lo_backing_get() 取得的引用，最后一个引用释放时关闭 backing_id
+static void lo_backing_put(fuse_req_p req, struct lo_inode *inode)
+{
+	struct lo_data *lo = lo_data(req);
+
+	pthread_mutex_lock(&lo->mutex);
+	if (inode->backing_refs > 0 && --inode->backing_refs == 0)
+	{
+		fuse_passthrough_close(req->se, inode->backing_id);
+		inode->backing_id = 0;
+	}
+	pthread_mutex_unlock(&lo->mutex);
+}
+
 static void lo_open(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
 {
 	int fd;
+	int res;
 	char buf[PATH_MAX];
 	struct lo_data *lo = lo_data(req);
 
@@ -248,9 +673,23 @@ static void lo_open(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
 
 	fi->fh = fd;
 	// if (lo->cache == CACHE_NEVER)
-	fi->direct_io = 1;
+	// writeback cache 需要经过页缓存
+	fi->direct_io = !(req->se->conn.want & FUSE_WRITEBACK_CACHE);
 	// else if (lo->cache == CACHE_ALWAYS)
 	// fi->keep_cache = 1;
+	if (lo_is_passthrough(req, fd))
+	{
+		res = lo_backing_get(req, lo_inode(req, ino), fd);
+		if (res < 0)
+		{
+			close(fd);
+			send_reply_err(req, -res);
+			return;
+		}
+		fi->backing_id = res;
+	}
+	if ((fi->flags & O_ACCMODE) != O_RDONLY)
+		atomic_fetch_add(&lo_inode(req, ino)->writers, 1);
 	send_reply_open(req, fi);
 }
 
@@ -277,15 +716,33 @@ static void lo_create(fuse_req_p req, fuse_inode parent, const char *name,
 
 	fi->fh = fd;
 	// if (lo->cache == CACHE_NEVER)
-	fi->direct_io = 1;
+	// writeback cache 需要经过页缓存
+	fi->direct_io = !(req->se->conn.want & FUSE_WRITEBACK_CACHE);
 	// else if (lo->cache == CACHE_ALWAYS)
 	// fi->keep_cache = 1;
 
 	err = do_lookup(req, parent, name, &e);
 	if (err)
+	{
 		send_reply_err(req, err);
-	else
-		send_reply_create(req, &e, fi);
+		return;
+	}
+	if (lo_is_passthrough(req, fd))
+	{
+		err = lo_backing_get(req, lo_inode(req, e.ino), fd);
+		if (err < 0)
+		{
+			// 创建失败时内核不会为这次 lookup 发送 forget
+			forget_one(req, e.ino, 1);
+			close(fd);
+			send_reply_err(req, -err);
+			return;
+		}
+		fi->backing_id = err;
+	}
+	if ((fi->flags & O_ACCMODE) != O_RDONLY)
+		atomic_fetch_add(&lo_inode(req, e.ino)->writers, 1);
+	send_reply_create(req, &e, fi);
 }
 
 static void lo_read(fuse_req_p req, fuse_inode ino, size_t size,
@@ -301,6 +758,9 @@ static void lo_read(fuse_req_p req, fuse_inode ino, size_t size,
 								 "off=%lu)\n",
 				 ino, size, (unsigned long)offset);
 
+	if (lo_data(req)->ring && lo_uring_read(req, fi->fh, size, offset) == 0)
+		return;
+
 	buf.flags = FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK;
 	buf.fd = fi->fh;
 	buf.pos = offset;
@@ -308,26 +768,29 @@ static void lo_read(fuse_req_p req, fuse_inode ino, size_t size,
 	send_reply_read(req, &buf);
 }
 
-static void lo_write(fuse_req_p req, fuse_inode ino, char *buf,
-					 size_t size, off_t off, struct fuse_file_info *fi)
+static void lo_write_buf(fuse_req_p req, fuse_inode ino, struct fuse_bufvec *in_buf,
+						 off_t off, struct fuse_file_info *fi)
 {
 #ifdef CRASH_TEST
 	sleep(10);
 #endif
-	struct fuse_buf outbuf = {.mem = NULL, .size = size};
-	outbuf.flags = FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK;
-	outbuf.fd = fi->fh;
-	outbuf.pos = off;
-
-	struct fuse_buf inbuf = {.mem = buf, .size = size, .flags = 0};
+	struct fuse_bufvec out_buf = FUSE_BUFVEC_INIT(fuse_buf_size(in_buf));
+	out_buf.buf[0].flags = FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK;
+	out_buf.buf[0].fd = fi->fh;
+	out_buf.buf[0].pos = off;
 
 	if (req->se->debug)
-		fuse_log(FUSE_LOG_DEBUG, "[FUSE_LOG_DEBUG] write(ino=0x%x, size=%zd, off=%lu)\n",
-				 ino, size, (unsigned long)off);
+		fuse_log(FUSE_LOG_DEBUG, "[FUSE_LOG_DEBUG] write_buf(ino=0x%x, size=%zd, off=%lu)\n",
+				 ino, out_buf.buf[0].size, (unsigned long)off);
 
-	send_reply_write(req, &outbuf, &inbuf);
+	if (lo_data(req)->ring && lo_uring_write(req, fi->fh, in_buf, off) == 0)
+		return;
+	send_reply_write_buf(req, &out_buf, in_buf);
 }
 
+#define LO_FILE_FD(fh) ((int)(fh))
+#include "passthrough_file.c"
+
 static void lo_unlink(fuse_req_p req, fuse_inode parent, const char *name)
 {
 	int res;
@@ -339,8 +802,11 @@ static void lo_unlink(fuse_req_p req, fuse_inode parent, const char *name)
 
 static void lo_release(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
 {
-	(void)ino;
-
+	// 开启 passthrough 后普通文件的每次打开都持有一个后端文件的引用
+	if (lo_is_passthrough(req, fi->fh))
+		lo_backing_put(req, lo_inode(req, ino));
+	if ((fi->flags & O_ACCMODE) != O_RDONLY)
+		atomic_fetch_sub(&lo_inode(req, ino)->writers, 1);
 	close(fi->fh);
 	send_reply_ok(req, NULL, 0);
 }
@@ -362,6 +828,142 @@ static void lo_flush(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
 		send_reply_err(req, errno);
 }
 
+static void lo_sync_reply(fuse_req_p req, void *data)
+{
+	send_reply_err(req, (int)(intptr_t)data);
+}
+
+// 同步一批请求：后端文件系统上只有一个请求时直接 fsync/fdatasync 这个文件，
+// 否则每个后端文件系统只调用一次 syncfs，结果回复给这个文件系统上的所有请求
+static void lo_sync_batch(struct lo_sync_req *batch)
+{
+	struct lo_sync_req *s, *t;
+	unsigned count = 0, syncs = 0;
+	int debug = batch->req->se->debug;
+	int res;
+
+	for (s = batch; s != NULL; s = s->next)
+	{
+		if (s->err != -1)
+			continue;
+		for (t = s->next; t != NULL; t = t->next)
+			if (t->err == -1 && t->dev == s->dev)
+				break;
+		if (t == NULL)
+		{
+			res = s->datasync ? fdatasync(s->fd) : fsync(s->fd);
+			s->err = res == -1 ? errno : 0;
+			continue;
+		}
+		res = syncfs(s->fd);
+		s->err = res == -1 ? errno : 0;
+		syncs++;
+		for (t = s->next; t != NULL; t = t->next)
+			if (t->err == -1 && t->dev == s->dev)
+				t->err = s->err;
+	}
+	while ((s = batch) != NULL)
+	{
+		batch = s->next;
+		count++;
+		fuse_req_complete(s->req, lo_sync_reply, (void *)(intptr_t)s->err);
+		if (s->close_fd)
+			close(s->fd);
+		free(s);
+	}
+	if (debug)
+		fuse_log(FUSE_LOG_DEBUG, "[FUSE_LOG_DEBUG] group commit: %u fsyncs, %u syncfs\n", count, syncs);
+}
+
+// 同步线程：每次取走所有等待中的请求作为一批同步，
+// 同步期间到达的请求留到下一批，保证每个请求的数据都在它所在的那一轮开始之前写入
+static void *lo_sync_routine(void *data)
+{
+	struct lo_data *lo = (struct lo_data *)data;
+	struct lo_sync_req *batch;
+
+	pthread_mutex_lock(&lo->sync_lock);
+	while (1)
+	{
+		while (lo->sync_list == NULL && !lo->sync_stop)
+			pthread_cond_wait(&lo->sync_cond, &lo->sync_lock);
+		// 停止时先同步完剩余的请求
+		if (lo->sync_list == NULL)
+			break;
+		if (lo->sync_window && !lo->sync_stop)
+		{
+			pthread_mutex_unlock(&lo->sync_lock);
+			usleep(lo->sync_window);
+			pthread_mutex_lock(&lo->sync_lock);
+		}
+		batch = lo->sync_list;
+		lo->sync_list = NULL;
+		pthread_mutex_unlock(&lo->sync_lock);
+		lo_sync_batch(batch);
+		pthread_mutex_lock(&lo->sync_lock);
+	}
+	pthread_mutex_unlock(&lo->sync_lock);
+	return NULL;
+}
+
+static void lo_sync_start(struct lo_data *lo)
+{
+	if (lo->no_group_commit || lo->sync_running)
+		return;
+	lo->sync_stop = 0;
+	if (pthread_create(&lo->sync_thread, NULL, lo_sync_routine, lo) == 0)
+		lo->sync_running = 1;
+	else
+		fuse_log(FUSE_LOG_WARNING, "[FUSE_LOG_WARNING] failed to start the group commit thread\n");
+}
+
+static void lo_sync_stop(struct lo_data *lo)
+{
+	if (!lo->sync_running)
+		return;
+	pthread_mutex_lock(&lo->sync_lock);
+	lo->sync_stop = 1;
+	pthread_cond_signal(&lo->sync_cond);
+	pthread_mutex_unlock(&lo->sync_lock);
+	pthread_join(lo->sync_thread, NULL);
+	lo->sync_running = 0;
+}
+
+// 同步线程在运行时请求交给它组提交，处理函数直接返回；否则在当前线程同步
+// @param close_fd fd 是否由调用者临时打开，同步之后关闭
+static void lo_sync(fuse_req_p req, fuse_inode ino, int fd, int datasync, int close_fd)
+{
+	struct lo_data *lo = lo_data(req);
+	struct lo_sync_req *s;
+	int res;
+
+	if (lo->sync_running && (s = malloc(sizeof(struct lo_sync_req))) != NULL)
+	{
+		s->req = req;
+		s->fd = fd;
+		s->dev = lo_inode(req, ino)->dev;
+		s->datasync = datasync;
+		s->close_fd = close_fd;
+		s->err = -1;
+		pthread_mutex_lock(&lo->sync_lock);
+		s->next = lo->sync_list;
+		lo->sync_list = s;
+		if (s->next == NULL)
+			pthread_cond_signal(&lo->sync_cond);
+		pthread_mutex_unlock(&lo->sync_lock);
+		return;
+	}
+	res = datasync ? fdatasync(fd) : fsync(fd);
+	send_reply_err(req, res == -1 ? errno : 0);
+	if (close_fd)
+		close(fd);
+}
+
+static void lo_fsync(fuse_req_p req, fuse_inode ino, int datasync, struct fuse_file_info *fi)
+{
+	lo_sync(req, ino, fi->fh, datasync, 0);
+}
+
 struct lo_dirp
 {
 	DIR *dp;
@@ -374,16 +976,16 @@ static struct lo_dirp *lo_dirp(struct fuse_file_info *fi)
 	return (struct lo_dirp *)(uintptr_t)fi->fh;
 }
 
-static void lo_opendir(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
+// 打开一个目录流，失败时返回 NULL 并设置 errno
+static struct lo_dirp *lo_dirp_open(fuse_req_p req, fuse_inode ino)
 {
-	int err;
-	struct lo_data *lo = lo_data(req);
 	struct lo_dirp *d;
 	int fd;
+	int err;
 
 	d = calloc(1, sizeof(struct lo_dirp));
 	if (d == NULL)
-		goto err_out;
+		return NULL;
 
 	fd = openat(lo_fd(req, ino), ".", O_RDONLY);
 	if (fd == -1)
@@ -391,26 +993,45 @@ static void lo_opendir(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi
 
 	d->dp = fdopendir(fd);
 	if (d->dp == NULL)
+	{
+		err = errno;
+		close(fd);
+		errno = err;
 		goto err_out;
+	}
 
 	d->offset = 0;
 	d->entry = NULL;
-
-	fi->fh = (uintptr_t)d;
-	// if (lo->cache == CACHE_ALWAYS)
-	// 	fi->cache_readdir = 1;
-	send_reply_open(req, fi);
-	return;
+	return d;
 
 err_out:
 	err = errno;
-	if (d)
+	free(d);
+	errno = err;
+	return NULL;
+}
+
+static void lo_dirp_close(struct lo_dirp *d)
+{
+	closedir(d->dp);
+	free(d);
+}
+
+static void lo_opendir(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
+{
+	struct lo_dirp *d;
+
+	d = lo_dirp_open(req, ino);
+	if (d == NULL)
 	{
-		if (fd != -1)
-			close(fd);
-		free(d);
+		send_reply_err(req, errno);
+		return;
 	}
-	send_reply_err(req, err);
+
+	fi->fh = (uintptr_t)d;
+	// if (lo->cache == CACHE_ALWAYS)
+	// 	fi->cache_readdir = 1;
+	send_reply_open(req, fi);
 }
 
 static void lo_mkdir(fuse_req_p req, fuse_inode parent, const char *name,
@@ -450,47 +1071,85 @@ static void lo_rmdir(fuse_req_p req, fuse_inode parent, const char *name)
 	send_reply_err(req, res == -1 ? errno : 0);
 }
 
-size_t fuse_add_direntry(fuse_req_p req, char *buf, size_t bufsize,
-						 const char *name, const struct stat *stbuf, off_t off)
+// 在 dfd 指向的目录中查找 name：先通过 fstatat 取得属性，inode 已经存在时只增加引用计数，
+// 省去 openat 以及 close，只有新的 inode 才需要以 O_PATH 打开
+// @return 0 on success, errno on failure
+static int lo_lookup_at(fuse_req_p req, fuse_inode parent, int dfd, const char *name,
+						struct fuse_entry_param *e)
 {
-	(void)req;
-	size_t namelen;
-	size_t entlen;
-	size_t entlen_padded;
-	struct fuse_dirent *dirent;
+	struct lo_data *lo = lo_data(req);
+	struct lo_inode *inode;
+	int newfd;
+	int err;
 
-	namelen = strlen(name);
-	entlen = FUSE_NAME_OFFSET + namelen;
-	// 内存对齐，内存起始位置必须为 8 字节的整数倍，多余的补0
-	entlen_padded = FUSE_DIRENT_ALIGN(entlen);
+	memset(e, 0, sizeof(*e));
+	if (fstatat(dfd, name, &e->attr, AT_SYMLINK_NOFOLLOW) == -1)
+		return errno;
 
-	if ((buf == NULL) || (entlen_padded > bufsize))
+	inode = lo_find(lo, &e->attr);
+	if (inode)
+	{
+		e->ino = (uintptr_t)inode;
+		e->attr_timeout = lo->timeout;
+		e->entry_timeout = lo->timeout;
 		return 0;
+	}
 
-	dirent = (struct fuse_dirent *)buf;
-	dirent->ino = stbuf->st_ino;
-	dirent->off = off;
-	dirent->namelen = namelen;
-	dirent->type = (stbuf->st_mode & S_IFMT) >> 12;
-	memcpy(dirent->name, name, namelen);
-	memset(dirent->name + namelen, 0, entlen_padded - entlen);
+	newfd = openat(dfd, name, O_PATH | O_NOFOLLOW);
+	if (newfd == -1)
+		return errno;
+	// 目录项可能在 fstatat 之后被替换，以打开的文件为准
+	if (fstatat(newfd, "", &e->attr, AT_EMPTY_PATH | AT_SYMLINK_NOFOLLOW) == -1)
+	{
+		err = errno;
+		close(newfd);
+		return err;
+	}
+	return lo_add_inode(req, parent, name, newfd, e);
+}
 
-	return entlen_padded;
+static int lo_is_dot_or_dotdot(const char *name)
+{
+	return name[0] == '.' &&
+		   (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
 }
 
-static void lo_readdir(fuse_req_p req, fuse_inode ino, size_t size,
-					   off_t offset, struct fuse_file_info *fi)
+// plus 为 1 时处理 READDIRPLUS，在填写目录项的同时完成每个目录项的查找（"." 和 ".." 除外），
+// 内核不再需要为每个目录项单独发送 LOOKUP；
+// 填不下的目录项保留在 d->entry 中，下一次从这里继续
+static void lo_do_readdir(fuse_req_p req, fuse_inode ino, size_t size,
+						  off_t offset, struct fuse_file_info *fi, int plus)
 {
 	struct lo_dirp *d = lo_dirp(fi);
-	char *buf = NULL;
+	struct lo_dirp *tmp = NULL;
+	struct fuse_entry_param e;
+	char *buf;
 	char *p;
 	size_t rem = size;
-	int err;
+	size_t entsize;
+	off_t nextoff;
+	const char *name;
+	int err = 0;
+
+	// 开启 --no_opendir 后没有 OPENDIR，fh 为 0，每次读取时临时打开目录，
+	// 偏移是上一次读到的 d_off，由后端文件系统在新的目录流中通过 seekdir 定位
+	if (d == NULL)
+	{
+		d = tmp = lo_dirp_open(req, ino);
+		if (d == NULL)
+		{
+			send_reply_err(req, errno);
+			return;
+		}
+	}
 
 	buf = calloc(1, size);
 	if (buf == NULL)
 	{
-		goto err_out;
+		if (tmp)
+			lo_dirp_close(tmp);
+		send_reply_err(req, ENOMEM);
+		return;
 	}
 	p = buf;
 
@@ -500,48 +1159,112 @@ static void lo_readdir(fuse_req_p req, fuse_inode ino, size_t size,
 		d->entry = NULL;
 		d->offset = offset;
 	}
-	errno = 0;
-	size_t entsize;
-	off_t nextoff;
-	const char *name;
-	d->entry = readdir(d->dp);
-	while (d->entry)
+	while (1)
 	{
+		if (d->entry == NULL)
+		{
+			errno = 0;
+			d->entry = readdir(d->dp);
+			if (d->entry == NULL)
+			{
+				err = errno;
+				break;
+			}
+		}
 		nextoff = d->entry->d_off;
 		name = d->entry->d_name;
-		struct stat st = {
-			.st_ino = d->entry->d_ino,
-			.st_mode = d->entry->d_type << 12,
-		};
-		entsize = fuse_add_direntry(req, p, rem, name,
-									&st, nextoff);
-		if (entsize == 0)
-			break;
+		if (plus)
+		{
+			if (lo_is_dot_or_dotdot(name))
+			{
+				memset(&e, 0, sizeof(e));
+				e.attr.st_ino = d->entry->d_ino;
+				e.attr.st_mode = d->entry->d_type << 12;
+			}
+			else
+			{
+				err = lo_lookup_at(req, ino, dirfd(d->dp), name, &e);
+				if (err == ENOENT)
+				{
+					// 目录项在读取之后被删除，跳过
+					err = 0;
+					d->entry = NULL;
+					d->offset = nextoff;
+					continue;
+				}
+				if (err)
+					break;
+			}
+			entsize = fuse_add_direntry_plus(req, p, rem, name, &e, nextoff);
+			if (entsize == 0)
+			{
+				// 没有发送给内核的目录项不会增加查找计数
+				if (e.ino)
+					forget_one(req, e.ino, 1);
+				break;
+			}
+		}
+		else
+		{
+			struct stat st = {
+				.st_ino = d->entry->d_ino,
+				.st_mode = d->entry->d_type << 12,
+			};
+			entsize = fuse_add_direntry(req, p, rem, name, &st, nextoff);
+			if (entsize == 0)
+				break;
+		}
 		p += entsize;
 		rem -= entsize;
-		d->entry = readdir(d->dp);
+		d->entry = NULL;
 		d->offset = nextoff;
 	}
-	if (errno)
-		goto err_out;
-	send_reply_ok(req, buf, size - rem);
-	return;
-err_out:
-	err = errno;
-	if (buf)
-		free(buf);
-	send_reply_err(req, err);
+	// 已经填写了目录项时先返回这些目录项，错误留到下一次读取
+	if (err && rem == size)
+		send_reply_err(req, err);
+	else
+		send_reply_ok(req, buf, size - rem);
+	free(buf);
+	if (tmp)
+		lo_dirp_close(tmp);
+}
+
+static void lo_readdir(fuse_req_p req, fuse_inode ino, size_t size,
+					   off_t offset, struct fuse_file_info *fi)
+{
+	lo_do_readdir(req, ino, size, offset, fi, 0);
+}
+
+static void lo_readdirplus(fuse_req_p req, fuse_inode ino, size_t size,
+						   off_t offset, struct fuse_file_info *fi)
+{
+	lo_do_readdir(req, ino, size, offset, fi, 1);
 }
 
 static void lo_releasedir(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
 {
-	struct lo_dirp *d = lo_dirp(fi);
 	(void)ino;
-	closedir(d->dp);
-	free(d);
+	lo_dirp_close(lo_dirp(fi));
 	send_reply_ok(req, NULL, 0);
 }
 
+static void lo_fsyncdir(fuse_req_p req, fuse_inode ino, int datasync, struct fuse_file_info *fi)
+{
+	int fd;
+
+	if (fi->fh != 0)
+	{
+		lo_sync(req, ino, dirfd(lo_dirp(fi)->dp), datasync, 0);
+		return;
+	}
+	// 没有 OPENDIR 时临时打开目录，同步之后关闭
+	fd = openat(lo_fd(req, ino), ".", O_RDONLY);
+	if (fd == -1)
+		send_reply_err(req, errno);
+	else
+		lo_sync(req, ino, fd, datasync, 1);
+}
+
 static void lo_getattr(fuse_req_p req, fuse_inode ino,
 					   struct fuse_file_info *fi)
 {
@@ -551,6 +1274,8 @@ static void lo_getattr(fuse_req_p req, fuse_inode ino,
 
 	(void)fi;
 
+	if (lo->ring && lo_uring_getattr(req, lo_fd(req, ino)) == 0)
+		return;
 	res = fstatat(lo_fd(req, ino), "", &stbuf, AT_EMPTY_PATH | AT_SYMLINK_NOFOLLOW);
 	if (res == 0)
 		send_reply_attr(req, &stbuf, lo->timeout);
@@ -642,40 +1367,343 @@ err_out:
 	send_reply_err(req, err);
 }
 
+// 监视线程对一个事件的处理方式
+enum lo_watch_action
+{
+	LO_WATCH_NONE,
+	LO_WATCH_ENTRY,		// 目录项被创建、删除或者移动，失效目录项以及父目录的属性
+	LO_WATCH_ATTR,		// 属性变化，只失效属性
+	LO_WATCH_DATA,		// 内容变化，失效属性以及页缓存
+};
+
+static enum lo_watch_action lo_watch_action(const struct inotify_event *ev)
+{
+	if (ev->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO))
+		return LO_WATCH_ENTRY;
+	if (ev->mask & IN_MODIFY)
+		return LO_WATCH_DATA;
+	if (ev->mask & IN_ATTRIB)
+		return LO_WATCH_ATTR;
+	return LO_WATCH_NONE;
+}
+
+// 查找监视描述符对应的目录，同时 dup 目录的文件描述符，用于查找目录中的文件
+// @return 目录的 nodeid，目录已经被内核遗忘时返回 0
+static fuse_inode lo_watch_dir(struct lo_data *lo, int wd, int *dfd)
+{
+	struct lo_inode *p;
+	fuse_inode nodeid = 0;
+	size_t i, j;
+
+	*dfd = -1;
+	if (lo->root.wd == wd)
+	{
+		*dfd = dup(lo->root.fd);
+		return FUSE_ROOT_ID;
+	}
+	for (i = 0; nodeid == 0 && i < LO_INODE_SHARDS; i++)
+	{
+		struct lo_inode_shard *shard = &lo->shards[i];
+
+		pthread_mutex_lock(&shard->lock);
+		for (j = 0; nodeid == 0 && j < shard->nbuckets; j++)
+		{
+			for (p = shard->buckets[j]; p != NULL; p = p->next)
+			{
+				if (p->wd == wd)
+				{
+					nodeid = (uintptr_t)p;
+					*dfd = dup(p->fd);
+					break;
+				}
+			}
+		}
+		pthread_mutex_unlock(&shard->lock);
+	}
+	return nodeid;
+}
+
+// 通过 (dev, ino) 在 inode 哈希表中查找目录中的文件
+// @param data 是否是内容的变化，通过挂载点以写方式打开的文件的内容变化来自守护进程自己的写入，
+//             内核的页缓存已经是最新的，失效反而使 writeback 以及较长的 --timeout 失去作用
+// @return 文件的 nodeid，内核中没有这个文件的缓存或者不需要通知时返回 0
+static fuse_inode lo_watch_child(struct lo_data *lo, int dfd, const char *name, int data)
+{
+	struct lo_inode_shard *shard;
+	struct lo_inode *inode;
+	struct stat st;
+	uint64_t hash;
+
+	if (fstatat(dfd, name, &st, AT_SYMLINK_NOFOLLOW) == -1)
+		return 0;
+	hash = lo_inode_hash(st.st_dev, st.st_ino);
+	shard = lo_shard(lo, hash);
+	pthread_mutex_lock(&shard->lock);
+	inode = lo_find_locked(shard, hash, st.st_dev, st.st_ino);
+	if (inode != NULL && data && atomic_load(&inode->writers) > 0)
+		inode = NULL;
+	pthread_mutex_unlock(&shard->lock);
+	return (uintptr_t)inode;
+}
+
+// 将一个 inotify 事件转换为内核的失效通知：
+// 通知在锁外发送，nodeid 对应的 inode 可能已经被回收，此时内核找不到这个 nodeid，通知没有作用
+static void lo_watch_event(struct lo_data *lo, const struct inotify_event *ev, enum lo_watch_action action)
+{
+	fuse_inode parent;
+	fuse_inode child;
+	int dfd;
+
+	parent = lo_watch_dir(lo, ev->wd, &dfd);
+	if (parent == 0)
+		return;
+	if (ev->len == 0)
+	{
+		// 目录自身的变化
+		fuse_notify_inval_inode(lo->se, parent, -1, 0);
+	}
+	else if (action == LO_WATCH_ENTRY)
+	{
+		fuse_notify_inval_entry(lo->se, parent, ev->name, strlen(ev->name));
+		fuse_notify_inval_inode(lo->se, parent, -1, 0);
+	}
+	else
+	{
+		child = lo_watch_child(lo, dfd, ev->name, action == LO_WATCH_DATA);
+		if (child != 0)
+			fuse_notify_inval_inode(lo->se, child, action == LO_WATCH_DATA ? 0 : -1, 0);
+	}
+	if (dfd != -1)
+		close(dfd);
+}
+
+// inotify 队列溢出后事件已经丢失，失效所有 inode 的属性以及页缓存；
+// 内核缓存的目录项无法枚举，只能等待它们超时
+static void lo_watch_overflow(struct lo_data *lo)
+{
+	struct lo_inode *p;
+	fuse_inode *nodeids;
+	size_t n = 0;
+	size_t i, j;
+
+	fuse_log(FUSE_LOG_WARNING, "[FUSE_LOG_WARNING] inotify queue overflow, invalidate all cached inodes\n");
+	// 同时持有所有分片的锁，取得一致的 inode 列表
+	for (i = 0; i < LO_INODE_SHARDS; i++)
+	{
+		pthread_mutex_lock(&lo->shards[i].lock);
+		n += lo->shards[i].count;
+	}
+	nodeids = (fuse_inode *)malloc((n + 1) * sizeof(fuse_inode));
+	if (nodeids != NULL)
+	{
+		n = 0;
+		nodeids[n++] = FUSE_ROOT_ID;
+		for (i = 0; i < LO_INODE_SHARDS; i++)
+		{
+			for (j = 0; j < lo->shards[i].nbuckets; j++)
+			{
+				for (p = lo->shards[i].buckets[j]; p != NULL; p = p->next)
+					nodeids[n++] = (uintptr_t)p;
+			}
+		}
+	}
+	for (i = 0; i < LO_INODE_SHARDS; i++)
+		pthread_mutex_unlock(&lo->shards[i].lock);
+	if (nodeids == NULL)
+		return;
+	for (i = 0; i < n; i++)
+		fuse_notify_inval_inode(lo->se, nodeids[i], 0, 0);
+	free(nodeids);
+}
+
+// 监视线程：每次读出一批 inotify 事件，连续的相同事件（如持续写入同一个文件）只通知一次
+static void *lo_watch_routine(void *data)
+{
+	struct lo_data *lo = (struct lo_data *)data;
+	char buf[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	const struct inotify_event *prev;
+	enum lo_watch_action action;
+	enum lo_watch_action prev_action = LO_WATCH_NONE;
+	struct pollfd pfd[2];
+	ssize_t len;
+	char *p;
+
+	pfd[0].fd = lo->watch_fd;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = lo->watch_efd;
+	pfd[1].events = POLLIN;
+	while (1)
+	{
+		if (poll(pfd, 2, -1) == -1 && errno != EINTR)
+			break;
+		if (pfd[1].revents & POLLIN)
+			break;
+		len = read(lo->watch_fd, buf, sizeof(buf));
+		if (len <= 0)
+		{
+			if (len == -1 && (errno == EAGAIN || errno == EINTR))
+				continue;
+			break;
+		}
+		prev = NULL;
+		for (p = buf; p < buf + len; p += sizeof(struct inotify_event) + ev->len)
+		{
+			ev = (const struct inotify_event *)p;
+			if (ev->mask & IN_Q_OVERFLOW)
+			{
+				lo_watch_overflow(lo);
+				prev = NULL;
+				continue;
+			}
+			action = lo_watch_action(ev);
+			if (action == LO_WATCH_NONE)
+				continue;
+			if (prev != NULL && prev->wd == ev->wd && prev_action == action &&
+				prev->len == ev->len && strcmp(prev->name, ev->name) == 0)
+				continue;
+			lo_watch_event(lo, ev, action);
+			prev = ev;
+			prev_action = action;
+		}
+	}
+	return NULL;
+}
+
+// 创建 inotify 以及监视线程，从根目录开始监视，之后的目录在 lookup 时加入
+static void lo_watch_start(struct lo_data *lo, struct fuse_conn_info *conn)
+{
+	lo->se = fuse_conn_session(conn);
+	lo->watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (lo->watch_fd == -1)
+		goto err_out;
+	lo->watch_efd = eventfd(0, EFD_CLOEXEC);
+	if (lo->watch_efd == -1)
+		goto err_out;
+	lo->root.wd = lo_watch_add(lo, lo->root.fd, S_IFDIR);
+	if (lo->root.wd == -1)
+		goto err_out;
+	if (pthread_create(&lo->watch_thread, NULL, lo_watch_routine, lo) != 0)
+		goto err_out;
+	return;
+
+err_out:
+	fuse_log(FUSE_LOG_WARNING, "[FUSE_LOG_WARNING] failed to watch the source directory, --watch is ignored\n");
+	if (lo->watch_efd != -1)
+		close(lo->watch_efd);
+	if (lo->watch_fd != -1)
+		close(lo->watch_fd);
+	lo->watch_efd = -1;
+	lo->watch_fd = -1;
+	lo->root.wd = -1;
+}
+
+static void lo_watch_stop(struct lo_data *lo)
+{
+	uint64_t one = 1;
+
+	if (lo->watch_fd == -1)
+		return;
+	if (write(lo->watch_efd, &one, sizeof(one)) == sizeof(one))
+		pthread_join(lo->watch_thread, NULL);
+	close(lo->watch_efd);
+	close(lo->watch_fd);
+	lo->watch_efd = -1;
+	lo->watch_fd = -1;
+}
+
+static void lo_init(void *userdata, struct fuse_conn_info *conn)
+{
+	struct lo_data *lo = (struct lo_data *)userdata;
+
+	// 收割线程不能在 fuse_daemonize() 的 fork 之前创建
+	if (lo->uring && lo->ring == NULL)
+	{
+		lo->ring = lo_uring_new();
+		if (lo->ring == NULL)
+			fuse_log(FUSE_LOG_WARNING, "[FUSE_LOG_WARNING] io_uring is not available, use synchronous I/O\n");
+	}
+	if (lo->passthrough)
+		conn->passthrough = 1;
+	if (lo->writeback && (conn->capable & FUSE_WRITEBACK_CACHE))
+		conn->want |= FUSE_WRITEBACK_CACHE;
+	// lo_open() 以原样的 flags 打开源文件，O_TRUNC 随 OPEN 一起完成，内核不再为它发送 SETATTR
+	if (conn->capable & FUSE_ATOMIC_O_TRUNC)
+		conn->want |= FUSE_ATOMIC_O_TRUNC;
+	if (lo->no_opendir)
+		conn->no_opendir = 1;
+	if (lo->watch && lo->watch_fd == -1)
+		lo_watch_start(lo, conn);
+	lo_sync_start(lo);
+	// 与收割线程一样在 fork 之后创建，创建失败时在 forget 中直接回收
+	if (!lo->reclaim_running)
+	{
+		lo->reclaim_stop = 0;
+		if (pthread_create(&lo->reclaim_thread, NULL, lo_reclaim_routine, lo) == 0)
+			lo->reclaim_running = 1;
+		else
+			fuse_log(FUSE_LOG_WARNING, "[FUSE_LOG_WARNING] failed to start the inode reclaim thread\n");
+	}
+}
+
 static struct fuse_ops ops = {
+	.init = lo_init,
 	.destroy = lo_destroy,
 	.lookup = lo_lookup,
 	.forget = lo_forget,
+	.forget_multi = lo_forget_multi,
 	.rename = lo_rename,
 	.open = lo_open,
 	.create = lo_create,
 	.read = lo_read,
-	.write = lo_write,
+	.write_buf = lo_write_buf,
+	.copy_file_range = lo_copy_file_range,
+	.fallocate = lo_fallocate,
+	.lseek = lo_lseek,
 	.unlink = lo_unlink,
 	.release = lo_release,
 	.flush = lo_flush,
+	.fsync = lo_fsync,
 	.opendir = lo_opendir,
 	.mkdir = lo_mkdir,
 	.rmdir = lo_rmdir,
 	.readdir = lo_readdir,
+	.readdirplus = lo_readdirplus,
 	.releasedir = lo_releasedir,
+	.fsyncdir = lo_fsyncdir,
 	.getattr = lo_getattr,
-	.setattr = lo_setattr
+	.setattr = lo_setattr,
+	.batch_end = lo_batch_end
 };
 
 int main(int argc, char *argv[])
 {
 	struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
 	int res = -EBUILD;
-	struct lo_data lo = {.timeout = 0};
+	struct lo_data lo = {.timeout = 0, .uring = 0, .ring = NULL, .passthrough = 0, .writeback = 0,
+						 .watch = 0, .watch_fd = -1, .watch_efd = -1, .se = NULL,
+						 .no_opendir = 0, .no_group_commit = 0, .sync_window = 0, .sync_list = NULL, .sync_running = 0};
 	pthread_mutex_init(&lo.mutex, NULL);
-	lo.root.next = lo.root.prev = &lo.root;
+	pthread_cond_init(&lo.reclaim_cond, NULL);
+	pthread_mutex_init(&lo.sync_lock, NULL);
+	pthread_cond_init(&lo.sync_cond, NULL);
+	lo.reclaim = NULL;
+	lo.reclaim_running = 0;
+	lo.root.next = NULL;
 	lo.root.fd = -1;
+	lo.root.wd = -1;
 	lo.source = NULL;
 	int alloc = 0;
 
+	if (lo_inode_table_init(&lo) < 0)
+	{
+		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] failed to allocate the inode table\n");
+		res = -ENOMEM;
+		goto err_out;
+	}
 	if (fuse_opts_parse(&args, &lo, lo_opts) == -1)
 		goto err_out;
+	lo.timeout = lo.timeout_sec;
 	if (lo.source)
 	{
 		alloc = 1;
@@ -699,7 +1727,7 @@ int main(int argc, char *argv[])
 	{
 		lo.source = "/";
 	}
-	lo.root.refcount = 2;
+	atomic_init(&lo.root.refcount, 2);
 	lo.root.fd = open(lo.source, O_PATH);
 	if (lo.root.fd == -1)
 	{
@@ -707,10 +1735,15 @@ int main(int argc, char *argv[])
 				 lo.source, strerror(errno));
 		goto err_out;
 	}
+	// 组提交根据 dev 区分后端文件系统，根目录不经过 lookup，需要在这里填写
+	struct stat root_stat;
+	if (fstat(lo.root.fd, &root_stat) == 0)
+		lo.root.dev = root_stat.st_dev;
 
 	res=fuse_normal_mode(&args,&ops,&lo,fuse_passthrough_help);
 
 err_out:
+	lo_inode_table_destroy(&lo);
 	free_lo_data(&lo,alloc);
 	free_fuse_args(&args);
 
@@ -9,21 +9,20 @@
 #include <fcntl.h>
 #include <dirent.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <sys/mman.h>
 
 struct lo_inode
 {
-	int used;			   /* protected by lo->mutex */
-						   // 标志预先分配的池中 lo_inode 结构体是否已经被占用
-	struct lo_inode *next; /* protected by lo->mutex */
-	struct lo_inode *prev; /* protected by lo->mutex */
+	int used;			   // 标志预先分配的池中 lo_inode 结构体是否已经被占用
+	struct lo_inode *next; /* 哈希桶中的下一个 inode，protected by 分片的锁 */
 
 	int fd;
 	int backupfd; 			// 复制工作进程中的 fd 到故障恢复进程得到的 fd；
 				  			// 故障发生后故障恢复进程修复会把 fd 字段设置成 backupfd，然后 backupfd 设置为 -1；
 	ino_t ino;
 	dev_t dev;
-	uint64_t refcount; 		/* protected by lo->mutex */
+	_Atomic(uint64_t) refcount; /* 只在分片的锁内减到 0 */
 };
 
 struct lo_fdmap
@@ -42,10 +41,9 @@ struct lo_dirp
 
 struct lo_data
 {
-	pthread_mutex_t mutex; // 循环遍历 lo_inode 的锁
 	char *source;		   // 该文件系统被重定向的目标路径
 	double timeout;
-	struct lo_inode root; // 通过上面的 mutex 来控制访问
+	struct lo_inode root;  // 根目录不在哈希表中，引用计数不会减到 0
 };
 
 #include "passthrough_cr_func.c"
@@ -93,22 +91,8 @@ static struct lo_dirp *lo_dirp(struct fuse_file_info *fi)
 
 static struct lo_inode *lo_find(struct lo_data *lo, struct stat *st)
 {
-	struct lo_inode *p;
-	struct lo_inode *ret = NULL;
-
-	pthread_mutex_lock(&lo->mutex);
-	for (p = lo->root.next; p != &lo->root; p = p->next)
-	{
-		if (p->ino == st->st_ino && p->dev == st->st_dev)
-		{
-			assert(p->refcount > 0);
-			ret = p;
-			ret->refcount++;
-			break;
-		}
-	}
-	pthread_mutex_unlock(&lo->mutex);
-	return ret;
+	(void)lo;
+	return lo_inode_find(st->st_dev, st->st_ino);
 }
 
 static int do_lookup(fuse_req_p req, fuse_inode parent, const char *name,
@@ -139,7 +123,7 @@ static int do_lookup(fuse_req_p req, fuse_inode parent, const char *name,
 	}
 	else
 	{
-		struct lo_inode *prev, *next;
+		struct lo_inode *found;
 
 		inode = alloc_inode();
 		if (inode==NULL)
@@ -148,22 +132,22 @@ static int do_lookup(fuse_req_p req, fuse_inode parent, const char *name,
 			goto err_out;
 		}
 
-		inode->refcount = 1;
+		atomic_init(&inode->refcount, 1);
 		inode->fd = newfd;
 		inode->ino = e->attr.st_ino;
 		inode->dev = e->attr.st_dev;
 
+		// 并发的 LOOKUP 先加入了同一个文件时使用已有的 inode
+		found = lo_inode_insert(inode);
+		if (found != inode)
+		{
+			close(newfd);
+			newfd = -1;
+			free_inode(inode);
+			inode = found;
+		}
 		//发送文件描述符
-
-		pthread_mutex_lock(&lo->mutex);
-		prev = &lo->root;
-		next = prev->next;
-		next->prev = inode;
-		inode->next = next;
-		inode->prev = prev;
-		prev->next = inode;
-		pthread_mutex_unlock(&lo->mutex);
-		if (pass_notify_lookup(inode) < 0)
+		else if (pass_notify_lookup(inode) < 0)
 			exit(0);
 	}
 	e->ino = (uintptr_t)inode;
@@ -208,32 +192,22 @@ static void forget_one(fuse_req_p req, fuse_inode ino, uint64_t nlookup)
 	{
 		fuse_log(FUSE_LOG_DEBUG, "[FUSE_LOG_DEBUG] forget 0x%x %llu -%llu\n",
 				 (unsigned long long)ino,
-				 (unsigned long long)inode->refcount,
+				 (unsigned long long)atomic_load(&inode->refcount),
 				 (unsigned long long)nlookup);
 	}
 
-	pthread_mutex_lock(&lo->mutex);
-	assert(inode->refcount >= nlookup);
-	inode->refcount -= nlookup;
-	if (!inode->refcount)
+	if (inode == &lo->root)
+	{
+		atomic_fetch_sub(&inode->refcount, nlookup);
+		return;
+	}
+	if (lo_inode_unref(inode, nlookup))
 	{
-		struct lo_inode *prev, *next;
-
-		prev = inode->prev;
-		next = inode->next;
-		next->prev = prev;
-		prev->next = next;
-
-		pthread_mutex_unlock(&lo->mutex);
 		close(inode->fd);
 		if (pass_notify_forget(inode) < 0)
 			exit(0);
 		free_inode(inode);
 	}
-	else
-	{
-		pthread_mutex_unlock(&lo->mutex);
-	}
 }
 
 static void lo_forget(fuse_req_p req, fuse_inode ino, uint64_t nlookup)
@@ -242,6 +216,16 @@ static void lo_forget(fuse_req_p req, fuse_inode ino, uint64_t nlookup)
 	send_reply_none(req);
 }
 
+// 故障恢复模式下每个 inode 的释放都需要同步通知管理进程，这里不延迟回收
+static void lo_forget_multi(fuse_req_p req, size_t count, struct fuse_forget_data *forgets)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++)
+		forget_one(req, forgets[i].ino, forgets[i].nlookup);
+	send_reply_none(req);
+}
+
 static void lo_rename(fuse_req_p req, fuse_inode parent, const char *name,
 					  fuse_inode newparent, const char *newname)
 {
@@ -375,6 +359,10 @@ static void lo_write(fuse_req_p req, fuse_inode ino, char *buf,
 	send_reply_write(req, &outbuf, &inbuf);
 }
 
+// 故障恢复模式下 fi->fh 是共享内存中 fdmap 的下标
+#define LO_FILE_FD(fh) parse_fdmap(fh)
+#include "passthrough_file.c"
+
 static void lo_unlink(fuse_req_p req, fuse_inode parent, const char *name)
 {
 	int res;
@@ -412,6 +400,16 @@ static void lo_flush(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
 		send_reply_err(req, errno);
 }
 
+static void lo_fsync(fuse_req_p req, fuse_inode ino, int datasync, struct fuse_file_info *fi)
+{
+	int fd = parse_fdmap(fi->fh);
+	int res;
+
+	(void)ino;
+	res = datasync ? fdatasync(fd) : fsync(fd);
+	send_reply_err(req, res == -1 ? errno : 0);
+}
+
 static void lo_opendir(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
 {
 	int err;
@@ -490,34 +488,6 @@ static void lo_rmdir(fuse_req_p req, fuse_inode parent, const char *name)
 	send_reply_err(req, res == -1 ? errno : 0);
 }
 
-size_t fuse_add_direntry(fuse_req_p req, char *buf, size_t bufsize,
-						 const char *name, const struct stat *stbuf, off_t off)
-{
-	(void)req;
-	size_t namelen;
-	size_t entlen;
-	size_t entlen_padded;
-	struct fuse_dirent *dirent;
-
-	namelen = strlen(name);
-	entlen = FUSE_NAME_OFFSET + namelen;
-	// 内存对齐，内存起始位置必须为 8 字节的整数倍，多余的补0
-	entlen_padded = FUSE_DIRENT_ALIGN(entlen);
-
-	if ((buf == NULL) || (entlen_padded > bufsize))
-		return 0;
-
-	dirent = (struct fuse_dirent *)buf;
-	dirent->ino = stbuf->st_ino;
-	dirent->off = off;
-	dirent->namelen = namelen;
-	dirent->type = (stbuf->st_mode & S_IFMT) >> 12;
-	memcpy(dirent->name, name, namelen);
-	memset(dirent->name + namelen, 0, entlen_padded - entlen);
-
-	return entlen_padded;
-}
-
 static void lo_readdir(fuse_req_p req, fuse_inode ino, size_t size,
 					   off_t offset, struct fuse_file_info *fi)
 {
@@ -578,6 +548,16 @@ static void lo_releasedir(fuse_req_p req, fuse_inode ino, struct fuse_file_info
 	send_reply_ok(req, NULL, 0);
 }
 
+static void lo_fsyncdir(fuse_req_p req, fuse_inode ino, int datasync, struct fuse_file_info *fi)
+{
+	int fd = dirfd(lo_dirp(fi)->dp);
+	int res;
+
+	(void)ino;
+	res = datasync ? fdatasync(fd) : fsync(fd);
+	send_reply_err(req, res == -1 ? errno : 0);
+}
+
 static void lo_getattr(fuse_req_p req, fuse_inode ino,
 					   struct fuse_file_info *fi)
 {
@@ -678,22 +658,37 @@ err_out:
 	send_reply_err(req, err);
 }
 
+static void lo_init(void *userdata, struct fuse_conn_info *conn)
+{
+	(void)userdata;
+	// lo_open() 以原样的 flags 打开源文件，O_TRUNC 随 OPEN 一起完成，内核不再为它发送 SETATTR
+	if (conn->capable & FUSE_ATOMIC_O_TRUNC)
+		conn->want |= FUSE_ATOMIC_O_TRUNC;
+}
+
 static struct fuse_ops ops = {
+	.init = lo_init,
 	.lookup = lo_lookup,
 	.forget = lo_forget,
+	.forget_multi = lo_forget_multi,
 	.rename = lo_rename,
 	.open = lo_open,
 	.create = lo_create,
 	.read = lo_read,
 	.write = lo_write,
+	.copy_file_range = lo_copy_file_range,
+	.fallocate = lo_fallocate,
+	.lseek = lo_lseek,
 	.unlink = lo_unlink,
 	.release = lo_release,
 	.flush = lo_flush,
+	.fsync = lo_fsync,
 	.opendir = lo_opendir,
 	.mkdir = lo_mkdir,
 	.rmdir = lo_rmdir,
 	.readdir = lo_readdir,
 	.releasedir = lo_releasedir,
+	.fsyncdir = lo_fsyncdir,
 	.getattr = lo_getattr,
 	.setattr = lo_setattr};
 
@@ -702,8 +697,7 @@ int main(int argc, char *argv[])
 	struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
 	int res = -EBUILD;
 	struct lo_data lo = {.timeout = 0};
-	pthread_mutex_init(&lo.mutex, NULL);
-	lo.root.next = lo.root.prev = &lo.root;
+	lo.root.next = NULL;
 	lo.root.fd = -1;
 	lo.source = NULL;
 	int alloc = 0;
@@ -735,7 +729,7 @@ int main(int argc, char *argv[])
 	{
 		lo.source = "/";
 	}
-	lo.root.refcount = 2;
+	atomic_init(&lo.root.refcount, 2);
 	lo.root.fd = open(lo.source, O_PATH);
 	if (lo.root.fd == -1)
 	{
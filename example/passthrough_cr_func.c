@@ -6,12 +6,19 @@
 #define MAX_FILEOPEN_NUM 255
 // 文件系统下最大能够 opendir 的目录数量（除去 O_PATH 打开的目录）
 #define MAX_DIROPEN_NUM 255
+// inode 哈希表的桶数量，inode 数量有上限，桶的数量固定
+#define LO_INODE_BUCKETS 1024
+// inode 哈希表的分片数量，第 i 个分片包含下标模 LO_INODE_SHARDS 为 i 的桶
+#define LO_INODE_SHARDS 16
 
 struct lo_inode_cache
 {
 	size_t index; // 当前分配到的 inodes号
 	size_t count; // 已经占用的 inodes 数
 	struct lo_inode inodes[MAX_INODE_NUM];
+	// 按 (dev, ino) 散列的哈希表与 inode 一起放在共享内存中，故障恢复后新的工作进程仍然可以找到已有的 inode
+	pthread_mutex_t locks[LO_INODE_SHARDS];
+	struct lo_inode *buckets[LO_INODE_BUCKETS];
 };
 
 static struct lo_inode_cache *ino_cache = NULL;
@@ -49,6 +56,126 @@ static void free_inode(struct lo_inode *inode)
 	ino_cache->count--;
 }
 
+static size_t lo_inode_bucket(dev_t dev, ino_t ino)
+{
+	uint64_t h = ((uint64_t)ino ^ ((uint64_t)dev << 32 | (uint64_t)dev >> 32)) * 0x9e3779b97f4a7c15ULL;
+
+	return (h ^ (h >> 29)) & (LO_INODE_BUCKETS - 1);
+}
+
+static pthread_mutex_t *lo_inode_lock(size_t bucket)
+{
+	return &ino_cache->locks[bucket % LO_INODE_SHARDS];
+}
+
+// 在桶中查找 inode，不增加引用计数，需要持有桶所在分片的锁
+static struct lo_inode *lo_find_locked(size_t bucket, dev_t dev, ino_t ino)
+{
+	struct lo_inode *p;
+
+	for (p = ino_cache->buckets[bucket]; p != NULL; p = p->next)
+	{
+		if (p->ino == ino && p->dev == dev)
+			return p;
+	}
+	return NULL;
+}
+
+// 查找 (dev, ino) 对应的 inode 并增加引用计数
+static struct lo_inode *lo_inode_find(dev_t dev, ino_t ino)
+{
+	size_t bucket = lo_inode_bucket(dev, ino);
+	struct lo_inode *ret;
+
+	pthread_mutex_lock(lo_inode_lock(bucket));
+	ret = lo_find_locked(bucket, dev, ino);
+	if (ret)
+	{
+		assert(atomic_load(&ret->refcount) > 0);
+		atomic_fetch_add(&ret->refcount, 1);
+	}
+	pthread_mutex_unlock(lo_inode_lock(bucket));
+	return ret;
+}
+
+// 将新的 inode 加入哈希表；并发的 LOOKUP 已经加入了同一个 (dev, ino) 时增加它的引用计数
+// @return 哈希表中的 inode，不是参数 inode 时由调用者释放参数 inode
+static struct lo_inode *lo_inode_insert(struct lo_inode *inode)
+{
+	size_t bucket = lo_inode_bucket(inode->dev, inode->ino);
+	struct lo_inode *p;
+
+	pthread_mutex_lock(lo_inode_lock(bucket));
+	p = lo_find_locked(bucket, inode->dev, inode->ino);
+	if (p)
+	{
+		atomic_fetch_add(&p->refcount, 1);
+	}
+	else
+	{
+		inode->next = ino_cache->buckets[bucket];
+		ino_cache->buckets[bucket] = inode;
+		p = inode;
+	}
+	pthread_mutex_unlock(lo_inode_lock(bucket));
+	return p;
+}
+
+// 减少 inode 的引用计数：不会减到 0 时只做一次原子操作，否则在分片的锁内减少并从哈希表中移除
+// @return 1 表示引用计数减到 0 并且已经从哈希表中移除，0 表示 inode 仍然被引用
+static int lo_inode_unref(struct lo_inode *inode, uint64_t nlookup)
+{
+	uint64_t ref = atomic_load(&inode->refcount);
+	size_t bucket;
+	struct lo_inode **pp;
+
+	while (ref > nlookup)
+	{
+		if (atomic_compare_exchange_weak(&inode->refcount, &ref, ref - nlookup))
+			return 0;
+	}
+	bucket = lo_inode_bucket(inode->dev, inode->ino);
+	pthread_mutex_lock(lo_inode_lock(bucket));
+	ref = atomic_fetch_sub(&inode->refcount, nlookup);
+	assert(ref >= nlookup);
+	if (ref != nlookup)
+	{
+		pthread_mutex_unlock(lo_inode_lock(bucket));
+		return 0;
+	}
+	for (pp = &ino_cache->buckets[bucket]; *pp != inode; pp = &(*pp)->next)
+		;
+	*pp = inode->next;
+	pthread_mutex_unlock(lo_inode_lock(bucket));
+	return 1;
+}
+
+// 故障恢复时重建哈希表：崩溃的工作进程可能持有分片的锁或者正在修改桶，
+// 重新初始化锁并按照仍然被引用的 inode 重新散列，引用计数已经为 0 的 inode 直接释放
+static void lo_inode_table_rebuild()
+{
+	size_t i, bucket;
+	struct lo_inode *inode;
+
+	for (i = 0; i < LO_INODE_SHARDS; i++)
+		pthread_mutex_init(&ino_cache->locks[i], NULL);
+	memset(ino_cache->buckets, 0, sizeof(ino_cache->buckets));
+	for (i = 0; i < MAX_INODE_NUM; i++)
+	{
+		inode = &ino_cache->inodes[i];
+		if (!inode->used)
+			continue;
+		if (atomic_load(&inode->refcount) == 0)
+		{
+			free_inode(inode);
+			continue;
+		}
+		bucket = lo_inode_bucket(inode->dev, inode->ino);
+		inode->next = ino_cache->buckets[bucket];
+		ino_cache->buckets[bucket] = inode;
+	}
+}
+
 struct lo_fdmap_cache
 {
 	size_t index;
@@ -219,6 +346,8 @@ static int pass_notify_closedir(struct lo_dirp *dirp)
 
 static int shmem_init()
 {
+	size_t i;
+
 	ino_cache = mmap(NULL, sizeof(struct lo_inode_cache), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
 	fdm_cache = mmap(NULL, sizeof(struct lo_fdmap_cache), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
 	fdm_cache->index = 3;
@@ -240,6 +369,9 @@ static int shmem_init()
 		dir_cache = NULL;
 		return -1;
 	}
+	// 同一时刻只有一个工作进程使用这些锁，不需要 PTHREAD_PROCESS_SHARED
+	for (i = 0; i < LO_INODE_SHARDS; i++)
+		pthread_mutex_init(&ino_cache->locks[i], NULL);
 	return 0;
 }
 
@@ -336,6 +468,7 @@ static void pass_crash_recovery_func()
 			ino_cache->inodes[i].fd = ino_cache->inodes[i].backupfd;
 		}
 	}
+	lo_inode_table_rebuild();
 	for (i = 0; i < MAX_FILEOPEN_NUM; i++)
 	{
 		if (fdm_cache->fdmaps[i].used)
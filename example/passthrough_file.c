@@ -0,0 +1,45 @@
+// passthrough.c 和 passthrough_cr.c 共用的文件操作，由它们包含；
+// 包含之前需要定义 LO_FILE_FD(fh)，把 fi->fh 转换为源文件的文件描述符
+
+// 由后端文件系统直接拷贝：支持 reflink 的文件系统（如 XFS、Btrfs）共享数据块，
+// 其他文件系统在内核中拷贝，数据不经过守护进程；可能只拷贝了一部分，调用者会继续拷贝剩余的部分
+static void lo_copy_file_range(fuse_req_p req, fuse_inode ino_in, off_t off_in,
+							   struct fuse_file_info *fi_in, fuse_inode ino_out, off_t off_out,
+							   struct fuse_file_info *fi_out, size_t len, int flags)
+{
+	ssize_t res;
+
+	if (req->se->debug)
+		fuse_log(FUSE_LOG_DEBUG, "[FUSE_LOG_DEBUG] copy_file_range(ino=0x%x/0x%x, off=%lu/%lu, len=%zu)\n",
+				 ino_in, ino_out, (unsigned long)off_in, (unsigned long)off_out, len);
+
+	res = copy_file_range(LO_FILE_FD(fi_in->fh), &off_in, LO_FILE_FD(fi_out->fh), &off_out, len, flags);
+	if (res == -1)
+		send_reply_err(req, errno);
+	else
+		send_reply_write_count(req, res);
+}
+
+static void lo_fallocate(fuse_req_p req, fuse_inode ino, int mode, off_t offset,
+						 off_t length, struct fuse_file_info *fi)
+{
+	(void)ino;
+	if (fallocate(LO_FILE_FD(fi->fh), mode, offset, length) == -1)
+		send_reply_err(req, errno);
+	else
+		send_reply_err(req, 0);
+}
+
+// 在源文件上查找数据或者空洞，cp、tar 等工具据此跳过空洞，不再通过 READ 读取大量的 0
+static void lo_lseek(fuse_req_p req, fuse_inode ino, off_t off, int whence,
+					 struct fuse_file_info *fi)
+{
+	off_t res;
+
+	(void)ino;
+	res = lseek(LO_FILE_FD(fi->fh), off, whence);
+	if (res == -1)
+		send_reply_err(req, errno);
+	else
+		send_reply_lseek(req, res);
+}
@@ -0,0 +1,561 @@
+// passthrough 的 io_uring 后端 I/O 引擎，由 passthrough.c 包含：
+// 1. 整个文件系统共享一个 io_uring，处理函数只填写 sqe 就返回，不再阻塞在 pread/pwrite/openat/fstatat 上；
+// 2. sqe 在会话循环即将阻塞时（ops.batch_end）统一提交，同一轮循环中读到的请求只需要一次 io_uring_enter；
+// 3. 收割线程等待 cqe，需要多步完成的操作（lookup 的 openat + statx）在收割线程中继续提交，
+//    最终结果通过 fuse_req_complete() 交给会话循环回复；
+// 4. 没有使用 liburing，直接通过系统调用操作共享的环形队列
+#include <fuse_async.h>
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#define LO_URING_ENTRIES 256
+
+struct lo_uring_op;
+
+// 在收割线程中调用，res 为 cqe 的返回值
+typedef void (*lo_uring_done)(struct lo_uring_op *op, int res);
+
+// 一个请求在 io_uring 中的上下文，作为 sqe 的 user_data
+struct lo_uring_op
+{
+	fuse_req_p req;
+	lo_uring_done done;
+	fuse_complete_func reply;	// 在会话循环中回复请求
+	int res;
+	void *buf;				// read/write 的数据，lookup 的文件名
+	int fd;					// lookup 打开的文件描述符
+	fuse_inode parent;
+	struct statx stx;
+};
+
+struct lo_uring
+{
+	int fd;
+	unsigned entries;
+	pthread_mutex_t lock;	// 保护 sq 以及 pending
+	unsigned pending;		// 已经填写但是尚未提交的 sqe 数量
+	pthread_t reaper;
+
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	struct io_uring_sqe *sqes;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	void *sq_ptr;
+	size_t sq_len;
+	void *cq_ptr;
+	size_t cq_len;
+	size_t sqes_len;
+};
+
+static int lo_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+// 提交所有已经填写的 sqe，调用者需要持有 ring->lock
+static void lo_uring_submit_locked(struct lo_uring *ring)
+{
+	int res;
+
+	while (ring->pending > 0)
+	{
+		res = lo_uring_enter(ring->fd, ring->pending, 0, 0);
+		if (res < 0)
+		{
+			// EAGAIN/EBUSY 表示内核暂时无法接收更多请求，留到下一次提交
+			if (errno != EINTR)
+				break;
+			continue;
+		}
+		ring->pending -= res;
+	}
+}
+
+static void lo_uring_submit(struct lo_uring *ring)
+{
+	pthread_mutex_lock(&ring->lock);
+	lo_uring_submit_locked(ring);
+	pthread_mutex_unlock(&ring->lock);
+}
+
+// 取得一个空闲的 sqe 并清零，调用者需要持有 ring->lock；sq 已满时先提交，仍然没有空闲时返回 NULL
+static struct io_uring_sqe *lo_uring_get_sqe(struct lo_uring *ring)
+{
+	unsigned tail = *ring->sq_tail;
+	unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	struct io_uring_sqe *sqe;
+
+	if (tail - head >= ring->entries)
+	{
+		lo_uring_submit_locked(ring);
+		head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+		if (tail - head >= ring->entries)
+			return NULL;
+	}
+	sqe = &ring->sqes[tail & *ring->sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+// 将填写好的 sqe 放入 sq，调用者需要持有 ring->lock
+static void lo_uring_queue(struct lo_uring *ring, struct io_uring_sqe *sqe, struct lo_uring_op *op)
+{
+	unsigned tail = *ring->sq_tail;
+
+	sqe->user_data = (uint64_t)(uintptr_t)op;
+	ring->sq_array[tail & *ring->sq_mask] = tail & *ring->sq_mask;
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	ring->pending++;
+}
+
+static void *lo_uring_reap(void *data)
+{
+	struct lo_uring *ring = (struct lo_uring *)data;
+	struct io_uring_cqe *cqe;
+	struct lo_uring_op *op;
+	unsigned head;
+	unsigned tail;
+	int stop = 0;
+
+	while (!stop)
+	{
+		if (lo_uring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+		{
+			fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] io_uring_enter: %s\n", strerror(errno));
+			break;
+		}
+		head = *ring->cq_head;
+		tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+		for (; head != tail; head++)
+		{
+			cqe = &ring->cqes[head & *ring->cq_mask];
+			op = (struct lo_uring_op *)(uintptr_t)cqe->user_data;
+			// user_data 为 0 的 NOP 表示引擎正在销毁
+			if (op == NULL)
+				stop = 1;
+			else
+				op->done(op, cqe->res);
+		}
+		__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+static struct lo_uring *lo_uring_new(void)
+{
+	struct io_uring_params p;
+	struct lo_uring *ring;
+
+	ring = calloc(1, sizeof(struct lo_uring));
+	if (ring == NULL)
+		return NULL;
+	memset(&p, 0, sizeof(p));
+	ring->fd = (int)syscall(__NR_io_uring_setup, LO_URING_ENTRIES, &p);
+	if (ring->fd < 0)
+		goto err_out;
+	ring->entries = p.sq_entries;
+
+	ring->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (ring->cq_len > ring->sq_len)
+			ring->sq_len = ring->cq_len;
+		ring->cq_len = ring->sq_len;
+	}
+	ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+						ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ptr == MAP_FAILED)
+		goto err_close;
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		ring->cq_ptr = ring->sq_ptr;
+	}
+	else
+	{
+		ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+							ring->fd, IORING_OFF_CQ_RING);
+		if (ring->cq_ptr == MAP_FAILED)
+			goto err_unmap_sq;
+	}
+	ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+					  ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		goto err_unmap_cq;
+
+	ring->sq_head = (unsigned *)((char *)ring->sq_ptr + p.sq_off.head);
+	ring->sq_tail = (unsigned *)((char *)ring->sq_ptr + p.sq_off.tail);
+	ring->sq_mask = (unsigned *)((char *)ring->sq_ptr + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned *)((char *)ring->sq_ptr + p.sq_off.array);
+	ring->cq_head = (unsigned *)((char *)ring->cq_ptr + p.cq_off.head);
+	ring->cq_tail = (unsigned *)((char *)ring->cq_ptr + p.cq_off.tail);
+	ring->cq_mask = (unsigned *)((char *)ring->cq_ptr + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ptr + p.cq_off.cqes);
+
+	pthread_mutex_init(&ring->lock, NULL);
+	if (pthread_create(&ring->reaper, NULL, lo_uring_reap, ring) != 0)
+		goto err_unmap_sqes;
+	return ring;
+
+err_unmap_sqes:
+	pthread_mutex_destroy(&ring->lock);
+	munmap(ring->sqes, ring->sqes_len);
+err_unmap_cq:
+	if (ring->cq_ptr != ring->sq_ptr)
+		munmap(ring->cq_ptr, ring->cq_len);
+err_unmap_sq:
+	munmap(ring->sq_ptr, ring->sq_len);
+err_close:
+	close(ring->fd);
+err_out:
+	fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] failed to set up io_uring: %s\n", strerror(errno));
+	free(ring);
+	return NULL;
+}
+
+static void lo_uring_destroy(struct lo_uring *ring)
+{
+	struct io_uring_sqe *sqe;
+
+	if (ring == NULL)
+		return;
+	pthread_mutex_lock(&ring->lock);
+	sqe = lo_uring_get_sqe(ring);
+	if (sqe != NULL)
+	{
+		sqe->opcode = IORING_OP_NOP;
+		lo_uring_queue(ring, sqe, NULL);
+	}
+	lo_uring_submit_locked(ring);
+	pthread_mutex_unlock(&ring->lock);
+	// 无法提交退出通知时直接取消收割线程
+	if (sqe == NULL)
+		pthread_cancel(ring->reaper);
+	pthread_join(ring->reaper, NULL);
+
+	pthread_mutex_destroy(&ring->lock);
+	munmap(ring->sqes, ring->sqes_len);
+	if (ring->cq_ptr != ring->sq_ptr)
+		munmap(ring->cq_ptr, ring->cq_len);
+	munmap(ring->sq_ptr, ring->sq_len);
+	close(ring->fd);
+	free(ring);
+}
+
+static struct lo_uring_op *lo_uring_op_new(fuse_req_p req, lo_uring_done done, fuse_complete_func reply)
+{
+	struct lo_uring_op *op = calloc(1, sizeof(struct lo_uring_op));
+
+	if (op == NULL)
+		return NULL;
+	op->req = req;
+	op->done = done;
+	op->reply = reply;
+	op->fd = -1;
+	return op;
+}
+
+static void lo_uring_op_free(struct lo_uring_op *op)
+{
+	free(op->buf);
+	free(op);
+}
+
+static void statx_to_stat(const struct statx *stx, struct stat *st)
+{
+	memset(st, 0, sizeof(*st));
+	st->st_dev = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+	st->st_ino = stx->stx_ino;
+	st->st_mode = stx->stx_mode;
+	st->st_nlink = stx->stx_nlink;
+	st->st_uid = stx->stx_uid;
+	st->st_gid = stx->stx_gid;
+	st->st_rdev = makedev(stx->stx_rdev_major, stx->stx_rdev_minor);
+	st->st_size = stx->stx_size;
+	st->st_blksize = stx->stx_blksize;
+	st->st_blocks = stx->stx_blocks;
+	st->st_atim.tv_sec = stx->stx_atime.tv_sec;
+	st->st_atim.tv_nsec = stx->stx_atime.tv_nsec;
+	st->st_mtim.tv_sec = stx->stx_mtime.tv_sec;
+	st->st_mtim.tv_nsec = stx->stx_mtime.tv_nsec;
+	st->st_ctim.tv_sec = stx->stx_ctime.tv_sec;
+	st->st_ctim.tv_nsec = stx->stx_ctime.tv_nsec;
+}
+
+// 操作完成后交给会话循环，由 op->reply 回复
+static void lo_uring_done_reply(struct lo_uring_op *op, int res)
+{
+	op->res = res;
+	fuse_req_complete(op->req, op->reply, op);
+}
+
+static void lo_uring_reply_read(fuse_req_p req, void *data)
+{
+	struct lo_uring_op *op = (struct lo_uring_op *)data;
+
+	if (op->res < 0)
+		send_reply_err(req, -op->res);
+	else
+		send_reply_ok(req, op->buf, op->res);
+	lo_uring_op_free(op);
+}
+
+static void lo_uring_reply_write(fuse_req_p req, void *data)
+{
+	struct lo_uring_op *op = (struct lo_uring_op *)data;
+	struct fuse_write_out arg;
+
+	if (op->res < 0)
+	{
+		send_reply_err(req, -op->res);
+	}
+	else
+	{
+		memset(&arg, 0, sizeof(arg));
+		arg.size = op->res;
+		send_reply_ok(req, &arg, sizeof(arg));
+	}
+	lo_uring_op_free(op);
+}
+
+static void lo_uring_reply_attr(fuse_req_p req, void *data)
+{
+	struct lo_uring_op *op = (struct lo_uring_op *)data;
+	struct stat st;
+
+	if (op->res < 0)
+	{
+		send_reply_err(req, -op->res);
+	}
+	else
+	{
+		statx_to_stat(&op->stx, &st);
+		send_reply_attr(req, &st, lo_data(req)->timeout);
+	}
+	lo_uring_op_free(op);
+}
+
+static void lo_uring_reply_entry(fuse_req_p req, void *data)
+{
+	struct lo_uring_op *op = (struct lo_uring_op *)data;
+	struct fuse_entry_param e;
+	int err = -op->res;
+
+	memset(&e, 0, sizeof(e));
+	if (op->res >= 0)
+	{
+		statx_to_stat(&op->stx, &e.attr);
+		err = lo_add_inode(req, op->parent, (const char *)op->buf, op->fd, &e);
+	}
+	else if (op->fd != -1)
+	{
+		close(op->fd);
+	}
+	if (err)
+		send_reply_err(req, err);
+	else
+		send_reply_entry(req, &e);
+	lo_uring_op_free(op);
+}
+
+// lookup 的第二步：对 openat 得到的文件描述符执行 statx，与 do_lookup() 中的 fstatat 相同
+static void lo_uring_done_openat(struct lo_uring_op *op, int res)
+{
+	struct lo_uring *ring = lo_data(op->req)->ring;
+	struct io_uring_sqe *sqe;
+
+	if (res < 0)
+	{
+		lo_uring_done_reply(op, res);
+		return;
+	}
+	op->fd = res;
+	op->done = lo_uring_done_reply;
+
+	pthread_mutex_lock(&ring->lock);
+	sqe = lo_uring_get_sqe(ring);
+	if (sqe != NULL)
+	{
+		sqe->opcode = IORING_OP_STATX;
+		sqe->fd = op->fd;
+		sqe->addr = (uint64_t)(uintptr_t)"";
+		sqe->len = STATX_BASIC_STATS;
+		sqe->statx_flags = AT_EMPTY_PATH | AT_SYMLINK_NOFOLLOW;
+		sqe->off = (uint64_t)(uintptr_t)&op->stx;
+		lo_uring_queue(ring, sqe, op);
+		// 收割线程中不会再有 batch_end，直接提交
+		lo_uring_submit_locked(ring);
+	}
+	pthread_mutex_unlock(&ring->lock);
+	if (sqe == NULL)
+		lo_uring_done_reply(op, -EAGAIN);
+}
+
+// 以下函数将请求交给 io_uring 处理，成功返回 0；
+// 返回 -1 表示无法放入 io_uring，请求没有被回复，调用者退回到同步处理
+
+static int lo_uring_read(fuse_req_p req, int fd, size_t size, off_t off)
+{
+	struct lo_uring *ring = lo_data(req)->ring;
+	struct lo_uring_op *op;
+	struct io_uring_sqe *sqe;
+
+	op = lo_uring_op_new(req, lo_uring_done_reply, lo_uring_reply_read);
+	if (op == NULL)
+		return -1;
+	op->buf = malloc(size ? size : 1);
+	if (op->buf == NULL)
+		goto err_out;
+
+	pthread_mutex_lock(&ring->lock);
+	sqe = lo_uring_get_sqe(ring);
+	if (sqe != NULL)
+	{
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = fd;
+		sqe->addr = (uint64_t)(uintptr_t)op->buf;
+		sqe->len = size;
+		sqe->off = off;
+		lo_uring_queue(ring, sqe, op);
+	}
+	pthread_mutex_unlock(&ring->lock);
+	if (sqe == NULL)
+		goto err_out;
+	return 0;
+err_out:
+	lo_uring_op_free(op);
+	return -1;
+}
+
+// 写入的数据在接收缓冲区或者接收管道中，处理函数返回后就会被下一个请求覆盖，需要先拷贝出来
+static int lo_uring_write(fuse_req_p req, int fd, struct fuse_bufvec *in_buf, off_t off)
+{
+	struct lo_uring *ring = lo_data(req)->ring;
+	struct fuse_bufvec mem = FUSE_BUFVEC_INIT(fuse_buf_size(in_buf));
+	struct lo_uring_op *op;
+	struct io_uring_sqe *sqe;
+	ssize_t res;
+
+	op = lo_uring_op_new(req, lo_uring_done_reply, lo_uring_reply_write);
+	if (op == NULL)
+		return -1;
+	op->buf = malloc(mem.buf[0].size ? mem.buf[0].size : 1);
+	if (op->buf == NULL)
+		goto err_out;
+	mem.buf[0].mem = op->buf;
+	res = fuse_buf_copy(&mem, in_buf);
+	if (res < 0)
+	{
+		send_reply_err(req, -res);
+		lo_uring_op_free(op);
+		return 0;
+	}
+
+	pthread_mutex_lock(&ring->lock);
+	sqe = lo_uring_get_sqe(ring);
+	if (sqe != NULL)
+	{
+		sqe->opcode = IORING_OP_WRITE;
+		sqe->fd = fd;
+		sqe->addr = (uint64_t)(uintptr_t)op->buf;
+		sqe->len = res;
+		sqe->off = off;
+		lo_uring_queue(ring, sqe, op);
+	}
+	pthread_mutex_unlock(&ring->lock);
+	if (sqe == NULL)
+	{
+		// 数据已经从输入中取出，只能在这里同步写入
+		res = pwrite(fd, op->buf, res, off);
+		lo_uring_done_reply(op, res < 0 ? -errno : (int)res);
+	}
+	return 0;
+err_out:
+	lo_uring_op_free(op);
+	return -1;
+}
+
+static int lo_uring_getattr(fuse_req_p req, int fd)
+{
+	struct lo_uring *ring = lo_data(req)->ring;
+	struct lo_uring_op *op;
+	struct io_uring_sqe *sqe;
+
+	op = lo_uring_op_new(req, lo_uring_done_reply, lo_uring_reply_attr);
+	if (op == NULL)
+		return -1;
+
+	pthread_mutex_lock(&ring->lock);
+	sqe = lo_uring_get_sqe(ring);
+	if (sqe != NULL)
+	{
+		sqe->opcode = IORING_OP_STATX;
+		sqe->fd = fd;
+		sqe->addr = (uint64_t)(uintptr_t)"";
+		sqe->len = STATX_BASIC_STATS;
+		sqe->statx_flags = AT_EMPTY_PATH | AT_SYMLINK_NOFOLLOW;
+		sqe->off = (uint64_t)(uintptr_t)&op->stx;
+		lo_uring_queue(ring, sqe, op);
+	}
+	pthread_mutex_unlock(&ring->lock);
+	if (sqe == NULL)
+	{
+		lo_uring_op_free(op);
+		return -1;
+	}
+	return 0;
+}
+
+// lookup 的第一步：以 O_PATH 打开文件，文件名在提交时才被内核读取，需要先复制出来
+static int lo_uring_lookup(fuse_req_p req, fuse_inode parent, const char *name)
+{
+	struct lo_uring *ring = lo_data(req)->ring;
+	struct lo_uring_op *op;
+	struct io_uring_sqe *sqe;
+
+	op = lo_uring_op_new(req, lo_uring_done_openat, lo_uring_reply_entry);
+	if (op == NULL)
+		return -1;
+	op->parent = parent;
+	op->buf = strdup(name);
+	if (op->buf == NULL)
+		goto err_out;
+
+	pthread_mutex_lock(&ring->lock);
+	sqe = lo_uring_get_sqe(ring);
+	if (sqe != NULL)
+	{
+		sqe->opcode = IORING_OP_OPENAT;
+		sqe->fd = lo_fd(req, parent);
+		sqe->addr = (uint64_t)(uintptr_t)op->buf;
+		sqe->open_flags = O_PATH | O_NOFOLLOW | O_CLOEXEC;
+		lo_uring_queue(ring, sqe, op);
+	}
+	pthread_mutex_unlock(&ring->lock);
+	if (sqe == NULL)
+		goto err_out;
+	return 0;
+err_out:
+	lo_uring_op_free(op);
+	return -1;
+}
+
+// 会话循环即将阻塞，一次提交这一轮处理函数填写的所有 sqe
+static void lo_batch_end(void *userdata)
+{
+	struct lo_data *lo = (struct lo_data *)userdata;
+
+	if (lo->ring != NULL)
+		lo_uring_submit(lo->ring);
+}
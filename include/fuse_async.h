@@ -0,0 +1,66 @@
+#ifndef _FUSE_ASYNC_H
+#define _FUSE_ASYNC_H
+
+#include "fuse_req.h"
+#include "fuse_session.h"
+
+#include <stdatomic.h>
+
+// 异步完成的回调函数，在会话循环的线程中调用，需要通过 send_reply_*() 回复请求
+typedef void (*fuse_complete_func)(fuse_req_p req, void *data);
+
+// 会话的完成队列：
+// 1. 任意线程通过 CAS 将请求压入 head，队列由空变为非空时写 efd 唤醒会话循环；
+// 2. 会话循环同时等待 /dev/fuse 和 efd，先读空 efd 再一次性取走 head，保证不会丢失唤醒；
+// 3. 处理中的请求数量达到 max_inflight 时会话循环只等待 efd，不再读取新请求，
+//    未读取的请求留在内核队列中，由内核对发起请求的进程形成反压
+struct fuse_cq
+{
+	_Atomic(struct fuse_req *) head;
+	int efd;
+};
+
+// 开启异步模式，在进入会话循环之前调用：
+// 开启后处理函数可以保留请求体直接返回，之后在任意线程调用 fuse_req_complete() 完成请求
+// @param se 会话
+// @param max_inflight 同时处理的请求数量上限，包括异步处理中的请求，0 表示不限制
+// @return 0 on success, -1 on failure
+int fuse_session_async(struct fuse_session *se, unsigned max_inflight);
+
+// 完成一个异步处理的请求，可以在任意线程调用：
+// 请求被放入完成队列，由会话循环的线程调用 func 回复；
+// 没有开启异步模式时直接在调用线程中调用 func
+// @param req 请求体，调用后不能再访问
+// @param func 回复请求的回调函数
+// @param data 传递给 func 的参数
+void fuse_req_complete(fuse_req_p req, fuse_complete_func func, void *data);
+
+// 处理完成队列中的所有请求，由会话循环调用
+// @return 处理的请求数量
+int fuse_cq_drain(struct fuse_session *se);
+
+// 唤醒等待完成队列的会话循环
+void fuse_cq_wake(struct fuse_session *se);
+
+// 处理中的请求数量是否已经达到上限，达到上限时会话循环不再读取新请求
+static inline int fuse_session_throttled(struct fuse_session *se)
+{
+	return se->max_inflight &&
+		   atomic_load_explicit(&se->reqs->inflight, memory_order_relaxed) >= se->max_inflight;
+}
+
+// 会话循环读取请求之前在 inflight 中预占一个名额，处理完读到的请求后调用 fuse_session_release() 归还；
+// 请求登记时 inflight 会再加一，因此多个线程同时读取时处理中的请求数量也不会超过上限
+// @return 1 表示预占成功或者没有上限，0 表示已经达到上限
+int fuse_session_reserve(struct fuse_session *se);
+
+// 归还 fuse_session_reserve() 预占的名额
+void fuse_session_release(struct fuse_session *se);
+
+// 回复请求时调用，从请求表中移除请求，处理中的请求数量降到上限以下时唤醒会话循环
+void fuse_session_unregister(fuse_req_p req);
+
+// 处理完成队列中剩余的请求并释放完成队列，在会话销毁时调用
+void fuse_cq_destroy(struct fuse_session *se);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef _FUSE_BUFPOOL_H
+#define _FUSE_BUFPOOL_H
+
+#include "fuse_session.h"
+
+#include <pthread.h>
+
+// 大页的大小，缓冲区池的每次映射的起始地址都按这个大小对齐
+#define FUSE_HUGEPAGE_SIZE (2UL << 20)
+
+// 一次映射，销毁缓冲区池时释放
+struct fuse_bufpool_chunk
+{
+	struct fuse_bufpool_chunk *next;
+	void *addr;
+	size_t len;
+};
+
+// 会话循环接收请求的缓冲区池，替代每个线程 malloc 一个 se->bufsize 的缓冲区：
+// 1. 缓冲区从起始地址按 2MB 对齐的映射中切分，优先使用预留的 hugetlb 大页，否则通过 MADV_HUGEPAGE 请求透明大页，
+//    拷贝请求数据时 TLB 缺失更少；
+// 2. 映射在会话循环开始时一次性创建并预先访问，处理请求时不会缺页；
+// 3. 空闲缓冲区由各个线程共享，按需创建的线程退出后缓冲区留给之后的线程使用
+struct fuse_bufpool
+{
+	pthread_mutex_t lock;
+	size_t bufsize;						// 每个缓冲区的大小，按页对齐，不小于会话开始时的 se->bufsize
+	void *free_list;					// 空闲缓冲区，缓冲区开头保存下一个空闲缓冲区的地址
+	size_t nfree;
+	size_t total;						// 已经切分出的缓冲区数量
+	struct fuse_bufpool_chunk *chunks;
+	int hugetlb;						// 是否有映射使用了 hugetlb 大页
+};
+
+// 保证缓冲区池中至少有 count 个空闲缓冲区，第一次调用时创建缓冲区池，一般在会话循环开始时调用
+// @param se 会话
+// @param count 需要的空闲缓冲区数量
+// @return 0 on success, -ENOMEM on failure
+int fuse_bufpool_reserve(struct fuse_session *se, size_t count);
+
+// 取得一个接收缓冲区，缓冲区池为空时再映射一块
+// @param se 会话
+// @param local 为 1 时总是在调用线程中映射并访问一块新的内存，绑定 CPU 的线程据此得到本地 NUMA 节点的缓冲区
+// @return 缓冲区 on success, NULL on failure
+void *fuse_bufpool_get(struct fuse_session *se, int local);
+
+// 归还 fuse_bufpool_get() 取得的缓冲区，mem 为 NULL 时直接返回
+void fuse_bufpool_put(struct fuse_session *se, void *mem);
+
+// 释放缓冲区池的所有映射，在所有缓冲区归还之后调用
+void fuse_bufpool_destroy(struct fuse_session *se);
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef _FUSE_DISPATCH_H
+#define _FUSE_DISPATCH_H
+
+#include "fuse_session.h"
+#include "fuse_reply.h"
+#include "fuse_bufpool.h"
+#include "fuse_async.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+// 分发模式下请求的类别，数值越小优先级越高；
+// INIT、DESTROY 以及 INTERRUPT 属于特殊请求，由读取线程直接处理，不进入队列
+enum fuse_dispatch_class
+{
+	FUSE_CLASS_METADATA,		// 元数据、属性、目录项以及其他开销较小的请求
+	FUSE_CLASS_FORGET,			// FORGET、BATCH_FORGET、RELEASE 以及 RELEASEDIR
+	FUSE_CLASS_DATA,			// READ、WRITE、FSYNC 以及读取目录等可能搬运大量数据或者等待磁盘的请求
+	FUSE_CLASS_MAX,
+	FUSE_CLASS_SPECIAL = FUSE_CLASS_MAX,
+};
+
+// 队列中的一个请求，接收缓冲区的所有权随请求一起交给处理它的线程
+struct fuse_dispatch_item
+{
+	struct fuse_buf buf;
+	int fd;						// 读取请求的文件描述符，回复需要写回同一个文件描述符
+};
+
+// 一个环形队列，容量为 2 的幂
+struct fuse_dispatch_deque
+{
+	struct fuse_dispatch_item *items;
+	unsigned head;				// 下一个取出的位置
+	unsigned tail;				// 下一个放入的位置
+};
+
+struct fuse_dispatcher;
+struct fuse_qos;
+struct fuse_qos_config;
+
+// 工作线程，每个类别拥有一个队列，队列由 lock 保护，其他空闲的线程可以从这里窃取请求
+struct fuse_dispatch_worker
+{
+	struct fuse_dispatcher *d;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	struct fuse_dispatch_deque q[FUSE_CLASS_MAX];
+};
+
+// 处理一个队列中的请求，处理完成后由分发器归还接收缓冲区，并释放异步模式下读取请求前预占的名额
+typedef void (*fuse_dispatch_process_func)(struct fuse_session *se, struct fuse_buf *buf, int fd);
+
+struct fuse_dispatcher
+{
+	struct fuse_session *se;
+	fuse_dispatch_process_func process;
+	unsigned nworkers;
+	struct fuse_dispatch_worker *workers;
+	unsigned capacity;			// 所有队列中的请求总数上限，也是每个队列的容量
+	unsigned data_limit;		// 同时处理 DATA 类请求的线程数上限，其余线程留给其他类别
+	atomic_uint next;			// 轮流选择放入请求的线程
+
+	pthread_mutex_t lock;		// 保护以下字段，以及线程的睡眠和唤醒
+	pthread_cond_t work_cond;	// 有新请求或者 DATA 类的名额被释放
+	pthread_cond_t space_cond;	// 队列中的请求数降到上限以下
+	atomic_uint queued[FUSE_CLASS_MAX];	// 每个类别已经放入队列的请求数，工作线程据此跳过空的类别
+	unsigned total;				// 所有队列中的请求数，开启 QoS 时不使用，由调度器的共享节点限制排队的请求数
+	unsigned data_running;		// 正在处理 DATA 类请求的线程数
+	unsigned sleeping;			// 等待 work_cond 的线程数
+	int stopping;
+	struct fuse_qos *qos;		// 不为 NULL 时所有请求按租户排入 QoS 调度器，不使用每个线程的队列
+};
+
+// 分发模式下请求的类别
+// @param opcode 请求的操作码
+// @return 请求所属的类别，INIT、DESTROY 以及 INTERRUPT 为 FUSE_CLASS_SPECIAL
+enum fuse_dispatch_class fuse_op_class(enum fuse_opcode opcode);
+
+// 创建分发器及其工作线程
+// @param se 会话
+// @param nworkers 工作线程数量
+// @param capacity 所有队列中的请求总数上限，读取线程在队列满时等待，0 表示使用 nworkers 的 16 倍
+// @param qos QoS 配置，NULL 或者 qos->tenant 为 FUSE_QOS_NONE 时不开启
+// @param process 处理请求的函数
+// @return 分发器 on success, NULL on failure
+struct fuse_dispatcher *fuse_dispatch_new(struct fuse_session *se, unsigned nworkers, unsigned capacity,
+										  const struct fuse_qos_config *qos, fuse_dispatch_process_func process);
+
+// 把请求放入一个工作线程的队列，队列已满时等待
+// 成功后 buf 的所有权交给分发器，buf->mem 被置为 NULL，调用者下次接收时重新取得缓冲区
+// @param d 分发器
+// @param buf 接收到的请求
+// @param fd 读取请求的文件描述符，-1 表示 se->fd
+// @param cls 请求的类别，不能是 FUSE_CLASS_SPECIAL
+// @return 0 on success, -1 表示分发器已经停止
+int fuse_dispatch_push(struct fuse_dispatcher *d, struct fuse_buf *buf, int fd, enum fuse_dispatch_class cls);
+
+// 是否有工作线程正在等待新请求
+int fuse_dispatch_idle(struct fuse_dispatcher *d);
+
+// 唤醒所有等待中的读取线程和工作线程，之后 fuse_dispatch_push() 返回 -1
+void fuse_dispatch_stop(struct fuse_dispatcher *d);
+
+// 停止并回收所有工作线程，丢弃队列中剩余的请求并归还它们的缓冲区
+void fuse_dispatch_destroy(struct fuse_dispatcher *d);
+
+#endif
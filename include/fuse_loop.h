@@ -7,20 +7,44 @@
 #include "fuse_option.h"
 #include "fuse_session.h"
 #include "fuse_reply.h"
+#include "fuse_async.h"
+#include "fuse_bufpool.h"
+#include "fuse_notify.h"
+#include "fuse_uring.h"
+#include "fuse_dispatch.h"
+#include "fuse_qos.h"
 #include "fuse_error.h"
 
 #include <unistd.h>
 #include <signal.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <poll.h>
+#include <sched.h>
 #include <sys/uio.h>
 
+// 多线程循环的配置
+struct fuse_loop_config
+{
+	int clonefd;				// 是否为常驻线程克隆 /dev/fuse
+	unsigned min_threads;		// 常驻线程数量，这些线程在会话结束前不会退出
+	unsigned max_threads;		// 线程数量上限，所有线程都在处理请求时按需创建新线程，直到达到这个数量
+	unsigned idle_timeout;		// 按需创建的线程空闲超过这个秒数后退出，0 表示不回收
+	const int *cpus;			// 不为 NULL 时为每个 CPU 创建一个绑定的线程，忽略 min_threads 和 max_threads
+	unsigned ncpus;				// cpus 数组的长度
+	unsigned readers;			// 大于 0 时使用分发模式，由这么多个线程读取请求并按类别分发给 min_threads 个工作线程
+	struct fuse_qos_config qos;	// 分发模式下按租户公平调度以及限速的配置
+	unsigned busy_poll;			// 大于 0 时常驻线程先在非阻塞的文件描述符上自旋等待请求，最多自旋这么多微秒
+	unsigned poll_threads;		// 自旋等待请求的常驻线程数量，0 表示所有常驻线程
+};
+
 // 根据参数 foreground 确定是否创建守护进程
 // @param foreground 如果为 true，则保持在前端继续运行，否则在后台创建守护进程并运行
 // @return 0 on success, -1 on failure
 int fuse_daemonize(int foreground);
 
-// 单线程循环中从 /dev/fuse 接收请求，并处理请求
+// 单线程循环中从 /dev/fuse 接收请求，并处理请求；
+// 开启异步模式时同时等待完成队列，处理中的请求达到上限后只处理完成队列
 // @param se 代表当前会话，管理正在交互的 /dev/fuse 文件描述符
 // @return 如果返回 0，表示因为文件系统解除挂载（unmount or /sys/fs/fuse/connections/NNN/abort）而退出；
 // 如果返回一个正值，表示因为一个注册的信号 signal 被触发而退出；
@@ -36,6 +60,46 @@ int fuse_single_session_loop(struct fuse_session *se);
 // 如果返回一个负值，则表示因为运行过程中发生错误而退出，对应错误号
 int fuse_multi_session_loop(struct fuse_session *se, int clonefd, unsigned threads);
 
+// 创建弹性线程池，每个线程循环中从 /dev/fuse 接收请求，并处理请求：
+// 1. 启动时创建 min_threads 个常驻线程；
+// 2. 没有空闲线程时按需创建新线程，线程总数不超过 max_threads，
+//    按需创建的线程使用非阻塞的克隆文件描述符，空闲超过 idle_timeout 秒后退出；
+// 3. 主线程阻塞等待会话退出，而不是周期性检查 se->exited；
+// 4. 如果设置了 cpus，则为每个 CPU 创建一个绑定的常驻线程，线程绑定后自己克隆 /dev/fuse
+//    并首次访问接收缓冲区，使文件描述符、请求体缓存池以及接收缓冲区都分配在本地 NUMA 节点
+// 5. 开启异步模式时所有线程都使用非阻塞的文件描述符，同时等待 /dev/fuse 和完成队列
+// 6. 如果设置了 readers，则改用分发模式：readers 个线程读取请求，按照 fuse_op_class() 的类别
+//    放入 min_threads 个工作线程各自的队列，工作线程按类别的优先级取请求，自己的队列为空时窃取其他线程的请求；
+//    DATA 类最多同时占用 min_threads - 1 个工作线程，没有空闲的工作线程时其他类别由读取线程直接处理，
+//    忽略 max_threads、cpus、clonefd 以及 splice_read；
+// 7. 分发模式下如果设置了 qos.tenant，则所有请求按照租户（uid、pid 或者 cgroup）排入加权公平队列，
+//    同一类别中按租户的权重分配处理的顺序，并可以为每个租户设置 IOPS 和带宽的令牌桶
+// 8. 如果设置了 busy_poll，则前 poll_threads 个常驻线程使用非阻塞的克隆文件描述符，
+//    先自旋读取请求，超过预算后再阻塞等待；预算根据最近请求的平均到达间隔自适应调整，
+//    请求稀疏时不再自旋；分发模式下不生效
+// @param se 代表当前会话，管理正在交互的 /dev/fuse 文件描述符
+// @param config 线程池配置
+// @return 与 fuse_multi_session_loop() 相同
+int fuse_multi_session_loop_config(struct fuse_session *se, const struct fuse_loop_config *config);
+
+// 通过 FUSE-over-io_uring 接收请求并发送回复，传输方式在 INIT 中与内核协商：
+// 1. INIT、FORGET 以及 INTERRUPT 仍然通过 /dev/fuse 收发，由经典循环处理，
+//    config 为 NULL 时使用 fuse_single_session_loop()，否则使用 fuse_multi_session_loop_config()；
+// 2. 协商成功后为每个 CPU 创建一个队列，每个队列拥有自己的 io_uring、注册给内核的队列缓冲区以及绑定的线程，
+//    回复与获取下一个请求合并为一次 FUSE_IO_URING_CMD_COMMIT_AND_FETCH，批量提交；
+// 3. 内核不支持或者队列创建失败时，所有请求继续由经典循环处理
+// @param se 代表当前会话，管理正在交互的 /dev/fuse 文件描述符
+// @param config 经典循环的配置，NULL 表示单线程循环
+// @param depth 每个队列的队列项数量，0 表示使用 FUSE_URING_DEFAULT_DEPTH
+// @return 与 fuse_multi_session_loop() 相同
+int fuse_uring_session_loop(struct fuse_session *se, const struct fuse_loop_config *config, unsigned depth);
+
+// 解析 CPU 列表，格式如 0-3,8,10-11，列表中的 CPU 必须在当前进程允许运行的范围内
+// @param str CPU 列表字符串
+// @param cpus 输出动态分配的 CPU 编号数组，需要调用者释放
+// @return 成功返回 CPU 数量，失败返回 -1
+int fuse_parse_cpus(const char *str, int **cpus);
+
 // 故障恢复需要的函数
 void fuse_session_set_ptr(void * ptr);
 void fuse_session_recovery(struct fuse_session *se);
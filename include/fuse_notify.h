@@ -0,0 +1,67 @@
+#ifndef _FUSE_NOTIFY_H
+#define _FUSE_NOTIFY_H
+
+#include "fuse_kernel.h"
+#include "fuse_session.h"
+#include "fuse_reply.h"
+
+// 文件系统主动发给内核的通知，通知没有对应的请求，fuse_out_header 中 unique 为 0，error 为通知的类型。
+// 以下函数可以在会话循环运行时从任意线程调用，每个通知通过一次 writev 写入 /dev/fuse；
+// 注意不要在处理同一个 inode（INVAL_ENTRY 和 DELETE 为父目录）的请求时同步发送 INVAL 类的通知，
+// 内核在失效缓存时可能需要等待这个请求完成，从而造成死锁
+
+// 失效内核中 inode 的属性缓存以及一段页缓存
+// @param se 会话
+// @param ino inode 编号
+// @param off 页缓存的起始位置，小于 0 时只失效属性缓存
+// @param len 页缓存的长度，0 表示直到文件末尾
+// @return 0 on success, -ENOSYS 表示内核不支持, negative errno on failure
+int fuse_notify_inval_inode(struct fuse_session *se, fuse_inode ino, off_t off, off_t len);
+
+// 失效内核中的一个目录项，之后访问这个名字时内核重新发送 LOOKUP
+// @param se 会话
+// @param parent 父目录的 inode 编号
+// @param name 目录项的名字，不需要以 '\0' 结尾
+// @param namelen 名字的长度
+// @return 0 on success, -ENOSYS 表示内核不支持, negative errno on failure
+int fuse_notify_inval_entry(struct fuse_session *se, fuse_inode parent, const char *name, size_t namelen);
+
+// 通知内核一个目录项已经被删除：目录项指向 child 时失效目录项，并且删除 child 的 dentry 别名，
+// 与 fuse_notify_inval_entry() 相比，已经打开的目录或者当前工作目录也能够被正确地移除
+// @param se 会话
+// @param parent 父目录的 inode 编号
+// @param child 被删除的 inode 编号
+// @param name 目录项的名字
+// @param namelen 名字的长度
+// @return 0 on success, -ENOSYS 表示内核不支持, negative errno on failure
+int fuse_notify_delete(struct fuse_session *se, fuse_inode parent, fuse_inode child,
+					   const char *name, size_t namelen);
+
+// 把数据直接写入内核的页缓存，之后内核读取这个范围时不再发送 READ；
+// 写入的范围超过文件大小时内核同时扩展文件大小，inode 不在内核缓存中时数据被丢弃
+// @param se 会话
+// @param ino inode 编号
+// @param offset 数据在文件中的位置
+// @param bufv 数据，从当前位置开始，可以包含文件描述符
+// @return 0 on success, -ENOSYS 表示内核不支持, negative errno on failure
+int fuse_notify_store(struct fuse_session *se, fuse_inode ino, off_t offset, struct fuse_bufvec *bufv);
+
+// 从内核的页缓存中取回数据：内核以 NOTIFY_REPLY 请求把当前缓存的数据（最多 max_write 字节）发回，
+// 会话循环收到之后调用 ops.retrieve_reply，文件系统在其中调用 send_reply_none()；
+// inode 不在内核缓存中时内核不发送 NOTIFY_REPLY，cookie 在会话销毁时被丢弃
+// @param se 会话
+// @param ino inode 编号
+// @param size 需要取回的长度
+// @param offset 在文件中的位置
+// @param cookie 原样交给 retrieve_reply
+// @return 0 on success, -ENOSYS 表示内核或者文件系统不支持, negative errno on failure
+int fuse_notify_retrieve(struct fuse_session *se, fuse_inode ino, size_t size, off_t offset, void *cookie);
+
+// 取出 notify_unique 对应的 RETRIEVE 记录，由 NOTIFY_REPLY 的处理函数调用，调用者负责释放
+// @return 对应的记录，没有找到时返回 NULL
+struct fuse_notify_req *fuse_notify_take(struct fuse_session *se, uint64_t unique);
+
+// 释放所有尚未收到回复的 RETRIEVE 记录，在 fuse_session_destroy() 中调用
+void fuse_notify_destroy(struct fuse_session *se);
+
+#endif
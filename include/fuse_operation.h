@@ -56,7 +56,15 @@ struct stat;
 struct flock;
 struct fuse_pollhandle;
 struct fuse_bufvec;
-struct fuse_forget_data;
+
+/**
+ * One entry of a batch forget, with the same layout as struct
+ * fuse_forget_one so the kernel's array can be passed through as is.
+ */
+struct fuse_forget_data {
+	fuse_inode ino;
+	uint64_t nlookup;
+};
 
 /**
  * Information about an open file.
@@ -127,6 +135,12 @@ struct fuse_file_info {
 	/** Requested poll events.  Available in ->poll.  Only set on kernels
 	    which support it.  If unsupported, this field is set to zero. */
 	uint32_t poll_events;
+
+	/** Can be filled in by open/create, with the backing id returned by
+	    fuse_passthrough_open(), to let the kernel serve read/write/mmap
+	    of this file directly from the backing file.  Only valid when
+	    conn->passthrough is set after init.  Overrides direct_io. */
+	int32_t backing_id;
 };
 
 struct fuse_ops{
@@ -153,7 +167,7 @@ struct fuse_ops{
 	 *
 	 * Called on filesystem exit. When this method is called, the
 	 * connection to the kernel may be gone already, so that eg. calls
-	 * to fuse_lowlevel_notify_* will fail.
+	 * to fuse_notify_* will fail.
 	 *
 	 * There's no reply to this function
 	 *
@@ -450,10 +464,15 @@ struct fuse_ops{
 	 * See fuse_file_info structure in <fuse_common.h> for more details.
 	 *
 	 * If this request is answered with an error code of ENOSYS
-	 * and FUSE_CAP_NO_OPEN_SUPPORT is set in
+	 * and FUSE_NO_OPEN_SUPPORT is set in
 	 * `fuse_conn_info.capable`, this is treated as success and
 	 * future calls to open and release will also succeed without being
-	 * sent to the filesystem process.
+	 * sent to the filesystem process. Setting `fuse_conn_info.no_open`
+	 * in init makes the library answer ENOSYS without calling open.
+	 *
+	 * If FUSE_ATOMIC_O_TRUNC is set in `fuse_conn_info.want`, O_TRUNC
+	 * is passed in fi->flags and must be handled by open, the kernel
+	 * no longer sends a separate setattr for it.
 	 *
 	 * Valid replies:
 	 *   fuse_reply_open
@@ -622,11 +641,13 @@ struct fuse_ops{
 	 * stream operations (readdir, releasedir, fsyncdir).
 	 *
 	 * If this request is answered with an error code of ENOSYS and
-	 * FUSE_CAP_NO_OPENDIR_SUPPORT is set in `fuse_conn_info.capable`,
+	 * FUSE_NO_OPENDIR_SUPPORT is set in `fuse_conn_info.capable`,
 	 * this is treated as success and future calls to opendir and
 	 * releasedir will also succeed without being sent to the filesystem
 	 * process. In addition, the kernel will cache readdir results
 	 * as if opendir returned FOPEN_KEEP_CACHE | FOPEN_CACHE_DIR.
+	 * Setting `fuse_conn_info.no_opendir` in init makes the library
+	 * answer ENOSYS without calling opendir.
 	 *
 	 * Valid replies:
 	 *   fuse_reply_open
@@ -1033,6 +1054,12 @@ struct fuse_ops{
 	 * bufv->off is correctly updated (reflecting the number of
 	 * bytes read from bufv->buf[0]).
 	 *
+	 * The data in bufv is only valid until write_buf returns: it
+	 * is either in the receiving thread's splice pipe or in its
+	 * receive buffer, and both are reused for the next request.
+	 * With async replies (se->cq != NULL) the handler must consume
+	 * or copy the data before returning and defer only the reply.
+	 *
 	 * Unless FUSE_CAP_HANDLE_KILLPRIV is disabled, this method is
 	 * expected to reset the setuid and setgid bits.
 	 *
@@ -1057,9 +1084,9 @@ struct fuse_ops{
 	 *	fuse_reply_none
 	 *
 	 * @param req request handle
-	 * @param cookie user data supplied to fuse_lowlevel_notify_retrieve()
-	 * @param ino the inode number supplied to fuse_lowlevel_notify_retrieve()
-	 * @param offset the offset supplied to fuse_lowlevel_notify_retrieve()
+	 * @param cookie user data supplied to fuse_notify_retrieve()
+	 * @param ino the inode number supplied to fuse_notify_retrieve()
+	 * @param offset the offset supplied to fuse_notify_retrieve()
 	 * @param bufv the buffer containing the returned data
 	 */
 	void (*retrieve_reply) (fuse_req_p req, void *cookie, fuse_inode ino,
@@ -1165,7 +1192,7 @@ struct fuse_ops{
 	 * being send to the filesystem process.
 	 *
 	 * Valid replies:
-	 *   fuse_reply_write
+	 *   send_reply_write_count
 	 *   fuse_reply_err
 	 *
 	 * @param req request handle
@@ -1193,7 +1220,7 @@ struct fuse_ops{
 	 * process.
 	 *
 	 * Valid replies:
-	 *   fuse_reply_lseek
+	 *   send_reply_lseek
 	 *   fuse_reply_err
 	 *
 	 * @param req request handle
@@ -1204,6 +1231,22 @@ struct fuse_ops{
 	 */
 	void (*lseek) (fuse_req_p req, fuse_inode ino, off_t off, int whence,
 		       struct fuse_file_info *fi);
+
+	/**
+	 * End of a batch of requests
+	 *
+	 * Called by a session loop thread right before it may block waiting
+	 * for new requests. In async mode this happens only after all requests
+	 * that were already readable have been handed to the handlers, so a
+	 * filesystem that queues backend I/O in its handlers can submit the
+	 * whole batch here with a single system call. Without async mode the
+	 * loop blocks in read() and this is called before every read.
+	 *
+	 * This is not a request and must not send a reply.
+	 *
+	 * @param userdata the user data passed to fuse_session_new()
+	 */
+	void (*batch_end) (void *userdata);
 };
 
 #endif
\ No newline at end of file
@@ -15,7 +15,8 @@
 #define FUSE_ARGS_INIT(argc, argv) {argc,argv,0}
 
 #define DEFAULT_THREAD_NUM 10
-#define FUSE_CMD_OPTS_INIT {0, 0, 0, 0, 0, NULL, 0,DEFAULT_THREAD_NUM}
+#define DEFAULT_IDLE_TIMEOUT 10
+#define FUSE_CMD_OPTS_INIT {0, 0, 0, 0, 0, NULL, 0,DEFAULT_THREAD_NUM,0,DEFAULT_IDLE_TIMEOUT,NULL,0,0,0,0,NULL,NULL,0,0,0,0,0}
 
 #define FUSE_MNT_OPTS_INIT {0, 0, 0, NULL, NULL, NULL}
 
@@ -25,7 +26,7 @@
 #define DEFAULT_MAX_BACKGROUND 4
 #define DEFAULT_CONGESTION_THRESHOLD 3
 #define DEFAULT_TIME_GRAN 1
-#define FUSE_CONN_INFO_INIT {0,0,DEFAULT_MAX_WRITE,DEFAULT_MAX_READ,DEFAULT_MAX_READAHEAD,DEFAULT_MAX_BACKGROUND,DEFAULT_CONGESTION_THRESHOLD,DEFAULT_TIME_GRAN,0,0,{0}}
+#define FUSE_CONN_INFO_INIT {0,0,DEFAULT_MAX_WRITE,DEFAULT_MAX_READ,DEFAULT_MAX_READAHEAD,DEFAULT_MAX_BACKGROUND,DEFAULT_CONGESTION_THRESHOLD,DEFAULT_TIME_GRAN,0,0,0,0,0,0,0,0,{0}}
 
 #define DEFINE_FUSE_OPT(s, t, p) {s, offsetof(t, p), 1}
 
@@ -57,7 +58,21 @@ struct fuse_cmd_opts
     int multithread;      // 是否多线程处理请求
     char* mountpoint;     // 挂载点
 	int clonefd;		  // 在多线程模式下，是否为每个线程拷贝 /dev/fuse，这个选项可以加快多线程模式下的处理速度
-    unsigned threads;     // 多线程情况下，处理请求线程
+    unsigned threads;     // 多线程情况下，常驻的处理请求线程数量
+    unsigned max_threads; // 多线程情况下，所有线程都在处理请求时按需创建线程，线程总数不超过这个值（0 表示与 threads 相同，即固定线程数）
+    unsigned idle_timeout;// 按需创建的线程空闲超过这个秒数后退出（0 表示不回收）
+    char* cpus;           // 多线程情况下，为列表中的每个 CPU 创建一个绑定的线程，格式如 0-3,8,10-11
+    unsigned max_inflight;// 大于 0 时开启异步模式，同时处理的请求（包括异步处理中的请求）不超过这个数量
+    int io_uring;         // 是否在内核支持时通过 FUSE-over-io_uring 收发请求
+    unsigned io_uring_depth;// io_uring 每个队列（每个 CPU）的队列项数量，0 表示使用默认值
+    unsigned readers;     // 多线程情况下，大于 0 时使用分发模式，由这么多个线程读取请求，threads 个线程按类别处理请求
+    char* qos;            // 分发模式下按租户公平调度，租户的划分方式为 uid、pid 或者 cgroup，未设置 readers 时使用一个读取线程
+    char* qos_weights;    // 租户的权重以及限速，格式为 name:weight[:iops[:MB/s]]，以逗号分隔
+    unsigned qos_iops;    // 每个租户默认的 IOPS 上限（0 表示不限制）
+    unsigned qos_bw;      // 每个租户默认的 READ/WRITE 带宽上限，单位为 MB/s（0 表示不限制）
+    unsigned qos_report;  // 每隔这么多秒输出一次各个租户的排队延迟（0 表示只在退出时输出）
+    unsigned busy_poll;   // 多线程情况下，常驻线程阻塞等待请求前最多自旋这么多微秒（0 表示不自旋）
+    unsigned poll_threads;// 自旋等待请求的常驻线程数量（0 表示所有常驻线程）
 };
 
 // 文件系统挂载相关配置
@@ -112,11 +127,38 @@ struct fuse_conn_info {
 	// fuse 内核所能支持能力的标记（只读）
 	uint32_t capable;
 
-	// libfuse 希望文件系统拥有能力的标记（只读）
+	// 文件系统希望开启的能力的标记，必须是 capable 的子集（读写）
+	// 库在调用 init 之前设置默认开启的能力，init 中可以增加或者清除，最终全部在 INIT 回复中交给内核；
+	// 如 FUSE_WRITEBACK_CACHE 开启后缓存写由内核合并，之后以 FUSE_WRITE_CACHE 标记的 WRITE 请求写回
 	uint32_t want;
 
+	// 是否通过 splice 从 /dev/fuse 接收请求，内核支持时设置 want 中的 FUSE_SPLICE_READ，
+	// 此时 WRITE 请求的数据留在管道中，通过 write_buf 交给文件系统（读写）
+	unsigned splice_read;
+
+	// 是否使用内核 passthrough：文件系统在 init 中设置，内核不支持时在 init 之后被清零；
+	// 开启后 open/create 可以通过 fuse_file_info.backing_id 让内核直接读写后端文件（读写）
+	unsigned passthrough;
+
+	// 每个请求最多携带的页数，决定 max_write、max_pages 以及接收缓冲区的大小，
+	// 0 表示使用 FUSE_MAX_MAX_PAGES，超过内核的 /proc/sys/fs/fuse/max_pages_limit 时按内核的限制（读写）
+	unsigned max_pages;
+
+	// 大 I/O 模式：max_pages 取内核允许的最大值，max_readahead 没有设置时同样取这个大小，
+	// 接收缓冲区从预先访问的大页缓冲区池中分配（读写）
+	unsigned large_io;
+
+	// 文件系统不需要 OPEN 和 RELEASE：内核支持 FUSE_NO_OPEN_SUPPORT 时 OPEN 直接回复 ENOSYS，
+	// 内核此后不再发送 OPEN 以及 RELEASE，其他请求中的 fh 为 0；没有实现 open 时默认开启，
+	// 内核不支持时在 init 之后被清零（读写）
+	unsigned no_open;
+
+	// 与 no_open 相同，对应 OPENDIR 和 RELEASEDIR（FUSE_NO_OPENDIR_SUPPORT），
+	// 开启后内核像 opendir 设置了 keep_cache 以及 cache_readdir 一样缓存 READDIR 的结果（读写）
+	unsigned no_opendir;
+
 	// 保留字段
-	unsigned reserved[22];
+	unsigned reserved[16];
 };
 
 // 根据 opts 中的规则，解析 args 中的参数，结果存储在 data；
@@ -0,0 +1,154 @@
+#ifndef _FUSE_QOS_H
+#define _FUSE_QOS_H
+
+#include "fuse_kernel.h"
+#include "fuse_dispatch.h"
+
+#include <stdint.h>
+#include <pthread.h>
+
+// 租户的划分方式
+#define FUSE_QOS_NONE 0
+#define FUSE_QOS_UID 1		// 每个 uid 一个租户
+#define FUSE_QOS_PID 2		// 每个进程一个租户
+#define FUSE_QOS_CGROUP 3	// 按照发起请求的进程所在的 cgroup 划分租户
+
+// 租户数量的上限，超过之后新出现的租户都归入同一个名为 other 的租户
+#define FUSE_QOS_MAX_TENANTS 1024
+// 租户名称的最大长度，cgroup 路径超过这个长度时被截断
+#define FUSE_QOS_NAME_MAX 128
+// 进程到 cgroup 的缓存大小，按 pid 直接映射
+#define FUSE_QOS_PID_CACHE 256
+
+// 分发模式下的 QoS 配置，在挂载时由命令行参数指定
+struct fuse_qos_config
+{
+	int tenant;					// 租户的划分方式，FUSE_QOS_NONE 表示不开启
+	const char *weights;		// 每个租户的配置，格式为 name:weight[:iops[:MB/s]]，以逗号分隔，NULL 表示都使用默认值
+	unsigned iops;				// 每个租户默认的 IOPS 上限，0 表示不限制
+	unsigned bandwidth;			// 每个租户默认的 READ/WRITE 带宽上限，单位为 MB/s，0 表示不限制
+	unsigned report;			// 每隔这么多秒输出一次各个租户的排队延迟，0 表示只在会话结束时输出
+};
+
+struct fuse_qos_tenant;
+
+// 排队中的一个请求
+struct fuse_qos_node
+{
+	struct fuse_qos_node *next;
+	struct fuse_dispatch_item item;
+	struct fuse_qos_tenant *t;
+	uint64_t start;				// 虚拟开始时间，同一类别中开始时间最小的请求先被处理
+	uint64_t enqueued;			// 入队时刻，单位为纳秒
+	uint32_t bytes;				// READ/WRITE 的数据量，消耗带宽令牌
+	int throttled;				// 是否因为令牌不足而等待过
+	int overflow;				// 限速租户单独分配的节点，出队后释放
+};
+
+struct fuse_qos_tenant
+{
+	struct fuse_qos_tenant *hnext;		// 哈希表中的下一个租户
+	struct fuse_qos_tenant *anext;		// 有请求排队的租户链表
+	char name[FUSE_QOS_NAME_MAX];
+	unsigned weight;
+	unsigned iops;
+	unsigned bandwidth;					// 单位为字节每秒
+	unsigned queued;					// 所有类别中排队的请求数
+	struct fuse_qos_node *head[FUSE_CLASS_MAX];
+	struct fuse_qos_node *tail[FUSE_CLASS_MAX];
+	uint64_t finish[FUSE_CLASS_MAX];	// 上一个入队请求的虚拟完成时间
+
+	// 令牌桶，桶的容量为一秒的配额
+	double iops_tokens;
+	double byte_tokens;
+	uint64_t refilled;					// 上一次补充令牌的时刻
+
+	// 统计信息，interval 开头的字段在每次输出后清零
+	uint64_t requests;
+	uint64_t delay;
+	uint64_t max_delay;
+	uint64_t throttled;
+	uint64_t interval_requests;
+	uint64_t interval_delay;
+	uint64_t interval_max_delay;
+};
+
+// 一条租户配置
+struct fuse_qos_rule
+{
+	char name[FUSE_QOS_NAME_MAX];
+	unsigned weight;
+	unsigned iops;
+	unsigned bandwidth;
+};
+
+// 按 pid 缓存进程所在的 cgroup，进程退出后 pid 被复用的情况忽略不计
+struct fuse_qos_pid_entry
+{
+	uint32_t pid;
+	char name[FUSE_QOS_NAME_MAX];
+};
+
+// 加权公平队列：每个类别维护一个虚拟时间，请求入队时的虚拟开始时间为
+// max(虚拟时间, 同一租户上一个请求的虚拟完成时间)，完成时间再加上 开销/权重，
+// 出队时选择开始时间最小、令牌充足的租户的请求，并把虚拟时间推进到这个开始时间。
+// 除了 fuse_qos_key() 以外，所有函数都需要调用者持有分发器的锁
+struct fuse_qos
+{
+	struct fuse_qos_config config;
+	uint64_t vtime[FUSE_CLASS_MAX];
+	struct fuse_qos_tenant *buckets[64];
+	struct fuse_qos_tenant *active;			// 有请求排队的租户
+	struct fuse_qos_tenant *other;			// 租户数量达到上限后共用的租户
+	unsigned ntenants;
+	struct fuse_qos_rule *rules;
+	unsigned nrules;
+	struct fuse_qos_node *nodes;			// 预先分配给不限速租户的排队节点，数量与分发器的容量相同
+	struct fuse_qos_node *free_nodes;
+	uint64_t next_report;
+
+	pthread_mutex_t cache_lock;				// 保护 pid_cache
+	struct fuse_qos_pid_entry *pid_cache;
+};
+
+// 当前 CLOCK_MONOTONIC 时间，单位为纳秒
+uint64_t fuse_qos_now(void);
+
+// 创建 QoS 调度器
+// @param config QoS 配置
+// @param capacity 同时排队的请求数上限
+// @return 调度器 on success, NULL on failure (配置格式错误或者内存不足)
+struct fuse_qos *fuse_qos_new(const struct fuse_qos_config *config, unsigned capacity);
+
+// 根据请求头部计算租户名称，cgroup 方式下读取 /proc/<pid>/cgroup，不需要持有分发器的锁
+// @param q 调度器
+// @param in 请求头部
+// @param name 输出租户名称，长度为 FUSE_QOS_NAME_MAX
+void fuse_qos_key(struct fuse_qos *q, const struct fuse_in_header *in, char *name);
+
+// 请求入队，限速租户的请求使用单独分配的节点，不占用 capacity 个共享的节点
+// @return 0 on success, -1 表示共享的节点已经用完，调用者等待有请求出队后重试
+int fuse_qos_enqueue(struct fuse_qos *q, const char *name, const struct fuse_dispatch_item *item,
+					 enum fuse_dispatch_class cls, uint64_t now);
+
+// 按照类别的优先级取出一个请求，同一类别中按照虚拟开始时间选择租户
+// @param q 调度器
+// @param data 是否可以取出 DATA 类请求
+// @param now 当前时刻
+// @param item 输出取出的请求
+// @param cls 输出取出的请求的类别
+// @param wait 没有可以取出的请求时，输出距离最早一个因令牌不足而等待的请求可以处理的纳秒数，0 表示没有这样的请求
+// @return 1 表示取出了一个请求，0 表示没有可以处理的请求
+int fuse_qos_dequeue(struct fuse_qos *q, int data, uint64_t now, struct fuse_dispatch_item *item,
+					 enum fuse_dispatch_class *cls, uint64_t *wait);
+
+// 不考虑令牌取出任意一个排队的请求，停止分发器时丢弃剩余请求使用
+int fuse_qos_drain(struct fuse_qos *q, struct fuse_dispatch_item *item);
+
+// 输出每个租户自上次输出以来的请求数以及排队延迟
+void fuse_qos_report(struct fuse_qos *q);
+
+// 输出每个租户累计的统计信息并释放调度器
+void fuse_qos_destroy(struct fuse_qos *q);
+
+#endif
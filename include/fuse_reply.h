@@ -6,6 +6,9 @@
 #include "fuse_session.h"
 
 #include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <limits.h>
 #include <sys/uio.h>
 
 // 缓冲区为某个文件描述符，这个字段设置之后 .mem 无效
@@ -24,6 +27,60 @@ struct fuse_buf {
 	off_t pos;		// 只有当 FUSE_BUF_FD_SEEK 设置时，这个字段才有用
 };
 
+// 由多个缓冲区组成的数据，idx 和 off 记录当前已经处理到的位置
+struct fuse_bufvec {
+	size_t count;	// buf 数组的长度
+	size_t idx;		// 当前缓冲区下标
+	size_t off;		// 当前缓冲区内的偏移
+	struct fuse_buf buf[1];
+};
+
+// 初始化只有一个内存缓冲区的 fuse_bufvec
+#define FUSE_BUFVEC_INIT(size__)                  \
+	((struct fuse_bufvec){                        \
+		.count = 1,                               \
+		.idx = 0,                                 \
+		.off = 0,                                 \
+		.buf = {{                                 \
+			.size = (size__),                     \
+			.mem = NULL,                          \
+			.flags = 0,                           \
+			.fd = -1,                             \
+			.pos = 0,                             \
+		}}})
+
+// 计算 bufv 中所有缓冲区的总大小
+size_t fuse_buf_size(const struct fuse_bufvec *bufv);
+
+// 从 src 拷贝数据到 dst，拷贝的长度为两者剩余长度中较小的一个，
+// 拷贝后 src 和 dst 的 idx 以及 off 都会向后移动；
+// 两端都是文件描述符并且其中一端为管道时使用 splice，数据不经过用户空间
+// @param dst 目标缓冲区
+// @param src 源缓冲区
+// @return 成功返回拷贝的字节数，失败返回负的错误号
+ssize_t fuse_buf_copy(struct fuse_bufvec *dst, struct fuse_bufvec *src);
+
+// 线程独有的管道，用于 splice
+enum fuse_pipe_type {
+	FUSE_PIPE_REPLY,	// 发送 READ 响应
+	FUSE_PIPE_RECEIVE,	// 通过 splice 接收请求
+	FUSE_PIPE_MAX,
+};
+
+struct fuse_pipe {
+	int fd[2];		// 非阻塞的管道读写端
+	size_t size;	// 管道容量
+};
+
+// 获取调用线程指定用途的管道，第一次调用时创建，线程退出时自动关闭
+// @param type 管道用途
+// @param size 需要的管道容量，容量不足时尝试扩大管道
+// @return 成功返回管道，无法创建或者扩大到指定容量时返回 NULL
+struct fuse_pipe *fuse_pipe_get(enum fuse_pipe_type type, size_t size);
+
+// 关闭调用线程指定用途的管道，在管道中可能残留数据时调用，下次获取时重新创建
+void fuse_pipe_reset(enum fuse_pipe_type type);
+
 // 发送 iov 中的数据，如果 clonefd 为 -1 ，则将数据发往 se->fd；否则发往 se->fd
 // @param se 请求所在的会话主体
 // @param clonefd 在 clonefd 设置时，克隆的 /dev/fuse 文件描述符
@@ -55,10 +112,55 @@ int send_reply_open(fuse_req_p req, const struct fuse_file_info *f);
 
 int send_reply_create(fuse_req_p req, const struct fuse_entry_param *e, const struct fuse_file_info *f);
 
+// 发送 READ 响应，等同于只有一个缓冲区的 send_reply_data()
 int send_reply_read(fuse_req_p req, const struct fuse_buf *buf);
 
+// 发送由多个缓冲区组成的响应数据，从 bufv 的当前位置开始：
+// 1. 所有缓冲区都在内存中时，与响应头部一起通过一次 writev 发送，不需要拼接；
+// 2. 包含文件描述符并且内核支持 splice 写入 /dev/fuse 时，内存缓冲区通过 vmsplice、
+//    文件通过 splice 依次放入线程独有的管道，再整体 splice 到 /dev/fuse；
+// 3. 否则拷贝到一个临时缓冲区后发送；
+// 文件提前结束时只发送已经读取到的数据
+// @param req 请求体
+// @param bufv 响应数据
+// @return 发送成功返回 0，发送失败返回对应的错误号
+int send_reply_data(fuse_req_p req, struct fuse_bufvec *bufv);
+
 int send_reply_write(fuse_req_p req, const struct fuse_buf *outbuf, const struct fuse_buf *inbuf);
 
+// 与 send_reply_write() 相同，用于 write_buf，数据在管道中时通过 splice 写入 outbufv
+int send_reply_write_buf(fuse_req_p req, struct fuse_bufvec *outbufv, struct fuse_bufvec *inbufv);
+
+// 发送 WRITE 以及 COPY_FILE_RANGE 的响应，文件系统已经自己完成了写入
+// @param req 请求体
+// @param count 写入的字节数
+// @return 发送成功返回 0，发送失败返回对应的错误号
+int send_reply_write_count(fuse_req_p req, size_t count);
+
+// 发送 LSEEK (SEEK_DATA/SEEK_HOLE) 的响应
+// @param req 请求体
+// @param off 找到的数据或者空洞的位置
+// @return 发送成功返回 0，发送失败返回对应的错误号
+int send_reply_lseek(fuse_req_p req, off_t off);
+
 int send_reply_attr(fuse_req_p req, const struct stat *stbuf, double attr_timeout);
 
+// 向 READDIR 的响应缓冲区中添加一个目录项，只使用 stbuf 中的 st_ino 以及 st_mode 的文件类型部分
+// @param req 请求体
+// @param buf 响应缓冲区中的当前位置
+// @param bufsize 缓冲区剩余大小
+// @param name 目录项名称
+// @param stbuf 目录项属性
+// @param off 下一个目录项的偏移
+// @return 目录项占用的大小，缓冲区剩余空间不足时返回 0
+size_t fuse_add_direntry(fuse_req_p req, char *buf, size_t bufsize,
+						 const char *name, const struct stat *stbuf, off_t off);
+
+// 向 READDIRPLUS 的响应缓冲区中添加一个带有属性的目录项，e 中的 entry_timeout 以及 attr_timeout
+// 与 lookup 的回复含义相同；e->ino 不为 0 时内核会增加这个 inode 的查找计数（"." 和 ".." 除外），
+// e->ino 为 0 时只填写 e->attr 中的 st_ino 以及文件类型
+// @return 目录项占用的大小，缓冲区剩余空间不足时返回 0，此时调用者需要撤销这次查找
+size_t fuse_add_direntry_plus(fuse_req_p req, char *buf, size_t bufsize,
+							  const char *name, const struct fuse_entry_param *e, off_t off);
+
 #endif
\ No newline at end of file
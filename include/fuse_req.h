@@ -6,12 +6,15 @@
 #include<stdint.h>
 #include<stdatomic.h>
 #include<sys/types.h>
+#include<pthread.h>
 
 // 计算缓冲区默认大小
 #define FUSE_MAX_MAX_PAGES 256
 #define FUSE_DEFAULT_MAX_PAGES_PER_REQ 32
 #define FUSE_BUFFER_HEADER_SIZE 0x1000
 
+struct fuse_uring_ent;
+
 struct fuse_ctx
 {
     /** User ID of the calling process */
@@ -44,29 +47,136 @@ struct fuse_req
 	// 请求 ID
     uint64_t unique;        
 
-	// 收到一个新的请求，如果 int_list 中有对应的打断请求，
+	// 收到一个新的请求，如果请求表中有对应的打断请求，
 	// 那么新接收到的请求的这个字段将会被标记为 1，
-	// 随后这个新接收到的请求不会被处理，而是直接释放
-    int interrupted;
+	// 随后这个新接收到的请求不会被处理，而是直接回复 EINTR；
+	// 处理中的请求由处理 int 请求的线程设置，因此是原子变量
+    atomic_int interrupted;
 
 	// 对于一个 int 请求，这个字段设置为期望打断的请求号
-    int interrupted_id;
+    uint64_t interrupted_id;
+	// 挂起的 int 请求在请求表分片的 int_buckets 中的下一个
+	struct fuse_req *int_next;
+
+	// 请求是否已经登记在会话的请求表中，回复时据此决定是否需要从请求表中移除
+	int registered;
 
 	// 请求发起者的用户信息，进程信息等
     struct fuse_ctx ctx; 
 
+	// 分配这个请求体的线程缓存池，为 NULL 表示直接通过 calloc 分配
+	struct fuse_req_pool *pool;
+
+	// 异步完成时由会话循环调用的回调函数及其参数，见 fuse_req_complete()
+	void (*complete)(struct fuse_req *req, void *data);
+	void *complete_data;
+	// 在会话完成队列中的下一个请求
+	struct fuse_req *cq_next;
+
+	// 通过 io_uring 收到的请求所在的队列项，回复写入队列项后提交给内核，
+	// 为 NULL 表示请求来自 /dev/fuse，回复也写入 /dev/fuse
+	struct fuse_uring_ent *ring_ent;
+
     struct fuse_req* prev;
     struct fuse_req* next;
 };
 typedef struct fuse_req* fuse_req_p;
 typedef uint64_t fuse_inode;
 
+// 每个线程缓存池中最多保留的空闲请求体数量，超过的部分直接释放
+#define FUSE_REQ_POOL_MAX 1024
+
+// 线程独有的请求体缓存池，稳定运行时分配和释放请求体都不需要访问堆：
+// 1. 所属线程分配和释放请求体只操作 free_list，不需要加锁；
+// 2. 其他线程（如 interrupt 处理或者异步响应）释放的请求体通过 CAS 压入 remote_list，
+//    所属线程在 free_list 为空时一次性取走 remote_list；
+// 3. refcount 等于所属线程持有的 1 加上尚未归还的请求体数量，
+//    线程退出后缓存池由最后一个归还请求体的线程释放
+struct fuse_req_pool
+{
+	struct fuse_req *free_list;
+	size_t cached;
+	_Atomic(struct fuse_req *) remote_list;
+	atomic_size_t refcount;
+};
+
+// 请求表的分片数量以及每个分片的哈希桶数量，都必须是 2 的幂
+#define FUSE_REQ_TABLE_SHARDS 64
+#define FUSE_REQ_TABLE_BUCKETS 256
+#define FUSE_REQ_TABLE_INT_BUCKETS 64
+
+// 请求表的一个分片，请求 ID 相同的普通请求与 int 请求总是落在同一个分片中，
+// 因此查找、登记以及打断只需要持有一个分片的锁
+struct fuse_req_shard
+{
+	pthread_mutex_t lock;
+	// 正在处理的请求，通过 next 字段链接成单链表
+	struct fuse_req *buckets[FUSE_REQ_TABLE_BUCKETS];
+	// 尚未找到对应请求的 int 请求，按到达顺序排列，用于取出最早挂起的一个
+	struct fuse_req int_list;
+	// 同样的 int 请求以 interrupted_id 为键散列，通过 int_next 字段链接成单链表
+	struct fuse_req *int_buckets[FUSE_REQ_TABLE_INT_BUCKETS];
+} __attribute__((aligned(64)));
+
+// 会话的请求表，以请求 ID 为键，替代原先由一把锁保护的 req_list 和 int_list
+struct fuse_req_table
+{
+	struct fuse_req_shard shards[FUSE_REQ_TABLE_SHARDS];
+	// 当前登记在请求表中的请求数量，加上会话循环为读取请求预占的名额
+	atomic_size_t inflight;
+};
+
 // struct fuse_notify_req
 // {
 //     struct fuse_notify_req *prev;
 //     struct fuse_notify_req *next;
 // };
 
+// 为调用线程创建请求体缓存池，一般在处理请求的循环开始前调用
+// @return 0 on success, -1 on failure
+int fuse_req_pool_init(void);
+
+// 释放调用线程的请求体缓存池，一般在处理请求的循环结束后调用
+void fuse_req_pool_destroy(void);
+
+// 分配一个新的请求体，调用线程拥有缓存池时优先从缓存池中获取
+// @param se 请求所在的会话
+// @return 成功返回初始化后的请求体，失败返回 NULL
+fuse_req_p fuse_alloc_req(struct fuse_session *se);
+
+// 释放请求体，请求体会被归还到分配它的缓存池，可以在任意线程调用
+// @param req 请求体
+void fuse_free_req(fuse_req_p req);
+
+// 创建请求表
+// @return 成功返回请求表，失败返回 NULL
+struct fuse_req_table *fuse_req_table_new(void);
+
+// 销毁请求表，同时释放仍然挂起的 int 请求
+void fuse_req_table_destroy(struct fuse_req_table *table);
+
+// 登记一个新收到的请求：
+// 1. 如果已经有对应的 int 请求，则释放这个 int 请求并设置 req->interrupted，请求不会被登记；
+// 2. 否则登记这个请求，并从同一个分片中取出一个最早挂起的 int 请求，
+//    调用者需要对其回复 EAGAIN，这样保证挂起的 int 请求不会无限增长
+// @param table 请求表
+// @param req 新收到的请求
+// @return 需要回复 EAGAIN 的 int 请求，没有则返回 NULL
+fuse_req_p fuse_req_register(struct fuse_req_table *table, fuse_req_p req);
+
+// 从请求表中移除一个请求，未登记的请求直接返回
+// @return 移除之前请求表的 inflight，未登记的请求返回 0
+size_t fuse_req_unregister(fuse_req_p req);
+
+// 处理一个 int 请求：
+// 1. 如果对应的请求已登记且尚未开始处理，则抢先标记这个请求，
+//    处理线程随后会直接回复 EINTR；已经在处理中的请求仅设置 interrupted 标记；
+// 2. 如果对应的请求尚未到达，则挂起这个 int 请求，等待对应请求到达时处理
+// @param table 请求表
+// @param intr int 请求，其 interrupted_id 为期望打断的请求号
+// @return 1 表示调用者可以释放这个 int 请求，0 表示 int 请求已被挂起
+int fuse_req_interrupt(struct fuse_req_table *table, fuse_req_p intr);
+
 #define FUSE_LIST_INIT(item) \
     {                       \
         item.prev = &item;    \
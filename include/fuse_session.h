@@ -6,6 +6,20 @@
 
 #include <unistd.h>
 #include <pthread.h>
+#include <semaphore.h>
+
+struct fuse_cq;
+struct fuse_uring;
+struct fuse_bufpool;
+
+// fuse_notify_retrieve() 发出后等待 NOTIFY_REPLY 的记录
+struct fuse_notify_req
+{
+	uint64_t unique;			// 交给内核的 notify_unique，NOTIFY_REPLY 请求的 unique 与之相同
+	void *cookie;				// 调用者的数据，原样交给 retrieve_reply
+	struct fuse_notify_req *next;
+	struct fuse_notify_req *prev;
+};
 
 struct fuse_session{
 	const char* mountpoint;		// 挂载点绝对地址，在挂载成功后被初始化
@@ -20,11 +34,17 @@ struct fuse_session{
 	struct fuse_ops ops;		// FUSE 文件系统下自定义的操作（根据 VFS 操作接口格式）
 	uid_t owner;				// 创建会话的用户 ID
 	void *userdata;				// 用户自定义数据
-	pthread_mutex_t lock;		// 应该是访问 req_list 以及 int_list 的锁
-	struct fuse_req req_list;	// 正常用户请求队列
-	struct fuse_req int_list;	// interrupt 请求队列
+	struct fuse_req_table *reqs;	// 以请求 ID 为键的分片请求表，记录正在处理的请求以及挂起的 interrupt 请求
 	size_t bufsize;				// 接收从内核传来请求的缓冲区大小
 	int error;					// 进程如果因为信号而被中断，则这个字段会被设置
+	sem_t exit_sem;				// 设置 exited 时发布，多线程循环的主线程在这个信号量上等待退出
+	struct fuse_cq *cq;			// 异步模式下的完成队列，为 NULL 表示未开启异步模式
+	unsigned max_inflight;		// 异步模式下同时处理的请求数量上限，0 表示不限制
+	struct fuse_uring *uring;	// io_uring 传输方式，为 NULL 表示只通过 read/writev 访问 /dev/fuse
+	struct fuse_bufpool *bufpool;	// 接收请求的缓冲区池，在会话循环开始时创建
+	pthread_mutex_t notify_lock;	// 保护 notify_list 以及 notify_ctr
+	struct fuse_notify_req notify_list;	// 尚未收到 NOTIFY_REPLY 的 RETRIEVE 通知
+	uint64_t notify_ctr;		// 下一个 RETRIEVE 通知的 notify_unique
 };
 
 // 根据 args 以及 op 参数创建一个会话 session；
@@ -42,9 +62,19 @@ struct fuse_session *fuse_session_new(struct fuse_args *args, const struct fuse_
 // @param se session 对象
 void fuse_session_reset(struct fuse_session *se);
 
+// 通知会话退出，设置 se->exited=1 并唤醒等待退出的主线程；
+// 这个函数可以在信号处理函数中调用
+// @param se session 对象
+void fuse_session_exit(struct fuse_session *se);
+
+// 取得连接信息所属的会话，ops.init 只收到 conn，需要发送通知的文件系统由此得到会话
+// @param conn 会话中的连接信息
+// @return conn 所在的 session 对象
+struct fuse_session *fuse_conn_session(struct fuse_conn_info *conn);
+
 // 这个函数一般在文件系统解除挂载后进行最后的清理工作:
 // 1. 如果有 ops.destroy 函数，则调用这个函数；
-// 2. 清理分配的锁 lock；
+// 2. 处理完成队列中剩余的请求，释放完成队列以及请求表 reqs；
 // 3. 如果有打开的 clonefds，则关闭对应的文件描述符
 // 4. 如果文件描述符未关闭（一般会在 `fuse_session_umount()` 中关闭），就关闭文件描述符；
 // 5. 释放 mo 中动态分配的内存；
@@ -52,4 +82,17 @@ void fuse_session_reset(struct fuse_session *se);
 // @param se session 对象
 void fuse_session_destroy(struct fuse_session *se);
 
+// 将打开的文件 fd 注册为内核 passthrough 的后端文件（FUSE_DEV_IOC_BACKING_OPEN），
+// 需要在 init 之后 conn.passthrough 仍然为 1，并且进程具有 CAP_SYS_ADMIN 权限；
+// 内核持有后端文件的引用，调用者可以随后关闭 fd；
+// 同一个 inode 同时打开的所有文件必须使用同一个 backing_id
+// @param se 会话
+// @param fd 后端文件
+// @return 大于 0 的 backing_id on success, negative errno on failure
+int fuse_passthrough_open(struct fuse_session *se, int fd);
+
+// 释放 fuse_passthrough_open() 返回的 backing_id，已经使用这个 backing_id 打开的文件不受影响
+// @return 0 on success, negative errno on failure
+int fuse_passthrough_close(struct fuse_session *se, int backing_id);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,107 @@
+#ifndef _FUSE_URING_H
+#define _FUSE_URING_H
+
+#include "fuse_kernel.h"
+#include "fuse_req.h"
+#include "fuse_session.h"
+#include "fuse_reply.h"
+
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+// 每个队列默认的队列项数量，也就是每个 CPU 上同时处理的请求数量上限
+#define FUSE_URING_DEFAULT_DEPTH 8
+
+struct fuse_uring_queue;
+
+// 一个队列项，注册给内核后由内核写入请求，回复写回同一个队列项后再提交给内核：
+// 1. 每个队列项占用队列缓冲区中连续的一段，开头的 FUSE_BUFFER_HEADER_SIZE 字节存放 fuse_uring_req_header，
+//    之后是按页对齐的负载缓冲区，请求中除了操作头部以外的参数（文件名、WRITE 的数据等）都由内核写入负载缓冲区；
+// 2. 收到请求后将 fuse_in_header 和操作头部拷贝到负载缓冲区之前，拼成与 /dev/fuse 相同的连续请求，
+//    WRITE 的数据不需要拷贝
+struct fuse_uring_ent
+{
+	struct fuse_uring_queue *q;
+	struct fuse_uring_req_header *hdr;
+	char *payload;
+	uint64_t commit_id;			// 当前请求的提交 ID，回复时交还给内核
+	struct iovec iov[2];		// 注册时交给内核的头部和负载缓冲区
+};
+
+// 处理一个通过 io_uring 收到的请求，buf 为拼好的连续请求
+typedef void (*fuse_uring_process_func)(struct fuse_session *se, struct fuse_buf *buf,
+										struct fuse_uring_ent *ent);
+
+// 一个队列对应一个 CPU，拥有自己的 io_uring、队列缓冲区以及绑定在这个 CPU 上的线程；
+// 内核总是把请求放入发起请求的进程所在 CPU 的队列中
+struct fuse_uring_queue
+{
+	struct fuse_uring *ring;
+	unsigned qid;
+	int fd;						// io_uring 的文件描述符
+	pthread_t thread;
+	pthread_mutex_t lock;		// 保护 sq，其他线程完成的异步请求也会在这个队列上提交回复
+	unsigned entries;
+
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	struct io_uring_sqe *sqes;	// 每个 sqe 占用两个 io_uring_sqe 的空间 (IORING_SETUP_SQE128)
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	void *sq_ptr;
+	size_t sq_len;
+	void *cq_ptr;
+	size_t cq_len;
+	size_t sqes_len;
+
+	char *buf;					// 队列缓冲区，由绑定后的线程首次访问，分配在本地 NUMA 节点
+	size_t buf_len;
+	struct fuse_uring_ent *ents;
+};
+
+struct fuse_uring
+{
+	struct fuse_session *se;
+	fuse_uring_process_func process;
+	unsigned depth;				// 每个队列的队列项数量
+	unsigned nr_queues;			// 等于内核中可能存在的 CPU 数量，所有队列都注册后内核才会通过 io_uring 发送请求
+	size_t payload_sz;			// 负载缓冲区的大小，在 INIT 中确定
+	int started;				// 所有队列都已经注册
+	struct fuse_uring_queue *queues;
+
+	sem_t ready;				// 每个队列完成注册（或者失败）后发布一次
+	atomic_int failed;
+};
+
+// 为会话开启 io_uring 传输方式，在进入会话循环之前调用：
+// 只是在 INIT 中向内核请求 FUSE_OVER_IO_URING，协商成功后由 fuse_uring_start() 创建队列
+// @param se 会话
+// @param depth 每个队列的队列项数量，0 表示使用 FUSE_URING_DEFAULT_DEPTH
+// @param process 处理请求的函数
+// @return 0 on success, -1 on failure
+int fuse_uring_new(struct fuse_session *se, unsigned depth, fuse_uring_process_func process);
+
+// 在 INIT 回复发送之后调用，为每个 CPU 创建一个队列及其线程，并把所有队列项注册给内核；
+// 失败时销毁已经创建的队列，内核只有在所有队列都注册后才会切换到 io_uring，因此请求继续通过 /dev/fuse 发送
+// @param se 会话
+// @param payload_sz 负载缓冲区的大小，不能小于内核根据 max_write 和 max_pages 计算出的大小
+// @return 0 on success, -1 on failure
+int fuse_uring_start(struct fuse_session *se, size_t payload_sz);
+
+// 将回复写入请求所在的队列项，并通过 FUSE_IO_URING_CMD_COMMIT_AND_FETCH 提交，可以在任意线程调用：
+// 在队列自己的线程中调用时 sqe 留到线程下一次等待请求时一起提交
+// @param ent 请求所在的队列项
+// @param iov 第一个元素为 fuse_out_header，之后为回复的参数
+// @param count iov 的长度
+// @return 0 on success, negative errno on failure
+int fuse_uring_commit(struct fuse_uring_ent *ent, struct iovec *iov, int count);
+
+// 停止所有队列的线程并释放 io_uring 传输方式
+void fuse_uring_destroy(struct fuse_session *se);
+
+#endif
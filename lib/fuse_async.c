@@ -0,0 +1,153 @@
+#include <fuse_async.h>
+#include <fuse_log.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+int fuse_session_async(struct fuse_session *se, unsigned max_inflight)
+{
+	struct fuse_cq *cq;
+
+	if (se->cq != NULL)
+	{
+		se->max_inflight = max_inflight;
+		return 0;
+	}
+
+	cq = (struct fuse_cq *)malloc(sizeof(struct fuse_cq));
+	if (cq == NULL)
+	{
+		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: unable to allocate completion queue: %s\n", strerror(errno));
+		return -1;
+	}
+	cq->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (cq->efd == -1)
+	{
+		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: unable to create completion eventfd: %s\n", strerror(errno));
+		free(cq);
+		return -1;
+	}
+	atomic_init(&cq->head, NULL);
+	se->cq = cq;
+	se->max_inflight = max_inflight;
+	return 0;
+}
+
+void fuse_cq_wake(struct fuse_session *se)
+{
+	uint64_t one = 1;
+
+	if (write(se->cq->efd, &one, sizeof(one)) != sizeof(one) && errno != EAGAIN)
+		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: writing completion eventfd: %s\n", strerror(errno));
+}
+
+int fuse_session_reserve(struct fuse_session *se)
+{
+	size_t inflight;
+
+	if (se->max_inflight == 0)
+		return 1;
+	inflight = atomic_load_explicit(&se->reqs->inflight, memory_order_relaxed);
+	do
+	{
+		if (inflight >= se->max_inflight)
+			return 0;
+	} while (!atomic_compare_exchange_weak_explicit(&se->reqs->inflight, &inflight, inflight + 1,
+													 memory_order_relaxed,
+													 memory_order_relaxed));
+	return 1;
+}
+
+// inflight 从上限降到上限以下时唤醒因为达到上限而只等待完成队列的会话循环
+// @param inflight 减少之前的 inflight
+static void fuse_session_inflight_dropped(struct fuse_session *se, size_t inflight)
+{
+	if (se->cq != NULL && inflight == se->max_inflight)
+		fuse_cq_wake(se);
+}
+
+void fuse_session_release(struct fuse_session *se)
+{
+	if (se->max_inflight == 0)
+		return;
+	fuse_session_inflight_dropped(se, atomic_fetch_sub_explicit(&se->reqs->inflight, 1, memory_order_relaxed));
+}
+
+void fuse_session_unregister(fuse_req_p req)
+{
+	struct fuse_session *se = req->se;
+
+	// 由其他线程直接回复时，也需要唤醒会话循环
+	fuse_session_inflight_dropped(se, fuse_req_unregister(req));
+}
+
+void fuse_req_complete(fuse_req_p req, fuse_complete_func func, void *data)
+{
+	struct fuse_cq *cq = req->se->cq;
+	struct fuse_req *head;
+
+	if (cq == NULL)
+	{
+		func(req, data);
+		return;
+	}
+
+	req->complete = func;
+	req->complete_data = data;
+	head = atomic_load_explicit(&cq->head, memory_order_relaxed);
+	do
+	{
+		req->cq_next = head;
+	} while (!atomic_compare_exchange_weak_explicit(&cq->head, &head, req,
+													 memory_order_release,
+													 memory_order_relaxed));
+	// 队列原本不为空时，之前的压入者已经唤醒过会话循环
+	if (head == NULL)
+		fuse_cq_wake(req->se);
+}
+
+int fuse_cq_drain(struct fuse_session *se)
+{
+	struct fuse_cq *cq = se->cq;
+	struct fuse_req *list;
+	struct fuse_req *prev = NULL;
+	struct fuse_req *next;
+	uint64_t count;
+	int n = 0;
+
+	if (cq == NULL)
+		return 0;
+	// 必须先读空 efd 再取走队列，否则会吞掉取走之后压入的请求发出的唤醒
+	(void)read(cq->efd, &count, sizeof(count));
+	list = atomic_exchange_explicit(&cq->head, NULL, memory_order_acquire);
+
+	// 压入顺序与完成顺序相反，反转后按完成顺序回复
+	while (list != NULL)
+	{
+		next = list->cq_next;
+		list->cq_next = prev;
+		prev = list;
+		list = next;
+	}
+	for (list = prev; list != NULL; list = next)
+	{
+		next = list->cq_next;
+		list->complete(list, list->complete_data);
+		n++;
+	}
+	return n;
+}
+
+void fuse_cq_destroy(struct fuse_session *se)
+{
+	if (se->cq == NULL)
+		return;
+	// 回调函数负责释放文件系统自己的资源，此时回复会因为会话已经退出而被忽略
+	fuse_cq_drain(se);
+	close(se->cq->efd);
+	free(se->cq);
+	se->cq = NULL;
+}
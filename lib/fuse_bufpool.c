@@ -0,0 +1,188 @@
+#include <fuse_bufpool.h>
+#include <fuse_log.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// 映射一块按大页对齐的内存并预先访问：
+// 优先使用预留的 hugetlb 大页，hugetlb 映射的长度必须是 2MB 的整数倍；
+// try_hugetlb 为 0 或者没有预留大页时按 2MB 对齐起始地址映射 *len 字节的普通内存并请求透明大页
+// @param len 需要的长度，按页对齐，返回实际映射的长度
+// @return 映射的地址 on success, NULL on failure
+static void *fuse_bufpool_map(size_t *len, int try_hugetlb, int *hugetlb)
+{
+	size_t pagesize = getpagesize();
+	size_t hlen = (*len + FUSE_HUGEPAGE_SIZE - 1) & ~(FUSE_HUGEPAGE_SIZE - 1);
+	char *p;
+	char *aligned;
+	size_t head;
+	size_t off;
+
+	if (try_hugetlb)
+	{
+		p = mmap(NULL, hlen, PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+		if (p != MAP_FAILED)
+		{
+			*len = hlen;
+			*hugetlb = 1;
+			return p;
+		}
+	}
+
+	p = mmap(NULL, *len + FUSE_HUGEPAGE_SIZE, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		return NULL;
+	aligned = (char *)(((uintptr_t)p + FUSE_HUGEPAGE_SIZE - 1) & ~(FUSE_HUGEPAGE_SIZE - 1));
+	head = aligned - p;
+	if (head > 0)
+		munmap(p, head);
+	munmap(aligned + *len, FUSE_HUGEPAGE_SIZE - head);
+
+	madvise(aligned, *len, MADV_HUGEPAGE);
+	// 在调用线程中访问每一页，内存分配在调用线程所在的 NUMA 节点
+	for (off = 0; off < *len; off += pagesize)
+		((volatile char *)aligned)[off] = 0;
+	*hugetlb = 0;
+	return aligned;
+}
+
+// 映射一块至少能切分出 count 个缓冲区的内存，切分出的缓冲区全部放入空闲链表，调用者需要持有 pool->lock
+static int fuse_bufpool_grow(struct fuse_bufpool *pool, size_t count)
+{
+	struct fuse_bufpool_chunk *chunk;
+	size_t len = count * pool->bufsize;
+	size_t hlen;
+	size_t n;
+	size_t i;
+	int hugetlb;
+
+	// 按 2MB 取整后切分剩下的空间超过半个大页时（例如 4MB + 4KB 的缓冲区要占用 6MB）不使用 hugetlb，
+	// 按缓冲区的实际大小映射普通内存
+	hlen = (len + FUSE_HUGEPAGE_SIZE - 1) & ~(FUSE_HUGEPAGE_SIZE - 1);
+	chunk = (struct fuse_bufpool_chunk *)malloc(sizeof(struct fuse_bufpool_chunk));
+	if (chunk == NULL)
+		return -ENOMEM;
+	chunk->addr = fuse_bufpool_map(&len, hlen % pool->bufsize <= FUSE_HUGEPAGE_SIZE / 2, &hugetlb);
+	if (chunk->addr == NULL)
+	{
+		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: unable to map receive buffers: %s\n", strerror(errno));
+		free(chunk);
+		return -ENOMEM;
+	}
+	chunk->len = len;
+	chunk->next = pool->chunks;
+	pool->chunks = chunk;
+	if (hugetlb)
+		pool->hugetlb = 1;
+
+	// hugetlb 映射取整后多出来的空间也切分成缓冲区
+	n = len / pool->bufsize;
+	for (i = n; i > 0; i--)
+	{
+		void *mem = (char *)chunk->addr + (i - 1) * pool->bufsize;
+		*(void **)mem = pool->free_list;
+		pool->free_list = mem;
+	}
+	pool->nfree += n;
+	pool->total += n;
+	return 0;
+}
+
+int fuse_bufpool_reserve(struct fuse_session *se, size_t count)
+{
+	struct fuse_bufpool *pool = se->bufpool;
+	size_t pagesize = getpagesize();
+	int res = 0;
+
+	if (pool == NULL)
+	{
+		pool = (struct fuse_bufpool *)calloc(1, sizeof(struct fuse_bufpool));
+		if (pool == NULL)
+		{
+			fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: unable to allocate buffer pool: %s\n", strerror(errno));
+			return -ENOMEM;
+		}
+		pthread_mutex_init(&pool->lock, NULL);
+		// INIT 之后 se->bufsize 只会变小，按会话开始时的大小切分
+		pool->bufsize = (se->bufsize + pagesize - 1) & ~(pagesize - 1);
+		se->bufpool = pool;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->nfree < count)
+	{
+		res = fuse_bufpool_grow(pool, count - pool->nfree);
+		if (res == 0)
+			fuse_log(FUSE_LOG_INFO, "[FUSE_LOG_INFO] fuse: %zu receive buffers of %zu bytes, %s\n",
+					 pool->total, pool->bufsize,
+					 pool->hugetlb ? "backed by hugetlb pages" : "transparent hugepages requested");
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return res;
+}
+
+void *fuse_bufpool_get(struct fuse_session *se, int local)
+{
+	struct fuse_bufpool *pool;
+	void *mem = NULL;
+
+	if (se->bufpool == NULL && fuse_bufpool_reserve(se, 0) < 0)
+		return NULL;
+	pool = se->bufpool;
+
+	pthread_mutex_lock(&pool->lock);
+	if (local)
+	{
+		// 新映射的缓冲区位于空闲链表的开头
+		if (fuse_bufpool_grow(pool, 1) < 0)
+			goto out;
+	}
+	else if (pool->free_list == NULL && fuse_bufpool_grow(pool, 1) < 0)
+	{
+		goto out;
+	}
+	mem = pool->free_list;
+	pool->free_list = *(void **)mem;
+	pool->nfree--;
+out:
+	pthread_mutex_unlock(&pool->lock);
+	return mem;
+}
+
+void fuse_bufpool_put(struct fuse_session *se, void *mem)
+{
+	struct fuse_bufpool *pool = se->bufpool;
+
+	if (mem == NULL)
+		return;
+	pthread_mutex_lock(&pool->lock);
+	*(void **)mem = pool->free_list;
+	pool->free_list = mem;
+	pool->nfree++;
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void fuse_bufpool_destroy(struct fuse_session *se)
+{
+	struct fuse_bufpool *pool = se->bufpool;
+	struct fuse_bufpool_chunk *chunk;
+
+	if (pool == NULL)
+		return;
+	while (pool->chunks != NULL)
+	{
+		chunk = pool->chunks;
+		pool->chunks = chunk->next;
+		munmap(chunk->addr, chunk->len);
+		free(chunk);
+	}
+	pthread_mutex_destroy(&pool->lock);
+	free(pool);
+	se->bufpool = NULL;
+}
@@ -0,0 +1,466 @@
+#include <fuse_dispatch.h>
+#include <fuse_qos.h>
+#include <fuse_log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+
+enum fuse_dispatch_class fuse_op_class(enum fuse_opcode opcode)
+{
+	switch (opcode)
+	{
+	case FUSE_INIT:
+	case FUSE_DESTROY:
+	case FUSE_INTERRUPT:
+		return FUSE_CLASS_SPECIAL;
+	case FUSE_FORGET:
+	case FUSE_BATCH_FORGET:
+	case FUSE_RELEASE:
+	case FUSE_RELEASEDIR:
+		return FUSE_CLASS_FORGET;
+	case FUSE_READ:
+	case FUSE_WRITE:
+	case FUSE_FSYNC:
+	case FUSE_FSYNCDIR:
+	case FUSE_READDIR:
+	case FUSE_READDIRPLUS:
+	case FUSE_FALLOCATE:
+	case FUSE_COPY_FILE_RANGE:
+		return FUSE_CLASS_DATA;
+	default:
+		return FUSE_CLASS_METADATA;
+	}
+}
+
+// 调用者需要持有 d->lock
+// 元数据和 FORGET 类总是可以处理，DATA 类只有在名额未用完时才可以处理
+static int fuse_dispatch_available(struct fuse_dispatcher *d)
+{
+	if (atomic_load(&d->queued[FUSE_CLASS_METADATA]) || atomic_load(&d->queued[FUSE_CLASS_FORGET]))
+		return 1;
+	return atomic_load(&d->queued[FUSE_CLASS_DATA]) && d->data_running < d->data_limit;
+}
+
+// 从线程 v 的队列中取出一个请求：自己的队列从头部取出最早到达的请求，
+// 窃取时从尾部取出最新的请求，被窃取的线程仍然按照到达顺序处理剩下的请求
+static int fuse_dispatch_pop(struct fuse_dispatch_worker *v, enum fuse_dispatch_class cls, int steal,
+							 struct fuse_dispatch_item *item)
+{
+	struct fuse_dispatch_deque *q = &v->q[cls];
+	unsigned mask = v->d->capacity - 1;
+	int found = 0;
+
+	pthread_mutex_lock(&v->lock);
+	if (q->head != q->tail)
+	{
+		if (steal)
+			*item = q->items[--q->tail & mask];
+		else
+			*item = q->items[q->head++ & mask];
+		found = 1;
+	}
+	pthread_mutex_unlock(&v->lock);
+	return found;
+}
+
+// 按照类别的优先级依次检查自己的队列和其他线程的队列
+// @return 取到的请求的类别，没有可以处理的请求时返回 FUSE_CLASS_MAX
+static enum fuse_dispatch_class fuse_dispatch_take(struct fuse_dispatch_worker *w, struct fuse_dispatch_item *item)
+{
+	struct fuse_dispatcher *d = w->d;
+	unsigned self = (unsigned)(w - d->workers);
+	unsigned i;
+	int cls;
+
+	for (cls = 0; cls < FUSE_CLASS_MAX; cls++)
+	{
+		if (atomic_load_explicit(&d->queued[cls], memory_order_relaxed) == 0)
+			continue;
+		// 先占用 DATA 类的名额，保证至少有一个线程可以处理其他类别的请求
+		if (cls == FUSE_CLASS_DATA)
+		{
+			pthread_mutex_lock(&d->lock);
+			if (d->data_running >= d->data_limit)
+			{
+				pthread_mutex_unlock(&d->lock);
+				break;
+			}
+			d->data_running++;
+			pthread_mutex_unlock(&d->lock);
+		}
+		for (i = 0; i < d->nworkers; i++)
+		{
+			if (fuse_dispatch_pop(&d->workers[(self + i) % d->nworkers], cls, i != 0, item))
+			{
+				pthread_mutex_lock(&d->lock);
+				atomic_fetch_sub(&d->queued[cls], 1);
+				d->total--;
+				pthread_cond_signal(&d->space_cond);
+				pthread_mutex_unlock(&d->lock);
+				return cls;
+			}
+		}
+		if (cls == FUSE_CLASS_DATA)
+		{
+			pthread_mutex_lock(&d->lock);
+			d->data_running--;
+			pthread_mutex_unlock(&d->lock);
+		}
+	}
+	return FUSE_CLASS_MAX;
+}
+
+// 请求处理完成后归还接收缓冲区以及预占的名额
+static void fuse_dispatch_done(struct fuse_dispatcher *d, struct fuse_dispatch_item *item)
+{
+	fuse_bufpool_put(d->se, item->buf.mem);
+	fuse_session_release(d->se);
+}
+
+// 丢弃队列中剩余的请求并释放分发器，调用者需要保证工作线程都已经退出
+static void fuse_dispatch_free(struct fuse_dispatcher *d)
+{
+	struct fuse_dispatch_item item;
+	unsigned i;
+	int cls;
+
+	for (i = 0; d->workers != NULL && i < d->nworkers; i++)
+	{
+		struct fuse_dispatch_worker *w = &d->workers[i];
+
+		for (cls = 0; cls < FUSE_CLASS_MAX; cls++)
+		{
+			if (w->q[cls].items == NULL)
+				continue;
+			while (fuse_dispatch_pop(w, cls, 0, &item))
+				fuse_dispatch_done(d, &item);
+			free(w->q[cls].items);
+		}
+		pthread_mutex_destroy(&w->lock);
+	}
+	free(d->workers);
+	if (d->qos != NULL)
+	{
+		while (fuse_qos_drain(d->qos, &item))
+			fuse_dispatch_done(d, &item);
+		fuse_qos_destroy(d->qos);
+	}
+	pthread_cond_destroy(&d->work_cond);
+	pthread_cond_destroy(&d->space_cond);
+	pthread_mutex_destroy(&d->lock);
+	free(d);
+}
+
+// 开启 QoS 时工作线程的循环：所有请求都在 QoS 调度器中排队，由 d->lock 保护，
+// 有请求因为令牌不足而等待时，最多睡眠到令牌补充为止
+static void fuse_dispatch_qos_loop(struct fuse_dispatcher *d)
+{
+	struct fuse_session *se = d->se;
+	struct fuse_dispatch_item item;
+	enum fuse_dispatch_class cls;
+	struct timespec ts;
+	uint64_t wait;
+	uint64_t deadline;
+	int batched = 0;
+
+	pthread_mutex_lock(&d->lock);
+	while (!d->stopping)
+	{
+		if (fuse_qos_dequeue(d->qos, d->data_running < d->data_limit, fuse_qos_now(), &item, &cls, &wait))
+		{
+			atomic_fetch_sub(&d->queued[cls], 1);
+			if (cls == FUSE_CLASS_DATA)
+				d->data_running++;
+			pthread_mutex_unlock(&d->lock);
+			pthread_cond_signal(&d->space_cond);
+
+			d->process(se, &item.buf, item.fd);
+			fuse_dispatch_done(d, &item);
+			batched = 1;
+
+			pthread_mutex_lock(&d->lock);
+			if (cls == FUSE_CLASS_DATA && d->data_running-- == d->data_limit &&
+				atomic_load(&d->queued[FUSE_CLASS_DATA]) && d->sleeping)
+				pthread_cond_signal(&d->work_cond);
+			continue;
+		}
+
+		// 当前这批请求已经处理完，即将睡眠
+		if (batched && se->ops.batch_end)
+		{
+			batched = 0;
+			pthread_mutex_unlock(&d->lock);
+			se->ops.batch_end(se->userdata);
+			pthread_mutex_lock(&d->lock);
+			continue;
+		}
+		d->sleeping++;
+		if (wait)
+		{
+			clock_gettime(CLOCK_REALTIME, &ts);
+			deadline = (uint64_t)ts.tv_nsec + wait;
+			ts.tv_sec += deadline / 1000000000ULL;
+			ts.tv_nsec = deadline % 1000000000ULL;
+			pthread_cond_timedwait(&d->work_cond, &d->lock, &ts);
+		}
+		else
+		{
+			pthread_cond_wait(&d->work_cond, &d->lock);
+		}
+		d->sleeping--;
+	}
+	pthread_mutex_unlock(&d->lock);
+}
+
+static void *fuse_dispatch_worker_routine(void *data)
+{
+	struct fuse_dispatch_worker *w = (struct fuse_dispatch_worker *)data;
+	struct fuse_dispatcher *d = w->d;
+	struct fuse_session *se = d->se;
+	struct fuse_dispatch_item item;
+	enum fuse_dispatch_class cls;
+
+	// 缓存池创建失败时退化为每个请求调用 calloc 分配
+	fuse_req_pool_init();
+	if (d->qos != NULL)
+	{
+		fuse_dispatch_qos_loop(d);
+		fuse_req_pool_destroy();
+		return NULL;
+	}
+	for (;;)
+	{
+		cls = fuse_dispatch_take(w, &item);
+		if (cls != FUSE_CLASS_MAX)
+		{
+			d->process(se, &item.buf, item.fd);
+			fuse_dispatch_done(d, &item);
+			if (cls == FUSE_CLASS_DATA)
+			{
+				pthread_mutex_lock(&d->lock);
+				if (d->data_running-- == d->data_limit && atomic_load(&d->queued[FUSE_CLASS_DATA]) &&
+					d->sleeping)
+					pthread_cond_signal(&d->work_cond);
+				pthread_mutex_unlock(&d->lock);
+			}
+			continue;
+		}
+
+		pthread_mutex_lock(&d->lock);
+		if (!d->stopping && !fuse_dispatch_available(d))
+		{
+			// 当前这批请求已经处理完，即将睡眠
+			pthread_mutex_unlock(&d->lock);
+			if (se->ops.batch_end)
+				se->ops.batch_end(se->userdata);
+			pthread_mutex_lock(&d->lock);
+			while (!d->stopping && !fuse_dispatch_available(d))
+			{
+				d->sleeping++;
+				pthread_cond_wait(&d->work_cond, &d->lock);
+				d->sleeping--;
+			}
+		}
+		if (d->stopping)
+		{
+			pthread_mutex_unlock(&d->lock);
+			break;
+		}
+		pthread_mutex_unlock(&d->lock);
+	}
+	fuse_req_pool_destroy();
+	return NULL;
+}
+
+struct fuse_dispatcher *fuse_dispatch_new(struct fuse_session *se, unsigned nworkers, unsigned capacity,
+										  const struct fuse_qos_config *qos, fuse_dispatch_process_func process)
+{
+	struct fuse_dispatcher *d;
+	sigset_t oldset;
+	sigset_t newset;
+	unsigned started = 0;
+	unsigned i;
+	int cls;
+	int res;
+
+	if (nworkers == 0)
+		nworkers = 1;
+	if (capacity == 0)
+		capacity = nworkers * 16;
+	d = (struct fuse_dispatcher *)calloc(1, sizeof(struct fuse_dispatcher));
+	if (d == NULL)
+		goto err_nomem;
+	d->se = se;
+	d->process = process;
+	d->nworkers = nworkers;
+	// 每个队列的容量按 2 的幂对齐，所有请求都放入同一个队列时也不会溢出
+	d->capacity = 1;
+	while (d->capacity < capacity)
+		d->capacity <<= 1;
+	d->data_limit = nworkers > 1 ? nworkers - 1 : 1;
+	atomic_init(&d->next, 0);
+	for (cls = 0; cls < FUSE_CLASS_MAX; cls++)
+		atomic_init(&d->queued[cls], 0);
+	pthread_mutex_init(&d->lock, NULL);
+	pthread_cond_init(&d->work_cond, NULL);
+	pthread_cond_init(&d->space_cond, NULL);
+
+	d->workers = (struct fuse_dispatch_worker *)calloc(nworkers, sizeof(struct fuse_dispatch_worker));
+	if (d->workers == NULL)
+		goto err_free;
+	for (i = 0; i < nworkers; i++)
+	{
+		struct fuse_dispatch_worker *w = &d->workers[i];
+
+		w->d = d;
+		pthread_mutex_init(&w->lock, NULL);
+		for (cls = 0; cls < FUSE_CLASS_MAX; cls++)
+		{
+			w->q[cls].items = (struct fuse_dispatch_item *)calloc(d->capacity, sizeof(struct fuse_dispatch_item));
+			if (w->q[cls].items == NULL)
+				goto err_free;
+		}
+	}
+
+	if (qos != NULL && qos->tenant != FUSE_QOS_NONE)
+	{
+		d->qos = fuse_qos_new(qos, d->capacity);
+		if (d->qos == NULL)
+		{
+			fuse_dispatch_free(d);
+			return NULL;
+		}
+	}
+
+	// 与多线程循环的工作线程相同，信号只由主线程处理
+	sigemptyset(&newset);
+	sigaddset(&newset, SIGTERM);
+	sigaddset(&newset, SIGINT);
+	sigaddset(&newset, SIGHUP);
+	sigaddset(&newset, SIGQUIT);
+	pthread_sigmask(SIG_BLOCK, &newset, &oldset);
+	for (i = 0; i < nworkers; i++)
+	{
+		res = pthread_create(&d->workers[i].thread, NULL, fuse_dispatch_worker_routine, &d->workers[i]);
+		if (res != 0)
+		{
+			fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: error creating dispatch thread: %s\n", strerror(res));
+			break;
+		}
+		started++;
+	}
+	pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+	if (started < nworkers)
+	{
+		fuse_dispatch_stop(d);
+		for (i = 0; i < started; i++)
+			pthread_join(d->workers[i].thread, NULL);
+		fuse_dispatch_free(d);
+		return NULL;
+	}
+	return d;
+
+err_free:
+	fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: unable to allocate dispatch queues: %s\n", strerror(errno));
+	fuse_dispatch_free(d);
+	return NULL;
+err_nomem:
+	fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: unable to allocate dispatcher: %s\n", strerror(errno));
+	return NULL;
+}
+
+int fuse_dispatch_push(struct fuse_dispatcher *d, struct fuse_buf *buf, int fd, enum fuse_dispatch_class cls)
+{
+	struct fuse_dispatch_worker *w;
+	struct fuse_dispatch_deque *q;
+	char name[FUSE_QOS_NAME_MAX];
+	int wake;
+
+	if (d->qos != NULL)
+	{
+		fuse_qos_key(d->qos, (struct fuse_in_header *)buf->mem, name);
+		pthread_mutex_lock(&d->lock);
+		while (!d->stopping && fuse_qos_enqueue(d->qos, name, &(struct fuse_dispatch_item){.buf = *buf, .fd = fd},
+												cls, fuse_qos_now()) < 0)
+			pthread_cond_wait(&d->space_cond, &d->lock);
+		if (d->stopping)
+		{
+			pthread_mutex_unlock(&d->lock);
+			return -1;
+		}
+		atomic_fetch_add(&d->queued[cls], 1);
+		wake = d->sleeping > 0;
+		pthread_mutex_unlock(&d->lock);
+		if (wake)
+			pthread_cond_signal(&d->work_cond);
+		goto out;
+	}
+
+	// 先占用一个位置，之后放入的队列一定不会溢出
+	pthread_mutex_lock(&d->lock);
+	while (!d->stopping && d->total >= d->capacity)
+		pthread_cond_wait(&d->space_cond, &d->lock);
+	if (d->stopping)
+	{
+		pthread_mutex_unlock(&d->lock);
+		return -1;
+	}
+	d->total++;
+	pthread_mutex_unlock(&d->lock);
+
+	w = &d->workers[atomic_fetch_add_explicit(&d->next, 1, memory_order_relaxed) % d->nworkers];
+	q = &w->q[cls];
+	pthread_mutex_lock(&w->lock);
+	q->items[q->tail++ & (d->capacity - 1)] = (struct fuse_dispatch_item){
+		.buf = *buf,
+		.fd = fd,
+	};
+	pthread_mutex_unlock(&w->lock);
+
+	// 请求放入队列之后才计数，工作线程在 d->lock 下检查计数后睡眠，不会丢失唤醒
+	pthread_mutex_lock(&d->lock);
+	atomic_fetch_add(&d->queued[cls], 1);
+	wake = d->sleeping > 0;
+	pthread_mutex_unlock(&d->lock);
+	if (wake)
+		pthread_cond_signal(&d->work_cond);
+
+out:
+	buf->mem = NULL;
+	buf->flags = 0;
+	buf->fd = -1;
+	return 0;
+}
+
+int fuse_dispatch_idle(struct fuse_dispatcher *d)
+{
+	int idle;
+
+	pthread_mutex_lock(&d->lock);
+	idle = d->sleeping > 0;
+	pthread_mutex_unlock(&d->lock);
+	return idle;
+}
+
+void fuse_dispatch_stop(struct fuse_dispatcher *d)
+{
+	pthread_mutex_lock(&d->lock);
+	d->stopping = 1;
+	pthread_cond_broadcast(&d->work_cond);
+	pthread_cond_broadcast(&d->space_cond);
+	pthread_mutex_unlock(&d->lock);
+}
+
+void fuse_dispatch_destroy(struct fuse_dispatcher *d)
+{
+	unsigned i;
+
+	fuse_dispatch_stop(d);
+	for (i = 0; i < d->nworkers; i++)
+		pthread_join(d->workers[i].thread, NULL);
+	fuse_dispatch_free(d);
+}
@@ -1,11 +1,61 @@
 #include <fuse_helper.h>
 
+// 根据命令行参数生成多线程循环的配置，config->cpus 需要调用者释放
+// @return 0 on success, -1 on failure
+static int fuse_loop_config_init(const struct fuse_cmd_opts *opts, struct fuse_loop_config *config)
+{
+    int *cpus = NULL;
+    int ncpus = 0;
+
+    if (opts->cpus != NULL)
+    {
+        ncpus = fuse_parse_cpus(opts->cpus, &cpus);
+        if (ncpus < 0)
+            return -1;
+    }
+    config->clonefd = opts->clonefd;
+    config->min_threads = opts->threads;
+    config->max_threads = opts->max_threads ? opts->max_threads : opts->threads;
+    config->idle_timeout = opts->idle_timeout;
+    config->cpus = cpus;
+    config->ncpus = ncpus;
+    config->readers = opts->readers;
+    if (opts->qos != NULL)
+    {
+        if (strcmp(opts->qos, "uid") == 0)
+            config->qos.tenant = FUSE_QOS_UID;
+        else if (strcmp(opts->qos, "pid") == 0)
+            config->qos.tenant = FUSE_QOS_PID;
+        else if (strcmp(opts->qos, "cgroup") == 0)
+            config->qos.tenant = FUSE_QOS_CGROUP;
+        else
+        {
+            fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: invalid qos tenant `%s`\n", opts->qos);
+            free(cpus);
+            return -1;
+        }
+        // QoS 只在分发模式下生效
+        if (config->readers == 0)
+            config->readers = 1;
+    }
+    config->qos.weights = opts->qos_weights;
+    config->qos.iops = opts->qos_iops;
+    config->qos.bandwidth = opts->qos_bw;
+    config->qos.report = opts->qos_report;
+    config->busy_poll = opts->busy_poll;
+    config->poll_threads = opts->poll_threads;
+    return 0;
+}
+
 int fuse_normal_mode(struct fuse_args *args, struct fuse_ops *ops, void *userdata, void (*helper)(void))
 {
     int res = -EBUILD;
     struct fuse_cmd_opts opts = FUSE_CMD_OPTS_INIT;
+    struct fuse_loop_config config = {0};
     if (parse_cmd_opts(args, &opts) < 0)
         goto err_out4;
+    if (fuse_loop_config_init(&opts, &config) < 0)
+        goto err_out4;
 
     if (opts.version)
     {
@@ -25,6 +75,8 @@ int fuse_normal_mode(struct fuse_args *args, struct fuse_ops *ops, void *userdat
     struct fuse_session *se = fuse_session_new(args, ops, opts.debug, userdata);
     if (se == NULL)
         goto err_out4;
+    if (opts.max_inflight && fuse_session_async(se, opts.max_inflight) < 0)
+        goto err_out3;
 
     if (fuse_set_signal_handlers(se) < 0)
         goto err_out3;
@@ -33,9 +85,13 @@ int fuse_normal_mode(struct fuse_args *args, struct fuse_ops *ops, void *userdat
     if (fuse_daemonize(opts.foreground) < 0)
         goto err_out1;
 
-    if (opts.multithread)
+    if (opts.io_uring)
     {
-        res = fuse_multi_session_loop(se, opts.clonefd, opts.threads);
+        res = fuse_uring_session_loop(se, opts.multithread ? &config : NULL, opts.io_uring_depth);
+    }
+    else if (opts.multithread)
+    {
+        res = fuse_multi_session_loop_config(se, &config);
     }
     else
     {
@@ -49,6 +105,7 @@ err_out2:
 err_out3:
     fuse_session_destroy(se);
 err_out4:
+    free((void *)config.cpus);
     free_cmd_opts(&opts);
     return res;
 }
@@ -61,7 +118,8 @@ err_out4:
 // 5. 子进程设置信号进入循环
 // 6. 父进程等待子进程结束循环，如果子进程异常退出那么 i) ioctl 重置内核队列；ii) fuse_session_recovery 更新会话信息 iii) crfunc 恢复共享内存
 // 7. 最后父进程取消例程，等待其结束；destroy 释放共享内存；释放 gse 共享内存
-static int fuse_crash_recovery_start(struct fuse_session *se, struct fuse_cmd_opts opts, struct fuse_crash_recovery_handlers crhandlers)
+static int fuse_crash_recovery_start(struct fuse_session *se, struct fuse_cmd_opts opts, const struct fuse_loop_config *config,
+                                     struct fuse_crash_recovery_handlers crhandlers)
 {
     int res = -EBUILD;
     int err;
@@ -95,7 +153,7 @@ CRASH_RECOVERY:
             return res;
         if (opts.multithread)
         {
-            res = fuse_multi_session_loop(se, opts.clonefd, opts.threads);
+            res = fuse_multi_session_loop_config(se, config);
         }
         else
         {
@@ -154,8 +212,11 @@ int fuse_crash_recovery_mode(struct fuse_args *args, struct fuse_ops *ops, void
 {
     int res = -EBUILD;
     struct fuse_cmd_opts opts = FUSE_CMD_OPTS_INIT;
+    struct fuse_loop_config config = {0};
     if (parse_cmd_opts(args, &opts) < 0)
         goto err_out4;
+    if (fuse_loop_config_init(&opts, &config) < 0)
+        goto err_out4;
 
     if (opts.version)
     {
@@ -175,6 +236,11 @@ int fuse_crash_recovery_mode(struct fuse_args *args, struct fuse_ops *ops, void
     struct fuse_session *se = fuse_session_new(args, ops, opts.debug, userdata);
     if (se == NULL)
         goto err_out4;
+    if (opts.max_inflight && fuse_session_async(se, opts.max_inflight) < 0)
+        goto err_out3;
+    // 重启后的子进程收不到 INIT，无法重新注册 io_uring 队列
+    if (opts.io_uring)
+        fuse_log(FUSE_LOG_WARNING, "[FUSE_LOG_WARNING] --io_uring is ignored in crash recovery mode\n");
     if (fuse_set_signal_ignore() < 0)
         goto err_out3;
     if (fuse_session_mount(se, opts.mountpoint) < 0)
@@ -184,7 +250,7 @@ int fuse_crash_recovery_mode(struct fuse_args *args, struct fuse_ops *ops, void
 
     // 如果 fork 正常，子进程循环结束后从这个过程中返回，父进程等待子进程结束后从这个函数中返回 0
     // 如果 fork 异常，返回 -EBUILD
-    res = fuse_crash_recovery_start(se, opts, crhandlers);
+    res = fuse_crash_recovery_start(se, opts, &config, crhandlers);
 
 err_out1:
     fuse_session_unmount(se);
@@ -193,6 +259,7 @@ err_out2:
 err_out3:
     fuse_session_destroy(se);
 err_out4:
+    free((void *)config.cpus);
     free_cmd_opts(&opts);
     return res;
 }
\ No newline at end of file
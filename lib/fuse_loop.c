@@ -50,66 +50,57 @@ int fuse_daemonize(int foreground){
 	return 0;
 }
 
-static fuse_req_p fuse_alloc_req(struct fuse_session *se)
+// 从管道中读出请求头部以及参数，交给 write_buf 的 WRITE 请求的数据留在管道中，
+// 此时 buf 被标记为 FUSE_BUF_IS_FD，fd 指向管道的读端
+static int fuse_session_read_pipe(struct fuse_session *se, struct fuse_buf *buf,
+								  struct fuse_pipe *p, size_t len)
 {
-	fuse_req_p req;
+	struct fuse_in_header *in = (struct fuse_in_header *)buf->mem;
+	size_t headlen = sizeof(struct fuse_in_header);
 
-	req = (fuse_req_p )calloc(1, sizeof(struct fuse_req));
-	if (req == NULL)
-	{
-		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: unable to allocate a new memory for new request\n");
-	}
+	if (read(p->fd[0], buf->mem, headlen) != (ssize_t)headlen || in->len != len)
+		goto err_out;
+	if (in->opcode == FUSE_WRITE && se->ops.write_buf &&
+		len >= headlen + sizeof(struct fuse_write_in))
+		headlen += sizeof(struct fuse_write_in);
 	else
-	{
-		req->se = se;
-		// req->ctr = 1;
-		list_init_item(req);
-		// pthread_mutex_init(&req->lock, NULL);
-	}
-
-	return req;
-}
+		headlen = len;
+	if (headlen > sizeof(struct fuse_in_header) &&
+		read(p->fd[0], (char *)buf->mem + sizeof(struct fuse_in_header),
+			 headlen - sizeof(struct fuse_in_header)) != (ssize_t)(headlen - sizeof(struct fuse_in_header)))
+		goto err_out;
 
-// 收到一个请求后检查是否存在这个请求对应的 interrupt 请求
-static fuse_req_p check_interrupt(struct fuse_session *se,
-										fuse_req_p req)
-{
-	fuse_req_p curr;
-
-	// 寻找是否由对应的 interrupt 请求
-	for (curr = se->int_list.next; curr != &se->int_list;
-		 curr = curr->next)
+	if (headlen < len)
 	{
-		if (curr->interrupted_id == req->unique)
-		{
-			req->interrupted = 1;
-			list_del_item(struct fuse_req,curr);
-			free(curr);
-			return NULL;
-		}
+		buf->flags = FUSE_BUF_IS_FD | FUSE_BUF_FD_RETRY;
+		buf->fd = p->fd[0];
 	}
+	return 0;
 
-	// 如果没有找到对应的 interrupt 请求
-	// 每次需要删除一个最早放入队列的 interrupt 请求
-	// 这样保证 int_list 不会无限增长
-	curr = se->int_list.next;
-	if (curr != &se->int_list)
-	{
-		list_del_item(struct fuse_req,curr);
-		list_init_item(curr);
-		return curr;
-	}
-	else
-		return NULL;
+err_out:
+	fuse_pipe_reset(FUSE_PIPE_RECEIVE);
+	fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: short read on splice pipe\n");
+	return -EIO;
 }
 
 static int fuse_session_receive(struct fuse_session *se, struct fuse_buf *buf, int clonefd)
 {
 	int err;
 	ssize_t res;
+	struct fuse_pipe *p = NULL;
+	int pending;
+
+	// 上一个 WRITE 请求的数据如果没有被文件系统全部取走，就丢弃整个管道
+	if (buf->flags & FUSE_BUF_IS_FD)
+	{
+		if (ioctl(buf->fd, FIONREAD, &pending) == -1 || pending > 0)
+			fuse_pipe_reset(FUSE_PIPE_RECEIVE);
+		buf->flags = 0;
+		buf->fd = -1;
+	}
 	if (buf->mem == NULL)
 	{
-		buf->mem = malloc(se->bufsize);
+		buf->mem = fuse_bufpool_get(se, 0);
 		if (buf->mem == NULL)
 		{
 			fuse_log(FUSE_LOG_ERR,
@@ -118,8 +109,15 @@ static int fuse_session_receive(struct fuse_session *se, struct fuse_buf *buf, i
 		}
 	}
 
+	// 管道容量不足时退回到 read
+	if (se->conn.want & FUSE_SPLICE_READ)
+		p = fuse_pipe_get(FUSE_PIPE_RECEIVE, se->bufsize);
+
 restart:
-	res = read(clonefd==-1 ? se->fd:clonefd, buf->mem, se->bufsize);
+	if (p != NULL)
+		res = splice(clonefd==-1 ? se->fd:clonefd, NULL, p->fd[1], NULL, se->bufsize, 0);
+	else
+		res = read(clonefd==-1 ? se->fd:clonefd, buf->mem, se->bufsize);
 	err = errno;
 	if (se->exited)
 	{
@@ -137,11 +135,17 @@ restart:
 		// connection was aborted via /sys/fs/fuse/connections/NNN/abort)
 		if (err == ENODEV)
 		{
-			se->exited = 1;
+			fuse_session_exit(se);
 			return 0;
 		}
 
-		// 默认为阻塞 I/O，因此不会产生 EAGAIN
+		// 只有弹性线程使用非阻塞的克隆文件描述符，
+		// 多个线程同时被唤醒时请求可能已经被其他线程读走
+		if (err == EAGAIN)
+		{
+			return -EAGAIN;
+		}
+
 		// 其他情况的错误
 		fuse_log(FUSE_LOG_ERR,
 				 "[FUSE_LOG_ERR] fuse: reading device: %s\n", strerror(errno));
@@ -150,17 +154,23 @@ restart:
 
 	if ((size_t)res < sizeof(struct fuse_in_header))
 	{
+		if (p != NULL)
+			fuse_pipe_reset(FUSE_PIPE_RECEIVE);
 		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: short read on fuse device\n");
 		return -EIO;
 	}
 
+	if (p != NULL && fuse_session_read_pipe(se, buf, p, res) < 0)
+		return -EIO;
+
 	buf->size = res;
 
 	return res;
 }
 
+// @param ent 通过 io_uring 收到的请求所在的队列项，为 NULL 表示请求来自 /dev/fuse
 static void fuse_session_process(struct fuse_session *se, struct fuse_buf *buf,
-								 int clonefd)
+								 int clonefd, struct fuse_uring_ent *ent)
 {
 	struct fuse_in_header *in = buf->mem;
 	fuse_req_p req;
@@ -189,13 +199,18 @@ static void fuse_session_process(struct fuse_session *se, struct fuse_buf *buf,
 			.iov_len = sizeof(struct fuse_out_header),
 		};
 
-		fuse_send_iov_msg(se, clonefd, &iov, 1);
+		if (ent != NULL)
+			fuse_uring_commit(ent, &iov, 1);
+		else
+			fuse_send_iov_msg(se, clonefd, &iov, 1);
+		return;
 	}
 	req->unique = in->unique;
 	req->ctx.uid = in->uid;
 	req->ctx.gid = in->gid;
 	req->ctx.pid = in->pid;
 	req->fd = clonefd;
+	req->ring_ent = ent;
 
 	err = EIO;
 	// 当前会话未初始化，但是收到的请求却不是初始化请求
@@ -228,27 +243,31 @@ static void fuse_session_process(struct fuse_session *se, struct fuse_buf *buf,
 	// 1. 用户空间进程收到一个请求后收到对应的 int 请求
 	// 2. 用户空间收到 int 请求后，再收到对应的请求
 	// 这里的情况属于 2
-	if (in->opcode != FUSE_INTERRUPT)
+	// FORGET 和 BATCH_FORGET 不需要回复，内核也不会打断它们，不登记到请求表中，
+	// 大量 FORGET 到达时不会占用请求表的锁以及处理中的请求名额；
+	// NOTIFY_REPLY 同样不需要回复，它的 unique 由 fuse_notify_retrieve() 分配，可能与其他请求重复
+	if (in->opcode != FUSE_INTERRUPT && in->opcode != FUSE_FORGET &&
+		in->opcode != FUSE_BATCH_FORGET && in->opcode != FUSE_NOTIFY_REPLY)
 	{
 		fuse_req_p intr;
-		pthread_mutex_lock(&se->lock);
-		intr = check_interrupt(se, req);
-		if(req->interrupted)
-			free(req);
-		else
-			list_add_item(req, se->req_list);
-		pthread_mutex_unlock(&se->lock);
+		intr = fuse_req_register(se->reqs, req);
 		if (intr)
 			send_reply_err(intr,EAGAIN);
+		// 请求在到达之前已经被打断，不再处理，内核仍在等待回复
+		if (atomic_load(&req->interrupted))
+		{
+			send_reply_err(req, EINTR);
+			return;
+		}
 	}
 
 	const void *inarg = (void *)&in[1];
 
-	// if (in->opcode == FUSE_NOTIFY_REPLY)
-	// {
-		
-	// }
-	// else
+	if (in->opcode == FUSE_WRITE && se->ops.write_buf)
+	{
+		do_write_buf(req, in->nodeid, inarg, buf);
+	}
+	else
 	{
 		fuse_ops[in->opcode].func(req, in->nodeid, inarg);
 	}
@@ -258,6 +277,60 @@ reply_err:
 	send_reply_err(req, err);
 }
 
+// fuse_session_wait() 的返回值
+#define FUSE_WAIT_REQUEST 1		// /dev/fuse 可读，或者出错需要交给 fuse_session_receive() 处理
+#define FUSE_WAIT_COMPLETE 2	// 完成队列中有请求
+
+// 同时等待 /dev/fuse 和完成队列，处理中的请求达到上限时只等待完成队列
+// @param fd 克隆的文件描述符，-1 表示使用 se->fd
+// @param timeout poll 的超时时间，单位为毫秒，-1 表示不超时
+// @return FUSE_WAIT_REQUEST 与 FUSE_WAIT_COMPLETE 的组合，超时返回 0
+static int fuse_session_wait(struct fuse_session *se, int fd, int timeout)
+{
+	struct pollfd pfd[2];
+	int nfds = 0;
+	int devidx = -1;
+	int res;
+	int ev = 0;
+
+	if (!fuse_session_throttled(se))
+	{
+		devidx = nfds;
+		pfd[nfds].fd = fd == -1 ? se->fd : fd;
+		pfd[nfds].events = POLLIN;
+		pfd[nfds].revents = 0;
+		nfds++;
+	}
+	if (se->cq != NULL)
+	{
+		pfd[nfds].fd = se->cq->efd;
+		pfd[nfds].events = POLLIN;
+		pfd[nfds].revents = 0;
+		nfds++;
+	}
+
+	// 先检查是否已经有事件，没有时才说明当前这批请求已经处理完，即将阻塞
+	res = -1;
+	if (se->ops.batch_end)
+	{
+		res = poll(pfd, nfds, 0);
+		if (res == 0)
+			se->ops.batch_end(se->userdata);
+	}
+	if (res <= 0)
+		res = poll(pfd, nfds, timeout);
+	if (res == 0)
+		return 0;
+	// 被信号打断时由调用者重新检查 se->exited
+	if (res == -1)
+		return devidx >= 0 ? FUSE_WAIT_REQUEST : FUSE_WAIT_COMPLETE;
+	if (devidx >= 0 && pfd[devidx].revents)
+		ev |= FUSE_WAIT_REQUEST;
+	if (se->cq != NULL && pfd[nfds - 1].revents)
+		ev |= FUSE_WAIT_COMPLETE;
+	return ev;
+}
+
 int fuse_single_session_loop(struct fuse_session *se)
 {
 	fuse_log(FUSE_LOG_INFO, "[FUSE_LOG_INFO] fuse: start single thread session loop\n");
@@ -265,23 +338,51 @@ int fuse_single_session_loop(struct fuse_session *se)
 	struct fuse_buf receive_buf = {
 		.mem = NULL,
 	};
+	if (fuse_req_pool_init() < 0)
+		return -ENOMEM;
+	// 缓冲区在进入循环之前分配并访问
+	if (fuse_bufpool_reserve(se, 1) < 0)
+	{
+		fuse_req_pool_destroy();
+		return -ENOMEM;
+	}
 	while (!se->exited)
 	{
+		if (se->cq != NULL)
+		{
+			int ev = fuse_session_wait(se, -1, -1);
+			if (ev & FUSE_WAIT_COMPLETE)
+				fuse_cq_drain(se);
+			if (!(ev & FUSE_WAIT_REQUEST) || !fuse_session_reserve(se))
+				continue;
+		}
+		else if (se->ops.batch_end)
+		{
+			se->ops.batch_end(se->userdata);
+		}
 		res = fuse_session_receive(se, &receive_buf, -1);
+		if (se->cq != NULL && res <= 0)
+			fuse_session_release(se);
+		if (res==-EAGAIN){
+			continue;
+		}
 		// 挂载点取消，正常退出
-		if (res==0){
+		else if (res==0){
 			fuse_log(FUSE_LOG_INFO, "[FUSE_LOG_INFO] fuse: single thread session loop end\n");
 			break;
 		}
 		// 出现其他故障，故障恢复
 		else if(res<0){
-			se->exited=1;
+			fuse_session_exit(se);
 			fuse_log(FUSE_LOG_INFO, "[FUSE_LOG_ERR] fuse: single thread session loop end due to an error: %s\n",strerror(-res));
 			break;
 		}
-		fuse_session_process(se, &receive_buf, -1);
+		fuse_session_process(se, &receive_buf, -1, NULL);
+		if (se->cq != NULL)
+			fuse_session_release(se);
 	}
-	free(receive_buf.mem);
+	fuse_bufpool_put(se, receive_buf.mem);
+	fuse_req_pool_destroy();
 	if (res>0){
 		res=0;
 	}
@@ -292,8 +393,6 @@ int fuse_single_session_loop(struct fuse_session *se)
 	return res;
 }
 
-#define MAX_THREAD_NUM 96
-
 struct fuse_worker_info;
 struct fuse_worker
 {
@@ -306,19 +405,33 @@ struct fuse_worker
 	
 	struct fuse_buf receive_buf; 	// 线程独有的 buffer
 	int fd;							// 记录该线程操作的 clonefd
+	int elastic;					// 是否为按需创建的线程，只有这类线程会在空闲超时后退出
+	int cpu;						// 绑定的 CPU 编号，-1 表示不绑定
+	int poll;						// 是否在非阻塞的克隆文件描述符上自旋等待请求
+	uint64_t avg_wait;				// 最近等待请求的平均时长，单位为纳秒，决定自旋的预算
+	uint64_t spun;					// 自旋期间收到的请求数
+	uint64_t slept;					// 自旋预算用完之后阻塞等待收到的请求数
 };
 
 struct fuse_worker_info
 {
 	struct fuse_session *se;			// 指向当前会话
 	struct fuse_worker worker_head;
-	int clonefd;						// 是否调用 ioctl(FUSE_DEV_IOC_CLONE) 复制一个 fuse_dev
-	unsigned available; 				// 成功创建的线程数
-	unsigned threads;					// 用户输入的线程数
+	struct fuse_loop_config config;		// 线程池配置
+	pthread_mutex_t lock;				// 保护 worker_head、numworker、fds 以及 spare
+	unsigned numworker;					// 当前存活的线程数
+	atomic_uint idle;					// 当前阻塞在接收请求上的线程数
+	int stopping;						// 主线程开始回收线程后不再创建或者回收线程
+	int *fds;							// 所有克隆的文件描述符，以 -1 结尾，会话销毁时关闭
+	unsigned nfds;
+	int *spare;							// 退出的弹性线程留下的克隆文件描述符，供新线程复用
+	unsigned nspare;
+	unsigned npoll;						// 自旋等待请求的常驻线程数
+	int noclone;						// 克隆 /dev/fuse 失败过，不再按需创建线程
 	int error;							// 记录线程出错的原因
 };
 
-static int fuse_clonefd(struct fuse_session *se,struct fuse_worker* w)
+static int fuse_clonefd(struct fuse_session *se,struct fuse_worker* w, int flags)
 {
 	int masterfd = se->fd;
 	int clonefd;
@@ -328,7 +441,7 @@ static int fuse_clonefd(struct fuse_session *se,struct fuse_worker* w)
 #ifndef O_CLOEXEC
 #define O_CLOEXEC 0
 #endif
-	clonefd = open(devname, O_RDWR | O_CLOEXEC);
+	clonefd = open(devname, O_RDWR | O_CLOEXEC | flags);
 	if (clonefd == -1)
 	{
 		fuse_log(FUSE_LOG_WARNING, "[FUSE_LOG_WARNING] fuse: failed to open %s: %s\n",
@@ -350,38 +463,261 @@ static int fuse_clonefd(struct fuse_session *se,struct fuse_worker* w)
 	return 0;
 }
 
+// 线程被取消或者正常退出时释放线程独有的请求体缓存池
+static void fuse_worker_cleanup(void *data)
+{
+	(void)data;
+	fuse_req_pool_destroy();
+}
+
+static int fuse_start_worker(struct fuse_worker_info *wi, int elastic, int cpu);
+
+// 线程绑定到指定的 CPU，随后克隆 /dev/fuse 并首次访问接收缓冲区，
+// 按照 first-touch 策略，内核以及用户态的内存都分配在这个 CPU 所在的 NUMA 节点
+static void fuse_worker_bind(struct fuse_worker *w)
+{
+	struct fuse_worker_info *wi = w->wi;
+	struct fuse_session *se = wi->se;
+	cpu_set_t set;
+	int res;
+
+	CPU_ZERO(&set);
+	CPU_SET(w->cpu, &set);
+	res = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	if (res != 0)
+		fuse_log(FUSE_LOG_WARNING, "[FUSE_LOG_WARNING] fuse: failed to bind thread to cpu %d: %s\n",
+				 w->cpu, strerror(res));
+
+	if (fuse_clonefd(se, w, (se->cq || w->poll) ? O_NONBLOCK : 0) == 0)
+	{
+		pthread_mutex_lock(&wi->lock);
+		wi->fds[wi->nfds++] = w->fd;
+		pthread_mutex_unlock(&wi->lock);
+	}
+	else
+	{
+		// 只有异步模式下 se->fd 是非阻塞的，可以在上面自旋
+		w->poll = w->poll && se->cq != NULL;
+	}
+
+	// 缓冲区在绑定之后映射并访问，分配在本地 NUMA 节点
+	w->receive_buf.mem = fuse_bufpool_get(se, 1);
+}
+
+// 线程等待请求或者完成队列，弹性线程空闲超时返回 0，其余情况返回 fuse_session_wait() 的结果
+static int fuse_worker_wait(struct fuse_worker *w)
+{
+	struct fuse_session *se = w->wi->se;
+	int timeout = -1;
+
+	// 弹性线程、自旋的线程以及异步模式下的线程使用非阻塞的文件描述符，需要先阻塞在 poll 上
+	if (!w->elastic && !w->poll && se->cq == NULL)
+	{
+		if (se->ops.batch_end)
+			se->ops.batch_end(se->userdata);
+		return FUSE_WAIT_REQUEST;
+	}
+	if (w->elastic && w->wi->config.idle_timeout)
+		timeout = (int)w->wi->config.idle_timeout * 1000;
+	return fuse_session_wait(se, w->fd, timeout);
+}
+
+// 空闲超时的弹性线程尝试退出，线程数不超过 min_threads 时继续等待
+// @return 1 表示线程已经从线程池中移除，0 表示继续运行
+static int fuse_reap_worker(struct fuse_worker *w)
+{
+	struct fuse_worker_info *wi = w->wi;
+
+	pthread_mutex_lock(&wi->lock);
+	if (wi->stopping || wi->numworker <= wi->config.min_threads)
+	{
+		pthread_mutex_unlock(&wi->lock);
+		return 0;
+	}
+	wi->numworker--;
+	atomic_fetch_sub(&wi->idle, 1);
+	list_del_item(struct fuse_worker, w);
+	wi->spare[wi->nspare++] = w->fd;
+	// 移出线程池之后主线程不再等待这个线程，会话随时可能销毁，缓冲区必须在释放锁之前归还
+	fuse_bufpool_put(wi->se, w->receive_buf.mem);
+	w->receive_buf.mem = NULL;
+	pthread_mutex_unlock(&wi->lock);
+
+	// 主线程不会再回收这个线程，之后线程不能再访问 wi 以及会话
+	pthread_detach(pthread_self());
+	return 1;
+}
+
+// 最后一个空闲线程开始处理请求时，按需创建一个新线程
+static void fuse_grow_workers(struct fuse_worker_info *wi)
+{
+	pthread_mutex_lock(&wi->lock);
+	if (!wi->stopping && !wi->noclone && wi->numworker < wi->config.max_threads &&
+		atomic_load(&wi->idle) == 0)
+		fuse_start_worker(wi, 1, -1);
+	pthread_mutex_unlock(&wi->lock);
+}
+
+static uint64_t fuse_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// 根据最近的平均等待时长决定本次自旋的预算：
+// 请求通常在预算之内到达时自旋到平均等待时长的两倍，否则不再自旋，直接阻塞等待
+static uint64_t fuse_worker_budget(struct fuse_worker *w)
+{
+	uint64_t max = (uint64_t)w->wi->config.busy_poll * 1000;
+
+	if (w->avg_wait >= max)
+		return 0;
+	return w->avg_wait * 2 < max ? w->avg_wait * 2 + 1000 : max;
+}
+
+// 记录一次等待请求的时长，按 1/8 的权重更新平均值
+static void fuse_worker_adapt(struct fuse_worker *w, uint64_t wait)
+{
+	w->avg_wait = w->avg_wait - w->avg_wait / 8 + wait / 8;
+}
+
+// 在非阻塞的克隆文件描述符上反复读取请求，期间处理完成队列，直到读到请求或者预算用完
+// @return fuse_session_receive() 的结果，读到请求时保留预占的名额；预算用完时返回 -EAGAIN
+static int fuse_worker_spin(struct fuse_worker *w, uint64_t start)
+{
+	struct fuse_session *se = w->wi->se;
+	uint64_t budget = fuse_worker_budget(w);
+	int res;
+
+	if (budget == 0)
+		return -EAGAIN;
+	// 自旋期间不会进入 fuse_session_wait()，先结束当前批次
+	if (se->ops.batch_end)
+		se->ops.batch_end(se->userdata);
+	do
+	{
+		if (se->cq != NULL && atomic_load_explicit(&se->cq->head, memory_order_relaxed) != NULL)
+			fuse_cq_drain(se);
+		if (fuse_session_reserve(se))
+		{
+			res = fuse_session_receive(se, &w->receive_buf, w->fd);
+			if (res != -EAGAIN)
+			{
+				if (res <= 0)
+					fuse_session_release(se);
+				return res;
+			}
+			fuse_session_release(se);
+		}
+		// CPU 不足时让出 CPU，避免自旋的线程推迟发起请求的进程
+		sched_yield();
+	} while (!se->exited && fuse_now_ns() - start < budget);
+	return -EAGAIN;
+}
+
 static void *fuse_do_work(void *data){
 
 	struct fuse_worker *w = (struct fuse_worker *) data;
-	struct fuse_session *se=w->wi->se;
-	int res;
+	struct fuse_worker_info *wi = w->wi;
+	struct fuse_session *se=wi->se;
+	int res=0;
+	int reaped=0;
+	int ev;
+	uint64_t start=0;
+	if (w->cpu >= 0)
+		fuse_worker_bind(w);
+	// 缓存池创建失败时退化为每个请求调用 calloc 分配
+	fuse_req_pool_init();
+	pthread_cleanup_push(fuse_worker_cleanup, NULL);
 	while (!se->exited)
 	{
 		
-		// 持有锁或者申请动态内存未释放时不能被取消
-		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
-		res = fuse_session_receive(se, &w->receive_buf, w->fd);
-		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+		// 自旋的线程先在非阻塞的文件描述符上读取，预算用完后再阻塞等待
+		res = -EAGAIN;
+		if (w->poll)
+		{
+			if (start == 0)
+				start = fuse_now_ns();
+			res = fuse_worker_spin(w, start);
+			if (res > 0)
+				w->spun++;
+		}
+		if (res == -EAGAIN)
+		{
+			// 持有锁或者申请动态内存未释放时不能被取消
+			pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+			ev = fuse_worker_wait(w);
+			pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+			if (!ev)
+			{
+				if (fuse_reap_worker(w))
+				{
+					reaped=1;
+					break;
+				}
+				continue;
+			}
+			// 完成队列的回调函数会回复请求，不能被取消
+			if (ev & FUSE_WAIT_COMPLETE)
+				fuse_cq_drain(se);
+			if (!(ev & FUSE_WAIT_REQUEST) || !fuse_session_reserve(se))
+				continue;
+
+			pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+			res = fuse_session_receive(se, &w->receive_buf, w->fd);
+			pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+			if (res <= 0)
+				fuse_session_release(se);
+			if (w->poll && res > 0)
+				w->slept++;
+		}
+		if (w->poll && res > 0)
+		{
+			fuse_worker_adapt(w, fuse_now_ns() - start);
+			start = 0;
+		}
 
+		if (res==-EAGAIN){
+			continue;
+		}
 		// 挂载点取消，正常退出
-		if (res==0){
+		else if (res==0){
 			break;
 		}
 		// 如果有一个线程出现故障，其他的线程均应该退出
 		// 出现其他故障，故障恢复
 		else if(res<0){
-			se->exited=1;
-			w->wi->error=res;
-			fuse_log(FUSE_LOG_INFO, "[FUSE_LOG_ERR] fuse: thread %d session loop end due to an error:%s\n",w->thread_id,strerror(-res));
+			wi->error=res;
+			fuse_log(FUSE_LOG_INFO, "[FUSE_LOG_ERR] fuse: thread %lu session loop end due to an error:%s\n",(unsigned long)pthread_self(),strerror(-res));
 			break;
 		}
-		fuse_session_process(se, &w->receive_buf, w->fd);
+
+		if (atomic_fetch_sub(&wi->idle, 1) == 1)
+			fuse_grow_workers(wi);
+		fuse_session_process(se, &w->receive_buf, w->fd, NULL);
+		fuse_session_release(se);
+		atomic_fetch_add(&wi->idle, 1);
+	}
+
+	if(w->poll){
+		fuse_log(FUSE_LOG_INFO, "[FUSE_LOG_INFO] fuse: thread %lu busy poll: %llu requests while spinning, %llu after sleeping\n",
+			(unsigned long)pthread_self(),(unsigned long long)w->spun,(unsigned long long)w->slept);
+	}
+	if(reaped){
+		fuse_log(FUSE_LOG_INFO, "[FUSE_LOG_INFO] fuse: idle thread %lu exit\n",(unsigned long)pthread_self());
+	}else{
+		if(res>=0){
+			fuse_log(FUSE_LOG_INFO, "[FUSE_LOG_INFO] fuse: thread %lu session loop end\n",(unsigned long)pthread_self());
+		}
+		fuse_session_exit(se);
 	}
+	pthread_cleanup_pop(1);
 
-	if(res>=0){
-		fuse_log(FUSE_LOG_INFO, "[FUSE_LOG_INFO] fuse: thread %d session loop end\n",w->thread_id);
+	if(reaped){
+		free(w);
 	}
-	
 	return NULL;
 }
 
@@ -409,93 +745,424 @@ static int fuse_create_thread(pthread_t *thread_id, void *(*func)(void *), void
 	return 0;
 }
 
+// 创建一个线程并加入线程池，调用者需要持有 wi->lock
+// 常驻线程根据配置决定是否克隆 /dev/fuse；
+// 弹性线程优先复用退出线程留下的克隆文件描述符，否则克隆一个非阻塞的文件描述符，
+// 克隆失败时不创建弹性线程，之后也不再按需创建（阻塞的 se->fd 上无法空闲超时，线程永远不会被回收）；
+// 绑定 CPU 的线程在绑定之后自己克隆 /dev/fuse
+static int fuse_start_worker(struct fuse_worker_info *wi, int elastic, int cpu)
+{
+	struct fuse_worker* w=(struct fuse_worker*)calloc(1, sizeof(struct fuse_worker));
+
+	if(w==NULL){
+		fuse_log(FUSE_LOG_WARNING,
+			"[FUSE_LOG_WARNING] fuse: unable to allocate a new memory for fuse_worker: %s\n", strerror(errno));
+		return -1;
+	}
+	w->fd=-1;
+	w->wi=wi;
+	w->cpu=cpu;
+	// 前 poll_threads 个常驻线程自旋等待请求，它们总是使用非阻塞的克隆文件描述符
+	w->poll=!elastic&&wi->config.busy_poll&&(wi->config.poll_threads==0||wi->npoll<wi->config.poll_threads);
+	w->avg_wait=(uint64_t)wi->config.busy_poll*1000/2;
+	if(elastic&&wi->nspare>0){
+		w->fd=wi->spare[--wi->nspare];
+		w->elastic=1;
+	}else if(cpu<0&&(elastic||wi->config.clonefd||w->poll)){
+		if(fuse_clonefd(wi->se,w,(elastic||wi->se->cq||w->poll)?O_NONBLOCK:0)==0){
+			wi->fds[wi->nfds++]=w->fd;
+			w->elastic=elastic;
+		}else if(elastic){
+			wi->noclone=1;
+			free(w);
+			return -1;
+		}else{
+			// 只有异步模式下 se->fd 是非阻塞的，可以在上面自旋
+			w->poll=w->poll&&wi->se->cq!=NULL;
+		}
+	}
+	if(w->poll)
+		wi->npoll++;
+
+	wi->numworker++;
+	atomic_fetch_add(&wi->idle, 1);
+	list_add_item(w,wi->worker_head);
+	if (fuse_create_thread(&w->thread_id,fuse_do_work,w)<0){
+		list_del_item(struct fuse_worker,w);
+		atomic_fetch_sub(&wi->idle, 1);
+		wi->numworker--;
+		if(w->elastic)
+			wi->spare[wi->nspare++]=w->fd;
+		free(w);
+		return -1;
+	}
+	return 0;
+}
+
 static void fuse_join_thread(struct fuse_worker *w)
 {
 	pthread_cancel(w->thread_id);
 	pthread_join(w->thread_id, NULL);
 	list_del_item(struct fuse_worker,w);
-	free(w->receive_buf.mem);
+	fuse_bufpool_put(w->wi->se, w->receive_buf.mem);
 	free(w);
 }
 
 int fuse_multi_session_loop(struct fuse_session *se, int clonefd, unsigned threads)
 {
-	int *clonefds=NULL;
-	if(clonefd){
-		clonefds=(int *)calloc(threads+1,sizeof(int));
-		if (clonefds==NULL){
-			fuse_log(FUSE_LOG_ERR,
-				 "[FUSE_LOG_ERR] cannot init fuse_crash_recovery: %s", strerror(errno));
-			return -ERECOVERY;
+	struct fuse_loop_config config = {
+		.clonefd = clonefd,
+		.min_threads = threads,
+		.max_threads = threads,
+		.idle_timeout = 0,
+	};
+	return fuse_multi_session_loop_config(se, &config);
+}
+
+// 分发模式的读取线程
+struct fuse_reader
+{
+	struct fuse_session *se;
+	struct fuse_dispatcher *d;
+	pthread_t thread_id;
+	struct fuse_buf receive_buf;	// 请求放入队列后缓冲区随请求交给工作线程，下次接收时重新取得
+	int error;						// 记录线程出错的原因
+};
+
+static void fuse_dispatch_process(struct fuse_session *se, struct fuse_buf *buf, int fd)
+{
+	fuse_session_process(se, buf, fd, NULL);
+}
+
+// 读取线程只接收请求并按类别放入工作线程的队列，以下请求直接处理：
+// 1. 特殊请求，INIT 和 DESTROY 不会与其他请求并发到达，INTERRUPT 需要尽快标记被打断的请求，不应该排在其他请求之后；
+// 2. 没有空闲的工作线程时，开销较小的 METADATA 和 FORGET 类请求不再排在正在处理的请求之后，
+//    开启 QoS 时这些请求仍然需要排队，否则会绕过租户之间的公平调度
+static void *fuse_reader_routine(void *data)
+{
+	struct fuse_reader *r = (struct fuse_reader *)data;
+	struct fuse_session *se = r->se;
+	enum fuse_dispatch_class cls;
+	int res = 0;
+	int ev;
+
+	fuse_req_pool_init();
+	pthread_cleanup_push(fuse_worker_cleanup, NULL);
+	while (!se->exited)
+	{
+		if (se->cq != NULL)
+		{
+			pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+			ev = fuse_session_wait(se, -1, -1);
+			pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+			if (ev & FUSE_WAIT_COMPLETE)
+				fuse_cq_drain(se);
+			if (!(ev & FUSE_WAIT_REQUEST) || !fuse_session_reserve(se))
+				continue;
+		}
+
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+		res = fuse_session_receive(se, &r->receive_buf, -1);
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+		if (res <= 0)
+			fuse_session_release(se);
+
+		if (res == -EAGAIN)
+			continue;
+		// 挂载点取消，正常退出
+		else if (res == 0)
+			break;
+		else if (res < 0)
+		{
+			r->error = res;
+			fuse_log(FUSE_LOG_INFO, "[FUSE_LOG_ERR] fuse: reader %lu session loop end due to an error:%s\n",
+					 (unsigned long)pthread_self(), strerror(-res));
+			break;
+		}
+
+		cls = fuse_op_class(((struct fuse_in_header *)r->receive_buf.mem)->opcode);
+		if (cls == FUSE_CLASS_SPECIAL ||
+			(cls != FUSE_CLASS_DATA && r->d->qos == NULL && !fuse_dispatch_idle(r->d)))
+		{
+			fuse_session_process(se, &r->receive_buf, -1, NULL);
+			fuse_session_release(se);
+		}
+		else if (fuse_dispatch_push(r->d, &r->receive_buf, -1, cls) < 0)
+		{
+			fuse_session_release(se);
+			break;
 		}
-		clonefds[threads]=NULL;
 	}
+	fuse_session_exit(se);
+	pthread_cleanup_pop(1);
+	return NULL;
+}
+
+// 分发模式：config->readers 个读取线程接收请求，按类别放入 min_threads 个工作线程的队列，
+// 工作线程按照类别的优先级处理请求，自己的队列为空时从其他线程的队列中窃取
+static int fuse_dispatch_session_loop(struct fuse_session *se, const struct fuse_loop_config *config)
+{
+	unsigned nworkers = config->min_threads ? config->min_threads : 1;
+	struct fuse_reader *readers;
+	struct fuse_dispatcher *d;
+	unsigned started = 0;
+	unsigned i;
+	int res = 0;
+
+	// 管道属于读取请求的线程，WRITE 的数据无法随请求交给工作线程
+	if (se->conn.splice_read)
+	{
+		fuse_log(FUSE_LOG_WARNING, "[FUSE_LOG_WARNING] fuse: splice_read is disabled in dispatch mode\n");
+		se->conn.splice_read = 0;
+	}
+	// 异步模式下多个读取线程可能同时被 se->fd 可读唤醒，没有读到请求的线程需要回到 poll 等待完成队列
+	if (se->cq != NULL)
+		fcntl(se->fd, F_SETFL, fcntl(se->fd, F_GETFL) | O_NONBLOCK);
+
+	readers = (struct fuse_reader *)calloc(config->readers, sizeof(struct fuse_reader));
+	if (readers == NULL)
+	{
+		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: unable to allocate reader threads: %s\n", strerror(errno));
+		return -ENOMEM;
+	}
+	// 读取线程以及正在处理请求的工作线程各占用一个缓冲区，队列中的请求需要更多缓冲区时再按需映射
+	if (fuse_bufpool_reserve(se, config->readers + nworkers) < 0)
+	{
+		free(readers);
+		return -ENOMEM;
+	}
+	d = fuse_dispatch_new(se, nworkers, 0, &config->qos, fuse_dispatch_process);
+	if (d == NULL)
+	{
+		free(readers);
+		return -ENOTHREAD;
+	}
+	for (i = 0; i < config->readers; i++)
+	{
+		readers[i].se = se;
+		readers[i].d = d;
+		if (fuse_create_thread(&readers[i].thread_id, fuse_reader_routine, &readers[i]) < 0)
+			break;
+		started++;
+	}
+
+	if (started == 0)
+	{
+		fuse_log(FUSE_LOG_ERR,
+				 "[FUSE_LOG_ERR] fuse: cannot create any threads to read requests from user\n");
+		res = -ENOTHREAD;
+	}
+	else
+	{
+		fuse_log(FUSE_LOG_INFO,
+				 "[FUSE_LOG_INFO] fuse: %u reader(s) dispatch requests to %u worker(s)\n", started, nworkers);
+		// 等待信号处理函数、解除挂载或者出错的线程通知退出
+		while (!se->exited)
+		{
+			if (sem_wait(&se->exit_sem) == -1 && errno != EINTR)
+				break;
+		}
+	}
+
+	// 先唤醒等待队列空位的读取线程，再取消阻塞在接收请求上的读取线程
+	fuse_dispatch_stop(d);
+	for (i = 0; i < started; i++)
+	{
+		pthread_cancel(readers[i].thread_id);
+		pthread_join(readers[i].thread_id, NULL);
+		fuse_bufpool_put(se, readers[i].receive_buf.mem);
+		if (readers[i].error)
+			res = readers[i].error;
+	}
+	fuse_dispatch_destroy(d);
+	free(readers);
+	if (se->error)
+		res = se->error;
+	fuse_session_reset(se);
+	return res;
+}
+
+int fuse_multi_session_loop_config(struct fuse_session *se, const struct fuse_loop_config *config)
+{
+	if (config->readers > 0)
+		return fuse_dispatch_session_loop(se, config);
 
 	struct fuse_worker_info wi;
+	memset(&wi, 0, sizeof(wi));
 	FUSE_LIST_INIT(wi.worker_head);
-	wi.clonefd = clonefd;
-	wi.available = 0;
-	wi.error=0;
+	wi.config = *config;
 	wi.se=se;
-	if (threads > MAX_THREAD_NUM)
+	if (wi.config.cpus != NULL && wi.config.ncpus > 0)
 	{
-		fuse_log(FUSE_LOG_WARNING,
-				 "[FUSE_LOG_WARNING] too many threads created, input:%u, maximum:%u", threads, MAX_THREAD_NUM);
-		wi.threads = MAX_THREAD_NUM;
+		wi.config.clonefd = 1;
+		wi.config.min_threads = wi.config.ncpus;
+		wi.config.max_threads = wi.config.ncpus;
 	}
-	else
-	{
-		wi.threads = threads;
+	if (wi.config.min_threads == 0)
+		wi.config.min_threads = 1;
+	if (wi.config.max_threads < wi.config.min_threads)
+		wi.config.max_threads = wi.config.min_threads;
+	atomic_init(&wi.idle, 0);
+	pthread_mutex_init(&wi.lock, NULL);
+	// 异步模式下多个线程可能同时被 se->fd 可读唤醒，没有读到请求的线程需要回到 poll 等待完成队列
+	if (se->cq != NULL)
+		fcntl(se->fd, F_SETFL, fcntl(se->fd, F_GETFL) | O_NONBLOCK);
+
+	// 克隆的文件描述符最多与线程数相同，退出线程留下的文件描述符会被复用
+	wi.fds=(int *)calloc(wi.config.max_threads+1,sizeof(int));
+	wi.spare=(int *)calloc(wi.config.max_threads+1,sizeof(int));
+	if (wi.fds==NULL||wi.spare==NULL){
+		fuse_log(FUSE_LOG_ERR,
+			 "[FUSE_LOG_ERR] fuse: unable to allocate clonefd array: %s\n", strerror(errno));
+		free(wi.fds);
+		free(wi.spare);
+		pthread_mutex_destroy(&wi.lock);
+		return -ENOMEM;
 	}
+
 	unsigned i;
 	int res=0;
-	for (i=0 ; i < wi.threads; i++)
-	{
-		struct fuse_worker* w=(struct fuse_worker*)malloc(sizeof(struct fuse_worker));
-		w->fd=-1;
-		w->wi=&wi;
-		if(w==NULL){
-			fuse_log(FUSE_LOG_WARNING,
-				"[FUSE_LOG_WARNING] fuse: unable to allocate a new memory for fuse_worker: %s\n", strerror(errno));
-			continue;
-		}
-
-		if(clonefd){
-			fuse_clonefd(se,w);
-		}
-
-		res=fuse_create_thread(&w->thread_id,fuse_do_work,w);
-		if (res<0){
-			free(w);
-		}else{
-			wi.available++;
-			list_add_item(w,wi.worker_head);
-		}
+	// 未绑定 CPU 的线程共用预先分配的缓冲区，绑定 CPU 的线程在自己的 CPU 上分配
+	if (fuse_bufpool_reserve(se, wi.config.cpus ? 0 : wi.config.min_threads) < 0){
+		free(wi.fds);
+		free(wi.spare);
+		pthread_mutex_destroy(&wi.lock);
+		return -ENOMEM;
 	}
-	if(wi.available==0){
+	pthread_mutex_lock(&wi.lock);
+	for (i=0 ; i < wi.config.min_threads; i++)
+		fuse_start_worker(&wi, 0, wi.config.cpus ? wi.config.cpus[i] : -1);
+	pthread_mutex_unlock(&wi.lock);
+
+	if(wi.numworker==0){
 		fuse_log(FUSE_LOG_ERR,
 				"[FUSE_LOG_ERR] fuse: cannot create any threads to handle requests from user\n");
 		res=-ENOTHREAD;
 	}else{
 		fuse_log(FUSE_LOG_INFO,
-				"[FUSE_LOG_INFO] fuse: %u/%u is(are) running running to handle requests from user\n",wi.available,wi.threads);
+				"[FUSE_LOG_INFO] fuse: %u/%u is(are) running running to handle requests from user, up to %u on demand\n",
+				wi.numworker,wi.config.min_threads,wi.config.max_threads);
+		// 等待信号处理函数、解除挂载或者出错的线程通知退出
 		while (!se->exited)
-			sleep(1);
-		size_t index=0;
-		struct fuse_worker* w;
-		while (wi.worker_head.next!=&wi.worker_head){
-			w=wi.worker_head.next;
-			if(clonefd&&w->fd!=-1)
-				clonefds[index++]=w->fd;
-			fuse_join_thread(w);
-		}
-		se->clonefds=clonefds;
+		{
+			if (sem_wait(&se->exit_sem) == -1 && errno != EINTR)
+				break;
+		}
+
+		pthread_mutex_lock(&wi.lock);
+		wi.stopping=1;
+		pthread_mutex_unlock(&wi.lock);
+		while (wi.worker_head.next!=&wi.worker_head)
+			fuse_join_thread(wi.worker_head.next);
 		res=0;
 		if (wi.error)
 			res=wi.error;
 		if(se->error)
 			res=se->error;
 	}
+
+	// 克隆的文件描述符在会话销毁时关闭
+	if(wi.nfds>0){
+		if(se->clonefds!=NULL){
+			int *clonefd;
+			for(clonefd=se->clonefds;*clonefd!=-1;clonefd++)
+				close(*clonefd);
+			free(se->clonefds);
+		}
+		wi.fds[wi.nfds]=-1;
+		se->clonefds=wi.fds;
+	}else{
+		free(wi.fds);
+	}
+	free(wi.spare);
+	pthread_mutex_destroy(&wi.lock);
 	fuse_session_reset(se);
 	return res;
-}
\ No newline at end of file
+}
+
+static void fuse_uring_process(struct fuse_session *se, struct fuse_buf *buf, struct fuse_uring_ent *ent)
+{
+	fuse_session_process(se, buf, -1, ent);
+}
+
+int fuse_uring_session_loop(struct fuse_session *se, const struct fuse_loop_config *config, unsigned depth)
+{
+	int res;
+
+	if (fuse_uring_new(se, depth, fuse_uring_process) < 0)
+		fuse_log(FUSE_LOG_WARNING, "[FUSE_LOG_WARNING] fuse: io_uring disabled, "
+								   "requests are served through /dev/fuse\n");
+	if (config != NULL)
+		res = fuse_multi_session_loop_config(se, config);
+	else
+		res = fuse_single_session_loop(se);
+	fuse_uring_destroy(se);
+	return res;
+}
+
+int fuse_parse_cpus(const char *str, int **cpus)
+{
+	cpu_set_t allowed;
+	cpu_set_t selected;
+	const char *p = str;
+	char *end;
+	long first, last, cpu;
+	int *res;
+	int n = 0;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+		CPU_ZERO(&allowed);
+	CPU_ZERO(&selected);
+	while (*p != '\0')
+	{
+		first = strtol(p, &end, 10);
+		if (end == p || first < 0)
+			goto err_out;
+		last = first;
+		p = end;
+		if (*p == '-')
+		{
+			p++;
+			last = strtol(p, &end, 10);
+			if (end == p || last < first)
+				goto err_out;
+			p = end;
+		}
+		if (last >= CPU_SETSIZE)
+			goto err_out;
+		for (cpu = first; cpu <= last; cpu++)
+		{
+			if (!CPU_ISSET(cpu, &allowed))
+			{
+				fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: cpu %ld is not available\n", cpu);
+				return -1;
+			}
+			CPU_SET(cpu, &selected);
+		}
+		if (*p == ',')
+			p++;
+		else if (*p != '\0')
+			goto err_out;
+	}
+
+	n = CPU_COUNT(&selected);
+	if (n == 0)
+		goto err_out;
+	res = (int *)malloc(n * sizeof(int));
+	if (res == NULL)
+	{
+		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: unable to allocate cpu list: %s\n", strerror(errno));
+		return -1;
+	}
+	n = 0;
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+	{
+		if (CPU_ISSET(cpu, &selected))
+			res[n++] = (int)cpu;
+	}
+	*cpus = res;
+	return n;
+err_out:
+	fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: invalid cpu list `%s`\n", str);
+	return -1;
+}
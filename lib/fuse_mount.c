@@ -353,7 +353,7 @@ void fuse_session_unmount(struct fuse_session *se)
 	if (se->clonefds!=NULL)
 	{
 		int *clonefd = se->clonefds;
-		while (clonefd != NULL)
+		while (*clonefd != -1)
 		{
 			close(*clonefd);
 			clonefd++;
@@ -0,0 +1,240 @@
+#include <fuse_notify.h>
+#include <fuse_log.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// 检查会话是否已经初始化，并且内核的协议版本不低于 minor
+static int fuse_notify_check(struct fuse_session *se, unsigned minor)
+{
+	if (se == NULL)
+		return -EINVAL;
+	if (!se->inited)
+		return -ENOTCONN;
+	if (se->conn.proto_minor < minor)
+		return -ENOSYS;
+	return 0;
+}
+
+// 发送一个通知，iov[0] 留给 fuse_out_header
+static int fuse_notify_send(struct fuse_session *se, enum fuse_notify_code code,
+							struct iovec *iov, int count)
+{
+	struct fuse_out_header out;
+
+	memset(&out, 0, sizeof(out));
+	out.unique = 0;
+	out.error = code;
+	iov[0].iov_base = &out;
+	iov[0].iov_len = sizeof(out);
+	return fuse_send_iov_msg(se, -1, iov, count);
+}
+
+int fuse_notify_inval_inode(struct fuse_session *se, fuse_inode ino, off_t off, off_t len)
+{
+	struct fuse_notify_inval_inode_out outarg;
+	struct iovec iov[2];
+	int res;
+
+	res = fuse_notify_check(se, 12);
+	if (res < 0)
+		return res;
+	outarg.ino = ino;
+	outarg.off = off;
+	outarg.len = len;
+	iov[1].iov_base = &outarg;
+	iov[1].iov_len = sizeof(outarg);
+	return fuse_notify_send(se, FUSE_NOTIFY_INVAL_INODE, iov, 2);
+}
+
+int fuse_notify_inval_entry(struct fuse_session *se, fuse_inode parent, const char *name, size_t namelen)
+{
+	struct fuse_notify_inval_entry_out outarg;
+	struct iovec iov[4];
+	int res;
+
+	if (name == NULL)
+		return -EINVAL;
+	res = fuse_notify_check(se, 12);
+	if (res < 0)
+		return res;
+	memset(&outarg, 0, sizeof(outarg));
+	outarg.parent = parent;
+	outarg.namelen = namelen;
+	iov[1].iov_base = &outarg;
+	iov[1].iov_len = sizeof(outarg);
+	// 内核要求名字之后跟着一个 '\0'
+	iov[2].iov_base = (void *)name;
+	iov[2].iov_len = namelen;
+	iov[3].iov_base = (void *)"";
+	iov[3].iov_len = 1;
+	return fuse_notify_send(se, FUSE_NOTIFY_INVAL_ENTRY, iov, 4);
+}
+
+int fuse_notify_delete(struct fuse_session *se, fuse_inode parent, fuse_inode child,
+					   const char *name, size_t namelen)
+{
+	struct fuse_notify_delete_out outarg;
+	struct iovec iov[4];
+	int res;
+
+	if (name == NULL)
+		return -EINVAL;
+	res = fuse_notify_check(se, 18);
+	if (res < 0)
+		return res;
+	memset(&outarg, 0, sizeof(outarg));
+	outarg.parent = parent;
+	outarg.child = child;
+	outarg.namelen = namelen;
+	iov[1].iov_base = &outarg;
+	iov[1].iov_len = sizeof(outarg);
+	iov[2].iov_base = (void *)name;
+	iov[2].iov_len = namelen;
+	iov[3].iov_base = (void *)"";
+	iov[3].iov_len = 1;
+	return fuse_notify_send(se, FUSE_NOTIFY_DELETE, iov, 4);
+}
+
+int fuse_notify_store(struct fuse_session *se, fuse_inode ino, off_t offset, struct fuse_bufvec *bufv)
+{
+	struct fuse_notify_store_out outarg;
+	struct fuse_bufvec mem_buf;
+	struct iovec *iov;
+	size_t size = 0;
+	size_t i;
+	int count = 2;
+	int copy = 0;
+	int res;
+
+	if (bufv == NULL)
+		return -EINVAL;
+	res = fuse_notify_check(se, 15);
+	if (res < 0)
+		return res;
+
+	// 数据全部在内存中时与通知头部一起通过一次 writev 发送，否则先拷贝到临时缓冲区
+	for (i = bufv->idx; i < bufv->count; i++)
+	{
+		if (bufv->buf[i].flags & FUSE_BUF_IS_FD)
+			copy = 1;
+		size += bufv->buf[i].size - (i == bufv->idx ? bufv->off : 0);
+	}
+	iov = (struct iovec *)calloc(bufv->count - bufv->idx + 2, sizeof(struct iovec));
+	if (iov == NULL)
+		return -ENOMEM;
+	if (copy)
+	{
+		mem_buf = FUSE_BUFVEC_INIT(size);
+		mem_buf.buf[0].mem = malloc(size);
+		if (mem_buf.buf[0].mem == NULL)
+		{
+			free(iov);
+			return -ENOMEM;
+		}
+		res = fuse_buf_copy(&mem_buf, bufv);
+		if (res < 0)
+			goto out;
+		size = res;
+		iov[2].iov_base = mem_buf.buf[0].mem;
+		iov[2].iov_len = size;
+		count = 3;
+	}
+	else
+	{
+		for (i = bufv->idx; i < bufv->count; i++)
+		{
+			size_t off = i == bufv->idx ? bufv->off : 0;
+			iov[count].iov_base = (char *)bufv->buf[i].mem + off;
+			iov[count].iov_len = bufv->buf[i].size - off;
+			count++;
+		}
+	}
+
+	memset(&outarg, 0, sizeof(outarg));
+	outarg.nodeid = ino;
+	outarg.offset = offset;
+	outarg.size = size;
+	iov[1].iov_base = &outarg;
+	iov[1].iov_len = sizeof(outarg);
+	res = fuse_notify_send(se, FUSE_NOTIFY_STORE, iov, count);
+out:
+	if (copy)
+		free(mem_buf.buf[0].mem);
+	free(iov);
+	return res;
+}
+
+int fuse_notify_retrieve(struct fuse_session *se, fuse_inode ino, size_t size, off_t offset, void *cookie)
+{
+	struct fuse_notify_retrieve_out outarg;
+	struct fuse_notify_req *nreq;
+	struct iovec iov[2];
+	int res;
+
+	res = fuse_notify_check(se, 15);
+	if (res < 0)
+		return res;
+	if (se->ops.retrieve_reply == NULL)
+		return -ENOSYS;
+
+	nreq = (struct fuse_notify_req *)malloc(sizeof(struct fuse_notify_req));
+	if (nreq == NULL)
+		return -ENOMEM;
+	nreq->cookie = cookie;
+	// 先登记再发送，NOTIFY_REPLY 可能在 writev 返回之前就被其他线程收到
+	pthread_mutex_lock(&se->notify_lock);
+	nreq->unique = se->notify_ctr++;
+	list_add_item(nreq, se->notify_list);
+	pthread_mutex_unlock(&se->notify_lock);
+
+	memset(&outarg, 0, sizeof(outarg));
+	outarg.notify_unique = nreq->unique;
+	outarg.nodeid = ino;
+	outarg.offset = offset;
+	outarg.size = size;
+	iov[1].iov_base = &outarg;
+	iov[1].iov_len = sizeof(outarg);
+	res = fuse_notify_send(se, FUSE_NOTIFY_RETRIEVE, iov, 2);
+	if (res < 0)
+	{
+		nreq = fuse_notify_take(se, outarg.notify_unique);
+		free(nreq);
+	}
+	return res;
+}
+
+struct fuse_notify_req *fuse_notify_take(struct fuse_session *se, uint64_t unique)
+{
+	struct fuse_notify_req *nreq;
+	struct fuse_notify_req *found = NULL;
+
+	pthread_mutex_lock(&se->notify_lock);
+	for (nreq = se->notify_list.next; nreq != &se->notify_list; nreq = nreq->next)
+	{
+		if (nreq->unique == unique)
+		{
+			list_del_item(struct fuse_notify_req, nreq);
+			found = nreq;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&se->notify_lock);
+	return found;
+}
+
+void fuse_notify_destroy(struct fuse_session *se)
+{
+	struct fuse_notify_req *nreq;
+
+	pthread_mutex_lock(&se->notify_lock);
+	while (se->notify_list.next != &se->notify_list)
+	{
+		nreq = se->notify_list.next;
+		list_del_item(struct fuse_notify_req, nreq);
+		free(nreq);
+	}
+	pthread_mutex_unlock(&se->notify_lock);
+	pthread_mutex_destroy(&se->notify_lock);
+}
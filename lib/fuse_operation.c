@@ -3,6 +3,9 @@
 #include <fuse_kernel.h>
 #include <fuse_session.h>
 #include <fuse_reply.h>
+#include <fuse_uring.h>
+#include <fuse_notify.h>
+#include <fuse_dispatch.h>
 
 // FUSE Request Types Grouped by Semantics
 // Group (#) 				| Request Types
@@ -16,11 +19,19 @@
 // Directory (7) 			| mkdir, rmdir, opendir, releasedir, readdir, readdirplus, fsyncdir
 // Locking (3) 				| getlk, setlk, setlkw
 // Misc (6) 				| bmap, fallocate, mknod, ioctl, poll, notify_reply
+//
+// 分发模式下按照开销把上面的分组合并为几个类别，见 fuse_op_class()：
+// Special 由读取线程直接处理；forget、batch_forget、release、releasedir 归入 FORGET；
+// read、write、fsync、fsyncdir、readdir、readdirplus、fallocate、copy_file_range 归入 DATA；
+// 其余请求都归入 METADATA
 
 #define ENTER_ONCE(req, outlabel)                 \
 	{                                             \
 		if (atomic_flag_test_and_set(&req->used)) \
+		{                                         \
+			send_reply_err(req, EINTR);           \
 			goto outlabel;                        \
+		}                                         \
 	}
 
 #define OUT \
@@ -91,7 +102,7 @@ void do_init(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 				 arg->major, arg->minor);
 		send_reply_err(req, EPROTO);
 		se->error = -EPROTO;
-		se->exited = 1;
+		fuse_session_exit(se);
 		return;
 	}
 
@@ -158,10 +169,69 @@ void do_init(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 
 	se->conn.time_gran = 1;
 
+	// 默认通过 splice 发送 READ 响应，文件系统可以在 init 中清除这个标记
+	if (se->conn.capable & FUSE_SPLICE_WRITE)
+		se->conn.want |= FUSE_SPLICE_WRITE;
+	if (se->conn.splice_read && (se->conn.capable & FUSE_SPLICE_READ))
+		se->conn.want |= FUSE_SPLICE_READ;
+	// 以下能力在内核支持时默认开启，文件系统可以在 init 中清除：
+	// 预读请求可以并发发送，同一目录下的 lookup/readdir 可以并行，
+	// 文件大小或者 mtime 变化时内核自动丢弃页缓存，异步提交 direct I/O
+	se->conn.want |= se->conn.capable & (FUSE_ASYNC_READ | FUSE_PARALLEL_DIROPS |
+										 FUSE_AUTO_INVAL_DATA | FUSE_ASYNC_DIO);
+	// 实现了 readdirplus 时默认开启，由内核根据访问模式自适应地选择 READDIR 或者 READDIRPLUS；
+	// 文件系统可以在 init 中清除 FUSE_READDIRPLUS_AUTO，使内核总是发送 READDIRPLUS
+	if (se->ops.readdirplus && (se->conn.capable & FUSE_DO_READDIRPLUS))
+	{
+		se->conn.want |= FUSE_DO_READDIRPLUS;
+		if (se->conn.capable & FUSE_READDIRPLUS_AUTO)
+			se->conn.want |= FUSE_READDIRPLUS_AUTO;
+	}
+
+	// 没有实现 open/opendir 时不需要 OPEN/OPENDIR 以及对应的 RELEASE 请求
+	if (!se->ops.open && !se->ops.release && (se->conn.capable & FUSE_NO_OPEN_SUPPORT))
+		se->conn.no_open = 1;
+	if (!se->ops.opendir && !se->ops.releasedir && (se->conn.capable & FUSE_NO_OPENDIR_SUPPORT))
+		se->conn.no_opendir = 1;
+
 	se->inited = 1;
 	if (se->ops.init)
 		se->ops.init(se->userdata, &se->conn);
 
+	// 省略 OPEN/OPENDIR 需要内核支持，否则打开请求仍然交给文件系统处理
+	if (se->conn.no_open && !(se->conn.capable & FUSE_NO_OPEN_SUPPORT))
+	{
+		fuse_log(FUSE_LOG_WARNING, "[FUSE_LOG_WARNING] fuse: kernel does not support no_open\n");
+		se->conn.no_open = 0;
+	}
+	if (se->conn.no_opendir && !(se->conn.capable & FUSE_NO_OPENDIR_SUPPORT))
+	{
+		fuse_log(FUSE_LOG_WARNING, "[FUSE_LOG_WARNING] fuse: kernel does not support no_opendir\n");
+		se->conn.no_opendir = 0;
+	}
+
+	// 内核 passthrough 只在文件系统请求并且内核支持时开启，后端文件最多再叠加一层文件系统
+	if (se->conn.passthrough)
+	{
+		if ((arg->flags & FUSE_INIT_EXT) && (arg->flags2 & (FUSE_PASSTHROUGH >> 32)))
+		{
+			outarg.flags |= FUSE_INIT_EXT;
+			outarg.flags2 |= FUSE_PASSTHROUGH >> 32;
+			outarg.max_stack_depth = 1;
+		}
+		else
+		{
+			fuse_log(FUSE_LOG_WARNING, "[FUSE_LOG_WARNING] fuse: kernel does not support passthrough\n");
+			se->conn.passthrough = 0;
+		}
+	}
+	// 内核不允许 passthrough 与 writeback cache 同时开启，passthrough 本身已经绕过了用户态
+	if (se->conn.passthrough && (se->conn.want & FUSE_WRITEBACK_CACHE))
+	{
+		fuse_log(FUSE_LOG_WARNING, "[FUSE_LOG_WARNING] fuse: writeback cache is disabled by passthrough\n");
+		se->conn.want &= ~FUSE_WRITEBACK_CACHE;
+	}
+
 	if (se->conn.want & (~se->conn.capable))
 	{
 		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: filesystem requested capabilities "
@@ -169,7 +239,7 @@ void do_init(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 				 se->conn.want & (~se->conn.capable));
 		send_reply_err(req, EPROTO);
 		se->error = -EPROTO;
-		se->exited = 1;
+		fuse_session_exit(se);
 		return;
 	}
 
@@ -179,11 +249,21 @@ void do_init(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 		outarg.max_pages = (se->conn.max_write - 1) / getpagesize() + 1;
 	}
 	outarg.flags |= FUSE_BIG_WRITES;
+	// 文件系统请求并且内核支持的能力全部交给内核，上面已经检查过 want 是 capable 的子集
+	outarg.flags |= se->conn.want;
 	outarg.max_write = se->conn.max_write;
 	outarg.max_readahead = se->conn.max_readahead;
 	if (se->conn.proto_minor >= 23)
 		outarg.time_gran = se->conn.time_gran;
 
+	// 会话循环请求了 io_uring 传输方式，并且内核支持（需要开启 fuse 模块的 enable_uring 参数）
+	if (se->uring != NULL && (arg->flags & FUSE_INIT_EXT) &&
+		(arg->flags2 & (FUSE_OVER_IO_URING >> 32)))
+	{
+		outarg.flags |= FUSE_INIT_EXT;
+		outarg.flags2 |= FUSE_OVER_IO_URING >> 32;
+	}
+
 	if (se->debug)
 	{
 		fuse_log(FUSE_LOG_DEBUG, "[FUSE_LOG_DEBUG] INIT: %u.%u\n", outarg.major, outarg.minor);
@@ -197,6 +277,7 @@ void do_init(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 				 outarg.congestion_threshold);
 		fuse_log(FUSE_LOG_DEBUG, "[FUSE_LOG_DEBUG] time_gran=%u\n",
 				 outarg.time_gran);
+		fuse_log(FUSE_LOG_DEBUG, "[FUSE_LOG_DEBUG] flags2=0x%08x\n", outarg.flags2);
 	}
 
 	size_t outargsize = sizeof(outarg);
@@ -207,6 +288,22 @@ void do_init(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 
 	fuse_session_save(se);
 	send_reply_ok(req, &outarg, outargsize);
+
+	// 内核在处理 INIT 回复时开启 io_uring，之后才能注册队列；
+	// 负载缓冲区不能小于内核根据 max_write 和 max_pages 计算出的大小
+	if (outarg.flags2 & (FUSE_OVER_IO_URING >> 32))
+	{
+		size_t pages = (outarg.flags & FUSE_MAX_PAGES) ? outarg.max_pages : FUSE_DEFAULT_MAX_PAGES_PER_REQ;
+		size_t payload_sz = pages * getpagesize();
+
+		if (payload_sz < se->conn.max_write)
+			payload_sz = se->conn.max_write;
+		if (payload_sz < FUSE_MIN_READ_BUFFER)
+			payload_sz = FUSE_MIN_READ_BUFFER;
+		if (fuse_uring_start(se, payload_sz) < 0)
+			fuse_log(FUSE_LOG_WARNING, "[FUSE_LOG_WARNING] fuse: io_uring queues unavailable, "
+									   "requests are served through /dev/fuse\n");
+	}
 }
 
 static void do_destroy(fuse_req_p req, fuse_inode nodeid, const void *inarg)
@@ -224,33 +321,8 @@ static void do_destroy(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 	send_reply_ok(req, NULL, 0);
 }
 
-static int find_interrupted(struct fuse_session *se, fuse_req_p req)
-{
-	fuse_req_p curr;
-
-	for (curr = se->req_list.next; curr != &se->req_list; curr = curr->next)
-	{
-		if (curr->unique == req->interrupted_id)
-		{
-			// 找到之后需要确保这个请求当前未被处理，否则无法打断
-			ENTER_ONCE(curr, out);
-			pthread_mutex_unlock(&se->lock);
-			send_reply_none(curr);
-			pthread_mutex_lock(&se->lock);
-		out:
-			return 1;
-		}
-	}
-	for (curr = se->int_list.next; curr != &se->int_list; curr = curr->next)
-	{
-		if (curr->interrupted_id == req->interrupted_id)
-			return 1;
-	}
-	return 0;
-}
-
 // do_interrupt 请求仅仅实现了当对应的请求还没有开始被处理时
-// 如果收到 interrupt 请求，那么就移除这个请求
+// 如果收到 interrupt 请求，那么这个请求不再被处理，而是直接回复 EINTR
 // 如果这个请求已经在处理过程中，那么仅仅设置这个请求的 interrupted 标记为 1
 static void do_interrupt(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 {
@@ -264,14 +336,10 @@ static void do_interrupt(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 
 	req->interrupted_id = arg->unique;
 
-	pthread_mutex_lock(&se->lock);
-	// 如果找到需要打断的请求，则从请求列表中删除（如果有的话），并释放这个 int 请求
-	// 如果没有找到，则将这个 int 请求加入列表
-	if (find_interrupted(se, req))
-		free(req);
-	else
-		list_add_item(req, se->int_list);
-	pthread_mutex_unlock(&se->lock);
+	// 如果找到需要打断的请求，则释放这个 int 请求
+	// 如果没有找到，则将这个 int 请求挂起到请求表中
+	if (fuse_req_interrupt(se->reqs, req))
+		fuse_free_req(req);
 }
 
 static void do_lookup(fuse_req_p req, fuse_inode nodeid, const void *inarg)
@@ -286,6 +354,18 @@ static void do_lookup(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 	OUT
 }
 
+// 开启 writeback cache 后，页缓存由内核统一管理：
+// 1. 只写打开的文件在部分写入一个页时内核需要先读出这个页，因此改为读写打开；
+// 2. 追加写的偏移由内核根据自己维护的文件大小决定，WRITE 请求带有明确的偏移，去掉 O_APPEND
+static int fuse_open_flags(struct fuse_session *se, int flags)
+{
+	if (!(se->conn.want & FUSE_WRITEBACK_CACHE))
+		return flags;
+	if ((flags & O_ACCMODE) == O_WRONLY)
+		flags = (flags & ~O_ACCMODE) | O_RDWR;
+	return flags & ~O_APPEND;
+}
+
 static void do_create(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 {
 	struct fuse_create_in *arg = (struct fuse_create_in *)inarg;
@@ -293,7 +373,7 @@ static void do_create(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 	char *name = PARAM(arg);
 
 	memset(&fi, 0, sizeof(fi));
-	fi.flags = arg->flags;
+	fi.flags = fuse_open_flags(req->se, arg->flags);
 
 	if (req->se->conn.proto_minor >= 12)
 		req->ctx.umask = arg->umask;
@@ -316,10 +396,13 @@ static void do_open(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 	struct fuse_file_info fi;
 
 	memset(&fi, 0, sizeof(fi));
-	fi.flags = arg->flags;
+	fi.flags = fuse_open_flags(req->se, arg->flags);
 
 	ENTER_ONCE(req, out);
-	if (req->se->ops.open)
+	// 内核收到 ENOSYS 后认为打开总是成功，之后的 OPEN 和 RELEASE 都不再发送
+	if (req->se->conn.no_open)
+		send_reply_err(req, ENOSYS);
+	else if (req->se->ops.open)
 		req->se->ops.open(req, nodeid, &fi);
 	else
 		send_reply_open(req, &fi);
@@ -381,6 +464,42 @@ static void do_write(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 	OUT
 }
 
+// 文件系统实现了 write_buf 时，WRITE 请求由这个函数处理，
+// 通过 splice 接收请求时数据仍然留在管道中，ibuf 为指向管道的文件描述符
+static void do_write_buf(fuse_req_p req, fuse_inode nodeid, const void *inarg,
+						 const struct fuse_buf *ibuf)
+{
+	struct fuse_write_in *arg = (struct fuse_write_in *)inarg;
+	struct fuse_bufvec bufv = FUSE_BUFVEC_INIT(arg->size);
+	struct fuse_file_info fi;
+
+	memset(&fi, 0, sizeof(fi));
+	fi.fh = arg->fh;
+	fi.writepage = (arg->write_flags & FUSE_WRITE_CACHE) != 0;
+
+	if (req->se->conn.proto_minor >= 9)
+	{
+		fi.lock_owner = arg->lock_owner;
+		fi.flags = arg->flags;
+		bufv.buf[0].mem = PARAM(arg);
+	}
+	else
+	{
+		bufv.buf[0].mem = ((char *)arg) + FUSE_COMPAT_WRITE_IN_SIZE;
+	}
+
+	if (ibuf->flags & FUSE_BUF_IS_FD)
+	{
+		bufv.buf[0].mem = NULL;
+		bufv.buf[0].flags = ibuf->flags;
+		bufv.buf[0].fd = ibuf->fd;
+	}
+
+	ENTER_ONCE(req, out);
+	req->se->ops.write_buf(req, nodeid, &bufv, arg->offset, &fi);
+	OUT
+}
+
 static void do_unlink(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 {
 	char *name = (char *)inarg;
@@ -444,7 +563,9 @@ static void do_opendir(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 	fi.flags = arg->flags;
 
 	ENTER_ONCE(req, out);
-	if (req->se->ops.opendir)
+	if (req->se->conn.no_opendir)
+		send_reply_err(req, ENOSYS);
+	else if (req->se->ops.opendir)
 		req->se->ops.opendir(req, nodeid, &fi);
 	else
 		send_reply_open(req, &fi);
@@ -467,6 +588,22 @@ static void do_readdir(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 	OUT
 }
 
+static void do_readdirplus(fuse_req_p req, fuse_inode nodeid, const void *inarg)
+{
+	struct fuse_read_in *arg = (struct fuse_read_in *)inarg;
+	struct fuse_file_info fi;
+
+	memset(&fi, 0, sizeof(fi));
+	fi.fh = arg->fh;
+
+	ENTER_ONCE(req, out);
+	if (req->se->ops.readdirplus)
+		req->se->ops.readdirplus(req, nodeid, arg->size, arg->offset, &fi);
+	else
+		send_reply_err(req, ENOSYS);
+	OUT
+}
+
 static void do_rmdir(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 {
 	char *name = (char *)inarg;
@@ -522,6 +659,139 @@ static void do_forget(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 	OUT
 }
 
+// 一次处理内核合并发送的多个 FORGET，与 FORGET 一样不回复；
+// 没有实现 forget_multi 时为每个 inode 分配一个请求体调用 forget
+static void do_batch_forget(fuse_req_p req, fuse_inode nodeid, const void *inarg)
+{
+	struct fuse_batch_forget_in *arg = (struct fuse_batch_forget_in *)inarg;
+	struct fuse_forget_one *param = (struct fuse_forget_one *)&arg[1];
+	fuse_req_p one;
+	uint32_t i;
+
+	(void)nodeid;
+	ENTER_ONCE(req, out);
+	if (req->se->ops.forget_multi)
+	{
+		req->se->ops.forget_multi(req, arg->count, (struct fuse_forget_data *)param);
+		goto out;
+	}
+	if (req->se->ops.forget && arg->count > 0)
+	{
+		// 最后一个 FORGET 直接使用整批的请求，不需要再分配；
+		// 中间分配失败时只丢失这一个 FORGET（文件系统中这个 inode 的引用不再减少），其余的仍然交给文件系统
+		for (i = 0; i + 1 < arg->count; i++)
+		{
+			one = fuse_alloc_req(req->se);
+			if (one == NULL)
+			{
+				fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: forget of inode %llu dropped\n",
+						 (unsigned long long)param[i].nodeid);
+				continue;
+			}
+			one->unique = req->unique;
+			one->ctx = req->ctx;
+			one->fd = req->fd;
+			req->se->ops.forget(one, param[i].nodeid, param[i].nlookup);
+		}
+		req->se->ops.forget(req, param[i].nodeid, param[i].nlookup);
+		goto out;
+	}
+	send_reply_none(req);
+	OUT
+}
+
+// 分配、回收文件的一段空间（如 FALLOC_FL_PUNCH_HOLE 打洞），回复 ENOSYS 后内核不再发送这个请求
+static void do_fallocate(fuse_req_p req, fuse_inode nodeid, const void *inarg)
+{
+	struct fuse_fallocate_in *arg = (struct fuse_fallocate_in *)inarg;
+	struct fuse_file_info fi;
+
+	memset(&fi, 0, sizeof(fi));
+	fi.fh = arg->fh;
+
+	ENTER_ONCE(req, out);
+	if (req->se->ops.fallocate)
+		req->se->ops.fallocate(req, nodeid, arg->mode, arg->offset, arg->length, &fi);
+	else
+		send_reply_err(req, ENOSYS);
+	OUT
+}
+
+// 只有 SEEK_DATA 和 SEEK_HOLE 会发给文件系统，其余的 whence 由内核自己处理；
+// 回复 ENOSYS 后内核不再发送这个请求，把整个文件当作数据
+static void do_lseek(fuse_req_p req, fuse_inode nodeid, const void *inarg)
+{
+	struct fuse_lseek_in *arg = (struct fuse_lseek_in *)inarg;
+	struct fuse_file_info fi;
+
+	memset(&fi, 0, sizeof(fi));
+	fi.fh = arg->fh;
+
+	ENTER_ONCE(req, out);
+	if (req->se->ops.lseek)
+		req->se->ops.lseek(req, nodeid, arg->offset, arg->whence, &fi);
+	else
+		send_reply_err(req, ENOSYS);
+	OUT
+}
+
+// 在两个打开的文件之间拷贝数据，nodeid 为源文件，目标文件的 nodeid 在参数中；
+// 回复 ENOSYS 后内核不再发送这个请求，copy_file_range(2) 退回到由内核通过 READ 和 WRITE 拷贝
+static void do_copy_file_range(fuse_req_p req, fuse_inode nodeid, const void *inarg)
+{
+	struct fuse_copy_file_range_in *arg = (struct fuse_copy_file_range_in *)inarg;
+	struct fuse_file_info fi_in;
+	struct fuse_file_info fi_out;
+
+	memset(&fi_in, 0, sizeof(fi_in));
+	fi_in.fh = arg->fh_in;
+	memset(&fi_out, 0, sizeof(fi_out));
+	fi_out.fh = arg->fh_out;
+
+	ENTER_ONCE(req, out);
+	if (req->se->ops.copy_file_range)
+		req->se->ops.copy_file_range(req, nodeid, arg->off_in, &fi_in,
+									 arg->nodeid_out, arg->off_out, &fi_out,
+									 arg->len, arg->flags);
+	else
+		send_reply_err(req, ENOSYS);
+	OUT
+}
+
+// 内核对 fuse_notify_retrieve() 的回复，请求的 unique 为通知中的 notify_unique，数据跟在参数之后；
+// NOTIFY_REPLY 不需要回复
+static void do_notify_reply(fuse_req_p req, fuse_inode nodeid, const void *inarg)
+{
+	struct fuse_notify_retrieve_in *arg = (struct fuse_notify_retrieve_in *)inarg;
+	const struct fuse_in_header *in = (const struct fuse_in_header *)inarg - 1;
+	struct fuse_bufvec bufv = FUSE_BUFVEC_INIT(arg->size);
+	struct fuse_notify_req *nreq;
+	size_t datalen;
+
+	ENTER_ONCE(req, out);
+	nreq = fuse_notify_take(req->se, req->unique);
+	if (nreq == NULL)
+	{
+		send_reply_none(req);
+		goto out;
+	}
+	datalen = in->len - sizeof(*in) - sizeof(*arg);
+	if (in->len < sizeof(*in) + sizeof(*arg) || arg->size > datalen)
+	{
+		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: retrieve reply: buffer size too small\n");
+		send_reply_none(req);
+	}
+	else if (req->se->ops.retrieve_reply)
+	{
+		bufv.buf[0].mem = PARAM(arg);
+		req->se->ops.retrieve_reply(req, nreq->cookie, nodeid, arg->offset, &bufv);
+	}
+	else
+		send_reply_none(req);
+	free(nreq);
+	OUT
+}
+
 static void do_getattr(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 {
 	ENTER_ONCE(req, out);
@@ -613,6 +883,40 @@ static void do_flush(fuse_req_p req, fuse_inode nodeid, const void *inarg)
 		send_reply_err(req, ENOSYS);
 }
 
+static void do_fsync(fuse_req_p req, fuse_inode nodeid, const void *inarg)
+{
+	struct fuse_fsync_in *arg = (struct fuse_fsync_in *)inarg;
+	struct fuse_file_info fi;
+	int datasync = arg->fsync_flags & FUSE_FSYNC_FDATASYNC;
+
+	memset(&fi, 0, sizeof(fi));
+	fi.fh = arg->fh;
+
+	ENTER_ONCE(req, out);
+	if (req->se->ops.fsync)
+		req->se->ops.fsync(req, nodeid, datasync, &fi);
+	else
+		send_reply_err(req, ENOSYS);
+	OUT
+}
+
+static void do_fsyncdir(fuse_req_p req, fuse_inode nodeid, const void *inarg)
+{
+	struct fuse_fsync_in *arg = (struct fuse_fsync_in *)inarg;
+	struct fuse_file_info fi;
+	int datasync = arg->fsync_flags & FUSE_FSYNC_FDATASYNC;
+
+	memset(&fi, 0, sizeof(fi));
+	fi.fh = arg->fh;
+
+	ENTER_ONCE(req, out);
+	if (req->se->ops.fsyncdir)
+		req->se->ops.fsyncdir(req, nodeid, datasync, &fi);
+	else
+		send_reply_err(req, ENOSYS);
+	OUT
+}
+
 static struct
 {
 	void (*func)(fuse_req_p, fuse_inode, const void *);
@@ -635,7 +939,7 @@ static struct
 	[FUSE_WRITE] = {do_write, "WRITE"},
 	[FUSE_STATFS] = {NULL, "STATFS"}, // No Implementation TEMP
 	[FUSE_RELEASE] = {do_release, "RELEASE"},
-	[FUSE_FSYNC] = {NULL, "FSYNC"},				// No Implementation TEMP
+	[FUSE_FSYNC] = {do_fsync, "FSYNC"},
 	[FUSE_SETXATTR] = {NULL, "SETXATTR"},		// No Implementation
 	[FUSE_GETXATTR] = {NULL, "GETXATTR"},		// No Implementation
 	[FUSE_LISTXATTR] = {NULL, "LISTXATTR"},		// No Implementation
@@ -645,7 +949,7 @@ static struct
 	[FUSE_OPENDIR] = {do_opendir, "OPENDIR"},
 	[FUSE_READDIR] = {do_readdir, "READDIR"},
 	[FUSE_RELEASEDIR] = {do_releasedir, "RELEASEDIR"},
-	[FUSE_FSYNCDIR] = {NULL, "FSYNCDIR"}, // No Implementation TEMP
+	[FUSE_FSYNCDIR] = {do_fsyncdir, "FSYNCDIR"},
 	[FUSE_GETLK] = {NULL, "GETLK"},		  // No Implementation TEMP
 	[FUSE_SETLK] = {NULL, "SETLK"},		  // No Implementation TEMP
 	[FUSE_SETLKW] = {NULL, "SETLKW"},	  // No Implementation TEMP
@@ -655,14 +959,14 @@ static struct
 	[FUSE_BMAP] = {NULL, "BMAP"},			// No Implementation
 	[FUSE_IOCTL] = {NULL, "IOCTL"},			// No Implementation
 	[FUSE_POLL] = {NULL, "POLL"},			// No Implementation
-	[FUSE_FALLOCATE] = {NULL, "FALLOCATE"}, // No Implementation
+	[FUSE_FALLOCATE] = {do_fallocate, "FALLOCATE"},
 	[FUSE_DESTROY] = {do_destroy, "DESTROY"},
-	[FUSE_NOTIFY_REPLY] = {NULL, "NOTIFY_REPLY"},		 // No Implementation TEMP
-	[FUSE_BATCH_FORGET] = {NULL, "BATCH_FORGET"},		 // No Implementation
-	[FUSE_READDIRPLUS] = {NULL, "READDIRPLUS"},			 // No Implementation
+	[FUSE_NOTIFY_REPLY] = {do_notify_reply, "NOTIFY_REPLY"},
+	[FUSE_BATCH_FORGET] = {do_batch_forget, "BATCH_FORGET"},
+	[FUSE_READDIRPLUS] = {do_readdirplus, "READDIRPLUS"},
 	[FUSE_RENAME2] = {NULL, "RENAME2"},					 // No Implementation
-	[FUSE_LSEEK] = {NULL, "LSEEK"},						 // No Implementation TEMP
-	[FUSE_COPY_FILE_RANGE] = {NULL, "COPY_FILE_RANGE"}}; // No Implementation
+	[FUSE_LSEEK] = {do_lseek, "LSEEK"},
+	[FUSE_COPY_FILE_RANGE] = {do_copy_file_range, "COPY_FILE_RANGE"}};
 
 #define FUSE_MAXOP (sizeof(fuse_ops) / sizeof(fuse_ops[0]))
 
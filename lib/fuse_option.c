@@ -17,6 +17,20 @@ static const struct fuse_opt fuse_cmd_helper_opts[] = {
     DEFINE_FUSE_OPT("--clonefd", struct fuse_cmd_opts, clonefd),
     DEFINE_FUSE_OPT("-t=%u", struct fuse_cmd_opts, threads),
     DEFINE_FUSE_OPT("--threads=%u", struct fuse_cmd_opts, threads),
+    DEFINE_FUSE_OPT("--max_threads=%u", struct fuse_cmd_opts, max_threads),
+    DEFINE_FUSE_OPT("--idle_timeout=%u", struct fuse_cmd_opts, idle_timeout),
+    DEFINE_FUSE_OPT("--cpus=%s", struct fuse_cmd_opts, cpus),
+    DEFINE_FUSE_OPT("--max_inflight=%u", struct fuse_cmd_opts, max_inflight),
+    DEFINE_FUSE_OPT("--io_uring", struct fuse_cmd_opts, io_uring),
+    DEFINE_FUSE_OPT("--io_uring_depth=%u", struct fuse_cmd_opts, io_uring_depth),
+    DEFINE_FUSE_OPT("--readers=%u", struct fuse_cmd_opts, readers),
+    DEFINE_FUSE_OPT("--qos=%s", struct fuse_cmd_opts, qos),
+    DEFINE_FUSE_OPT("--qos_weights=%s", struct fuse_cmd_opts, qos_weights),
+    DEFINE_FUSE_OPT("--qos_iops=%u", struct fuse_cmd_opts, qos_iops),
+    DEFINE_FUSE_OPT("--qos_bw=%u", struct fuse_cmd_opts, qos_bw),
+    DEFINE_FUSE_OPT("--qos_report=%u", struct fuse_cmd_opts, qos_report),
+    DEFINE_FUSE_OPT("--busy_poll=%u", struct fuse_cmd_opts, busy_poll),
+    DEFINE_FUSE_OPT("--poll_threads=%u", struct fuse_cmd_opts, poll_threads),
     FUSE_OPT_END
 };
 
@@ -58,6 +72,9 @@ static const struct fuse_opt fuse_conn_info_helper[] = {
     DEFINE_FUSE_OPT("--max_background=%u", struct fuse_conn_info ,max_background),
     DEFINE_FUSE_OPT("--congestion_threshold=%u", struct fuse_conn_info ,congestion_threshold),
 	DEFINE_FUSE_OPT("--time_gran=%u", struct fuse_conn_info ,time_gran),
+	DEFINE_FUSE_OPT("--splice_read", struct fuse_conn_info ,splice_read),
+	DEFINE_FUSE_OPT("--max_pages=%u", struct fuse_conn_info ,max_pages),
+	DEFINE_FUSE_OPT("--large_io", struct fuse_conn_info ,large_io),
 	FUSE_OPT_END
 };
 
@@ -296,6 +313,18 @@ void free_cmd_opts(struct fuse_cmd_opts *opts){
 		free(opts->mountpoint);
 		opts->mountpoint=NULL;
 	}
+	if(opts->cpus!=NULL){
+		free(opts->cpus);
+		opts->cpus=NULL;
+	}
+	if(opts->qos!=NULL){
+		free(opts->qos);
+		opts->qos=NULL;
+	}
+	if(opts->qos_weights!=NULL){
+		free(opts->qos_weights);
+		opts->qos_weights=NULL;
+	}
 }
 
 int parse_mnt_opts(struct fuse_args *args, struct fuse_mnt_opts *opts){
@@ -374,7 +403,21 @@ void fuse_cmd_help()
 		   "    [-f, --foreground]           foreground operation\n"
 		   "    [-m, --multithread]          enable multi-thread operation\n"
 		   "    [-c, --clonefd]              clone /dev/fuse for every thread under multithread mode\n"
-		   "    [-t, --threads=%%u]           number of worker threads in multi-thread mode (default=10)\n");
+		   "    [-t, --threads=%%u]           number of worker threads in multi-thread mode (default=10)\n"
+		   "    [--max_threads=%%u]           spawn threads on demand up to this number when all are busy (default=threads)\n"
+		   "    [--idle_timeout=%%u]          seconds before an idle on-demand thread exits, 0 to keep them (default=10)\n"
+		   "    [--cpus=%%s]                  one pinned thread with its own clonefd per cpu, e.g. 0-3,8 (overrides -t)\n"
+		   "    [--max_inflight=%%u]          enable async replies and stop reading requests while this many are in flight\n"
+		   "    [--io_uring]                 transfer requests through FUSE-over-io_uring with one queue per cpu when the kernel supports it\n"
+		   "    [--io_uring_depth=%%u]        number of requests per io_uring queue (default=8)\n"
+		   "    [--readers=%%u]               dispatch mode: this many threads read requests and queue them by class to -t workers\n"
+		   "    [--qos=%%s]                   dispatch mode: weighted fair queuing across tenants, one of uid, pid, cgroup\n"
+		   "    [--qos_weights=%%s]           per tenant name:weight[:iops[:MB/s]], comma separated, e.g. 0:4,1000:1:500\n"
+		   "    [--qos_iops=%%u]              default IOPS limit of each tenant, 0 for unlimited\n"
+		   "    [--qos_bw=%%u]                default READ/WRITE bandwidth limit of each tenant in MB/s, 0 for unlimited\n"
+		   "    [--qos_report=%%u]            seconds between per-tenant queueing delay reports, 0 to report at exit only\n"
+		   "    [--busy_poll=%%u]             resident threads spin up to this many microseconds on a non-blocking fd before sleeping\n"
+		   "    [--poll_threads=%%u]          number of resident threads that spin, 0 for all\n");
 }
 
 void fuse_mnt_help()
@@ -395,5 +438,8 @@ void fuse_conn_help(){
 		   "    [--max_readahead=%%u]         maximum readahead (default=4)\n"
 		   "    [--max_background=%%u]        maximum readahead (default=4)\n"
 		   "    [--congestion_threshold=%%u]  congestion threshold (default=3)\n"
-		   "    [--time_gran=%%u]             time granularity (ns) of the filesystem (default=1)\n");	
+		   "    [--time_gran=%%u]             time granularity (ns) of the filesystem (default=1)\n"
+		   "    [--splice_read]              receive requests with splice, WRITE data is passed to write_buf in a pipe\n"
+		   "    [--max_pages=%%u]             maximum pages per request, limited by /proc/sys/fs/fuse/max_pages_limit (default=256)\n"
+		   "    [--large_io]                 use the largest requests allowed by the kernel, receive buffers backed by hugepages\n");	
 }
\ No newline at end of file
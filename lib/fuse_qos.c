@@ -0,0 +1,532 @@
+#include <fuse_qos.h>
+#include <fuse_log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+// 虚拟时间的单位，一个开销为 1、权重为 1 的请求推进这么多
+#define FUSE_QOS_SCALE 65536
+// READ/WRITE 每搬运这么多字节额外计一个单位的开销
+#define FUSE_QOS_BYTES_PER_COST 65536
+
+uint64_t fuse_qos_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static struct fuse_qos_tenant *fuse_qos_tenant_new(struct fuse_qos *q, const char *name);
+
+static unsigned fuse_qos_hash(const char *name)
+{
+	unsigned h = 5381;
+
+	while (*name != '\0')
+		h = h * 33 + (unsigned char)*name++;
+	return h % 64;
+}
+
+// 解析一个 name:weight[:iops[:MB/s]] 形式的租户配置
+static int fuse_qos_parse_rule(const struct fuse_qos_config *config, const char *str, size_t len,
+							   struct fuse_qos_rule *rule)
+{
+	unsigned long values[3];
+	const char *colon = memchr(str, ':', len);
+	const char *p;
+	const char *end = str + len;
+	char *next;
+	int n = 0;
+
+	if (colon == NULL || colon == str || (size_t)(colon - str) >= FUSE_QOS_NAME_MAX)
+		return -1;
+	memcpy(rule->name, str, colon - str);
+	rule->name[colon - str] = '\0';
+	p = colon + 1;
+	while (p < end && n < 3)
+	{
+		values[n] = strtoul(p, &next, 10);
+		if (next == p || next > end)
+			return -1;
+		n++;
+		p = next;
+		if (p < end && *p != ':')
+			return -1;
+		if (p < end)
+			p++;
+	}
+	if (n == 0 || p < end || values[0] == 0)
+		return -1;
+	rule->weight = (unsigned)values[0];
+	rule->iops = n > 1 ? (unsigned)values[1] : config->iops;
+	rule->bandwidth = n > 2 ? (unsigned)values[2] : config->bandwidth;
+	return 0;
+}
+
+static int fuse_qos_parse_rules(struct fuse_qos *q, const char *str)
+{
+	const char *p = str;
+	const char *comma;
+	size_t len;
+	unsigned n = 1;
+
+	for (comma = str; *comma != '\0'; comma++)
+	{
+		if (*comma == ',')
+			n++;
+	}
+	q->rules = (struct fuse_qos_rule *)calloc(n, sizeof(struct fuse_qos_rule));
+	if (q->rules == NULL)
+	{
+		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: unable to allocate qos rules: %s\n", strerror(errno));
+		return -1;
+	}
+	while (*p != '\0')
+	{
+		comma = strchr(p, ',');
+		len = comma ? (size_t)(comma - p) : strlen(p);
+		if (fuse_qos_parse_rule(&q->config, p, len, &q->rules[q->nrules]) < 0)
+		{
+			fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: invalid qos weights `%s`\n", str);
+			return -1;
+		}
+		q->nrules++;
+		p += len;
+		if (*p == ',')
+			p++;
+	}
+	return 0;
+}
+
+struct fuse_qos *fuse_qos_new(const struct fuse_qos_config *config, unsigned capacity)
+{
+	struct fuse_qos *q;
+	unsigned i;
+
+	q = (struct fuse_qos *)calloc(1, sizeof(struct fuse_qos));
+	if (q == NULL)
+		goto err_nomem;
+	q->config = *config;
+	q->config.weights = NULL;
+	pthread_mutex_init(&q->cache_lock, NULL);
+	q->nodes = (struct fuse_qos_node *)calloc(capacity, sizeof(struct fuse_qos_node));
+	if (q->nodes == NULL)
+		goto err_free;
+	for (i = 0; i < capacity; i++)
+	{
+		q->nodes[i].next = q->free_nodes;
+		q->free_nodes = &q->nodes[i];
+	}
+	if (config->tenant == FUSE_QOS_CGROUP)
+	{
+		q->pid_cache = (struct fuse_qos_pid_entry *)calloc(FUSE_QOS_PID_CACHE, sizeof(struct fuse_qos_pid_entry));
+		if (q->pid_cache == NULL)
+			goto err_free;
+	}
+	if (config->weights != NULL && fuse_qos_parse_rules(q, config->weights) < 0)
+	{
+		fuse_qos_destroy(q);
+		return NULL;
+	}
+	// 共用的租户预先创建，之后创建租户失败时总有一个租户可用
+	q->other = fuse_qos_tenant_new(q, "other");
+	if (q->other == NULL)
+		goto err_free;
+	if (config->report)
+		q->next_report = fuse_qos_now() + (uint64_t)config->report * 1000000000ULL;
+	return q;
+
+err_free:
+	fuse_qos_destroy(q);
+err_nomem:
+	fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: unable to allocate qos scheduler: %s\n", strerror(errno));
+	return NULL;
+}
+
+// 读取进程所在的 cgroup，优先使用 cgroup v2 的路径
+static void fuse_qos_cgroup(uint32_t pid, char *name)
+{
+	char path[64];
+	char line[FUSE_QOS_NAME_MAX + 64];
+	FILE *fp;
+	char *p;
+
+	strcpy(name, "?");
+	snprintf(path, sizeof(path), "/proc/%u/cgroup", pid);
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return;
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		line[strcspn(line, "\n")] = '\0';
+		if (strncmp(line, "0::", 3) == 0)
+		{
+			p = line + 3;
+		}
+		else if ((p = strstr(line, ":name=systemd:")) != NULL)
+		{
+			p += strlen(":name=systemd:");
+		}
+		else
+			continue;
+		snprintf(name, FUSE_QOS_NAME_MAX, "%s", p);
+		if (line[0] == '0')
+			break;
+	}
+	fclose(fp);
+}
+
+void fuse_qos_key(struct fuse_qos *q, const struct fuse_in_header *in, char *name)
+{
+	struct fuse_qos_pid_entry *e;
+
+	switch (q->config.tenant)
+	{
+	case FUSE_QOS_PID:
+		snprintf(name, FUSE_QOS_NAME_MAX, "%u", in->pid);
+		return;
+	case FUSE_QOS_CGROUP:
+		e = &q->pid_cache[in->pid % FUSE_QOS_PID_CACHE];
+		pthread_mutex_lock(&q->cache_lock);
+		if (e->pid == in->pid && e->name[0] != '\0')
+		{
+			memcpy(name, e->name, FUSE_QOS_NAME_MAX);
+			pthread_mutex_unlock(&q->cache_lock);
+			return;
+		}
+		pthread_mutex_unlock(&q->cache_lock);
+		// 内核发起的请求（例如 FORGET）pid 为 0
+		if (in->pid == 0)
+			strcpy(name, "/");
+		else
+			fuse_qos_cgroup(in->pid, name);
+		pthread_mutex_lock(&q->cache_lock);
+		e->pid = in->pid;
+		memcpy(e->name, name, FUSE_QOS_NAME_MAX);
+		pthread_mutex_unlock(&q->cache_lock);
+		return;
+	default:
+		snprintf(name, FUSE_QOS_NAME_MAX, "%u", in->uid);
+		return;
+	}
+}
+
+static struct fuse_qos_tenant *fuse_qos_tenant_new(struct fuse_qos *q, const char *name)
+{
+	struct fuse_qos_tenant *t;
+	unsigned i;
+
+	t = (struct fuse_qos_tenant *)calloc(1, sizeof(struct fuse_qos_tenant));
+	if (t == NULL)
+		return NULL;
+	snprintf(t->name, sizeof(t->name), "%s", name);
+	t->weight = 1;
+	t->iops = q->config.iops;
+	t->bandwidth = q->config.bandwidth;
+	for (i = 0; i < q->nrules; i++)
+	{
+		if (strcmp(q->rules[i].name, name) == 0)
+		{
+			t->weight = q->rules[i].weight;
+			t->iops = q->rules[i].iops;
+			t->bandwidth = q->rules[i].bandwidth;
+			break;
+		}
+	}
+	t->bandwidth = t->bandwidth > 4095 ? UINT32_MAX : t->bandwidth << 20;
+	t->iops_tokens = t->iops;
+	t->byte_tokens = t->bandwidth;
+	t->refilled = fuse_qos_now();
+	return t;
+}
+
+// 查找或者创建租户，内存不足或者租户数量达到上限时使用共用的租户
+static struct fuse_qos_tenant *fuse_qos_tenant(struct fuse_qos *q, const char *name)
+{
+	unsigned h = fuse_qos_hash(name);
+	struct fuse_qos_tenant *t;
+
+	for (t = q->buckets[h]; t != NULL; t = t->hnext)
+	{
+		if (strcmp(t->name, name) == 0)
+			return t;
+	}
+	if (q->ntenants < FUSE_QOS_MAX_TENANTS)
+	{
+		t = fuse_qos_tenant_new(q, name);
+		if (t != NULL)
+		{
+			t->hnext = q->buckets[h];
+			q->buckets[h] = t;
+			q->ntenants++;
+			return t;
+		}
+	}
+	return q->other;
+}
+
+// READ/WRITE 搬运的数据量
+static uint32_t fuse_qos_bytes(const struct fuse_dispatch_item *item)
+{
+	const struct fuse_in_header *in = (const struct fuse_in_header *)item->buf.mem;
+
+	if (in->opcode == FUSE_READ && in->len >= sizeof(*in) + sizeof(struct fuse_read_in))
+		return ((const struct fuse_read_in *)(in + 1))->size;
+	if (in->opcode == FUSE_WRITE && in->len >= sizeof(*in) + sizeof(struct fuse_write_in))
+		return ((const struct fuse_write_in *)(in + 1))->size;
+	return 0;
+}
+
+int fuse_qos_enqueue(struct fuse_qos *q, const char *name, const struct fuse_dispatch_item *item,
+					 enum fuse_dispatch_class cls, uint64_t now)
+{
+	struct fuse_qos_tenant *t = fuse_qos_tenant(q, name);
+	struct fuse_qos_node *n = NULL;
+	uint64_t cost;
+
+	// 限速租户的请求可能因为令牌不足长时间排队，不能占用共享的节点，否则读取线程等待空位时其他租户也被阻塞；
+	// 这些请求的数量受内核同时发出的请求数限制，内存不足时才退回到共享的节点
+	if (t->iops || t->bandwidth)
+	{
+		n = (struct fuse_qos_node *)malloc(sizeof(struct fuse_qos_node));
+		if (n != NULL)
+			n->overflow = 1;
+	}
+	if (n == NULL)
+	{
+		n = q->free_nodes;
+		if (n == NULL)
+			return -1;
+		q->free_nodes = n->next;
+		n->overflow = 0;
+	}
+	n->next = NULL;
+	n->item = *item;
+	n->t = t;
+	n->enqueued = now;
+	n->bytes = fuse_qos_bytes(item);
+	n->throttled = 0;
+	cost = (1 + n->bytes / FUSE_QOS_BYTES_PER_COST) * FUSE_QOS_SCALE / t->weight;
+	n->start = q->vtime[cls] > t->finish[cls] ? q->vtime[cls] : t->finish[cls];
+	t->finish[cls] = n->start + cost;
+
+	if (t->tail[cls] != NULL)
+		t->tail[cls]->next = n;
+	else
+		t->head[cls] = n;
+	t->tail[cls] = n;
+	if (t->queued++ == 0)
+	{
+		t->anext = q->active;
+		q->active = t;
+	}
+	return 0;
+}
+
+// 补充令牌并检查请求是否可以处理，FORGET 类不受限制
+// @return 0 表示可以处理，否则为还需要等待的纳秒数
+static uint64_t fuse_qos_throttle(struct fuse_qos_tenant *t, struct fuse_qos_node *n,
+								  enum fuse_dispatch_class cls, uint64_t now)
+{
+	double elapsed;
+	double wait = 0;
+
+	if (cls == FUSE_CLASS_FORGET || (t->iops == 0 && t->bandwidth == 0))
+		return 0;
+	elapsed = (double)(now - t->refilled) / 1e9;
+	t->refilled = now;
+	if (t->iops)
+	{
+		t->iops_tokens += elapsed * t->iops;
+		if (t->iops_tokens > t->iops)
+			t->iops_tokens = t->iops;
+		if (t->iops_tokens < 1)
+			wait = (1 - t->iops_tokens) / t->iops;
+	}
+	// 带宽允许透支，桶里还有令牌就可以处理，超过桶容量的大请求也不会一直等待
+	if (t->bandwidth && n->bytes)
+	{
+		t->byte_tokens += elapsed * t->bandwidth;
+		if (t->byte_tokens > t->bandwidth)
+			t->byte_tokens = t->bandwidth;
+		if (t->byte_tokens < 0 && -t->byte_tokens / t->bandwidth > wait)
+			wait = -t->byte_tokens / t->bandwidth;
+	}
+	if (wait <= 0)
+		return 0;
+	n->throttled = 1;
+	return (uint64_t)(wait * 1e9) + 1;
+}
+
+// 把节点从租户的队列头部移除并归还
+static void fuse_qos_remove(struct fuse_qos *q, struct fuse_qos_tenant *t, enum fuse_dispatch_class cls,
+							struct fuse_dispatch_item *item)
+{
+	struct fuse_qos_node *n = t->head[cls];
+	struct fuse_qos_tenant **pp;
+
+	t->head[cls] = n->next;
+	if (t->head[cls] == NULL)
+		t->tail[cls] = NULL;
+	if (--t->queued == 0)
+	{
+		for (pp = &q->active; *pp != t; pp = &(*pp)->anext)
+			;
+		*pp = t->anext;
+	}
+	*item = n->item;
+	if (n->overflow)
+	{
+		free(n);
+		return;
+	}
+	n->next = q->free_nodes;
+	q->free_nodes = n;
+}
+
+int fuse_qos_dequeue(struct fuse_qos *q, int data, uint64_t now, struct fuse_dispatch_item *item,
+					 enum fuse_dispatch_class *cls, uint64_t *wait)
+{
+	struct fuse_qos_tenant *t;
+	struct fuse_qos_tenant *best;
+	struct fuse_qos_node *n;
+	uint64_t delay;
+	uint64_t w;
+	int c;
+
+	*wait = 0;
+	if (q->config.report && now >= q->next_report)
+	{
+		fuse_qos_report(q);
+		q->next_report = now + (uint64_t)q->config.report * 1000000000ULL;
+	}
+	for (c = 0; c < FUSE_CLASS_MAX; c++)
+	{
+		if (c == FUSE_CLASS_DATA && !data)
+			break;
+		best = NULL;
+		for (t = q->active; t != NULL; t = t->anext)
+		{
+			n = t->head[c];
+			if (n == NULL || (best != NULL && n->start >= best->head[c]->start))
+				continue;
+			w = fuse_qos_throttle(t, n, (enum fuse_dispatch_class)c, now);
+			if (w != 0)
+			{
+				if (*wait == 0 || w < *wait)
+					*wait = w;
+				continue;
+			}
+			best = t;
+		}
+		if (best == NULL)
+			continue;
+
+		n = best->head[c];
+		if (c != FUSE_CLASS_FORGET)
+		{
+			if (best->iops)
+				best->iops_tokens -= 1;
+			if (best->bandwidth)
+				best->byte_tokens -= n->bytes;
+		}
+		q->vtime[c] = n->start;
+		delay = now - n->enqueued;
+		best->requests++;
+		best->delay += delay;
+		best->interval_requests++;
+		best->interval_delay += delay;
+		if (delay > best->max_delay)
+			best->max_delay = delay;
+		if (delay > best->interval_max_delay)
+			best->interval_max_delay = delay;
+		if (n->throttled)
+			best->throttled++;
+		fuse_qos_remove(q, best, (enum fuse_dispatch_class)c, item);
+		*cls = (enum fuse_dispatch_class)c;
+		return 1;
+	}
+	return 0;
+}
+
+int fuse_qos_drain(struct fuse_qos *q, struct fuse_dispatch_item *item)
+{
+	int c;
+
+	if (q->active == NULL)
+		return 0;
+	for (c = 0; q->active->head[c] == NULL; c++)
+		;
+	fuse_qos_remove(q, q->active, (enum fuse_dispatch_class)c, item);
+	return 1;
+}
+
+static void fuse_qos_report_tenant(struct fuse_qos_tenant *t, uint64_t requests, uint64_t delay, uint64_t max_delay)
+{
+	fuse_log(FUSE_LOG_INFO,
+			 "[FUSE_LOG_INFO] fuse: qos tenant %s: weight %u, %llu requests, avg delay %llu us, max delay %llu us, "
+			 "%llu throttled\n",
+			 t->name, t->weight, (unsigned long long)requests,
+			 (unsigned long long)(requests ? delay / requests / 1000 : 0),
+			 (unsigned long long)(max_delay / 1000), (unsigned long long)t->throttled);
+}
+
+void fuse_qos_report(struct fuse_qos *q)
+{
+	struct fuse_qos_tenant *t;
+	unsigned i;
+
+	for (i = 0; i < 64; i++)
+	{
+		for (t = q->buckets[i]; t != NULL; t = t->hnext)
+		{
+			if (t->interval_requests == 0)
+				continue;
+			fuse_qos_report_tenant(t, t->interval_requests, t->interval_delay, t->interval_max_delay);
+			t->interval_requests = 0;
+			t->interval_delay = 0;
+			t->interval_max_delay = 0;
+		}
+	}
+	if (q->other != NULL && q->other->interval_requests)
+	{
+		t = q->other;
+		fuse_qos_report_tenant(t, t->interval_requests, t->interval_delay, t->interval_max_delay);
+		t->interval_requests = 0;
+		t->interval_delay = 0;
+		t->interval_max_delay = 0;
+	}
+}
+
+void fuse_qos_destroy(struct fuse_qos *q)
+{
+	struct fuse_qos_tenant *t;
+	struct fuse_qos_tenant *next;
+	unsigned i;
+
+	for (i = 0; i < 64; i++)
+	{
+		for (t = q->buckets[i]; t != NULL; t = next)
+		{
+			next = t->hnext;
+			if (t->requests)
+				fuse_qos_report_tenant(t, t->requests, t->delay, t->max_delay);
+			free(t);
+		}
+	}
+	if (q->other != NULL)
+	{
+		if (q->other->requests)
+			fuse_qos_report_tenant(q->other, q->other->requests, q->other->delay, q->other->max_delay);
+		free(q->other);
+	}
+	pthread_mutex_destroy(&q->cache_lock);
+	free(q->pid_cache);
+	free(q->rules);
+	free(q->nodes);
+	free(q);
+}
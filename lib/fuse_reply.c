@@ -1,4 +1,6 @@
 #include <fuse_reply.h>
+#include <fuse_uring.h>
+#include <fuse_async.h>
 
 static size_t iov_length(const struct iovec *iov, size_t count)
 {
@@ -11,15 +13,8 @@ static size_t iov_length(const struct iovec *iov, size_t count)
 }
 
 
-int fuse_send_iov_msg(struct fuse_session *se, int clonefd,
-							 struct iovec *iov, int count)
+static void fuse_debug_out_header(struct fuse_session *se, const struct fuse_out_header *out)
 {
-	struct fuse_out_header *out = iov[0].iov_base;
-	ssize_t res;
-	int err;
-
-	assert(se != NULL);
-	out->len = iov_length(iov, count);
 	if (se->debug)
 	{
 		if (out->unique == 0)
@@ -44,6 +39,18 @@ int fuse_send_iov_msg(struct fuse_session *se, int clonefd,
 					 (unsigned long long)out->unique, out->len);
 		}
 	}
+}
+
+int fuse_send_iov_msg(struct fuse_session *se, int clonefd,
+							 struct iovec *iov, int count)
+{
+	struct fuse_out_header *out = iov[0].iov_base;
+	ssize_t res;
+	int err;
+
+	assert(se != NULL);
+	out->len = iov_length(iov, count);
+	fuse_debug_out_header(se, out);
 
 restart:
 	res = writev(clonefd==-1 ? se->fd : clonefd, iov, count);
@@ -61,18 +68,32 @@ restart:
 
 		if (err == ENODEV)
 		{
-			se->exited = 1;
+			fuse_session_exit(se);
 			return 0;
 		}
 
-		fuse_log(FUSE_LOG_ERR,
-				 "[FUSE_LOG_ERR] fuse: writing device: %s\n", strerror(errno));
+		// 通知的对象不在内核缓存中时内核返回 ENOENT，属于正常情况
+		if (out->unique != 0 || err != ENOENT)
+			fuse_log(FUSE_LOG_ERR,
+					 "[FUSE_LOG_ERR] fuse: writing device: %s\n", strerror(err));
 		return -err;
 	}
 
 	return 0;
 }
 
+// 发送请求的回复：通过 io_uring 收到的请求写回所在的队列项，其他请求写入 /dev/fuse
+static int fuse_send_reply_iov(fuse_req_p req, struct iovec *iov, int count)
+{
+	struct fuse_out_header *out = iov[0].iov_base;
+
+	if (req->ring_ent == NULL)
+		return fuse_send_iov_msg(req->se, req->fd, iov, count);
+	out->len = iov_length(iov, count);
+	fuse_debug_out_header(req->se, out);
+	return fuse_uring_commit(req->ring_ent, iov, count);
+}
+
 int send_iov_reply(fuse_req_p req, int error,
 						  const void *arg, size_t argsize)
 {
@@ -90,20 +111,28 @@ int send_iov_reply(fuse_req_p req, int error,
 		iov[1].iov_len = argsize;
 		count++;
 	}
-	int res=fuse_send_iov_msg(req->se, req->fd, iov, count);
-	pthread_mutex_lock(&req->se->lock);
-	list_del_item(struct fuse_req,req);
-	pthread_mutex_unlock(&req->se->lock);
-	free(req);
+	int res=fuse_send_reply_iov(req, iov, count);
+	fuse_session_unregister(req);
+	fuse_free_req(req);
 	return res;
 }
 
 inline void send_reply_none(fuse_req_p req)
 {
-	pthread_mutex_lock(&req->se->lock);
-	list_del_item(struct fuse_req,req);
-	pthread_mutex_unlock(&req->se->lock);
-	free(req);
+	// 通过 io_uring 收到的请求（例如 NOTIFY_REPLY）没有回复也要提交所在的队列项，否则内核不会再使用这个队列项
+	if (req->ring_ent != NULL)
+	{
+		struct fuse_out_header out;
+		struct iovec iov;
+
+		out.unique = req->unique;
+		out.error = 0;
+		iov.iov_base = &out;
+		iov.iov_len = sizeof(out);
+		fuse_send_reply_iov(req, &iov, 1);
+	}
+	fuse_session_unregister(req);
+	fuse_free_req(req);
 }
 
 int send_reply_ok(fuse_req_p req, const void *arg, size_t argsize)
@@ -169,6 +198,66 @@ static void fill_entry(struct fuse_entry_out *arg,
 }
 
 
+size_t fuse_add_direntry(fuse_req_p req, char *buf, size_t bufsize,
+						 const char *name, const struct stat *stbuf, off_t off)
+{
+	(void)req;
+	size_t namelen;
+	size_t entlen;
+	size_t entlen_padded;
+	struct fuse_dirent *dirent;
+
+	namelen = strlen(name);
+	entlen = FUSE_NAME_OFFSET + namelen;
+	// 内存对齐，内存起始位置必须为 8 字节的整数倍，多余的补0
+	entlen_padded = FUSE_DIRENT_ALIGN(entlen);
+
+	if ((buf == NULL) || (entlen_padded > bufsize))
+		return 0;
+
+	dirent = (struct fuse_dirent *)buf;
+	dirent->ino = stbuf->st_ino;
+	dirent->off = off;
+	dirent->namelen = namelen;
+	dirent->type = (stbuf->st_mode & S_IFMT) >> 12;
+	memcpy(dirent->name, name, namelen);
+	memset(dirent->name + namelen, 0, entlen_padded - entlen);
+
+	return entlen_padded;
+}
+
+size_t fuse_add_direntry_plus(fuse_req_p req, char *buf, size_t bufsize,
+							  const char *name, const struct fuse_entry_param *e, off_t off)
+{
+	(void)req;
+	size_t namelen;
+	size_t entlen;
+	size_t entlen_padded;
+	struct fuse_direntplus *dp;
+
+	namelen = strlen(name);
+	entlen = FUSE_NAME_OFFSET_DIRENTPLUS + namelen;
+	entlen_padded = FUSE_DIRENT_ALIGN(entlen);
+
+	if ((buf == NULL) || (entlen_padded > bufsize))
+		return 0;
+
+	dp = (struct fuse_direntplus *)buf;
+	memset(&dp->entry_out, 0, sizeof(dp->entry_out));
+	// e->ino 为 0 表示不返回属性，内核只把它当作普通的目录项，不增加查找计数
+	if (e->ino)
+		fill_entry(&dp->entry_out, e);
+
+	dp->dirent.ino = e->attr.st_ino;
+	dp->dirent.off = off;
+	dp->dirent.namelen = namelen;
+	dp->dirent.type = (e->attr.st_mode & S_IFMT) >> 12;
+	memcpy(dp->dirent.name, name, namelen);
+	memset(dp->dirent.name + namelen, 0, entlen_padded - entlen);
+
+	return entlen_padded;
+}
+
 int send_reply_entry(fuse_req_p req, const struct fuse_entry_param *e)
 {
     struct fuse_entry_out arg;
@@ -185,11 +274,18 @@ int send_reply_entry(fuse_req_p req, const struct fuse_entry_param *e)
 	return send_reply_ok(req, &arg, size);
 }
 
-static void fill_open(struct fuse_open_out *arg,
+static void fill_open(fuse_req_p req, struct fuse_open_out *arg,
 					  const struct fuse_file_info *f)
 {
 	arg->fh = f->fh;
-	if (f->direct_io)
+	// 内核优先使用 FOPEN_DIRECT_IO，设置了后端文件时忽略 direct_io；
+	// 没有协商 passthrough 时内核不认识 backing_id，按普通打开回复
+	if (f->backing_id > 0 && req->se->conn.passthrough)
+	{
+		arg->open_flags |= FOPEN_PASSTHROUGH;
+		arg->backing_id = f->backing_id;
+	}
+	else if (f->direct_io)
 		arg->open_flags |= FOPEN_DIRECT_IO;
 	if (f->keep_cache)
 		arg->open_flags |= FOPEN_KEEP_CACHE;
@@ -203,7 +299,7 @@ int send_reply_open(fuse_req_p req, const struct fuse_file_info *f)
 {
 	struct fuse_open_out arg;
 	memset(&arg, 0, sizeof(arg));
-	fill_open(&arg, f);
+	fill_open(req, &arg, f);
 	return send_reply_ok(req, &arg, sizeof(arg));
 }
 
@@ -218,7 +314,7 @@ int send_reply_create(fuse_req_p req, const struct fuse_entry_param *e,
 
 	memset(buf, 0, sizeof(buf));
 	fill_entry(earg, e);
-	fill_open(oarg, f);
+	fill_open(req, oarg, f);
 	return send_reply_ok(req, buf,
 			     entrysize + sizeof(struct fuse_open_out));
 }
@@ -289,6 +385,40 @@ static ssize_t fuse_buf_src_fd(const struct fuse_buf *dst, size_t dst_off,
 	return copied;
 }
 
+// 两端都是文件描述符并且其中一端为管道时，直接在内核中移动数据
+static ssize_t fuse_buf_splice(const struct fuse_buf *dst, size_t dst_off,
+			       const struct fuse_buf *src, size_t src_off, size_t len)
+{
+	loff_t in_off = src->pos + src_off;
+	loff_t out_off = dst->pos + dst_off;
+	ssize_t res;
+	size_t copied = 0;
+
+	while (len) {
+		res = splice(src->fd, (src->flags & FUSE_BUF_FD_SEEK) ? &in_off : NULL,
+			     dst->fd, (dst->flags & FUSE_BUF_FD_SEEK) ? &out_off : NULL,
+			     len, SPLICE_F_MOVE);
+		if (res == -1) {
+			if (errno == EINTR)
+				continue;
+			if (!copied)
+				return -errno;
+			break;
+		}
+		if (res == 0)
+			break;
+
+		copied += res;
+		if (!(src->flags & FUSE_BUF_FD_RETRY) &&
+		    !(dst->flags & FUSE_BUF_FD_RETRY))
+			break;
+
+		len -= res;
+	}
+
+	return copied;
+}
+
 // 首先从 src 读取到 buf，再从 buf 读取到 dst
 static ssize_t fuse_buf_fd_to_fd(const struct fuse_buf *dst, size_t dst_off,
 				 const struct fuse_buf *src, size_t src_off, size_t len)
@@ -361,31 +491,497 @@ static ssize_t fuse_buf_copy_one(const struct fuse_buf *dst, size_t dst_off,
 	}else if(!dst_is_fd){
 		return fuse_buf_src_fd(dst,dst_off,src,src_off,len);
 	}else{
+		ssize_t res=fuse_buf_splice(dst,dst_off,src,src_off,len);
+		// 两端都不是管道时 splice 返回 EINVAL，退回到通过临时缓冲区拷贝
+		if(res!=-EINVAL)
+			return res;
 		return fuse_buf_fd_to_fd(dst,dst_off,src,src_off,len);
 	}
 }
 
-int send_reply_read(fuse_req_p req,const struct fuse_buf *buf)
+size_t fuse_buf_size(const struct fuse_bufvec *bufv)
 {
-	struct fuse_buf tmp = {
-		.size = buf->size,
-		.flags = 0,
-		.mem=NULL
-	};
-	tmp.mem=malloc(tmp.size);
-	if(tmp.mem==NULL)
-		send_reply_err(req,errno);
-	int res=fuse_buf_copy_one(&tmp,0,buf,0,tmp.size);
-	if (res<0)
-		res=send_reply_err(req,errno);
+	size_t i;
+	size_t size = 0;
+
+	for (i = 0; i < bufv->count; i++)
+		size += bufv->buf[i].size;
+	return size;
+}
+
+static const struct fuse_buf *fuse_bufvec_current(struct fuse_bufvec *bufv)
+{
+	if (bufv->idx < bufv->count)
+		return &bufv->buf[bufv->idx];
 	else
+		return NULL;
+}
+
+// 向后移动 len 字节，到达最后一个缓冲区的末尾时返回 0
+static int fuse_bufvec_advance(struct fuse_bufvec *bufv, size_t len)
+{
+	const struct fuse_buf *buf = fuse_bufvec_current(bufv);
+
+	if (buf == NULL)
+		return 0;
+	bufv->off += len;
+	assert(bufv->off <= buf->size);
+	if (bufv->off == buf->size) {
+		assert(bufv->idx < bufv->count);
+		bufv->idx++;
+		if (bufv->idx == bufv->count)
+			return 0;
+		bufv->off = 0;
+	}
+	return 1;
+}
+
+ssize_t fuse_buf_copy(struct fuse_bufvec *dstv, struct fuse_bufvec *srcv)
+{
+	size_t copied = 0;
+
+	if (dstv == srcv)
+		return fuse_buf_size(dstv);
+
+	for (;;) {
+		const struct fuse_buf *src = fuse_bufvec_current(srcv);
+		const struct fuse_buf *dst = fuse_bufvec_current(dstv);
+		size_t src_len;
+		size_t dst_len;
+		size_t len;
+		ssize_t res;
+
+		if (src == NULL || dst == NULL)
+			break;
+
+		src_len = src->size - srcv->off;
+		dst_len = dst->size - dstv->off;
+		len = src_len < dst_len ? src_len : dst_len;
+
+		res = fuse_buf_copy_one(dst, dstv->off, src, srcv->off, len);
+		if (res < 0) {
+			if (!copied)
+				return res;
+			break;
+		}
+		copied += res;
+
+		// 两端都需要移动，之后才能判断是否结束
+		if (!fuse_bufvec_advance(srcv, res) |
+		    !fuse_bufvec_advance(dstv, res))
+			break;
+
+		if ((size_t)res < len)
+			break;
+	}
+
+	return copied;
+}
+
+static pthread_key_t fuse_pipe_key;
+static pthread_once_t fuse_pipe_once = PTHREAD_ONCE_INIT;
+
+static void fuse_pipe_close(struct fuse_pipe *p)
+{
+	if (p->fd[0] != -1)
 	{
-		res=send_reply_ok(req,tmp.mem,res);
+		close(p->fd[0]);
+		close(p->fd[1]);
 	}
-	free(tmp.mem);
+	p->fd[0] = p->fd[1] = -1;
+	p->size = 0;
+}
+
+// 线程退出时关闭这个线程创建的所有管道
+static void fuse_pipe_destructor(void *data)
+{
+	struct fuse_pipe *pipes = (struct fuse_pipe *)data;
+	int i;
+
+	for (i = 0; i < FUSE_PIPE_MAX; i++)
+		fuse_pipe_close(&pipes[i]);
+	free(pipes);
+}
+
+static void fuse_pipe_key_init(void)
+{
+	pthread_key_create(&fuse_pipe_key, fuse_pipe_destructor);
+}
+
+struct fuse_pipe *fuse_pipe_get(enum fuse_pipe_type type, size_t size)
+{
+	struct fuse_pipe *pipes;
+	struct fuse_pipe *p;
+	int i;
+	int res;
+
+	pthread_once(&fuse_pipe_once, fuse_pipe_key_init);
+	pipes = (struct fuse_pipe *)pthread_getspecific(fuse_pipe_key);
+	if (pipes == NULL)
+	{
+		pipes = (struct fuse_pipe *)calloc(FUSE_PIPE_MAX, sizeof(struct fuse_pipe));
+		if (pipes == NULL)
+			return NULL;
+		for (i = 0; i < FUSE_PIPE_MAX; i++)
+			pipes[i].fd[0] = pipes[i].fd[1] = -1;
+		pthread_setspecific(fuse_pipe_key, pipes);
+	}
+
+	p = &pipes[type];
+	if (p->fd[0] == -1)
+	{
+		if (pipe2(p->fd, O_CLOEXEC | O_NONBLOCK) == -1)
+		{
+			p->fd[0] = p->fd[1] = -1;
+			return NULL;
+		}
+		p->size = fcntl(p->fd[0], F_GETPIPE_SZ);
+	}
+	if (p->size < size)
+	{
+		// 非特权进程受 /proc/sys/fs/pipe-max-size 的限制，失败时调用者退回到拷贝
+		res = fcntl(p->fd[0], F_SETPIPE_SZ, size);
+		if (res == -1)
+			return NULL;
+		p->size = res;
+	}
+	return p;
+}
+
+void fuse_pipe_reset(enum fuse_pipe_type type)
+{
+	struct fuse_pipe *pipes = (struct fuse_pipe *)pthread_getspecific(fuse_pipe_key);
+
+	if (pipes != NULL)
+		fuse_pipe_close(&pipes[type]);
+}
+
+// 管道中已经有完整的响应，将它 splice 到 /dev/fuse
+static int fuse_send_splice_msg(struct fuse_session *se, int clonefd,
+								struct fuse_pipe *p, const struct fuse_out_header *out)
+{
+	ssize_t res;
+	int err;
+
+	fuse_debug_out_header(se, out);
+restart:
+	res = splice(p->fd[0], NULL, clonefd == -1 ? se->fd : clonefd, NULL, out->len, SPLICE_F_MOVE);
+	err = errno;
+	if (res == -1 && err == EINTR)
+	{
+		goto restart;
+	}
+	// 没有完整发送时管道中可能残留数据，会话退出时也一样，直接重建管道，之后的响应不会带上残留的数据
+	if (res != (ssize_t)out->len)
+	{
+		fuse_pipe_reset(FUSE_PIPE_REPLY);
+	}
+	if (se->exited)
+	{
+		return 0;
+	}
+	if (res == -1)
+	{
+		if (err == ENODEV)
+		{
+			fuse_session_exit(se);
+			return 0;
+		}
+
+		fuse_log(FUSE_LOG_ERR,
+				 "[FUSE_LOG_ERR] fuse: splicing device: %s\n", strerror(err));
+		return -err;
+	}
+	if ((size_t)res != out->len)
+	{
+		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: short splice to device: %zd/%u\n",
+				 res, out->len);
+		return -EIO;
+	}
+	return 0;
+}
+
+// 从 bufv 当前位置开始的第 i 个缓冲区，off 为这个缓冲区内的起始偏移
+#define BUFV_SEG(bufv, i) (&(bufv)->buf[(bufv)->idx + (i)])
+#define BUFV_OFF(bufv, i) ((i) == 0 ? (bufv)->off : 0)
+
+// 所有数据都在内存中时，响应头部和各个缓冲区组成一个 iovec 数组，通过一次 writev 发送
+static int send_reply_data_iov(fuse_req_p req, struct fuse_bufvec *bufv, size_t nseg)
+{
+	struct iovec iov_stack[16];
+	struct iovec *iov = iov_stack;
+	struct fuse_out_header out;
+	size_t i;
+	int count = 1;
+	int res;
+
+	if (nseg + 1 > sizeof(iov_stack) / sizeof(iov_stack[0]))
+	{
+		iov = (struct iovec *)malloc((nseg + 1) * sizeof(struct iovec));
+		if (iov == NULL)
+			return send_reply_err(req, ENOMEM);
+	}
+	out.unique = req->unique;
+	out.error = 0;
+	iov[0].iov_base = &out;
+	iov[0].iov_len = sizeof(out);
+	for (i = 0; i < nseg; i++)
+	{
+		const struct fuse_buf *buf = BUFV_SEG(bufv, i);
+		size_t off = BUFV_OFF(bufv, i);
+
+		if (buf->size == off)
+			continue;
+		iov[count].iov_base = (char *)buf->mem + off;
+		iov[count].iov_len = buf->size - off;
+		count++;
+	}
+
+	res = fuse_send_reply_iov(req, iov, count);
+	if (iov != iov_stack)
+		free(iov);
+	fuse_session_unregister(req);
+	fuse_free_req(req);
 	return res;
 }
 
+// 将内存中的数据写入管道，vmsplice 只是引用用户页面，
+// 在 splice 到 /dev/fuse 返回之前这些内存都不会被修改
+static ssize_t fuse_pipe_vmsplice(struct fuse_pipe *p, const void *mem, size_t len)
+{
+	struct iovec iov;
+	ssize_t res;
+	size_t copied = 0;
+
+	while (copied < len)
+	{
+		iov.iov_base = (char *)mem + copied;
+		iov.iov_len = len - copied;
+		res = vmsplice(p->fd[1], &iov, 1, 0);
+		if (res == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			return copied ? (ssize_t)copied : -errno;
+		}
+		copied += res;
+	}
+	return copied;
+}
+
+// 通过管道发送响应：依次写入响应头部、内存中的数据以及从文件 splice 的数据，最后整体 splice 到 /dev/fuse，
+// 文件中的数据不经过用户空间。无法使用 splice 时返回 1，调用者退回到拷贝
+static int send_reply_data_splice(fuse_req_p req, struct fuse_bufvec *bufv, size_t nseg, size_t len)
+{
+	struct fuse_session *se = req->se;
+	struct fuse_out_header out;
+	struct fuse_pipe *p;
+	size_t pagesize = getpagesize();
+	size_t pages = 1;
+	size_t copied = 0;
+	size_t seglen;
+	size_t done;
+	size_t i;
+	loff_t pos;
+	ssize_t res;
+	char *mem;
+
+	if (!(se->conn.want & FUSE_SPLICE_WRITE) || len == 0)
+		return 1;
+	// 每个缓冲区都可能不按页对齐，另外头部还需要占用一个管道缓冲区
+	for (i = 0; i < nseg; i++)
+		pages += (BUFV_SEG(bufv, i)->size + pagesize - 1) / pagesize + 1;
+	p = fuse_pipe_get(FUSE_PIPE_REPLY, pages * pagesize);
+	if (p == NULL)
+		return 1;
+
+	out.unique = req->unique;
+	out.error = 0;
+	out.len = sizeof(out) + len;
+	if (write(p->fd[1], &out, sizeof(out)) != sizeof(out))
+	{
+		fuse_pipe_reset(FUSE_PIPE_REPLY);
+		return 1;
+	}
+
+	for (i = 0; i < nseg; i++)
+	{
+		const struct fuse_buf *buf = BUFV_SEG(bufv, i);
+		size_t off = BUFV_OFF(bufv, i);
+
+		seglen = buf->size - off;
+		if (!(buf->flags & FUSE_BUF_IS_FD))
+		{
+			res = fuse_pipe_vmsplice(p, (char *)buf->mem + off, seglen);
+			if (res != (ssize_t)seglen)
+			{
+				fuse_pipe_reset(FUSE_PIPE_REPLY);
+				return copied ? send_reply_err(req, EIO) : 1;
+			}
+			copied += seglen;
+			continue;
+		}
+
+		pos = buf->pos + off;
+		done = 0;
+		while (done < seglen)
+		{
+			res = splice(buf->fd, (buf->flags & FUSE_BUF_FD_SEEK) ? &pos : NULL, p->fd[1], NULL,
+						 seglen - done, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+			if (res == -1)
+			{
+				if (errno == EINTR)
+					continue;
+				// 文件不支持 splice，退回到拷贝
+				if (copied == 0 && done == 0 && (errno == EINVAL || errno == ENOSYS))
+				{
+					fuse_pipe_reset(FUSE_PIPE_REPLY);
+					return 1;
+				}
+				if (copied == 0 && done == 0 && errno != EAGAIN)
+				{
+					res = errno;
+					fuse_pipe_reset(FUSE_PIPE_REPLY);
+					return send_reply_err(req, res);
+				}
+				break;
+			}
+			if (res == 0)
+				break;
+			done += res;
+			if (!(buf->flags & FUSE_BUF_FD_RETRY) && !(buf->flags & FUSE_BUF_FD_SEEK))
+				break;
+		}
+		copied += done;
+		// 读到文件末尾，之后的缓冲区不再发送
+		if (done < seglen)
+			break;
+	}
+
+	if (copied < len)
+	{
+		// 头部中的长度已经写入管道，只能将管道中的数据读回后再发送
+		mem = (char *)malloc(sizeof(out) + copied);
+		if (mem == NULL)
+		{
+			fuse_pipe_reset(FUSE_PIPE_REPLY);
+			return send_reply_err(req, ENOMEM);
+		}
+		// 管道中的数据少于写入的长度时（提前读到 EOF）无法组成完整的响应
+		if (read(p->fd[0], mem, sizeof(out) + copied) != (ssize_t)(sizeof(out) + copied))
+		{
+			free(mem);
+			fuse_pipe_reset(FUSE_PIPE_REPLY);
+			return send_reply_err(req, EIO);
+		}
+		res = send_reply_ok(req, mem + sizeof(out), copied);
+		free(mem);
+		return res;
+	}
+
+	res = fuse_send_splice_msg(se, req->fd, p, &out);
+	fuse_session_unregister(req);
+	fuse_free_req(req);
+	return res;
+}
+
+// 无法使用 splice 时，将所有数据拷贝到一个临时缓冲区后发送
+static int send_reply_data_copy(fuse_req_p req, struct fuse_bufvec *bufv, size_t len)
+{
+	struct fuse_bufvec tmp = FUSE_BUFVEC_INIT(len);
+	size_t idx = bufv->idx;
+	size_t off = bufv->off;
+	ssize_t res;
+
+	tmp.buf[0].mem = malloc(len ? len : 1);
+	if (tmp.buf[0].mem == NULL)
+		return send_reply_err(req, ENOMEM);
+	// 与其他发送方式保持一致，不改变 bufv 的当前位置
+	res = fuse_buf_copy(&tmp, bufv);
+	bufv->idx = idx;
+	bufv->off = off;
+	if (res < 0)
+		res = send_reply_err(req, -res);
+	else
+		res = send_reply_ok(req, tmp.buf[0].mem, res);
+	free(tmp.buf[0].mem);
+	return res;
+}
+
+// 通过 io_uring 收到的请求不能使用 splice，数据直接拷贝到队列项的负载缓冲区，不再经过临时缓冲区
+static int send_reply_data_ring(fuse_req_p req, struct fuse_bufvec *bufv, size_t len)
+{
+	struct fuse_uring_ent *ent = req->ring_ent;
+	struct fuse_bufvec dst = FUSE_BUFVEC_INIT(len);
+	struct fuse_out_header out;
+	struct iovec iov[2];
+	size_t idx = bufv->idx;
+	size_t off = bufv->off;
+	ssize_t res;
+
+	if (len > ent->q->ring->payload_sz)
+		return send_reply_err(req, EIO);
+	dst.buf[0].mem = ent->payload;
+	res = fuse_buf_copy(&dst, bufv);
+	bufv->idx = idx;
+	bufv->off = off;
+	if (res < 0)
+		return send_reply_err(req, -res);
+
+	out.unique = req->unique;
+	out.error = 0;
+	iov[0].iov_base = &out;
+	iov[0].iov_len = sizeof(out);
+	iov[1].iov_base = ent->payload;
+	iov[1].iov_len = res;
+	res = fuse_send_reply_iov(req, iov, 2);
+	fuse_session_unregister(req);
+	fuse_free_req(req);
+	return res;
+}
+
+int send_reply_data(fuse_req_p req, struct fuse_bufvec *bufv)
+{
+	size_t nseg;
+	size_t len;
+	size_t i;
+	int has_fd = 0;
+	int res;
+
+	if (bufv->idx >= bufv->count)
+		return send_reply_ok(req, NULL, 0);
+	nseg = bufv->count - bufv->idx;
+	len = 0;
+	for (i = 0; i < nseg; i++)
+	{
+		len += BUFV_SEG(bufv, i)->size - BUFV_OFF(bufv, i);
+		if (BUFV_SEG(bufv, i)->flags & FUSE_BUF_IS_FD)
+			has_fd = 1;
+	}
+
+	if (!has_fd && nseg < IOV_MAX)
+		return send_reply_data_iov(req, bufv, nseg);
+	if (req->ring_ent != NULL)
+		return send_reply_data_ring(req, bufv, len);
+
+	res = send_reply_data_splice(req, bufv, nseg, len);
+	if (res != 1)
+		return res;
+	return send_reply_data_copy(req, bufv, len);
+}
+
+int send_reply_read(fuse_req_p req,const struct fuse_buf *buf)
+{
+	struct fuse_bufvec bufv = {
+		.count = 1,
+		.idx = 0,
+		.off = 0,
+	};
+
+	bufv.buf[0] = *buf;
+	return send_reply_data(req, &bufv);
+}
+
 int send_reply_write(fuse_req_p req, const struct fuse_buf *outbuf, const struct fuse_buf *inbuf)
 {
 	int res=fuse_buf_copy_one(outbuf,0,inbuf,0,outbuf->size);
@@ -400,6 +996,38 @@ int send_reply_write(fuse_req_p req, const struct fuse_buf *outbuf, const struct
 	}
 }
 
+int send_reply_write_buf(fuse_req_p req, struct fuse_bufvec *outbufv, struct fuse_bufvec *inbufv)
+{
+	ssize_t res=fuse_buf_copy(outbufv,inbufv);
+	if (res<0)
+		return send_reply_err(req,-res);
+	else
+	{
+		struct fuse_write_out arg;
+		memset(&arg, 0, sizeof(arg));
+		arg.size = res;
+		return send_reply_ok(req, &arg, sizeof(arg));
+	}
+}
+
+int send_reply_write_count(fuse_req_p req, size_t count)
+{
+	struct fuse_write_out arg;
+
+	memset(&arg, 0, sizeof(arg));
+	arg.size = count;
+	return send_reply_ok(req, &arg, sizeof(arg));
+}
+
+int send_reply_lseek(fuse_req_p req, off_t off)
+{
+	struct fuse_lseek_out arg;
+
+	memset(&arg, 0, sizeof(arg));
+	arg.offset = off;
+	return send_reply_ok(req, &arg, sizeof(arg));
+}
+
 int send_reply_attr(fuse_req_p req, const struct stat *stbuf,
 		    double attr_timeout)
 {
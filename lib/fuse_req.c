@@ -0,0 +1,331 @@
+#include <fuse_req.h>
+#include <fuse_session.h>
+#include <fuse_log.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// 当前线程的请求体缓存池，只有调用过 fuse_req_pool_init() 的线程才不为 NULL
+static __thread struct fuse_req_pool *local_pool = NULL;
+
+static void fuse_req_pool_release(struct fuse_req_pool *pool)
+{
+	struct fuse_req *req;
+	struct fuse_req *next;
+
+	// 最后一个引用释放时，其他线程已经不会再访问 remote_list
+	for (req = atomic_load(&pool->remote_list); req != NULL; req = next)
+	{
+		next = req->next;
+		free(req);
+	}
+	free(pool);
+}
+
+static void fuse_req_pool_put(struct fuse_req_pool *pool)
+{
+	if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
+		fuse_req_pool_release(pool);
+}
+
+int fuse_req_pool_init(void)
+{
+	struct fuse_req_pool *pool;
+
+	if (local_pool != NULL)
+		return 0;
+
+	pool = (struct fuse_req_pool *)calloc(1, sizeof(struct fuse_req_pool));
+	if (pool == NULL)
+	{
+		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: unable to allocate request pool: %s\n", strerror(errno));
+		return -1;
+	}
+	atomic_init(&pool->remote_list, NULL);
+	atomic_init(&pool->refcount, 1);
+	local_pool = pool;
+	return 0;
+}
+
+void fuse_req_pool_destroy(void)
+{
+	struct fuse_req_pool *pool = local_pool;
+	struct fuse_req *req;
+
+	if (pool == NULL)
+		return;
+	local_pool = NULL;
+
+	while ((req = pool->free_list) != NULL)
+	{
+		pool->free_list = req->next;
+		free(req);
+	}
+	pool->cached = 0;
+
+	// 仍有请求体未归还（如异步处理中的请求），缓存池由最后归还的线程释放
+	fuse_req_pool_put(pool);
+}
+
+fuse_req_p fuse_alloc_req(struct fuse_session *se)
+{
+	struct fuse_req_pool *pool = local_pool;
+	fuse_req_p req = NULL;
+
+	if (pool != NULL)
+	{
+		if (pool->free_list == NULL)
+		{
+			// 本地链表为空，取走其他线程归还的全部请求体
+			pool->free_list = atomic_exchange_explicit(&pool->remote_list, NULL,
+														memory_order_acquire);
+			pool->cached = 0;
+			for (req = pool->free_list; req != NULL; req = req->next)
+				pool->cached++;
+		}
+		req = pool->free_list;
+		if (req != NULL)
+		{
+			pool->free_list = req->next;
+			pool->cached--;
+			memset(req, 0, sizeof(struct fuse_req));
+		}
+	}
+
+	if (req == NULL)
+	{
+		req = (fuse_req_p)calloc(1, sizeof(struct fuse_req));
+		if (req == NULL)
+		{
+			fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: unable to allocate a new memory for new request\n");
+			return NULL;
+		}
+	}
+
+	if (pool != NULL)
+	{
+		atomic_fetch_add_explicit(&pool->refcount, 1, memory_order_relaxed);
+		req->pool = pool;
+	}
+	req->se = se;
+	req->fd = -1;
+	list_init_item(req);
+	return req;
+}
+
+void fuse_free_req(fuse_req_p req)
+{
+	struct fuse_req_pool *pool = req->pool;
+	struct fuse_req *head;
+
+	if (pool == NULL)
+	{
+		free(req);
+		return;
+	}
+
+	if (pool == local_pool)
+	{
+		if (pool->cached < FUSE_REQ_POOL_MAX)
+		{
+			req->next = pool->free_list;
+			pool->free_list = req;
+			pool->cached++;
+		}
+		else
+		{
+			free(req);
+		}
+	}
+	else
+	{
+		head = atomic_load_explicit(&pool->remote_list, memory_order_relaxed);
+		do
+		{
+			req->next = head;
+		} while (!atomic_compare_exchange_weak_explicit(&pool->remote_list, &head, req,
+														 memory_order_release,
+														 memory_order_relaxed));
+	}
+	fuse_req_pool_put(pool);
+}
+
+// 请求 ID 由内核顺序分配，乘以黄金分割常数后取高位，使相邻的请求 ID 分散到不同的分片和桶中
+static inline uint64_t fuse_req_hash(uint64_t unique)
+{
+	return unique * 0x9E3779B97F4A7C15ULL;
+}
+
+static inline struct fuse_req_shard *fuse_req_shard_of(struct fuse_req_table *table, uint64_t hash)
+{
+	return &table->shards[(hash >> 32) & (FUSE_REQ_TABLE_SHARDS - 1)];
+}
+
+static inline struct fuse_req **fuse_req_bucket_of(struct fuse_req_shard *shard, uint64_t hash)
+{
+	return &shard->buckets[(hash >> 48) & (FUSE_REQ_TABLE_BUCKETS - 1)];
+}
+
+// 以 interrupted_id 查找挂起的 int 请求，返回指向它的链接，没有找到时链接指向 NULL，调用者需要持有分片锁
+static struct fuse_req **fuse_req_int_find(struct fuse_req_shard *shard, uint64_t hash, uint64_t unique)
+{
+	struct fuse_req **pp = &shard->int_buckets[(hash >> 48) & (FUSE_REQ_TABLE_INT_BUCKETS - 1)];
+
+	while (*pp != NULL && (*pp)->interrupted_id != unique)
+		pp = &(*pp)->int_next;
+	return pp;
+}
+
+// 从分片中移除一个挂起的 int 请求，调用者需要持有分片锁
+static void fuse_req_int_del(struct fuse_req_shard *shard, fuse_req_p intr)
+{
+	struct fuse_req **pp;
+
+	pp = fuse_req_int_find(shard, fuse_req_hash(intr->interrupted_id), intr->interrupted_id);
+	while (*pp != intr)
+		pp = &(*pp)->int_next;
+	*pp = intr->int_next;
+	list_del_item(struct fuse_req, intr);
+}
+
+struct fuse_req_table *fuse_req_table_new(void)
+{
+	struct fuse_req_table *table;
+	int i;
+
+	table = (struct fuse_req_table *)aligned_alloc(64, sizeof(struct fuse_req_table));
+	if (table == NULL)
+	{
+		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: unable to allocate request table: %s\n", strerror(errno));
+		return NULL;
+	}
+	memset(table, 0, sizeof(struct fuse_req_table));
+	for (i = 0; i < FUSE_REQ_TABLE_SHARDS; i++)
+	{
+		pthread_mutex_init(&table->shards[i].lock, NULL);
+		FUSE_LIST_INIT(table->shards[i].int_list);
+	}
+	atomic_init(&table->inflight, 0);
+	return table;
+}
+
+void fuse_req_table_destroy(struct fuse_req_table *table)
+{
+	struct fuse_req_shard *shard;
+	fuse_req_p curr;
+	int i;
+
+	if (table == NULL)
+		return;
+	for (i = 0; i < FUSE_REQ_TABLE_SHARDS; i++)
+	{
+		shard = &table->shards[i];
+		while ((curr = shard->int_list.next) != &shard->int_list)
+		{
+			list_del_item(struct fuse_req, curr);
+			fuse_free_req(curr);
+		}
+		pthread_mutex_destroy(&shard->lock);
+	}
+	free(table);
+}
+
+fuse_req_p fuse_req_register(struct fuse_req_table *table, fuse_req_p req)
+{
+	uint64_t hash = fuse_req_hash(req->unique);
+	struct fuse_req_shard *shard = fuse_req_shard_of(table, hash);
+	struct fuse_req **bucket;
+	fuse_req_p curr;
+	fuse_req_p expired = NULL;
+
+	pthread_mutex_lock(&shard->lock);
+	// 寻找是否有对应的 int 请求
+	curr = *fuse_req_int_find(shard, hash, req->unique);
+	if (curr != NULL)
+	{
+		atomic_store(&req->interrupted, 1);
+		fuse_req_int_del(shard, curr);
+		pthread_mutex_unlock(&shard->lock);
+		fuse_free_req(curr);
+		return NULL;
+	}
+
+	bucket = fuse_req_bucket_of(shard, hash);
+	req->next = *bucket;
+	*bucket = req;
+	req->registered = 1;
+
+	// 如果没有找到对应的 int 请求，取出本分片中最早挂起的一个
+	curr = shard->int_list.next;
+	if (curr != &shard->int_list)
+	{
+		fuse_req_int_del(shard, curr);
+		list_init_item(curr);
+		expired = curr;
+	}
+	pthread_mutex_unlock(&shard->lock);
+	atomic_fetch_add_explicit(&table->inflight, 1, memory_order_relaxed);
+	return expired;
+}
+
+size_t fuse_req_unregister(fuse_req_p req)
+{
+	struct fuse_req_table *table;
+	struct fuse_req_shard *shard;
+	struct fuse_req **pp;
+	uint64_t hash;
+
+	if (!req->registered)
+		return 0;
+	table = req->se->reqs;
+	hash = fuse_req_hash(req->unique);
+	shard = fuse_req_shard_of(table, hash);
+
+	pthread_mutex_lock(&shard->lock);
+	for (pp = fuse_req_bucket_of(shard, hash); *pp != NULL; pp = &(*pp)->next)
+	{
+		if (*pp == req)
+		{
+			*pp = req->next;
+			break;
+		}
+	}
+	req->registered = 0;
+	pthread_mutex_unlock(&shard->lock);
+	return atomic_fetch_sub_explicit(&table->inflight, 1, memory_order_relaxed);
+}
+
+int fuse_req_interrupt(struct fuse_req_table *table, fuse_req_p intr)
+{
+	uint64_t hash = fuse_req_hash(intr->interrupted_id);
+	struct fuse_req_shard *shard = fuse_req_shard_of(table, hash);
+	struct fuse_req **pp;
+	fuse_req_p curr;
+
+	pthread_mutex_lock(&shard->lock);
+	for (curr = *fuse_req_bucket_of(shard, hash); curr != NULL; curr = curr->next)
+	{
+		if (curr->unique == intr->interrupted_id)
+		{
+			// 持有分片锁期间请求不会被回复和释放；
+			// 如果请求尚未开始处理，处理线程的 ENTER_ONCE 会失败并回复 EINTR
+			atomic_store(&curr->interrupted, 1);
+			atomic_flag_test_and_set(&curr->used);
+			pthread_mutex_unlock(&shard->lock);
+			return 1;
+		}
+	}
+	// 同一个请求已经有挂起的 int 请求
+	pp = fuse_req_int_find(shard, hash, intr->interrupted_id);
+	if (*pp != NULL)
+	{
+		pthread_mutex_unlock(&shard->lock);
+		return 1;
+	}
+	intr->int_next = NULL;
+	*pp = intr;
+	list_add_item(intr, shard->int_list);
+	pthread_mutex_unlock(&shard->lock);
+	return 0;
+}
@@ -1,4 +1,49 @@
 #include <fuse_session.h>
+#include <fuse_async.h>
+#include <fuse_bufpool.h>
+#include <fuse_notify.h>
+#include <fuse_kernel.h>
+
+#include <stddef.h>
+#include <sys/ioctl.h>
+
+// 读取内核允许的每个请求的最大页数，旧内核没有这个参数时为 FUSE_MAX_MAX_PAGES
+static unsigned fuse_max_pages_limit(void)
+{
+	unsigned limit = FUSE_MAX_MAX_PAGES;
+	FILE *fp = fopen("/proc/sys/fs/fuse/max_pages_limit", "r");
+
+	if (fp != NULL)
+	{
+		if (fscanf(fp, "%u", &limit) != 1 || limit == 0)
+			limit = FUSE_MAX_MAX_PAGES;
+		fclose(fp);
+	}
+	return limit;
+}
+
+// 确定每个请求最多携带的页数以及接收缓冲区的大小
+static void fuse_session_size(struct fuse_session *se, struct fuse_conn_info *conn)
+{
+	unsigned limit = fuse_max_pages_limit();
+	unsigned pages = conn->max_pages;
+
+	if (conn->large_io)
+		pages = limit;
+	else if (pages == 0)
+		pages = FUSE_MAX_MAX_PAGES;
+	if (pages > limit)
+	{
+		fuse_log(FUSE_LOG_WARNING, "[FUSE_LOG_WARNING] fuse: max_pages %u exceeds the kernel limit, using %u\n",
+				 pages, limit);
+		pages = limit;
+	}
+	conn->max_pages = pages;
+	se->bufsize = (size_t)pages * getpagesize() + FUSE_BUFFER_HEADER_SIZE;
+	// 预读的大小同样放大到一个请求，内核会再按 INIT 中的 max_readahead 限制
+	if (conn->large_io && conn->max_readahead == DEFAULT_MAX_READAHEAD)
+		conn->max_readahead = pages * getpagesize();
+}
 
 struct fuse_session *fuse_session_new(struct fuse_args *args, const struct fuse_ops *ops, int debug, void* userdata)
 {
@@ -56,14 +101,15 @@ struct fuse_session *fuse_session_new(struct fuse_args *args, const struct fuse_
 		fuse_log(FUSE_LOG_WARNING, "%s`\n", args->argv[i]);
 	}
 	
-	se->bufsize = FUSE_MAX_MAX_PAGES * getpagesize() +
-		FUSE_BUFFER_HEADER_SIZE;
+	fuse_session_size(se, &conn);
 
-	FUSE_LIST_INIT(se->req_list);
-	FUSE_LIST_INIT(se->int_list);
-	//FUSE_LIST_INIT(se->notify_list);
-	//se->notify_ctr = 1;
-	pthread_mutex_init(&se->lock, NULL);
+	se->reqs = fuse_req_table_new();
+	if (se->reqs == NULL)
+		goto err_out;
+	sem_init(&se->exit_sem, 0, 0);
+	pthread_mutex_init(&se->notify_lock, NULL);
+	FUSE_LIST_INIT(se->notify_list);
+	se->notify_ctr = 1;
 
 	memcpy(&se->ops, ops, sizeof(struct fuse_ops));
 	se->owner = getuid();
@@ -80,6 +126,18 @@ err_out:
 void fuse_session_reset(struct fuse_session *se){
 	se->exited=0;
 	se->error=0;
+	while (sem_trywait(&se->exit_sem) == 0)
+		;
+}
+
+void fuse_session_exit(struct fuse_session *se){
+	se->exited=1;
+	sem_post(&se->exit_sem);
+}
+
+struct fuse_session *fuse_conn_session(struct fuse_conn_info *conn)
+{
+	return (struct fuse_session *)((char *)conn - offsetof(struct fuse_session, conn));
 }
 
 void fuse_session_destroy(struct fuse_session *se){
@@ -88,11 +146,16 @@ void fuse_session_destroy(struct fuse_session *se){
 		if(se->ops.destroy)
 			se->ops.destroy(se->userdata);
 	}
-	pthread_mutex_destroy(&se->lock);
+	fuse_cq_destroy(se);
+	fuse_bufpool_destroy(se);
+	fuse_notify_destroy(se);
+	fuse_req_table_destroy(se->reqs);
+	se->reqs = NULL;
+	sem_destroy(&se->exit_sem);
 	if (se->clonefds!=NULL)
 	{
 		int *clonefd = se->clonefds;
-		while (clonefd != NULL)
+		while (*clonefd != -1)
 		{
 			close(*clonefd);
 			clonefd++;
@@ -109,4 +172,34 @@ void fuse_session_destroy(struct fuse_session *se){
 	}
 	free_mnt_opts(&se->mo);
 	free(se);
-}
\ No newline at end of file
+}
+
+int fuse_passthrough_open(struct fuse_session *se, int fd)
+{
+	struct fuse_backing_map map = {.fd = fd};
+	int res;
+
+	res = ioctl(se->fd, FUSE_DEV_IOC_BACKING_OPEN, &map);
+	if (res <= 0)
+	{
+		res = res == 0 ? -EIO : -errno;
+		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: failed to open backing file: %s\n", strerror(-res));
+		return res;
+	}
+	return res;
+}
+
+int fuse_passthrough_close(struct fuse_session *se, int backing_id)
+{
+	uint32_t id = backing_id;
+	int res;
+
+	if (ioctl(se->fd, FUSE_DEV_IOC_BACKING_CLOSE, &id) == -1)
+	{
+		res = -errno;
+		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: failed to close backing id %d: %s\n",
+				 backing_id, strerror(-res));
+		return res;
+	}
+	return 0;
+}
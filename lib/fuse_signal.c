@@ -15,13 +15,13 @@ static void exit_handler(int sig)
 {
 	if (fuse_instance)
 	{
-		fuse_instance->exited = 1;
 		if (sig <= 0)
 		{
 			fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] assertion error: signal value <= 0\n");
 			abort();
 		}
 		fuse_instance->error = sig;
+		fuse_session_exit(fuse_instance);
 	}
 }
 
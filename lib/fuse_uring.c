@@ -0,0 +1,569 @@
+#include <fuse_uring.h>
+#include <fuse_log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/sysinfo.h>
+
+// 当前线程所服务的队列，在队列线程中回复时延迟提交
+static __thread struct fuse_uring_queue *fuse_uring_self;
+
+static int fuse_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+// 内核为每个可能存在的 CPU 创建一个队列，而不只是在线的 CPU
+static unsigned fuse_uring_nr_queues(void)
+{
+	FILE *fp;
+	char line[256];
+	char *p;
+	long cpu;
+	long last = -1;
+
+	fp = fopen("/sys/devices/system/cpu/possible", "r");
+	if (fp != NULL)
+	{
+		if (fgets(line, sizeof(line), fp) != NULL)
+		{
+			// 格式如 0-3,8,10-11，只需要最大的编号
+			for (p = line; *p != '\0' && *p != '\n';)
+			{
+				cpu = strtol(p, &p, 10);
+				if (cpu > last)
+					last = cpu;
+				if (*p == '-' || *p == ',')
+					p++;
+				else
+					break;
+			}
+		}
+		fclose(fp);
+	}
+	if (last < 0)
+		return (unsigned)get_nprocs_conf();
+	return (unsigned)last + 1;
+}
+
+// 第 idx 个 sqe，开启 IORING_SETUP_SQE128 后每个 sqe 占用 128 字节
+static struct io_uring_sqe *fuse_uring_sqe_at(struct fuse_uring_queue *q, unsigned idx)
+{
+	return (struct io_uring_sqe *)((char *)q->sqes + ((size_t)idx << 7));
+}
+
+// 已经放入 sq 但是内核尚未取走的 sqe 数量：没有使用 SQPOLL，sq_head 只在 io_uring_enter 提交时前进，
+// 由 sq 本身计数，队列线程在锁外提交时不需要再回头扣除
+static unsigned fuse_uring_unsubmitted(struct fuse_uring_queue *q)
+{
+	return __atomic_load_n(q->sq_tail, __ATOMIC_ACQUIRE) - __atomic_load_n(q->sq_head, __ATOMIC_ACQUIRE);
+}
+
+// 提交所有已经填写的 sqe，调用者需要持有 q->lock
+static void fuse_uring_submit_locked(struct fuse_uring_queue *q)
+{
+	unsigned n;
+	int res;
+
+	while ((n = fuse_uring_unsubmitted(q)) > 0)
+	{
+		res = fuse_uring_enter(q->fd, n, 0, 0);
+		if (res < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: io_uring_enter on queue %u: %s\n",
+					 q->qid, strerror(errno));
+			break;
+		}
+	}
+}
+
+// 取得一个空闲的 sqe 并清零，调用者需要持有 q->lock；sq 已满时先提交，仍然没有空闲时返回 NULL
+static struct io_uring_sqe *fuse_uring_get_sqe(struct fuse_uring_queue *q)
+{
+	unsigned tail = *q->sq_tail;
+	unsigned head = __atomic_load_n(q->sq_head, __ATOMIC_ACQUIRE);
+	struct io_uring_sqe *sqe;
+
+	if (tail - head >= q->entries)
+	{
+		fuse_uring_submit_locked(q);
+		head = __atomic_load_n(q->sq_head, __ATOMIC_ACQUIRE);
+		if (tail - head >= q->entries)
+			return NULL;
+	}
+	sqe = fuse_uring_sqe_at(q, tail & *q->sq_mask);
+	memset(sqe, 0, 2 * sizeof(struct io_uring_sqe));
+	return sqe;
+}
+
+// 将填写好的 sqe 放入 sq，调用者需要持有 q->lock
+static void fuse_uring_queue_sqe(struct fuse_uring_queue *q, struct io_uring_sqe *sqe, void *data)
+{
+	unsigned tail = *q->sq_tail;
+
+	sqe->user_data = (uint64_t)(uintptr_t)data;
+	q->sq_array[tail & *q->sq_mask] = tail & *q->sq_mask;
+	__atomic_store_n(q->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+// 填写一个发往 /dev/fuse 的命令，调用者需要持有 q->lock
+static int fuse_uring_queue_cmd(struct fuse_uring_queue *q, struct fuse_uring_ent *ent, uint32_t cmd_op)
+{
+	struct io_uring_sqe *sqe;
+	struct fuse_uring_cmd_req *cmd;
+
+	sqe = fuse_uring_get_sqe(q);
+	if (sqe == NULL)
+		return -EBUSY;
+	sqe->opcode = IORING_OP_URING_CMD;
+	sqe->fd = q->ring->se->fd;
+	sqe->cmd_op = cmd_op;
+	if (cmd_op == FUSE_IO_URING_CMD_REGISTER)
+	{
+		sqe->addr = (uint64_t)(uintptr_t)ent->iov;
+		sqe->len = 2;
+	}
+	cmd = (struct fuse_uring_cmd_req *)sqe->cmd;
+	cmd->commit_id = ent->commit_id;
+	cmd->qid = q->qid;
+	fuse_uring_queue_sqe(q, sqe, ent);
+	return 0;
+}
+
+static int fuse_uring_queue_setup(struct fuse_uring_queue *q)
+{
+	struct io_uring_params p;
+
+	memset(&p, 0, sizeof(p));
+	// 每个队列项同一时间最多有一个命令在内核中，另外预留退出通知的位置
+	p.flags = IORING_SETUP_SQE128;
+	q->fd = (int)syscall(__NR_io_uring_setup, 2 * q->ring->depth, &p);
+	if (q->fd < 0)
+		return -errno;
+	q->entries = p.sq_entries;
+
+	q->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	q->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (q->cq_len > q->sq_len)
+			q->sq_len = q->cq_len;
+		q->cq_len = q->sq_len;
+	}
+	q->sq_ptr = mmap(NULL, q->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+					 q->fd, IORING_OFF_SQ_RING);
+	if (q->sq_ptr == MAP_FAILED)
+		goto err_out;
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		q->cq_ptr = q->sq_ptr;
+	}
+	else
+	{
+		q->cq_ptr = mmap(NULL, q->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+						 q->fd, IORING_OFF_CQ_RING);
+		if (q->cq_ptr == MAP_FAILED)
+			goto err_out;
+	}
+	q->sqes_len = 2 * p.sq_entries * sizeof(struct io_uring_sqe);
+	q->sqes = mmap(NULL, q->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+				   q->fd, IORING_OFF_SQES);
+	if (q->sqes == MAP_FAILED)
+		goto err_out;
+
+	q->sq_head = (unsigned *)((char *)q->sq_ptr + p.sq_off.head);
+	q->sq_tail = (unsigned *)((char *)q->sq_ptr + p.sq_off.tail);
+	q->sq_mask = (unsigned *)((char *)q->sq_ptr + p.sq_off.ring_mask);
+	q->sq_array = (unsigned *)((char *)q->sq_ptr + p.sq_off.array);
+	q->cq_head = (unsigned *)((char *)q->cq_ptr + p.cq_off.head);
+	q->cq_tail = (unsigned *)((char *)q->cq_ptr + p.cq_off.tail);
+	q->cq_mask = (unsigned *)((char *)q->cq_ptr + p.cq_off.ring_mask);
+	q->cqes = (struct io_uring_cqe *)((char *)q->cq_ptr + p.cq_off.cqes);
+	return 0;
+
+err_out:
+	// 已经映射的部分由 fuse_uring_queue_free() 释放
+	return -errno;
+}
+
+static void fuse_uring_queue_free(struct fuse_uring_queue *q)
+{
+	if (q->sqes != NULL && q->sqes != MAP_FAILED)
+		munmap(q->sqes, q->sqes_len);
+	if (q->cq_ptr != NULL && q->cq_ptr != MAP_FAILED && q->cq_ptr != q->sq_ptr)
+		munmap(q->cq_ptr, q->cq_len);
+	if (q->sq_ptr != NULL && q->sq_ptr != MAP_FAILED)
+		munmap(q->sq_ptr, q->sq_len);
+	if (q->fd >= 0)
+		close(q->fd);
+	if (q->buf != NULL)
+		munmap(q->buf, q->buf_len);
+	free(q->ents);
+	pthread_mutex_destroy(&q->lock);
+}
+
+// 分配队列缓冲区并划分为队列项，在绑定 CPU 之后调用
+static int fuse_uring_queue_alloc(struct fuse_uring_queue *q)
+{
+	struct fuse_uring *ring = q->ring;
+	size_t pagesize = getpagesize();
+	size_t payload_sz = (ring->payload_sz + pagesize - 1) / pagesize * pagesize;
+	size_t stride = FUSE_BUFFER_HEADER_SIZE + payload_sz;
+	unsigned i;
+
+	q->ents = (struct fuse_uring_ent *)calloc(ring->depth, sizeof(struct fuse_uring_ent));
+	if (q->ents == NULL)
+		return -ENOMEM;
+	q->buf_len = ring->depth * stride;
+	q->buf = mmap(NULL, q->buf_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (q->buf == MAP_FAILED)
+	{
+		q->buf = NULL;
+		return -ENOMEM;
+	}
+	// 首次访问决定物理页所在的 NUMA 节点
+	memset(q->buf, 0, q->buf_len);
+
+	for (i = 0; i < ring->depth; i++)
+	{
+		struct fuse_uring_ent *ent = &q->ents[i];
+
+		ent->q = q;
+		ent->hdr = (struct fuse_uring_req_header *)(q->buf + i * stride);
+		ent->payload = q->buf + i * stride + FUSE_BUFFER_HEADER_SIZE;
+		ent->iov[0].iov_base = ent->hdr;
+		ent->iov[0].iov_len = sizeof(struct fuse_uring_req_header);
+		ent->iov[1].iov_base = ent->payload;
+		ent->iov[1].iov_len = payload_sz;
+	}
+	return 0;
+}
+
+// 注册队列中的所有队列项，注册失败的命令会立即完成并带回错误
+static int fuse_uring_queue_register(struct fuse_uring_queue *q)
+{
+	struct io_uring_cqe *cqe;
+	unsigned head;
+	unsigned tail;
+	unsigned i;
+	int res = 0;
+
+	pthread_mutex_lock(&q->lock);
+	for (i = 0; i < q->ring->depth && res == 0; i++)
+		res = fuse_uring_queue_cmd(q, &q->ents[i], FUSE_IO_URING_CMD_REGISTER);
+	fuse_uring_submit_locked(q);
+	pthread_mutex_unlock(&q->lock);
+	if (res < 0)
+		return res;
+
+	// 只检查不取走，注册成功后到达的请求留给队列线程处理
+	head = *q->cq_head;
+	tail = __atomic_load_n(q->cq_tail, __ATOMIC_ACQUIRE);
+	for (; head != tail; head++)
+	{
+		cqe = &q->cqes[head & *q->cq_mask];
+		if (cqe->res < 0)
+			return cqe->res;
+	}
+	return 0;
+}
+
+// 将请求头部和操作头部拷贝到负载缓冲区之前，拼成连续的请求后交给会话处理
+static void fuse_uring_handle(struct fuse_uring_queue *q, struct fuse_uring_ent *ent)
+{
+	struct fuse_uring *ring = q->ring;
+	struct fuse_in_header *in = (struct fuse_in_header *)ent->hdr->in_out;
+	size_t payload_sz = ent->hdr->ring_ent_in_out.payload_sz;
+	size_t headlen;
+	struct fuse_buf buf;
+
+	ent->commit_id = ent->hdr->ring_ent_in_out.commit_id;
+	if (payload_sz > ring->payload_sz || in->len < sizeof(struct fuse_in_header) + payload_sz ||
+		in->len - payload_sz > sizeof(struct fuse_in_header) + FUSE_URING_OP_IN_OUT_SZ)
+	{
+		struct fuse_out_header out = {
+			.unique = in->unique,
+			.error = -EIO,
+			.len = sizeof(struct fuse_out_header),
+		};
+		struct iovec iov = {
+			.iov_base = &out,
+			.iov_len = sizeof(struct fuse_out_header),
+		};
+
+		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: malformed io_uring request: len=%u payload=%zu\n",
+				 in->len, payload_sz);
+		fuse_uring_commit(ent, &iov, 1);
+		return;
+	}
+
+	headlen = in->len - payload_sz;
+	memset(&buf, 0, sizeof(buf));
+	buf.mem = ent->payload - headlen;
+	buf.size = in->len;
+	buf.fd = -1;
+	memcpy(buf.mem, in, sizeof(struct fuse_in_header));
+	memcpy((char *)buf.mem + sizeof(struct fuse_in_header), ent->hdr->op_in,
+		   headlen - sizeof(struct fuse_in_header));
+	ring->process(ring->se, &buf, ent);
+}
+
+static void *fuse_uring_worker(void *data)
+{
+	struct fuse_uring_queue *q = (struct fuse_uring_queue *)data;
+	struct fuse_uring *ring = q->ring;
+	struct fuse_session *se = ring->se;
+	struct io_uring_cqe *cqe;
+	struct fuse_uring_ent *ent;
+	cpu_set_t set;
+	unsigned to_submit;
+	unsigned head;
+	unsigned tail;
+	int stop = 0;
+	int res;
+
+	// 绑定到队列对应的 CPU，不在进程允许范围内的 CPU（例如离线的 CPU）不绑定
+	if (sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_ISSET(q->qid, &set))
+	{
+		CPU_ZERO(&set);
+		CPU_SET(q->qid, &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	}
+	fuse_uring_self = q;
+
+	res = fuse_uring_queue_setup(q);
+	if (res == 0)
+		res = fuse_uring_queue_alloc(q);
+	if (res == 0)
+		res = fuse_uring_queue_register(q);
+	if (res < 0)
+	{
+		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: failed to set up io_uring queue %u: %s\n",
+				 q->qid, strerror(-res));
+		atomic_store(&ring->failed, 1);
+		sem_post(&ring->ready);
+		return NULL;
+	}
+	sem_post(&ring->ready);
+
+	while (!stop)
+	{
+		// 回复产生的 commit 与等待下一批请求合并为一次系统调用；其他线程可能同时在锁内提交，
+		// 内核只取走 sq 中实际存在的 sqe，取到的比 to_submit 少时不等待，立即返回
+		to_submit = fuse_uring_unsubmitted(q);
+		if (se->ops.batch_end && *q->cq_head == __atomic_load_n(q->cq_tail, __ATOMIC_ACQUIRE))
+			se->ops.batch_end(se->userdata);
+		res = fuse_uring_enter(q->fd, to_submit, 1, IORING_ENTER_GETEVENTS);
+		if (res < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: io_uring_enter on queue %u: %s\n",
+					 q->qid, strerror(errno));
+			break;
+		}
+
+		head = *q->cq_head;
+		tail = __atomic_load_n(q->cq_tail, __ATOMIC_ACQUIRE);
+		for (; head != tail && !stop; head++)
+		{
+			cqe = &q->cqes[head & *q->cq_mask];
+			ent = (struct fuse_uring_ent *)(uintptr_t)cqe->user_data;
+			// user_data 为 0 的 NOP 表示队列正在销毁
+			if (ent == NULL)
+			{
+				stop = 1;
+			}
+			else if (cqe->res < 0)
+			{
+				// 文件系统解除挂载或者连接被中止时，内核以 ENOTCONN 完成所有队列项
+				if (cqe->res != -ENOTCONN && cqe->res != -ECANCELED)
+					fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: io_uring queue %u: %s\n",
+							 q->qid, strerror(-cqe->res));
+				stop = 1;
+			}
+			else
+			{
+				fuse_uring_handle(q, ent);
+			}
+		}
+		__atomic_store_n(q->cq_head, head, __ATOMIC_RELEASE);
+	}
+	fuse_uring_self = NULL;
+	return NULL;
+}
+
+// 向队列线程发送退出通知并等待其退出
+static void fuse_uring_queue_stop(struct fuse_uring_queue *q)
+{
+	struct io_uring_sqe *sqe = NULL;
+
+	if (q->sqes != NULL && q->sqes != MAP_FAILED)
+	{
+		pthread_mutex_lock(&q->lock);
+		sqe = fuse_uring_get_sqe(q);
+		if (sqe != NULL)
+		{
+			sqe->opcode = IORING_OP_NOP;
+			fuse_uring_queue_sqe(q, sqe, NULL);
+		}
+		fuse_uring_submit_locked(q);
+		pthread_mutex_unlock(&q->lock);
+	}
+	// 线程可能已经因为连接断开或者初始化失败而退出，此时 join 立即返回
+	if (sqe == NULL)
+		pthread_cancel(q->thread);
+	pthread_join(q->thread, NULL);
+}
+
+int fuse_uring_new(struct fuse_session *se, unsigned depth, fuse_uring_process_func process)
+{
+	struct fuse_uring *ring;
+
+	ring = (struct fuse_uring *)calloc(1, sizeof(struct fuse_uring));
+	if (ring == NULL)
+	{
+		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: unable to allocate io_uring context: %s\n", strerror(errno));
+		return -1;
+	}
+	ring->se = se;
+	ring->process = process;
+	ring->depth = depth ? depth : FUSE_URING_DEFAULT_DEPTH;
+	ring->nr_queues = fuse_uring_nr_queues();
+	sem_init(&ring->ready, 0, 0);
+	atomic_init(&ring->failed, 0);
+	se->uring = ring;
+	return 0;
+}
+
+int fuse_uring_start(struct fuse_session *se, size_t payload_sz)
+{
+	struct fuse_uring *ring = se->uring;
+	sigset_t oldset;
+	sigset_t newset;
+	unsigned started = 0;
+	unsigned i;
+	int res;
+
+	ring->payload_sz = payload_sz;
+	ring->queues = (struct fuse_uring_queue *)calloc(ring->nr_queues, sizeof(struct fuse_uring_queue));
+	if (ring->queues == NULL)
+	{
+		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: unable to allocate io_uring queues: %s\n", strerror(errno));
+		return -1;
+	}
+
+	// 与多线程循环的工作线程相同，信号只由主线程处理
+	sigemptyset(&newset);
+	sigaddset(&newset, SIGTERM);
+	sigaddset(&newset, SIGINT);
+	sigaddset(&newset, SIGHUP);
+	sigaddset(&newset, SIGQUIT);
+	pthread_sigmask(SIG_BLOCK, &newset, &oldset);
+	for (i = 0; i < ring->nr_queues; i++)
+	{
+		struct fuse_uring_queue *q = &ring->queues[i];
+
+		q->ring = ring;
+		q->qid = i;
+		q->fd = -1;
+		pthread_mutex_init(&q->lock, NULL);
+		res = pthread_create(&q->thread, NULL, fuse_uring_worker, q);
+		if (res != 0)
+		{
+			fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: error creating io_uring thread: %s\n", strerror(res));
+			pthread_mutex_destroy(&q->lock);
+			atomic_store(&ring->failed, 1);
+			break;
+		}
+		started++;
+	}
+	pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+
+	for (i = 0; i < started; i++)
+		sem_wait(&ring->ready);
+	if (atomic_load(&ring->failed))
+	{
+		for (i = 0; i < started; i++)
+		{
+			fuse_uring_queue_stop(&ring->queues[i]);
+			fuse_uring_queue_free(&ring->queues[i]);
+		}
+		free(ring->queues);
+		ring->queues = NULL;
+		return -1;
+	}
+	ring->started = 1;
+	if (se->debug)
+		fuse_log(FUSE_LOG_DEBUG, "[FUSE_LOG_DEBUG] io_uring: %u queues, depth %u, payload %zu\n",
+				 ring->nr_queues, ring->depth, ring->payload_sz);
+	return 0;
+}
+
+int fuse_uring_commit(struct fuse_uring_ent *ent, struct iovec *iov, int count)
+{
+	struct fuse_uring_queue *q = ent->q;
+	struct fuse_out_header *out = (struct fuse_out_header *)iov[0].iov_base;
+	size_t len = 0;
+	char *p = ent->payload;
+	int i;
+	int res;
+
+	for (i = 1; i < count; i++)
+		len += iov[i].iov_len;
+	if (len > q->ring->payload_sz)
+	{
+		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: reply too large for io_uring payload: %zu\n", len);
+		out->error = -EIO;
+		out->len = sizeof(struct fuse_out_header);
+		count = 1;
+		len = 0;
+	}
+	// 回复的参数可能引用请求中的数据，因此使用 memmove
+	for (i = 1; i < count; i++)
+	{
+		memmove(p, iov[i].iov_base, iov[i].iov_len);
+		p += iov[i].iov_len;
+	}
+	memcpy(ent->hdr->in_out, out, sizeof(struct fuse_out_header));
+	ent->hdr->ring_ent_in_out.payload_sz = len;
+
+	pthread_mutex_lock(&q->lock);
+	res = fuse_uring_queue_cmd(q, ent, FUSE_IO_URING_CMD_COMMIT_AND_FETCH);
+	// 队列线程自己的回复在下一次等待请求时提交
+	if (fuse_uring_self != q)
+		fuse_uring_submit_locked(q);
+	pthread_mutex_unlock(&q->lock);
+	if (res < 0)
+		fuse_log(FUSE_LOG_ERR, "[FUSE_LOG_ERR] fuse: unable to commit reply on io_uring queue %u\n", q->qid);
+	return res;
+}
+
+void fuse_uring_destroy(struct fuse_session *se)
+{
+	struct fuse_uring *ring = se->uring;
+	unsigned i;
+
+	if (ring == NULL)
+		return;
+	if (ring->queues != NULL)
+	{
+		for (i = 0; i < ring->nr_queues; i++)
+		{
+			fuse_uring_queue_stop(&ring->queues[i]);
+			fuse_uring_queue_free(&ring->queues[i]);
+		}
+		free(ring->queues);
+	}
+	sem_destroy(&ring->ready);
+	free(ring);
+	se->uring = NULL;
+}
@@ -0,0 +1,129 @@
+#include "fuse_test_util.h"
+
+#include <stdio.h>
+#include <errno.h>
+
+#define MAX_INFLIGHT 4
+#define REQUESTS 8
+
+// 处理函数只记录请求体就返回，由后端线程异步完成
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static fuse_req_p pending[REQUESTS];
+static int npending;
+static int nhandled;
+
+static void test_getattr(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
+{
+    (void)ino;
+    (void)fi;
+    pthread_mutex_lock(&lock);
+    pending[npending++] = req;
+    nhandled++;
+    pthread_mutex_unlock(&lock);
+}
+
+static void reply_attr(fuse_req_p req, void *data)
+{
+    struct stat st;
+    memset(&st, 0, sizeof(st));
+    st.st_ino = (ino_t)(uintptr_t)data;
+    st.st_mode = S_IFDIR | 0755;
+    send_reply_attr(req, &st, 1.0);
+}
+
+// 后端线程完成所有已经交给处理函数的请求
+static void *complete_routine(void *data)
+{
+    int i;
+    (void)data;
+    pthread_mutex_lock(&lock);
+    for (i = 0; i < npending; i++)
+        fuse_req_complete(pending[i], reply_attr, (void *)(uintptr_t)FUSE_ROOT_ID);
+    npending = 0;
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+static void complete_pending(void)
+{
+    pthread_t tid;
+    assert(pthread_create(&tid, NULL, complete_routine, NULL) == 0);
+    pthread_join(tid, NULL);
+}
+
+// 等待处理函数被调用 n 次，最多等待 1 秒
+static int wait_handled(int n)
+{
+    int i, res;
+    for (i = 0; i < 100; i++)
+    {
+        pthread_mutex_lock(&lock);
+        res = nhandled;
+        pthread_mutex_unlock(&lock);
+        if (res >= n)
+            break;
+        usleep(10000);
+    }
+    return res;
+}
+
+int main(int argc, char *argv[])
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_ops ops;
+    struct fuse_session *se;
+    struct fuse_loop_config config = {
+        .min_threads = 2,
+        .max_threads = 2,
+    };
+    struct fuse_getattr_in getattr;
+    struct fuse_test t;
+    char buf[256];
+    int loop = FUSE_TEST_SINGLE;
+    uint64_t seen = 0;
+    int i;
+
+    // 参数 -m 测试多线程循环
+    if (argc > 1 && strcmp(argv[1], "-m") == 0)
+    {
+        loop = FUSE_TEST_MULTI;
+        args.argc = 1;
+    }
+    memset(&ops, 0, sizeof(ops));
+    ops.getattr = test_getattr;
+    se = fuse_session_new(&args, &ops, 0, NULL);
+    assert(se != NULL);
+    assert(fuse_session_async(se, MAX_INFLIGHT) == 0);
+
+    fuse_test_start(&t, se, loop, &config);
+    fuse_test_init(t.fd, buf, sizeof(buf), 0);
+
+    // 处理中的请求达到上限后，剩余的请求留在队列中不再被读取
+    memset(&getattr, 0, sizeof(getattr));
+    for (i = 0; i < REQUESTS; i++)
+        fuse_test_post(t.fd, FUSE_GETATTR, 2 + i, &getattr, sizeof(getattr));
+    assert(wait_handled(MAX_INFLIGHT) == MAX_INFLIGHT);
+    usleep(100000);
+    assert(wait_handled(MAX_INFLIGHT) == MAX_INFLIGHT);
+    assert(atomic_load(&se->reqs->inflight) == MAX_INFLIGHT);
+
+    // 在其他线程完成请求后，会话循环发送回复并继续读取请求
+    complete_pending();
+    for (i = 0; i < MAX_INFLIGHT; i++)
+        seen |= 1ULL << fuse_test_reply(t.fd, 0);
+    assert(wait_handled(REQUESTS) == REQUESTS);
+    complete_pending();
+    for (i = MAX_INFLIGHT; i < REQUESTS; i++)
+        seen |= 1ULL << fuse_test_reply(t.fd, 0);
+    assert(seen == ((1ULL << (REQUESTS + 2)) - 4));
+    // 回复发出之后请求才从请求表中移除
+    for (i = 0; i < 100 && atomic_load(&se->reqs->inflight) != 0; i++)
+        usleep(10000);
+    assert(atomic_load(&se->reqs->inflight) == 0);
+    printf("async test passed\n");
+
+    fuse_test_stop(&t);
+    fuse_session_destroy(se);
+    free_fuse_args(&args);
+    return 0;
+}
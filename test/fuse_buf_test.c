@@ -0,0 +1,210 @@
+#include <fuse_loop.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#define DATA_SIZE 10000
+
+static char data[DATA_SIZE];
+
+// 分配包含 count 个缓冲区的 fuse_bufvec
+static struct fuse_bufvec *bufvec_new(size_t count)
+{
+    struct fuse_bufvec *bufv;
+
+    bufv = (struct fuse_bufvec *)calloc(1, sizeof(struct fuse_bufvec) + (count - 1) * sizeof(struct fuse_buf));
+    assert(bufv != NULL);
+    bufv->count = count;
+    return bufv;
+}
+
+// 将 data 按 sizes 切分为多个内存缓冲区
+static struct fuse_bufvec *bufvec_split(char *mem, const size_t *sizes, size_t count)
+{
+    struct fuse_bufvec *bufv = bufvec_new(count);
+    size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        bufv->buf[i].mem = mem;
+        bufv->buf[i].size = sizes[i];
+        bufv->buf[i].fd = -1;
+        mem += sizes[i];
+    }
+    return bufv;
+}
+
+static int tmpfile_with_data(void)
+{
+    char path[] = "/tmp/fuse_buf_test.XXXXXX";
+    int fd = mkstemp(path);
+
+    assert(fd != -1);
+    unlink(path);
+    assert(write(fd, data, DATA_SIZE) == DATA_SIZE);
+    return fd;
+}
+
+// 源和目标的切分方式不同时，拷贝需要跨越缓冲区边界
+static void test_copy_mem(void)
+{
+    size_t src_sizes[] = {1, 4095, 3000, 2904};
+    size_t dst_sizes[] = {2048, 0, 7000, 952};
+    char *out = (char *)calloc(1, DATA_SIZE);
+    struct fuse_bufvec *src = bufvec_split(data, src_sizes, 4);
+    struct fuse_bufvec *dst = bufvec_split(out, dst_sizes, 4);
+
+    assert(fuse_buf_size(src) == DATA_SIZE);
+    assert(fuse_buf_copy(dst, src) == DATA_SIZE);
+    assert(memcmp(out, data, DATA_SIZE) == 0);
+    // 两端都已经用完
+    assert(src->idx == src->count && dst->idx == dst->count);
+    assert(fuse_buf_copy(dst, src) == 0);
+    free(src);
+    free(dst);
+    free(out);
+}
+
+// 内存写入文件，再经由管道读回
+static void test_copy_fd(void)
+{
+    size_t sizes[] = {5000, 5000};
+    char *out = (char *)calloc(1, DATA_SIZE);
+    struct fuse_bufvec *src = bufvec_split(data, sizes, 2);
+    struct fuse_bufvec file = FUSE_BUFVEC_INIT(DATA_SIZE);
+    struct fuse_bufvec pipe_in = FUSE_BUFVEC_INIT(DATA_SIZE);
+    struct fuse_bufvec pipe_out = FUSE_BUFVEC_INIT(DATA_SIZE);
+    struct fuse_bufvec mem = FUSE_BUFVEC_INIT(DATA_SIZE);
+    char path[] = "/tmp/fuse_buf_test.XXXXXX";
+    int fd = mkstemp(path);
+    int pfd[2];
+
+    assert(fd != -1);
+    unlink(path);
+    assert(pipe(pfd) == 0);
+    assert(fcntl(pfd[1], F_SETPIPE_SZ, 16 * 4096) > 0);
+
+    file.buf[0].flags = FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK;
+    file.buf[0].fd = fd;
+    assert(fuse_buf_copy(&file, src) == DATA_SIZE);
+
+    file.idx = file.off = 0;
+    pipe_in.buf[0].flags = FUSE_BUF_IS_FD | FUSE_BUF_FD_RETRY;
+    pipe_in.buf[0].fd = pfd[1];
+    assert(fuse_buf_copy(&pipe_in, &file) == DATA_SIZE);
+
+    pipe_out.buf[0].flags = FUSE_BUF_IS_FD | FUSE_BUF_FD_RETRY;
+    pipe_out.buf[0].fd = pfd[0];
+    mem.buf[0].mem = out;
+    assert(fuse_buf_copy(&mem, &pipe_out) == DATA_SIZE);
+    assert(memcmp(out, data, DATA_SIZE) == 0);
+
+    close(pfd[0]);
+    close(pfd[1]);
+    close(fd);
+    free(src);
+    free(out);
+}
+
+// 通过 send_reply_data 发送 bufv，读取响应并与 expect 比较
+static void check_reply(struct fuse_session *se, int peer, struct fuse_bufvec *bufv,
+                        const char *expect, size_t len)
+{
+    static uint64_t unique = 1;
+    char *buf = (char *)malloc(sizeof(struct fuse_out_header) + DATA_SIZE);
+    struct fuse_out_header *out = (struct fuse_out_header *)buf;
+    fuse_req_p req = fuse_alloc_req(se);
+    ssize_t res;
+
+    assert(req != NULL);
+    req->unique = unique;
+    req->fd = se->fd;
+    assert(send_reply_data(req, bufv) == 0);
+
+    res = read(peer, buf, sizeof(struct fuse_out_header) + DATA_SIZE);
+    assert(res == (ssize_t)(sizeof(struct fuse_out_header) + len));
+    assert(out->unique == unique);
+    assert(out->error == 0);
+    assert(out->len == res);
+    assert(memcmp(buf + sizeof(struct fuse_out_header), expect, len) == 0);
+    free(buf);
+    unique++;
+}
+
+static void test_reply(struct fuse_session *se, int peer)
+{
+    size_t sizes[] = {100, 0, 900, 4000, 5000};
+    struct fuse_bufvec *bufv;
+    char expect[2000];
+    int fd = tmpfile_with_data();
+
+    // 全部为内存缓冲区，直接 writev
+    bufv = bufvec_split(data, sizes, 5);
+    check_reply(se, peer, bufv, data, DATA_SIZE);
+
+    // 从中间位置开始发送
+    bufv->idx = 2;
+    bufv->off = 500;
+    check_reply(se, peer, bufv, data + 600, DATA_SIZE - 600);
+
+    // 混合内存和文件缓冲区，没有协商 FUSE_SPLICE_WRITE 时拷贝后发送
+    bufv->buf[3].flags = FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK;
+    bufv->buf[3].fd = fd;
+    bufv->buf[3].pos = 1000;
+    bufv->idx = 0;
+    bufv->off = 0;
+    check_reply(se, peer, bufv, data, DATA_SIZE);
+
+    // 文件提前结束，只发送已经读取到的部分
+    bufv->buf[3].pos = DATA_SIZE - 1000;
+    memcpy(expect, data, 1000);
+    memcpy(expect + 1000, data + DATA_SIZE - 1000, 1000);
+    check_reply(se, peer, bufv, expect, 2000);
+
+    // 协商了 FUSE_SPLICE_WRITE 时，经由管道发送
+    se->conn.want |= FUSE_SPLICE_WRITE;
+    bufv->buf[3].pos = 1000;
+    check_reply(se, peer, bufv, data, DATA_SIZE);
+    bufv->buf[3].pos = DATA_SIZE - 1000;
+    check_reply(se, peer, bufv, expect, 2000);
+    se->conn.want &= ~FUSE_SPLICE_WRITE;
+    free(bufv);
+    close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_ops ops;
+    struct fuse_session *se;
+    int sv[2];
+    int i;
+
+    for (i = 0; i < DATA_SIZE; i++)
+        data[i] = (char)(i * 7 + i / 251);
+
+    test_copy_mem();
+    test_copy_fd();
+
+    memset(&ops, 0, sizeof(ops));
+    se = fuse_session_new(&args, &ops, 0, NULL);
+    assert(se != NULL);
+    // 不运行事件循环，响应直接写入 socketpair，一次 read 读取一个完整的响应
+    assert(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) == 0);
+    se->fd = sv[0];
+    test_reply(se, sv[1]);
+
+    close(sv[0]);
+    close(sv[1]);
+    se->fd = -1;
+    fuse_session_destroy(se);
+    free_fuse_args(&args);
+    printf("fuse_buf test passed\n");
+    return 0;
+}
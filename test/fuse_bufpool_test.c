@@ -0,0 +1,163 @@
+#include "fuse_test_util.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdint.h>
+
+static unsigned max_pages_limit(void)
+{
+    unsigned limit = FUSE_MAX_MAX_PAGES;
+    FILE *fp = fopen("/proc/sys/fs/fuse/max_pages_limit", "r");
+    if (fp != NULL)
+    {
+        if (fscanf(fp, "%u", &limit) != 1 || limit == 0)
+            limit = FUSE_MAX_MAX_PAGES;
+        fclose(fp);
+    }
+    return limit;
+}
+
+static struct fuse_session *new_session(const char *opt)
+{
+    char *argv[] = {"fuse_bufpool_test", (char *)opt, NULL};
+    struct fuse_args args = FUSE_ARGS_INIT(opt ? 2 : 1, argv);
+    struct fuse_session *se;
+    struct fuse_ops ops;
+
+    memset(&ops, 0, sizeof(ops));
+    se = fuse_session_new(&args, &ops, 0, NULL);
+    assert(se != NULL);
+    return se;
+}
+
+// 每个请求的页数决定接收缓冲区的大小，超过内核限制时按内核限制
+static void test_size(void)
+{
+    struct fuse_session *se;
+    unsigned limit = max_pages_limit();
+    size_t pagesize = getpagesize();
+
+    se = new_session(NULL);
+    assert(se->conn.max_pages == (FUSE_MAX_MAX_PAGES < limit ? FUSE_MAX_MAX_PAGES : limit));
+    fuse_session_destroy(se);
+
+    se = new_session("--max_pages=64");
+    assert(se->conn.max_pages == 64);
+    assert(se->bufsize == 64 * pagesize + FUSE_BUFFER_HEADER_SIZE);
+    fuse_session_destroy(se);
+
+    se = new_session("--max_pages=4294967295");
+    assert(se->conn.max_pages == limit);
+    fuse_session_destroy(se);
+
+    se = new_session("--large_io");
+    assert(se->conn.max_pages == limit);
+    assert(se->bufsize == limit * pagesize + FUSE_BUFFER_HEADER_SIZE);
+    assert(se->conn.max_readahead == limit * pagesize);
+    fuse_session_destroy(se);
+}
+
+// 缓冲区从按 2MB 对齐的映射中切分，归还后被复用
+static void test_pool(void)
+{
+    struct fuse_session *se = new_session("--max_pages=128");
+    struct fuse_bufpool *pool;
+    struct fuse_bufpool_chunk *chunk;
+    void *bufs[8];
+    void *local;
+    size_t i;
+
+    assert(fuse_bufpool_reserve(se, 4) == 0);
+    pool = se->bufpool;
+    assert(pool != NULL);
+    assert(pool->bufsize >= se->bufsize && pool->bufsize % getpagesize() == 0);
+    assert(pool->nfree >= 4);
+    for (chunk = pool->chunks; chunk != NULL; chunk = chunk->next)
+    {
+        assert((uintptr_t)chunk->addr % FUSE_HUGEPAGE_SIZE == 0);
+        assert(chunk->len % pool->bufsize == 0 || chunk->len % FUSE_HUGEPAGE_SIZE == 0);
+    }
+
+    for (i = 0; i < 4; i++)
+    {
+        bufs[i] = fuse_bufpool_get(se, 0);
+        assert(bufs[i] != NULL);
+        memset(bufs[i], 0xa5, se->bufsize);
+    }
+    fuse_bufpool_put(se, bufs[3]);
+    assert(fuse_bufpool_get(se, 0) == bufs[3]);
+
+    // 池中缓冲区用完后再映射一块
+    for (i = 4; i < 8; i++)
+    {
+        bufs[i] = fuse_bufpool_get(se, 0);
+        assert(bufs[i] != NULL);
+    }
+
+    // local 总是映射新的一块
+    local = fuse_bufpool_get(se, 1);
+    assert(local != NULL);
+    assert((uintptr_t)local % FUSE_HUGEPAGE_SIZE == 0);
+    for (i = 0; i < 8; i++)
+        assert(local != bufs[i]);
+
+    fuse_bufpool_put(se, local);
+    for (i = 0; i < 8; i++)
+        fuse_bufpool_put(se, bufs[i]);
+    assert(pool->nfree == pool->total);
+    fuse_session_destroy(se);
+}
+
+// 4MB + 4KB 的缓冲区按 2MB 取整要占用 6MB，映射按缓冲区的实际大小，不浪费接近一个大页的内存
+static void test_large_chunk(void)
+{
+    struct fuse_session *se = new_session("--max_pages=128");
+    struct fuse_bufpool *pool;
+    void *buf;
+
+    // 模拟 max_pages_limit 调到 1024 后的 --large_io
+    se->bufsize = 1024 * getpagesize() + FUSE_BUFFER_HEADER_SIZE;
+    assert(fuse_bufpool_reserve(se, 1) == 0);
+    pool = se->bufpool;
+    assert(pool->total == 1);
+    assert(pool->chunks->len == pool->bufsize);
+    assert((uintptr_t)pool->chunks->addr % FUSE_HUGEPAGE_SIZE == 0);
+
+    buf = fuse_bufpool_get(se, 1);
+    assert(buf != NULL);
+    assert(pool->chunks->len == pool->bufsize);
+    memset(buf, 0xa5, pool->bufsize);
+    fuse_bufpool_put(se, buf);
+    assert(pool->nfree == pool->total);
+    fuse_session_destroy(se);
+}
+
+// INIT 回复中的 max_pages 和 max_write 由每个请求的页数决定
+static void test_init(void)
+{
+    struct fuse_session *se = new_session("--max_pages=64");
+    struct fuse_init_out *initout;
+    struct fuse_test t;
+    char buf[512];
+
+    fuse_test_start(&t, se, FUSE_TEST_SINGLE, NULL);
+    initout = fuse_test_init(t.fd, buf, sizeof(buf), FUSE_MAX_PAGES);
+    assert(initout->flags & FUSE_MAX_PAGES);
+    assert(initout->max_pages == 64);
+    assert(initout->max_write == 64 * getpagesize());
+    assert(se->bufpool != NULL && se->bufpool->nfree + 1 == se->bufpool->total);
+
+    fuse_test_stop(&t);
+    assert(se->bufpool->nfree == se->bufpool->total);
+    fuse_session_destroy(se);
+}
+
+int main(void)
+{
+    test_size();
+    test_pool();
+    test_large_chunk();
+    test_init();
+    printf("buffer pool test passed\n");
+    return 0;
+}
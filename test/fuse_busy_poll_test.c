@@ -0,0 +1,129 @@
+#include "fuse_test_util.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#define REQUESTS 64
+#define ASYNC_INO 99
+
+// nodeid 为 ASYNC_INO 的 GETATTR 由其他线程异步完成，其余请求直接回复
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static fuse_req_p pending;
+
+static void test_getattr(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
+{
+    struct stat st;
+    (void)fi;
+    if (ino == ASYNC_INO)
+    {
+        pthread_mutex_lock(&lock);
+        pending = req;
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    memset(&st, 0, sizeof(st));
+    st.st_ino = ino;
+    st.st_mode = S_IFDIR | 0755;
+    send_reply_attr(req, &st, 1.0);
+}
+
+static void reply_attr(fuse_req_p req, void *data)
+{
+    struct stat st;
+    memset(&st, 0, sizeof(st));
+    st.st_ino = (ino_t)(uintptr_t)data;
+    st.st_mode = S_IFDIR | 0755;
+    send_reply_attr(req, &st, 1.0);
+}
+
+static void *complete_routine(void *data)
+{
+    (void)data;
+    pthread_mutex_lock(&lock);
+    fuse_req_complete(pending, reply_attr, (void *)(uintptr_t)ASYNC_INO);
+    pending = NULL;
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+// 等待处理函数收到异步请求，最多等待 1 秒
+static int wait_pending(void)
+{
+    int i, res = 0;
+    for (i = 0; i < 100 && !res; i++)
+    {
+        pthread_mutex_lock(&lock);
+        res = pending != NULL;
+        pthread_mutex_unlock(&lock);
+        if (!res)
+            usleep(10000);
+    }
+    return res;
+}
+
+static const struct fuse_loop_config config = {
+    .min_threads = 1,
+    .max_threads = 1,
+    .busy_poll = 2000,
+};
+
+// 进程累计的 CPU 时间，单位为秒
+static double cpu_time(void)
+{
+    struct rusage ru;
+    assert(getrusage(RUSAGE_SELF, &ru) == 0);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_ops ops;
+    struct fuse_session *se;
+    struct fuse_getattr_in getattr;
+    struct fuse_test t;
+    pthread_t ctid;
+    char buf[256];
+    double cpu;
+    int i;
+
+    memset(&ops, 0, sizeof(ops));
+    ops.getattr = test_getattr;
+    se = fuse_session_new(&args, &ops, 0, NULL);
+    assert(se != NULL);
+    // socketpair 无法克隆，异步模式下 se->fd 是非阻塞的，工作线程直接在上面自旋
+    assert(fuse_session_async(se, 4) == 0);
+    fuse_test_start(&t, se, FUSE_TEST_MULTI, &config);
+    fuse_test_init(t.fd, buf, sizeof(buf), 0);
+
+    // 连续的请求在自旋期间到达，按顺序得到回复
+    memset(&getattr, 0, sizeof(getattr));
+    for (i = 0; i < REQUESTS; i++)
+    {
+        fuse_test_post_node(t.fd, FUSE_GETATTR, 2 + i, FUSE_ROOT_ID, &getattr, sizeof(getattr));
+        assert(fuse_test_reply(t.fd, 0) == (uint64_t)(2 + i));
+    }
+
+    // 空闲时自旋的时间有上限，之后阻塞等待，不会持续占用 CPU
+    cpu = cpu_time();
+    usleep(300000);
+    assert(cpu_time() - cpu < 0.1);
+
+    // 自旋或者阻塞期间完成队列中的回复都会被发出
+    fuse_test_post_node(t.fd, FUSE_GETATTR, 100, ASYNC_INO, &getattr, sizeof(getattr));
+    assert(wait_pending());
+    assert(pthread_create(&ctid, NULL, complete_routine, NULL) == 0);
+    pthread_join(ctid, NULL);
+    assert(fuse_test_reply(t.fd, 0) == 100);
+    fuse_test_post_node(t.fd, FUSE_GETATTR, 101, FUSE_ROOT_ID, &getattr, sizeof(getattr));
+    assert(fuse_test_reply(t.fd, 0) == 101);
+    printf("busy poll test passed\n");
+
+    fuse_test_stop(&t);
+    fuse_session_destroy(se);
+    free_fuse_args(&args);
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include "fuse_test_util.h"
+
+#include <stdio.h>
+#include <errno.h>
+
+static void test_copy_file_range(fuse_req_p req, fuse_inode ino_in, off_t off_in,
+                                 struct fuse_file_info *fi_in, fuse_inode ino_out, off_t off_out,
+                                 struct fuse_file_info *fi_out, size_t len, int flags)
+{
+    assert(ino_in == 2 && fi_in->fh == 10 && off_in == 4096);
+    assert(ino_out == 3 && fi_out->fh == 11 && off_out == 8192);
+    assert(flags == 0);
+    // 只拷贝了一部分
+    send_reply_write_count(req, len / 2);
+}
+
+// 文件系统实现了 copy_file_range 时以 fuse_write_out 回复拷贝的字节数，否则回复 ENOSYS
+static void test_dispatch(int argc, char *argv[], int implemented)
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_ops ops;
+    struct fuse_session *se;
+    struct fuse_copy_file_range_in copy;
+    struct fuse_write_out *write_out;
+    char buf[256];
+    struct fuse_test t;
+
+    memset(&ops, 0, sizeof(ops));
+    if (implemented)
+        ops.copy_file_range = test_copy_file_range;
+    se = fuse_session_new(&args, &ops, 0, NULL);
+    assert(se != NULL);
+    fuse_test_start(&t, se, FUSE_TEST_SINGLE, NULL);
+
+    fuse_test_init(t.fd, buf, sizeof(buf), 0);
+
+    memset(&copy, 0, sizeof(copy));
+    copy.fh_in = 10;
+    copy.off_in = 4096;
+    copy.nodeid_out = 3;
+    copy.fh_out = 11;
+    copy.off_out = 8192;
+    copy.len = 1 << 20;
+    fuse_test_post_node(t.fd, FUSE_COPY_FILE_RANGE, 2, 2, &copy, sizeof(copy));
+    if (implemented)
+    {
+        write_out = fuse_test_read(t.fd, buf, sizeof(buf), 2, 0);
+        assert(((struct fuse_out_header *)buf)->len == sizeof(struct fuse_out_header) + sizeof(*write_out));
+        assert(write_out->size == 1 << 19);
+    }
+    else
+    {
+        fuse_test_read(t.fd, buf, sizeof(buf), 2, -ENOSYS);
+    }
+
+    fuse_test_stop(&t);
+    fuse_session_destroy(se);
+    free_fuse_args(&args);
+}
+
+int main(int argc, char *argv[])
+{
+    test_dispatch(argc, argv, 1);
+    test_dispatch(argc, argv, 0);
+    printf("copy_file_range test passed\n");
+    return 0;
+}
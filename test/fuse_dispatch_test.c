@@ -0,0 +1,126 @@
+#include "fuse_test_util.h"
+
+#include <stdio.h>
+#include <errno.h>
+
+#define READS 3
+
+// READ 阻塞到测试放行为止，模拟占用工作线程的大 I/O
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static int released;
+static int nread;
+static int nforget;
+
+static void test_read(fuse_req_p req, fuse_inode ino, size_t size, off_t off, struct fuse_file_info *fi)
+{
+    (void)ino;
+    (void)size;
+    (void)off;
+    (void)fi;
+    pthread_mutex_lock(&lock);
+    nread++;
+    while (!released)
+        pthread_cond_wait(&cond, &lock);
+    pthread_mutex_unlock(&lock);
+    send_reply_err(req, 0);
+}
+
+static void test_forget(fuse_req_p req, fuse_inode ino, uint64_t nlookup)
+{
+    (void)ino;
+    pthread_mutex_lock(&lock);
+    nforget += (int)nlookup;
+    pthread_mutex_unlock(&lock);
+    send_reply_none(req);
+}
+
+static void test_getattr(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
+{
+    struct stat st;
+    (void)fi;
+    memset(&st, 0, sizeof(st));
+    st.st_ino = ino;
+    st.st_mode = S_IFDIR | 0755;
+    send_reply_attr(req, &st, 1.0);
+}
+
+// 等待计数达到 n，最多等待 1 秒
+static int wait_count(int *count, int n)
+{
+    int i, res;
+    for (i = 0; i < 100; i++)
+    {
+        pthread_mutex_lock(&lock);
+        res = *count;
+        pthread_mutex_unlock(&lock);
+        if (res >= n)
+            break;
+        usleep(10000);
+    }
+    return res;
+}
+
+static const struct fuse_loop_config config = {
+    .min_threads = 2,
+    .max_threads = 2,
+    .readers = 1,
+};
+
+int main(int argc, char *argv[])
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_ops ops;
+    struct fuse_session *se;
+    struct fuse_read_in readin;
+    struct fuse_forget_in forget;
+    struct fuse_getattr_in getattr;
+    struct fuse_test t;
+    char buf[256];
+    uint64_t seen = 0;
+    int i;
+
+    memset(&ops, 0, sizeof(ops));
+    ops.read = test_read;
+    ops.forget = test_forget;
+    ops.getattr = test_getattr;
+    se = fuse_session_new(&args, &ops, 0, NULL);
+    assert(se != NULL);
+    fuse_test_start(&t, se, FUSE_TEST_MULTI, &config);
+    fuse_test_init(t.fd, buf, sizeof(buf), 0);
+
+    // 两个工作线程中只有一个可以处理 DATA 类请求，其余 READ 留在队列中
+    memset(&readin, 0, sizeof(readin));
+    readin.size = 4096;
+    for (i = 0; i < READS; i++)
+        fuse_test_post(t.fd, FUSE_READ, 2 + i, &readin, sizeof(readin));
+    assert(wait_count(&nread, 1) == 1);
+    usleep(100000);
+    assert(wait_count(&nread, 1) == 1);
+
+    // READ 阻塞期间，FORGET 和 GETATTR 由另一个工作线程处理
+    memset(&forget, 0, sizeof(forget));
+    forget.nlookup = 1;
+    fuse_test_post(t.fd, FUSE_FORGET, 10, &forget, sizeof(forget));
+    memset(&getattr, 0, sizeof(getattr));
+    fuse_test_post(t.fd, FUSE_GETATTR, 11, &getattr, sizeof(getattr));
+    assert(fuse_test_reply(t.fd, 0) == 11);
+    assert(wait_count(&nforget, 1) == 1);
+    assert(wait_count(&nread, 1) == 1);
+
+    // 放行之后剩余的 READ 依次被处理
+    pthread_mutex_lock(&lock);
+    released = 1;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+    for (i = 0; i < READS; i++)
+        seen |= 1ULL << fuse_test_reply(t.fd, 0);
+    assert(seen == ((1ULL << (READS + 2)) - 4));
+    assert(wait_count(&nread, READS) == READS);
+    printf("dispatch test passed\n");
+
+    fuse_test_stop(&t);
+    fuse_session_destroy(se);
+    free_fuse_args(&args);
+    return 0;
+}
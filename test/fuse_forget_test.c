@@ -0,0 +1,106 @@
+#include "fuse_test_util.h"
+
+#include <stdio.h>
+#include <errno.h>
+
+#define FORGETS 3
+
+static uint64_t forgotten[FORGETS + 1];
+static int nforget;
+static int nbatch;
+
+static void test_forget(fuse_req_p req, fuse_inode ino, uint64_t nlookup)
+{
+    assert(ino <= FORGETS);
+    forgotten[ino] += nlookup;
+    nforget++;
+    send_reply_none(req);
+}
+
+static void test_forget_multi(fuse_req_p req, size_t count, struct fuse_forget_data *forgets)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        assert(forgets[i].ino <= FORGETS);
+        forgotten[forgets[i].ino] += forgets[i].nlookup;
+    }
+    nbatch++;
+    send_reply_none(req);
+}
+
+static void test_getattr(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
+{
+    struct stat st;
+    (void)fi;
+    memset(&st, 0, sizeof(st));
+    st.st_ino = ino;
+    st.st_mode = S_IFDIR | 0755;
+    send_reply_attr(req, &st, 1.0);
+}
+
+// BATCH_FORGET 不回复：紧随其后的 GETATTR 的回复是读到的下一个回复；
+// 没有实现 forget_multi 时对每个 inode 调用一次 forget
+static void test_batch(int argc, char *argv[], struct fuse_ops *ops)
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_session *se;
+    struct fuse_getattr_in getattr;
+    struct {
+        struct fuse_batch_forget_in in;
+        struct fuse_forget_one one[FORGETS];
+    } batch;
+    struct fuse_test t;
+    char buf[256];
+    int i;
+
+    memset(forgotten, 0, sizeof(forgotten));
+    nforget = nbatch = 0;
+    se = fuse_session_new(&args, ops, 0, NULL);
+    assert(se != NULL);
+    fuse_test_start(&t, se, FUSE_TEST_SINGLE, NULL);
+
+    fuse_test_init(t.fd, buf, sizeof(buf), 0);
+
+    memset(&batch, 0, sizeof(batch));
+    batch.in.count = FORGETS;
+    for (i = 0; i < FORGETS; i++)
+    {
+        batch.one[i].nodeid = i + 1;
+        batch.one[i].nlookup = 10 * (i + 1);
+    }
+    fuse_test_post(t.fd, FUSE_BATCH_FORGET, 2, &batch, sizeof(batch));
+    memset(&getattr, 0, sizeof(getattr));
+    fuse_test_post(t.fd, FUSE_GETATTR, 3, &getattr, sizeof(getattr));
+    assert(fuse_test_reply(t.fd, 0) == 3);
+
+    for (i = 0; i < FORGETS; i++)
+        assert(forgotten[i + 1] == (uint64_t)(10 * (i + 1)));
+    if (ops->forget_multi)
+        assert(nbatch == 1 && nforget == 0);
+    else
+        assert(nbatch == 0 && nforget == FORGETS);
+    // 回复发出之后请求才从请求表中移除，BATCH_FORGET 从未登记
+    for (i = 0; i < 100 && atomic_load(&se->reqs->inflight) != 0; i++)
+        usleep(10000);
+    assert(atomic_load(&se->reqs->inflight) == 0);
+
+    fuse_test_stop(&t);
+    fuse_session_destroy(se);
+    free_fuse_args(&args);
+}
+
+int main(int argc, char *argv[])
+{
+    struct fuse_ops ops;
+
+    memset(&ops, 0, sizeof(ops));
+    ops.getattr = test_getattr;
+    ops.forget = test_forget;
+    test_batch(argc, argv, &ops);
+    ops.forget_multi = test_forget_multi;
+    test_batch(argc, argv, &ops);
+    printf("batch forget test passed\n");
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include "fuse_test_util.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <pthread.h>
+
+// 处理函数只记录请求，等两个请求都到达后由其他线程一起回复，模拟组提交
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static fuse_req_p pending[2];
+static int npending;
+
+static void test_fsync(fuse_req_p req, fuse_inode ino, int datasync, struct fuse_file_info *fi)
+{
+    assert(ino == 2 && fi->fh == 10);
+    assert(datasync == (npending == 0));
+    pthread_mutex_lock(&lock);
+    pending[npending++] = req;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&lock);
+}
+
+static void test_fsyncdir(fuse_req_p req, fuse_inode ino, int datasync, struct fuse_file_info *fi)
+{
+    assert(ino == 2 && fi->fh == 11 && datasync == 0);
+    send_reply_err(req, EIO);
+}
+
+static void reply_err(fuse_req_p req, void *data)
+{
+    send_reply_err(req, (int)(intptr_t)data);
+}
+
+static void *commit_routine(void *data)
+{
+    int i;
+    (void)data;
+    pthread_mutex_lock(&lock);
+    while (npending < 2)
+        pthread_cond_wait(&cond, &lock);
+    for (i = 0; i < npending; i++)
+        fuse_req_complete(pending[i], reply_err, (void *)0);
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+static void post_fsync(int fd, uint32_t opcode, uint64_t unique, uint64_t fh, uint32_t flags)
+{
+    struct fuse_fsync_in fsync_in;
+
+    memset(&fsync_in, 0, sizeof(fsync_in));
+    fsync_in.fh = fh;
+    fsync_in.fsync_flags = flags;
+    fuse_test_post_node(fd, opcode, unique, 2, &fsync_in, sizeof(fsync_in));
+}
+
+// 文件系统实现了 fsync 和 fsyncdir 时交给文件系统处理，否则回复 ENOSYS
+static void test_dispatch(int argc, char *argv[], int implemented)
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_ops ops;
+    struct fuse_session *se;
+    char buf[256];
+    struct fuse_test t;
+    pthread_t commit_tid;
+    uint64_t seen;
+
+    memset(&ops, 0, sizeof(ops));
+    if (implemented)
+    {
+        ops.fsync = test_fsync;
+        ops.fsyncdir = test_fsyncdir;
+    }
+    se = fuse_session_new(&args, &ops, 0, NULL);
+    assert(se != NULL);
+    fuse_test_start(&t, se, FUSE_TEST_SINGLE, NULL);
+
+    fuse_test_init(t.fd, buf, sizeof(buf), 0);
+
+    if (implemented)
+    {
+        // 第一个请求没有回复时会话循环继续读取第二个请求，两个请求一起完成
+        assert(pthread_create(&commit_tid, NULL, commit_routine, NULL) == 0);
+        post_fsync(t.fd, FUSE_FSYNC, 2, 10, FUSE_FSYNC_FDATASYNC);
+        post_fsync(t.fd, FUSE_FSYNC, 3, 10, 0);
+        pthread_join(commit_tid, NULL);
+        seen = 1ULL << fuse_test_reply(t.fd, 0);
+        seen |= 1ULL << fuse_test_reply(t.fd, 0);
+        assert(seen == ((1ULL << 2) | (1ULL << 3)));
+
+        post_fsync(t.fd, FUSE_FSYNCDIR, 4, 11, 0);
+        assert(fuse_test_reply(t.fd, -EIO) == 4);
+    }
+    else
+    {
+        post_fsync(t.fd, FUSE_FSYNC, 2, 10, 0);
+        assert(fuse_test_reply(t.fd, -ENOSYS) == 2);
+        post_fsync(t.fd, FUSE_FSYNCDIR, 3, 11, 0);
+        assert(fuse_test_reply(t.fd, -ENOSYS) == 3);
+    }
+
+    fuse_test_stop(&t);
+    fuse_session_destroy(se);
+    free_fuse_args(&args);
+}
+
+int main(int argc, char *argv[])
+{
+    test_dispatch(argc, argv, 1);
+    test_dispatch(argc, argv, 0);
+    printf("fsync test passed\n");
+    return 0;
+}
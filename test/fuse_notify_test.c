@@ -0,0 +1,147 @@
+#include "fuse_test_util.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdatomic.h>
+
+static atomic_int retrieved;
+static char retrieve_data[64];
+
+static void test_getattr(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
+{
+    struct stat st;
+    (void)fi;
+    memset(&st, 0, sizeof(st));
+    st.st_ino = ino;
+    st.st_mode = S_IFDIR | 0755;
+    send_reply_attr(req, &st, 1.0);
+}
+
+static void test_retrieve_reply(fuse_req_p req, void *cookie, fuse_inode ino,
+                                off_t offset, struct fuse_bufvec *bufv)
+{
+    assert(strcmp((char *)cookie, "cookie") == 0);
+    assert(ino == 9);
+    assert(offset == 100);
+    assert(bufv->count == 1 && bufv->buf[0].size == 5);
+    memcpy(retrieve_data, bufv->buf[0].mem, bufv->buf[0].size);
+    send_reply_none(req);
+    atomic_store(&retrieved, 1);
+}
+
+// 读取一个通知，返回通知的参数部分
+static void *read_notify(int fd, char *buf, size_t size, int code, size_t len)
+{
+    struct fuse_out_header *out = (struct fuse_out_header *)buf;
+
+    assert(read(fd, buf, size) == (ssize_t)(sizeof(*out) + len));
+    assert(out->unique == 0);
+    assert(out->error == code);
+    assert(out->len == sizeof(*out) + len);
+    return out + 1;
+}
+
+int main(int argc, char *argv[])
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_ops ops;
+    struct fuse_session *se;
+    struct fuse_getattr_in getattr;
+    struct fuse_notify_retrieve_in retrieve_in;
+    struct fuse_notify_inval_inode_out *inval_inode;
+    struct fuse_notify_inval_entry_out *inval_entry;
+    struct fuse_notify_delete_out *del;
+    struct fuse_notify_store_out *store;
+    struct fuse_notify_retrieve_out *retrieve;
+    struct fuse_bufvec *bufv;
+    char buf[512];
+    struct fuse_test t;
+    int pfd[2];
+    int i;
+
+    memset(&ops, 0, sizeof(ops));
+    ops.getattr = test_getattr;
+    ops.retrieve_reply = test_retrieve_reply;
+    se = fuse_session_new(&args, &ops, 0, NULL);
+    assert(se != NULL);
+
+    // INIT 之前不能发送通知
+    assert(fuse_notify_inval_inode(se, 5, 0, 0) == -ENOTCONN);
+
+    fuse_test_start(&t, se, FUSE_TEST_SINGLE, NULL);
+    fuse_test_init(t.fd, buf, sizeof(buf), 0);
+
+    assert(fuse_notify_inval_inode(se, 5, 4096, 8192) == 0);
+    inval_inode = read_notify(t.fd, buf, sizeof(buf), FUSE_NOTIFY_INVAL_INODE, sizeof(*inval_inode));
+    assert(inval_inode->ino == 5 && inval_inode->off == 4096 && inval_inode->len == 8192);
+
+    // 名字之后带上 '\0'
+    assert(fuse_notify_inval_entry(se, FUSE_ROOT_ID, "abcdef", 3) == 0);
+    inval_entry = read_notify(t.fd, buf, sizeof(buf), FUSE_NOTIFY_INVAL_ENTRY, sizeof(*inval_entry) + 4);
+    assert(inval_entry->parent == FUSE_ROOT_ID && inval_entry->namelen == 3);
+    assert(memcmp(inval_entry + 1, "abc", 4) == 0);
+
+    assert(fuse_notify_delete(se, FUSE_ROOT_ID, 7, "abc", 3) == 0);
+    del = read_notify(t.fd, buf, sizeof(buf), FUSE_NOTIFY_DELETE, sizeof(*del) + 4);
+    assert(del->parent == FUSE_ROOT_ID && del->child == 7 && del->namelen == 3);
+    assert(memcmp(del + 1, "abc", 4) == 0);
+
+    // 内存中的数据从当前位置开始发送
+    bufv = (struct fuse_bufvec *)calloc(1, sizeof(*bufv) + sizeof(struct fuse_buf));
+    bufv->count = 2;
+    bufv->off = 2;
+    bufv->buf[0].mem = "xxhello";
+    bufv->buf[0].size = 7;
+    bufv->buf[0].fd = -1;
+    bufv->buf[1].mem = "world";
+    bufv->buf[1].size = 5;
+    bufv->buf[1].fd = -1;
+    assert(fuse_notify_store(se, 9, 100, bufv) == 0);
+    store = read_notify(t.fd, buf, sizeof(buf), FUSE_NOTIFY_STORE, sizeof(*store) + 10);
+    assert(store->nodeid == 9 && store->offset == 100 && store->size == 10);
+    assert(memcmp(store + 1, "helloworld", 10) == 0);
+
+    // 文件描述符中的数据先拷贝到临时缓冲区
+    assert(pipe(pfd) == 0);
+    assert(write(pfd[1], "piped", 5) == 5);
+    *bufv = FUSE_BUFVEC_INIT(5);
+    bufv->buf[0].flags = FUSE_BUF_IS_FD;
+    bufv->buf[0].fd = pfd[0];
+    assert(fuse_notify_store(se, 9, 0, bufv) == 0);
+    store = read_notify(t.fd, buf, sizeof(buf), FUSE_NOTIFY_STORE, sizeof(*store) + 5);
+    assert(store->size == 5 && memcmp(store + 1, "piped", 5) == 0);
+    close(pfd[0]);
+    close(pfd[1]);
+    free(bufv);
+
+    // 内核以 NOTIFY_REPLY 发回数据，由 retrieve_reply 处理，不需要回复
+    assert(fuse_notify_retrieve(se, 9, 4096, 100, "cookie") == 0);
+    retrieve = read_notify(t.fd, buf, sizeof(buf), FUSE_NOTIFY_RETRIEVE, sizeof(*retrieve));
+    assert(retrieve->nodeid == 9 && retrieve->offset == 100 && retrieve->size == 4096);
+    memset(&retrieve_in, 0, sizeof(retrieve_in));
+    retrieve_in.offset = 100;
+    retrieve_in.size = 5;
+    fuse_test_post_ext(t.fd, FUSE_NOTIFY_REPLY, retrieve->notify_unique, 9, 0,
+                       &retrieve_in, sizeof(retrieve_in), "hello", 5);
+    for (i = 0; i < 100 && !atomic_load(&retrieved); i++)
+        usleep(10000);
+    assert(atomic_load(&retrieved));
+    assert(memcmp(retrieve_data, "hello", 5) == 0);
+    assert(se->notify_list.next == &se->notify_list);
+
+    // 没有对应记录的 NOTIFY_REPLY 被丢弃，下一个收到的是 GETATTR 的回复
+    fuse_test_post_ext(t.fd, FUSE_NOTIFY_REPLY, 12345, 9, 0, &retrieve_in, sizeof(retrieve_in), "hello", 5);
+    memset(&getattr, 0, sizeof(getattr));
+    fuse_test_post(t.fd, FUSE_GETATTR, 2, &getattr, sizeof(getattr));
+    fuse_test_read(t.fd, buf, sizeof(buf), 2, 0);
+
+    // 尚未收到回复的记录在会话销毁时释放
+    assert(fuse_notify_retrieve(se, 9, 4096, 0, "cookie") == 0);
+    assert(read(t.fd, buf, sizeof(buf)) > 0);
+
+    fuse_test_stop(&t);
+    fuse_session_destroy(se);
+    free_fuse_args(&args);
+    printf("notify test passed\n");
+    return 0;
+}
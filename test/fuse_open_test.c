@@ -0,0 +1,107 @@
+#include "fuse_test_util.h"
+
+#include <stdio.h>
+#include <errno.h>
+
+static int nopen;
+static int nopendir;
+
+static void test_init(void *userdata, struct fuse_conn_info *conn)
+{
+    (void)userdata;
+    if (conn->capable & FUSE_ATOMIC_O_TRUNC)
+        conn->want |= FUSE_ATOMIC_O_TRUNC;
+    conn->no_opendir = 1;
+}
+
+static void test_open(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
+{
+    (void)ino;
+    nopen++;
+    // 开启 FUSE_ATOMIC_O_TRUNC 后 O_TRUNC 随 OPEN 一起到达
+    assert(fi->flags & O_TRUNC);
+    fi->fh = 10;
+    send_reply_open(req, fi);
+}
+
+static void test_opendir(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
+{
+    (void)ino;
+    nopendir++;
+    fi->fh = 11;
+    send_reply_open(req, fi);
+}
+
+// 发送 OPEN 和 OPENDIR，检查回复的错误码；成功时 fh 由处理函数设置，没有处理函数时为 0
+static void open_both(int fd, int open_err, int opendir_err)
+{
+    struct fuse_open_in open_in;
+    struct fuse_open_out *open_out;
+    char buf[256];
+
+    memset(&open_in, 0, sizeof(open_in));
+    open_in.flags = O_RDWR | O_TRUNC;
+    fuse_test_post(fd, FUSE_OPEN, 2, &open_in, sizeof(open_in));
+    open_out = fuse_test_read(fd, buf, sizeof(buf), 2, open_err);
+    if (open_err == 0)
+        assert(open_out->fh == (nopen ? 10 : 0));
+
+    open_in.flags = O_RDONLY;
+    fuse_test_post(fd, FUSE_OPENDIR, 3, &open_in, sizeof(open_in));
+    open_out = fuse_test_read(fd, buf, sizeof(buf), 3, opendir_err);
+    if (opendir_err == 0)
+        assert(open_out->fh == (nopendir ? 11 : 0));
+}
+
+// @param implemented 文件系统是否实现了 open 和 opendir，实现时在 init 中请求 no_opendir
+// @param flags 内核在 INIT 中提供的能力
+static void test_open_support(int argc, char *argv[], int implemented, uint32_t flags,
+                              int open_err, int opendir_err)
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_ops ops;
+    struct fuse_session *se;
+    struct fuse_init_out *initout;
+    char buf[256];
+    struct fuse_test t;
+
+    memset(&ops, 0, sizeof(ops));
+    if (implemented)
+    {
+        ops.init = test_init;
+        ops.open = test_open;
+        ops.opendir = test_opendir;
+    }
+    se = fuse_session_new(&args, &ops, 0, NULL);
+    assert(se != NULL);
+    fuse_test_start(&t, se, FUSE_TEST_SINGLE, NULL);
+
+    initout = fuse_test_init(t.fd, buf, sizeof(buf), flags);
+    // no_open/no_opendir 只是内核的能力，不出现在回复中
+    assert(!(initout->flags & (FUSE_NO_OPEN_SUPPORT | FUSE_NO_OPENDIR_SUPPORT)));
+    if (implemented)
+        assert(initout->flags & FUSE_ATOMIC_O_TRUNC);
+
+    nopen = nopendir = 0;
+    open_both(t.fd, open_err, opendir_err);
+    assert(nopen == (implemented && open_err == 0));
+    assert(nopendir == (implemented && opendir_err == 0));
+
+    fuse_test_stop(&t);
+    fuse_session_destroy(se);
+    free_fuse_args(&args);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t all = FUSE_NO_OPEN_SUPPORT | FUSE_NO_OPENDIR_SUPPORT;
+
+    // 没有实现 open/opendir：内核支持时回复 ENOSYS，之后不再发送，否则回复成功
+    test_open_support(argc, argv, 0, all, -ENOSYS, -ENOSYS);
+    test_open_support(argc, argv, 0, 0, 0, 0);
+    // 实现了 open/opendir 并在 init 中请求 no_opendir：内核不支持时 no_opendir 被清零
+    test_open_support(argc, argv, 1, all | FUSE_ATOMIC_O_TRUNC, 0, -ENOSYS);
+    test_open_support(argc, argv, 1, FUSE_ATOMIC_O_TRUNC, 0, 0);
+    printf("open test passed\n");
+    return 0;
+}
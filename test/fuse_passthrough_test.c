@@ -0,0 +1,86 @@
+#include "fuse_test_util.h"
+
+#include <stdio.h>
+#include <errno.h>
+
+#define BACKING_ID 5
+
+static void test_init(void *userdata, struct fuse_conn_info *conn)
+{
+    (void)userdata;
+    conn->passthrough = 1;
+}
+
+static void test_open(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
+{
+    (void)ino;
+    fi->fh = 1;
+    fi->direct_io = 1;
+    fi->backing_id = BACKING_ID;
+    send_reply_open(req, fi);
+}
+
+// 内核提供 FUSE_PASSTHROUGH 时 INIT 回复中带上这个标记和 max_stack_depth，否则 conn.passthrough 被清除；
+// OPEN 回复中带有 backing_id 时设置 FOPEN_PASSTHROUGH 并忽略 direct_io，没有协商 passthrough 时按普通打开回复
+static void test_negotiate(int argc, char *argv[], struct fuse_ops *ops, int offer)
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_session *se;
+    struct fuse_init_out *initout;
+    struct fuse_open_in open;
+    struct fuse_open_out *openout;
+    char buf[512];
+    struct fuse_test t;
+
+    se = fuse_session_new(&args, ops, 0, NULL);
+    assert(se != NULL);
+    fuse_test_start(&t, se, FUSE_TEST_SINGLE, NULL);
+
+    initout = fuse_test_init(t.fd, buf, sizeof(buf), offer ? FUSE_PASSTHROUGH : 0);
+    if (offer)
+    {
+        assert(initout->flags & FUSE_INIT_EXT);
+        assert(initout->flags2 & (FUSE_PASSTHROUGH >> 32));
+        assert(initout->max_stack_depth == 1);
+        assert(se->conn.passthrough);
+    }
+    else
+    {
+        assert(initout->flags2 == 0);
+        assert(initout->max_stack_depth == 0);
+        assert(!se->conn.passthrough);
+    }
+
+    memset(&open, 0, sizeof(open));
+    fuse_test_post(t.fd, FUSE_OPEN, 2, &open, sizeof(open));
+    openout = fuse_test_read(t.fd, buf, sizeof(buf), 2, 0);
+    if (offer)
+    {
+        assert(openout->open_flags & FOPEN_PASSTHROUGH);
+        assert(!(openout->open_flags & FOPEN_DIRECT_IO));
+        assert(openout->backing_id == BACKING_ID);
+    }
+    else
+    {
+        assert(!(openout->open_flags & FOPEN_PASSTHROUGH));
+        assert(openout->open_flags & FOPEN_DIRECT_IO);
+        assert(openout->backing_id == 0);
+    }
+
+    fuse_test_stop(&t);
+    fuse_session_destroy(se);
+    free_fuse_args(&args);
+}
+
+int main(int argc, char *argv[])
+{
+    struct fuse_ops ops;
+
+    memset(&ops, 0, sizeof(ops));
+    ops.init = test_init;
+    ops.open = test_open;
+    test_negotiate(argc, argv, &ops, 0);
+    test_negotiate(argc, argv, &ops, 1);
+    printf("passthrough negotiation test passed\n");
+    return 0;
+}
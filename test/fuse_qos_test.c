@@ -0,0 +1,143 @@
+#include "fuse_test_util.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+
+#define BLOCK_INO 99
+
+// nodeid 为 BLOCK_INO 的 GETATTR 阻塞到测试放行为止，使其他请求在 QoS 调度器中排队
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static int blocked;
+static int released;
+
+static void test_getattr(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
+{
+    struct stat st;
+    (void)fi;
+    if (ino == BLOCK_INO)
+    {
+        pthread_mutex_lock(&lock);
+        blocked = 1;
+        pthread_cond_broadcast(&cond);
+        while (!released)
+            pthread_cond_wait(&cond, &lock);
+        pthread_mutex_unlock(&lock);
+    }
+    memset(&st, 0, sizeof(st));
+    st.st_ino = ino;
+    st.st_mode = S_IFDIR | 0755;
+    send_reply_attr(req, &st, 1.0);
+}
+
+static const struct fuse_loop_config config = {
+    .min_threads = 1,
+    .max_threads = 1,
+    .readers = 1,
+    .qos = {
+        .tenant = FUSE_QOS_UID,
+        .weights = "1000:1,1001:2,1002:1:10",
+    },
+};
+
+static void block_worker(int fd, uint64_t unique)
+{
+    struct fuse_getattr_in getattr;
+
+    memset(&getattr, 0, sizeof(getattr));
+    pthread_mutex_lock(&lock);
+    blocked = 0;
+    released = 0;
+    pthread_mutex_unlock(&lock);
+    fuse_test_post_node(fd, FUSE_GETATTR, unique, BLOCK_INO, &getattr, sizeof(getattr));
+    pthread_mutex_lock(&lock);
+    while (!blocked)
+        pthread_cond_wait(&cond, &lock);
+    pthread_mutex_unlock(&lock);
+}
+
+static void release_worker(void)
+{
+    pthread_mutex_lock(&lock);
+    released = 1;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+}
+
+static double elapsed(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_ops ops;
+    struct fuse_session *se;
+    struct fuse_getattr_in getattr;
+    struct timespec start;
+    struct fuse_test t;
+    char buf[256];
+    int last1001 = -1;
+    uint64_t unique;
+    int i;
+
+    memset(&ops, 0, sizeof(ops));
+    ops.getattr = test_getattr;
+    se = fuse_session_new(&args, &ops, 0, NULL);
+    assert(se != NULL);
+    se->mo.allow_other = 1;
+    fuse_test_start(&t, se, FUSE_TEST_MULTI, &config);
+    fuse_test_init(t.fd, buf, sizeof(buf), 0);
+
+    // uid 1000 先排入 4 个请求，权重为 2 的 uid 1001 再排入 4 个请求，
+    // 按照到达顺序 uid 1001 的请求在最后，加权公平队列中它们在前 6 个回复中全部完成
+    memset(&getattr, 0, sizeof(getattr));
+    block_worker(t.fd, 2);
+    for (i = 0; i < 4; i++)
+        fuse_test_post_ext(t.fd, FUSE_GETATTR, 10 + i, FUSE_ROOT_ID, 1000, &getattr, sizeof(getattr), NULL, 0);
+    for (i = 0; i < 4; i++)
+        fuse_test_post_ext(t.fd, FUSE_GETATTR, 20 + i, FUSE_ROOT_ID, 1001, &getattr, sizeof(getattr), NULL, 0);
+    usleep(100000);
+    release_worker();
+    assert(fuse_test_reply(t.fd, 0) == 2);
+    for (i = 0; i < 8; i++)
+    {
+        unique = fuse_test_reply(t.fd, 0);
+        if (unique >= 20)
+            last1001 = i;
+    }
+    assert(last1001 >= 0 && last1001 < 6);
+
+    // uid 1002 的 IOPS 上限为 10，桶中的 10 个令牌用完后，之后的 5 个请求至少需要 0.4 秒
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < 15; i++)
+        fuse_test_post_ext(t.fd, FUSE_GETATTR, 30 + i, FUSE_ROOT_ID, 1002, &getattr, sizeof(getattr), NULL, 0);
+    for (i = 0; i < 10; i++)
+        fuse_test_reply(t.fd, 0);
+    assert(elapsed(&start) < 0.3);
+    for (i = 0; i < 5; i++)
+        fuse_test_reply(t.fd, 0);
+    assert(elapsed(&start) >= 0.4);
+
+    // uid 1002 的令牌已经用完，排队的请求超过分发器的容量（1 个工作线程时为 16）时，
+    // 读取线程仍然可以接收其他租户的请求，uid 1000 的请求不需要等待 uid 1002 的请求逐个放行
+    for (i = 0; i < 20; i++)
+        fuse_test_post_ext(t.fd, FUSE_GETATTR, 50 + i, FUSE_ROOT_ID, 1002, &getattr, sizeof(getattr), NULL, 0);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    fuse_test_post_ext(t.fd, FUSE_GETATTR, 100, FUSE_ROOT_ID, 1000, &getattr, sizeof(getattr), NULL, 0);
+    for (i = 0; fuse_test_reply(t.fd, 0) != 100; i++)
+        ;
+    assert(elapsed(&start) < 0.2);
+    for (; i < 20; i++)
+        fuse_test_reply(t.fd, 0);
+    printf("qos test passed\n");
+
+    fuse_test_stop(&t);
+    fuse_session_destroy(se);
+    free_fuse_args(&args);
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "fuse_test_util.h"
+
+#include <stdio.h>
+#include <errno.h>
+
+#define CHILD_ID 2
+
+// 第一个目录项为 "."，不返回属性；第二个目录项带有属性，第三个目录项放不下
+static void test_readdirplus(fuse_req_p req, fuse_inode ino, size_t size, off_t off,
+                             struct fuse_file_info *fi)
+{
+    struct fuse_entry_param e;
+    char buf[512];
+    size_t len = 0;
+    size_t entsize;
+
+    (void)fi;
+    (void)off;
+    assert(size <= sizeof(buf));
+    memset(&e, 0, sizeof(e));
+    e.attr.st_ino = ino;
+    e.attr.st_mode = S_IFDIR;
+    entsize = fuse_add_direntry_plus(req, buf, size, ".", &e, 1);
+    assert(entsize == FUSE_DIRENT_ALIGN(FUSE_NAME_OFFSET_DIRENTPLUS + 1));
+    len += entsize;
+
+    e.ino = CHILD_ID;
+    e.attr.st_ino = CHILD_ID;
+    e.attr.st_mode = S_IFREG | 0644;
+    e.attr.st_size = 4096;
+    e.entry_timeout = 1.5;
+    e.attr_timeout = 2.0;
+    entsize = fuse_add_direntry_plus(req, buf + len, size - len, "file", &e, 2);
+    assert(entsize == FUSE_DIRENT_ALIGN(FUSE_NAME_OFFSET_DIRENTPLUS + 4));
+    len += entsize;
+
+    assert(fuse_add_direntry_plus(req, buf + len, size - len, "more", &e, 3) == 0);
+    send_reply_ok(req, buf, len);
+}
+
+int main(int argc, char *argv[])
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_ops ops;
+    struct fuse_session *se;
+    struct fuse_init_out *initout;
+    struct fuse_read_in read_in;
+    struct fuse_direntplus *dp;
+    char buf[512];
+    char *p = buf + sizeof(struct fuse_out_header);
+    ssize_t len;
+    struct fuse_test t;
+
+    memset(&ops, 0, sizeof(ops));
+    ops.readdirplus = test_readdirplus;
+    se = fuse_session_new(&args, &ops, 0, NULL);
+    assert(se != NULL);
+    fuse_test_start(&t, se, FUSE_TEST_SINGLE, NULL);
+
+    // 实现了 readdirplus 时默认请求 FUSE_DO_READDIRPLUS 以及 FUSE_READDIRPLUS_AUTO
+    initout = fuse_test_init(t.fd, buf, sizeof(buf), FUSE_DO_READDIRPLUS | FUSE_READDIRPLUS_AUTO);
+    assert(initout->flags & FUSE_DO_READDIRPLUS);
+    assert(initout->flags & FUSE_READDIRPLUS_AUTO);
+
+    memset(&read_in, 0, sizeof(read_in));
+    read_in.size = 2 * FUSE_DIRENT_ALIGN(FUSE_NAME_OFFSET_DIRENTPLUS + 4) + 8;
+    fuse_test_post(t.fd, FUSE_READDIRPLUS, 2, &read_in, sizeof(read_in));
+    fuse_test_read(t.fd, buf, sizeof(buf), 2, 0);
+    len = ((struct fuse_out_header *)buf)->len - sizeof(struct fuse_out_header);
+
+    dp = (struct fuse_direntplus *)p;
+    assert(dp->entry_out.nodeid == 0);
+    assert(dp->dirent.ino == FUSE_ROOT_ID);
+    assert(dp->dirent.off == 1);
+    assert(dp->dirent.namelen == 1 && dp->dirent.name[0] == '.');
+    assert(dp->dirent.type == S_IFDIR >> 12);
+    p += FUSE_DIRENTPLUS_SIZE(dp);
+
+    dp = (struct fuse_direntplus *)p;
+    assert(dp->entry_out.nodeid == CHILD_ID);
+    assert(dp->entry_out.entry_valid == 1 && dp->entry_out.entry_valid_nsec == 500000000);
+    assert(dp->entry_out.attr_valid == 2 && dp->entry_out.attr_valid_nsec == 0);
+    assert(dp->entry_out.attr.ino == CHILD_ID);
+    assert(dp->entry_out.attr.size == 4096);
+    assert(dp->dirent.off == 2);
+    assert(dp->dirent.namelen == 4 && memcmp(dp->dirent.name, "file", 4) == 0);
+    assert(dp->dirent.type == S_IFREG >> 12);
+    p += FUSE_DIRENTPLUS_SIZE(dp);
+    assert(p - buf - sizeof(struct fuse_out_header) == (size_t)len);
+    printf("readdirplus test passed\n");
+
+    fuse_test_stop(&t);
+    fuse_session_destroy(se);
+    free_fuse_args(&args);
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include "fuse_test_util.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdatomic.h>
+
+// 通过包装 malloc/calloc/realloc 统计堆分配次数
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static atomic_long alloc_count;
+
+void *malloc(size_t size)
+{
+    atomic_fetch_add(&alloc_count, 1);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    atomic_fetch_add(&alloc_count, 1);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    atomic_fetch_add(&alloc_count, 1);
+    return __libc_realloc(ptr, size);
+}
+
+#define WARMUP_REQUESTS 1000
+#define MEASURE_REQUESTS 100000
+
+static void test_getattr(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
+{
+    struct stat st;
+    (void)fi;
+    memset(&st, 0, sizeof(st));
+    st.st_ino = ino;
+    st.st_mode = S_IFDIR | 0755;
+    send_reply_attr(req, &st, 1.0);
+}
+
+// 模拟内核发送一个请求，并等待对应的响应
+static void send_request(int fd, uint32_t opcode, uint64_t unique, const void *arg, size_t argsize, int error)
+{
+    char buf[256];
+
+    fuse_test_post(fd, opcode, unique, arg, argsize);
+    fuse_test_read(fd, buf, sizeof(buf), unique, error);
+}
+
+int main(int argc, char *argv[])
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_ops ops;
+    struct fuse_session *se;
+    struct fuse_getattr_in getattr;
+    struct fuse_interrupt_in intr;
+    struct fuse_test t;
+    char buf[256];
+    uint64_t unique = 1;
+    long before, after;
+    int i;
+
+    memset(&ops, 0, sizeof(ops));
+    ops.getattr = test_getattr;
+    se = fuse_session_new(&args, &ops, 0, NULL);
+    assert(se != NULL);
+
+    fuse_test_start(&t, se, FUSE_TEST_SINGLE, NULL);
+    fuse_test_init(t.fd, buf, sizeof(buf), 0);
+    unique++;
+
+    memset(&getattr, 0, sizeof(getattr));
+    for (i = 0; i < WARMUP_REQUESTS; i++)
+        send_request(t.fd, FUSE_GETATTR, unique++, &getattr, sizeof(getattr), 0);
+
+    before = atomic_load(&alloc_count);
+    for (i = 0; i < MEASURE_REQUESTS; i++)
+        send_request(t.fd, FUSE_GETATTR, unique++, &getattr, sizeof(getattr), 0);
+    after = atomic_load(&alloc_count);
+
+    printf("allocations for %d requests after warmup: %ld\n", MEASURE_REQUESTS, after - before);
+    assert(after - before == 0);
+
+    // interrupt 请求先于对应的请求到达，对应的请求不再被处理而是回复 EINTR
+    memset(&intr, 0, sizeof(intr));
+    intr.unique = unique;
+    fuse_test_post(t.fd, FUSE_INTERRUPT, unique | 1, &intr, sizeof(intr));
+    send_request(t.fd, FUSE_GETATTR, unique, &getattr, sizeof(getattr), -EINTR);
+    unique++;
+    assert(atomic_load(&se->reqs->inflight) == 0);
+
+    // 多个 interrupt 请求挂起时，对应的请求按 unique 找到各自的 interrupt 请求，与到达顺序无关
+    for (i = 0; i < 3; i++)
+    {
+        intr.unique = unique + i * 2;
+        fuse_test_post(t.fd, FUSE_INTERRUPT, intr.unique | 1, &intr, sizeof(intr));
+    }
+    for (i = 2; i >= 0; i--)
+        send_request(t.fd, FUSE_GETATTR, unique + i * 2, &getattr, sizeof(getattr), -EINTR);
+    unique += 6;
+    assert(atomic_load(&se->reqs->inflight) == 0);
+
+    // 关闭对端，循环读取到不完整的请求后退出
+    fuse_test_stop(&t);
+    fuse_session_destroy(se);
+    free_fuse_args(&args);
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "fuse_test_util.h"
+
+#include <stdio.h>
+#include <errno.h>
+
+static void test_fallocate(fuse_req_p req, fuse_inode ino, int mode, off_t offset,
+                           off_t length, struct fuse_file_info *fi)
+{
+    assert(ino == 2 && fi->fh == 10);
+    assert(mode == 3 && offset == 4096 && length == 8192);
+    send_reply_err(req, 0);
+}
+
+static void test_lseek(fuse_req_p req, fuse_inode ino, off_t off, int whence,
+                       struct fuse_file_info *fi)
+{
+    assert(ino == 2 && fi->fh == 10);
+    // 4096 之后是一个 1MB 的空洞
+    if (whence == SEEK_DATA)
+        send_reply_lseek(req, off < 4096 ? off : 4096 + (1 << 20));
+    else
+        send_reply_lseek(req, off < 4096 ? 4096 : off);
+}
+
+static off_t seek(int fd, uint64_t unique, off_t offset, int whence)
+{
+    struct fuse_lseek_in lseek_in;
+    struct fuse_lseek_out *lseek_out;
+    char buf[256];
+
+    memset(&lseek_in, 0, sizeof(lseek_in));
+    lseek_in.fh = 10;
+    lseek_in.offset = offset;
+    lseek_in.whence = whence;
+    fuse_test_post_node(fd, FUSE_LSEEK, unique, 2, &lseek_in, sizeof(lseek_in));
+    lseek_out = fuse_test_read(fd, buf, sizeof(buf), unique, 0);
+    assert(((struct fuse_out_header *)buf)->len == sizeof(struct fuse_out_header) + sizeof(*lseek_out));
+    return lseek_out->offset;
+}
+
+// 文件系统实现了 lseek 和 fallocate 时交给文件系统处理，否则回复 ENOSYS
+static void test_dispatch(int argc, char *argv[], int implemented)
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_ops ops;
+    struct fuse_session *se;
+    struct fuse_fallocate_in fallocate_in;
+    struct fuse_lseek_in lseek_in;
+    char buf[256];
+    struct fuse_test t;
+
+    memset(&ops, 0, sizeof(ops));
+    if (implemented)
+    {
+        ops.fallocate = test_fallocate;
+        ops.lseek = test_lseek;
+    }
+    se = fuse_session_new(&args, &ops, 0, NULL);
+    assert(se != NULL);
+    fuse_test_start(&t, se, FUSE_TEST_SINGLE, NULL);
+
+    fuse_test_init(t.fd, buf, sizeof(buf), 0);
+
+    memset(&fallocate_in, 0, sizeof(fallocate_in));
+    fallocate_in.fh = 10;
+    fallocate_in.offset = 4096;
+    fallocate_in.length = 8192;
+    fallocate_in.mode = 3;
+    fuse_test_post_node(t.fd, FUSE_FALLOCATE, 2, 2, &fallocate_in, sizeof(fallocate_in));
+    fuse_test_read(t.fd, buf, sizeof(buf), 2, implemented ? 0 : -ENOSYS);
+
+    if (implemented)
+    {
+        assert(seek(t.fd, 3, 0, SEEK_HOLE) == 4096);
+        assert(seek(t.fd, 4, 4096, SEEK_DATA) == 4096 + (1 << 20));
+    }
+    else
+    {
+        memset(&lseek_in, 0, sizeof(lseek_in));
+        lseek_in.whence = SEEK_DATA;
+        fuse_test_post_node(t.fd, FUSE_LSEEK, 3, 2, &lseek_in, sizeof(lseek_in));
+        fuse_test_read(t.fd, buf, sizeof(buf), 3, -ENOSYS);
+    }
+
+    fuse_test_stop(&t);
+    fuse_session_destroy(se);
+    free_fuse_args(&args);
+}
+
+int main(int argc, char *argv[])
+{
+    test_dispatch(argc, argv, 1);
+    test_dispatch(argc, argv, 0);
+    printf("sparse file test passed\n");
+    return 0;
+}
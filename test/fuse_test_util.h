@@ -0,0 +1,143 @@
+#ifndef FUSE_TEST_UTIL_H_
+#define FUSE_TEST_UTIL_H_
+
+#include <fuse_loop.h>
+
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+// 测试公用的会话夹具：用 SOCK_SEQPACKET 模拟 /dev/fuse，一次 read 读取一个完整的请求或回复；
+// 会话使用 socketpair 的一端运行事件循环，测试在另一端扮演内核，发送请求并读取回复和通知
+
+// 事件循环的运行方式
+#define FUSE_TEST_SINGLE 0
+#define FUSE_TEST_MULTI 1
+#define FUSE_TEST_URING 2
+
+struct fuse_test
+{
+    struct fuse_session *se;
+    // FUSE_TEST_MULTI 使用的循环配置
+    const struct fuse_loop_config *config;
+    int loop;
+    // 扮演内核的一端
+    int fd;
+    pthread_t tid;
+};
+
+static inline void *fuse_test_routine(void *data)
+{
+    struct fuse_test *t = (struct fuse_test *)data;
+
+    if (t->loop == FUSE_TEST_MULTI)
+        fuse_multi_session_loop_config(t->se, t->config);
+    else if (t->loop == FUSE_TEST_URING)
+        fuse_uring_session_loop(t->se, NULL, 0);
+    else
+        fuse_single_session_loop(t->se);
+    return NULL;
+}
+
+// 创建 socketpair 并在新线程中运行会话的事件循环
+static inline void fuse_test_start(struct fuse_test *t, struct fuse_session *se, int loop,
+                                   const struct fuse_loop_config *config)
+{
+    int sv[2];
+
+    assert(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) == 0);
+    t->se = se;
+    t->config = config;
+    t->loop = loop;
+    t->fd = sv[1];
+    se->fd = sv[0];
+    assert(pthread_create(&t->tid, NULL, fuse_test_routine, t) == 0);
+}
+
+// 关闭扮演内核的一端，循环读取到连接断开后退出
+static inline void fuse_test_stop(struct fuse_test *t)
+{
+    close(t->fd);
+    pthread_join(t->tid, NULL);
+}
+
+// 模拟内核发送一个请求，arg2 非空时作为第二段参数（例如 WRITE 的数据），不等待回复
+static inline void fuse_test_post_ext(int fd, uint32_t opcode, uint64_t unique, uint64_t nodeid, uint32_t uid,
+                                      const void *arg, size_t argsize, const void *arg2, size_t arg2size)
+{
+    struct fuse_in_header in;
+    struct iovec iov[3];
+
+    memset(&in, 0, sizeof(in));
+    in.len = sizeof(in) + argsize + arg2size;
+    in.opcode = opcode;
+    in.unique = unique;
+    in.nodeid = nodeid;
+    in.uid = uid;
+    iov[0].iov_base = &in;
+    iov[0].iov_len = sizeof(in);
+    iov[1].iov_base = (void *)arg;
+    iov[1].iov_len = argsize;
+    iov[2].iov_base = (void *)arg2;
+    iov[2].iov_len = arg2size;
+    assert(writev(fd, iov, 3) == (ssize_t)in.len);
+}
+
+static inline void fuse_test_post_node(int fd, uint32_t opcode, uint64_t unique, uint64_t nodeid,
+                                       const void *arg, size_t argsize)
+{
+    fuse_test_post_ext(fd, opcode, unique, nodeid, 0, arg, argsize, NULL, 0);
+}
+
+static inline void fuse_test_post(int fd, uint32_t opcode, uint64_t unique, const void *arg, size_t argsize)
+{
+    fuse_test_post_ext(fd, opcode, unique, FUSE_ROOT_ID, 0, arg, argsize, NULL, 0);
+}
+
+// 读取一个回复，检查 unique 和错误码，返回回复的参数部分
+static inline void *fuse_test_read(int fd, char *buf, size_t size, uint64_t unique, int error)
+{
+    struct fuse_out_header *out = (struct fuse_out_header *)buf;
+    ssize_t res;
+
+    res = read(fd, buf, size);
+    assert(res >= (ssize_t)sizeof(struct fuse_out_header));
+    assert(out->len == (uint32_t)res);
+    assert(out->unique == unique);
+    assert(out->error == error);
+    return out + 1;
+}
+
+// 读取一个回复，检查错误码，返回回复对应的 unique，用于回复顺序不确定的场景
+static inline uint64_t fuse_test_reply(int fd, int error)
+{
+    char buf[256];
+    struct fuse_out_header *out = (struct fuse_out_header *)buf;
+
+    assert(read(fd, buf, sizeof(buf)) >= (ssize_t)sizeof(struct fuse_out_header));
+    assert(out->error == error);
+    return out->unique;
+}
+
+// 以 unique 1 完成 INIT 协商，flags 的高 32 位放入 flags2，返回 INIT 回复
+static inline struct fuse_init_out *fuse_test_init(int fd, char *buf, size_t size, uint64_t flags)
+{
+    struct fuse_init_in init;
+
+    memset(&init, 0, sizeof(init));
+    init.major = FUSE_KERNEL_VERSION;
+    init.minor = FUSE_KERNEL_MINOR_VERSION;
+    init.flags = (uint32_t)flags;
+    if (flags >> 32)
+    {
+        init.flags |= FUSE_INIT_EXT;
+        init.flags2 = flags >> 32;
+    }
+    fuse_test_post(fd, FUSE_INIT, 1, &init, sizeof(init));
+    return (struct fuse_init_out *)fuse_test_read(fd, buf, size, 1, 0);
+}
+
+#endif
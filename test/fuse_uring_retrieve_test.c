@@ -0,0 +1,177 @@
+#include <fuse_loop.h>
+#include <fuse_mount.h>
+#include <fuse_notify.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// 跳过测试时的返回值，对应 CMakeLists.txt 中的 SKIP_RETURN_CODE
+#define SKIP 77
+#define DEPTH 2
+#define FILE_INO 2
+#define FILE_SIZE 4096
+
+static atomic_int retrieved;
+
+static void fill_stat(fuse_inode ino, struct stat *st)
+{
+    memset(st, 0, sizeof(*st));
+    st->st_ino = ino;
+    st->st_nlink = 1;
+    if (ino == FUSE_ROOT_ID)
+    {
+        st->st_mode = S_IFDIR | 0755;
+    }
+    else
+    {
+        st->st_mode = S_IFREG | 0644;
+        st->st_size = FILE_SIZE;
+    }
+}
+
+static void test_lookup(fuse_req_p req, fuse_inode parent, const char *name)
+{
+    struct fuse_entry_param e;
+
+    if (parent != FUSE_ROOT_ID || strcmp(name, "f") != 0)
+    {
+        send_reply_err(req, ENOENT);
+        return;
+    }
+    memset(&e, 0, sizeof(e));
+    e.ino = FILE_INO;
+    e.attr_timeout = 60.0;
+    e.entry_timeout = 60.0;
+    fill_stat(FILE_INO, &e.attr);
+    send_reply_entry(req, &e);
+}
+
+static void test_getattr(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
+{
+    struct stat st;
+    (void)fi;
+    fill_stat(ino, &st);
+    send_reply_attr(req, &st, 60.0);
+}
+
+static void test_open(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
+{
+    (void)ino;
+    fi->keep_cache = 1;
+    send_reply_open(req, fi);
+}
+
+static void test_read(fuse_req_p req, fuse_inode ino, size_t size, off_t off, struct fuse_file_info *fi)
+{
+    static char data[FILE_SIZE];
+    (void)ino;
+    (void)fi;
+    memset(data, 'x', sizeof(data));
+    if (off >= FILE_SIZE)
+        size = 0;
+    else if (off + size > FILE_SIZE)
+        size = FILE_SIZE - off;
+    send_reply_ok(req, data + off, size);
+}
+
+static void test_retrieve_reply(fuse_req_p req, void *cookie, fuse_inode ino,
+                                off_t offset, struct fuse_bufvec *bufv)
+{
+    (void)cookie;
+    (void)offset;
+    (void)bufv;
+    assert(ino == FILE_INO);
+    send_reply_none(req);
+    atomic_fetch_add(&retrieved, 1);
+}
+
+static void *loop_routine(void *data)
+{
+    struct fuse_session *se = (struct fuse_session *)data;
+    fuse_uring_session_loop(se, NULL, DEPTH);
+    return NULL;
+}
+
+// 等待 retrieve_reply 被调用 n 次，最多等待 2 秒
+static int wait_retrieved(int n)
+{
+    int i;
+    for (i = 0; i < 200 && atomic_load(&retrieved) < n; i++)
+        usleep(10000);
+    return atomic_load(&retrieved);
+}
+
+// 在真实的挂载点上通过 io_uring 收取 NOTIFY_REPLY：
+// NOTIFY_REPLY 不需要回复，但是所在的队列项仍然要提交，否则每次 retrieve 泄漏一个队列项，
+// 所有队列项用完之后内核发出的请求不再有人处理；无法挂载或者内核没有开启 io_uring 时跳过
+int main(int argc, char *argv[])
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_ops ops;
+    struct fuse_session *se;
+    char mountpoint[] = "/tmp/fuse_uring_XXXXXX";
+    char path[64];
+    char buf[FILE_SIZE];
+    pthread_t tid;
+    int started;
+    int count;
+    int fd;
+    int i;
+
+    memset(&ops, 0, sizeof(ops));
+    ops.lookup = test_lookup;
+    ops.getattr = test_getattr;
+    ops.open = test_open;
+    ops.read = test_read;
+    ops.retrieve_reply = test_retrieve_reply;
+    se = fuse_session_new(&args, &ops, 0, NULL);
+    assert(se != NULL);
+    assert(mkdtemp(mountpoint) != NULL);
+    if (fuse_session_mount(se, mountpoint) < 0)
+    {
+        printf("unable to mount, skipped\n");
+        fuse_session_destroy(se);
+        rmdir(mountpoint);
+        return SKIP;
+    }
+    assert(pthread_create(&tid, NULL, loop_routine, se) == 0);
+
+    // 第一个请求等待 INIT 完成，此时队列已经注册或者已经回退到 /dev/fuse
+    snprintf(path, sizeof(path), "%s/f", mountpoint);
+    fd = open(path, O_RDONLY);
+    assert(fd >= 0);
+    started = se->uring != NULL && se->uring->started;
+    if (started)
+    {
+        assert(read(fd, buf, sizeof(buf)) == FILE_SIZE);
+        count = 2 * se->uring->nr_queues * DEPTH + 1;
+        for (i = 0; i < count; i++)
+        {
+            assert(fuse_notify_retrieve(se, FILE_INO, FILE_SIZE, 0, NULL) == 0);
+            assert(wait_retrieved(i + 1) == i + 1);
+        }
+        // 队列项仍然可用，普通请求照常得到回复
+        assert(pread(fd, buf, sizeof(buf), 0) == FILE_SIZE);
+    }
+    close(fd);
+
+    fuse_session_unmount(se);
+    pthread_join(tid, NULL);
+    fuse_session_destroy(se);
+    free_fuse_args(&args);
+    rmdir(mountpoint);
+    if (!started)
+    {
+        printf("io_uring not available, skipped\n");
+        return SKIP;
+    }
+    printf("io_uring retrieve test passed: %d retrieves\n", count);
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "fuse_test_util.h"
+
+#include <stdio.h>
+#include <errno.h>
+
+static void test_getattr(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
+{
+    struct stat st;
+    (void)fi;
+    memset(&st, 0, sizeof(st));
+    st.st_ino = ino;
+    st.st_mode = S_IFDIR | 0755;
+    send_reply_attr(req, &st, 1.0);
+}
+
+// 内核在 INIT 中提供 FUSE_OVER_IO_URING 时回复中同样带上这个标记，否则不带；
+// 套接字上无法注册 io_uring 队列，请求继续通过经典循环处理
+static void test_negotiate(int argc, char *argv[], struct fuse_ops *ops, int offer)
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_session *se;
+    struct fuse_init_out *initout;
+    struct fuse_getattr_in getattr;
+    struct fuse_attr_out *attr;
+    char buf[512];
+    struct fuse_test t;
+
+    se = fuse_session_new(&args, ops, 0, NULL);
+    assert(se != NULL);
+    fuse_test_start(&t, se, FUSE_TEST_URING, NULL);
+
+    initout = fuse_test_init(t.fd, buf, sizeof(buf), offer ? FUSE_OVER_IO_URING : 0);
+    if (offer)
+    {
+        assert(initout->flags & FUSE_INIT_EXT);
+        assert(initout->flags2 & (FUSE_OVER_IO_URING >> 32));
+    }
+    else
+    {
+        assert(!(initout->flags & FUSE_INIT_EXT));
+        assert(initout->flags2 == 0);
+    }
+
+    memset(&getattr, 0, sizeof(getattr));
+    fuse_test_post(t.fd, FUSE_GETATTR, 2, &getattr, sizeof(getattr));
+    attr = fuse_test_read(t.fd, buf, sizeof(buf), 2, 0);
+    assert(attr->attr.ino == FUSE_ROOT_ID);
+    assert(se->uring != NULL && !se->uring->started);
+
+    fuse_test_stop(&t);
+    assert(se->uring == NULL);
+    fuse_session_destroy(se);
+    free_fuse_args(&args);
+}
+
+int main(int argc, char *argv[])
+{
+    struct fuse_ops ops;
+
+    memset(&ops, 0, sizeof(ops));
+    ops.getattr = test_getattr;
+    test_negotiate(argc, argv, &ops, 0);
+    test_negotiate(argc, argv, &ops, 1);
+    printf("io_uring fallback test passed\n");
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include "fuse_test_util.h"
+
+#include <stdio.h>
+#include <errno.h>
+
+static int open_flags;
+static int want_passthrough;
+
+static void test_init(void *userdata, struct fuse_conn_info *conn)
+{
+    (void)userdata;
+    conn->want |= FUSE_WRITEBACK_CACHE;
+    conn->passthrough = want_passthrough;
+}
+
+static void test_open(fuse_req_p req, fuse_inode ino, struct fuse_file_info *fi)
+{
+    (void)ino;
+    open_flags = fi->flags;
+    send_reply_open(req, fi);
+}
+
+// 文件系统请求的 FUSE_WRITEBACK_CACHE 以及默认开启的能力都出现在 INIT 回复中，
+// 开启之后只写或者追加写打开的文件以读写方式交给文件系统；
+// 同时请求 passthrough 时 writeback cache 被关闭
+static void test_negotiate(int argc, char *argv[], struct fuse_ops *ops, int passthrough)
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_session *se;
+    struct fuse_init_out *initout;
+    struct fuse_open_in open;
+    char buf[512];
+    struct fuse_test t;
+
+    want_passthrough = passthrough;
+    se = fuse_session_new(&args, ops, 0, NULL);
+    assert(se != NULL);
+    fuse_test_start(&t, se, FUSE_TEST_SINGLE, NULL);
+
+    initout = fuse_test_init(t.fd, buf, sizeof(buf), FUSE_ASYNC_READ | FUSE_WRITEBACK_CACHE | FUSE_PARALLEL_DIROPS |
+                             FUSE_AUTO_INVAL_DATA | FUSE_ASYNC_DIO | FUSE_PASSTHROUGH);
+    assert(initout->flags & FUSE_ASYNC_READ);
+    assert(initout->flags & FUSE_PARALLEL_DIROPS);
+    assert(initout->flags & FUSE_AUTO_INVAL_DATA);
+    assert(initout->flags & FUSE_ASYNC_DIO);
+    if (passthrough)
+        assert(!(initout->flags & FUSE_WRITEBACK_CACHE));
+    else
+        assert(initout->flags & FUSE_WRITEBACK_CACHE);
+
+    memset(&open, 0, sizeof(open));
+    open.flags = O_WRONLY | O_APPEND;
+    fuse_test_post(t.fd, FUSE_OPEN, 2, &open, sizeof(open));
+    fuse_test_read(t.fd, buf, sizeof(buf), 2, 0);
+    if (passthrough)
+        assert(open_flags == (O_WRONLY | O_APPEND));
+    else
+        assert(open_flags == O_RDWR);
+
+    fuse_test_stop(&t);
+    fuse_session_destroy(se);
+    free_fuse_args(&args);
+}
+
+int main(int argc, char *argv[])
+{
+    struct fuse_ops ops;
+
+    memset(&ops, 0, sizeof(ops));
+    ops.init = test_init;
+    ops.open = test_open;
+    test_negotiate(argc, argv, &ops, 0);
+    test_negotiate(argc, argv, &ops, 1);
+    printf("writeback negotiation test passed\n");
+    return 0;
+}
@@ -0,0 +1,106 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define WRITE_SIZE 4096
+
+/*
+ * fsync 测试：像数据库提交事务一样，threads 个线程各自在 dir 中的一个文件上
+ * 循环追加 4KB 并调用 fdatasync，统计每秒完成的 fsync 次数以及平均延迟
+ */
+
+static char *dir;
+static int loops;
+
+static void usage(char *name)
+{
+	printf("Usage: %s dir [threads] [loops]\n", name);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *sync_routine(void *data)
+{
+	char path[4096];
+	char buf[WRITE_SIZE];
+	long id = (long)data;
+	int fd, i;
+
+	snprintf(path, sizeof(path), "%s/fsync_bench.%ld", dir, id);
+	fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+	if (fd < 0) {
+		printf("open %s failed: %s\n", path, strerror(errno));
+		return (void *)-1;
+	}
+	memset(buf, 'a' + id % 26, sizeof(buf));
+	for (i = 0; i < loops; i++) {
+		if (write(fd, buf, sizeof(buf)) != sizeof(buf) || fdatasync(fd) < 0) {
+			printf("write/fdatasync %s failed: %s\n", path, strerror(errno));
+			close(fd);
+			return (void *)-1;
+		}
+	}
+	close(fd);
+	unlink(path);
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t *tids;
+	void *ret;
+	int threads, i, failed = 0;
+	double start, elapsed;
+
+	if (argc < 2)
+		usage(argv[0]);
+	dir = argv[1];
+	threads = argc > 2 ? atoi(argv[2]) : 16;
+	loops = argc > 3 ? atoi(argv[3]) : 200;
+	if (threads <= 0 || loops <= 0)
+		usage(argv[0]);
+
+	tids = calloc(threads, sizeof(pthread_t));
+	if (tids == NULL) {
+		printf("alloc memory failed.\n");
+		return 1;
+	}
+	start = now();
+	for (i = 0; i < threads; i++) {
+		if (pthread_create(&tids[i], NULL, sync_routine, (void *)(long)i) != 0) {
+			printf("create thread failed.\n");
+			return 1;
+		}
+	}
+	for (i = 0; i < threads; i++) {
+		pthread_join(tids[i], &ret);
+		if (ret != NULL)
+			failed = 1;
+	}
+	elapsed = now() - start;
+	free(tids);
+	if (failed)
+		return 1;
+
+	printf("threads:      %d\n", threads);
+	printf("fsyncs:       %d\n", threads * loops);
+	printf("time:         %.3f s\n", elapsed);
+	printf("fsyncs/s:     %.0f\n", threads * loops / elapsed);
+	printf("avg latency:  %.3f ms\n", elapsed * 1000 / loops);
+	return 0;
+}
@@ -0,0 +1,116 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define SAMPLES 2000
+
+/*
+ * LOOKUP 开销测试：在 dir 中分批创建文件，使文件系统缓存的 inode 数依次达到 1000、4000、16000 ...
+ * 直到 max_files，每一批之后都 stat 一遍所有文件使它们留在内核的 inode 缓存中，
+ * 再随机 stat 其中 SAMPLES 个文件并统计平均耗时；挂载时目录项缓存时间为 0（passthrough 默认），
+ * 每次 stat 都会产生一个 LOOKUP，命中文件系统已经缓存的 inode，耗时随 inode 数增长说明查找不是常数时间；
+ * passthrough 每个缓存的 inode 占用一个 O_PATH 文件描述符，max_files 不能超过文件系统进程的 RLIMIT_NOFILE
+ */
+
+static void usage(char *name)
+{
+	printf("Usage: %s dir [max_files]\n", name);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int create_files(const char *dir, int from, int to)
+{
+	char path[4096];
+	int fd;
+	int i;
+
+	for (i = from; i < to; i++) {
+		snprintf(path, sizeof(path), "%s/f%d", dir, i);
+		fd = open(path, O_CREAT | O_WRONLY, 0644);
+		if (fd < 0) {
+			printf("create %s failed: %s\n", path, strerror(errno));
+			return -1;
+		}
+		close(fd);
+	}
+	return 0;
+}
+
+static int stat_file(const char *dir, int i)
+{
+	char path[4096];
+	struct stat st;
+
+	snprintf(path, sizeof(path), "%s/f%d", dir, i);
+	if (stat(path, &st) < 0) {
+		printf("stat %s failed: %s\n", path, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+static void remove_files(const char *dir, int n)
+{
+	char path[4096];
+	int i;
+
+	for (i = 0; i < n; i++) {
+		snprintf(path, sizeof(path), "%s/f%d", dir, i);
+		unlink(path);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int max_files = 16000;
+	int n = 0;
+	int target;
+	double start;
+	int i;
+
+	if (argc < 2)
+		usage(argv[0]);
+	if (argc > 2)
+		max_files = atoi(argv[2]);
+	if (max_files <= 0)
+		usage(argv[0]);
+	srandom(1);
+
+	printf("%10s %14s\n", "inodes", "us/lookup");
+	for (target = 1000; n < max_files; target *= 4) {
+		if (target > max_files)
+			target = max_files;
+		if (create_files(argv[1], n, target) < 0)
+			goto out;
+		n = target;
+		for (i = 0; i < n; i++) {
+			if (stat_file(argv[1], i) < 0)
+				goto out;
+		}
+
+		start = now();
+		for (i = 0; i < SAMPLES; i++) {
+			if (stat_file(argv[1], random() % n) < 0)
+				goto out;
+		}
+		printf("%10d %14.2f\n", n, (now() - start) * 1e6 / SAMPLES);
+	}
+out:
+	remove_files(argv[1], n);
+	return 0;
+}
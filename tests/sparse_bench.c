@@ -0,0 +1,193 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifndef FALLOC_FL_KEEP_SIZE
+#define FALLOC_FL_KEEP_SIZE 0x01
+#endif
+#ifndef FALLOC_FL_PUNCH_HOLE
+#define FALLOC_FL_PUNCH_HOLE 0x02
+#endif
+
+#define CHUNK_SIZE (1024 * 1024)
+#define DATA_SIZE (64 * 1024)
+
+/*
+ * 稀疏文件拷贝测试：在 dir 中创建一个 size_mb MB、每隔 every_mb MB 只有 64KB 数据的文件，
+ * 然后像 cp/tar 一样通过 SEEK_DATA/SEEK_HOLE 只拷贝数据区域，统计实际读取的字节数以及耗时；
+ * 文件系统不支持 LSEEK 时整个文件都被当作数据读取
+ */
+
+static void usage(char *name)
+{
+	printf("Usage: %s dir [size_mb] [every_mb]\n", name);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int create_sparse(const char *path, off_t size, off_t every, char *buf)
+{
+	off_t off;
+	int fd;
+
+	fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0644);
+	if (fd < 0) {
+		printf("open %s failed: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if (ftruncate(fd, size) < 0) {
+		printf("truncate %s failed: %s\n", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	memset(buf, 'x', DATA_SIZE);
+	for (off = 0; off < size; off += every) {
+		if (pwrite(fd, buf, DATA_SIZE, off) != DATA_SIZE) {
+			printf("write %s failed: %s\n", path, strerror(errno));
+			close(fd);
+			return -1;
+		}
+	}
+	/* 把最后一段数据重新打成空洞 */
+	off -= every;
+	if (off > 0 && fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, off, DATA_SIZE) < 0)
+		printf("fallocate punch hole: %s\n", strerror(errno));
+	fsync(fd);
+	close(fd);
+	return 0;
+}
+
+/* 只拷贝数据区域，返回读取的字节数 */
+static long long copy_sparse(int in, int out, off_t size, char *buf, int *extents)
+{
+	long long total = 0;
+	off_t data = 0;
+	off_t hole;
+	ssize_t res;
+
+	*extents = 0;
+	while (data < size) {
+		data = lseek(in, data, SEEK_DATA);
+		if (data < 0)
+			break;
+		hole = lseek(in, data, SEEK_HOLE);
+		if (hole < 0)
+			hole = size;
+		(*extents)++;
+		while (data < hole) {
+			size_t len = hole - data < CHUNK_SIZE ? hole - data : CHUNK_SIZE;
+
+			res = pread(in, buf, len, data);
+			if (res <= 0)
+				return -1;
+			total += res;
+			if (pwrite(out, buf, res, data) != res)
+				return -1;
+			data += res;
+		}
+	}
+	if (ftruncate(out, size) < 0)
+		return -1;
+	return total;
+}
+
+static int compare(const char *a, const char *b, char *buf, char *buf2)
+{
+	int fa, fb, ret = 0;
+	ssize_t ra, rb;
+
+	fa = open(a, O_RDONLY);
+	fb = open(b, O_RDONLY);
+	if (fa < 0 || fb < 0)
+		ret = -1;
+	while (ret == 0) {
+		ra = read(fa, buf, CHUNK_SIZE);
+		rb = read(fb, buf2, CHUNK_SIZE);
+		if (ra != rb || memcmp(buf, buf2, ra > 0 ? ra : 0) != 0)
+			ret = -1;
+		if (ra <= 0)
+			break;
+	}
+	if (fa >= 0)
+		close(fa);
+	if (fb >= 0)
+		close(fb);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	char src[4096], dst[4096];
+	off_t size, every;
+	long long total;
+	char *buf, *buf2;
+	struct stat st;
+	int in, out, extents;
+	double start, elapsed;
+
+	if (argc < 2)
+		usage(argv[0]);
+	size = (off_t)(argc > 2 ? atoi(argv[2]) : 1024) * CHUNK_SIZE;
+	every = (off_t)(argc > 3 ? atoi(argv[3]) : 64) * CHUNK_SIZE;
+	if (size <= 0 || every <= 0)
+		usage(argv[0]);
+	snprintf(src, sizeof(src), "%s/sparse_bench.src", argv[1]);
+	snprintf(dst, sizeof(dst), "%s/sparse_bench.dst", argv[1]);
+
+	buf = malloc(CHUNK_SIZE);
+	buf2 = malloc(CHUNK_SIZE);
+	if (buf == NULL || buf2 == NULL) {
+		printf("alloc memory failed.\n");
+		return 1;
+	}
+	if (create_sparse(src, size, every, buf) < 0)
+		return 1;
+
+	in = open(src, O_RDONLY);
+	out = open(dst, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+	if (in < 0 || out < 0) {
+		printf("open failed: %s\n", strerror(errno));
+		return 1;
+	}
+	start = now();
+	total = copy_sparse(in, out, size, buf, &extents);
+	fsync(out);
+	elapsed = now() - start;
+	close(in);
+	close(out);
+	if (total < 0) {
+		printf("copy failed: %s\n", strerror(errno));
+		return 1;
+	}
+	if (compare(src, dst, buf, buf2) < 0) {
+		printf("copy differs from source\n");
+		return 1;
+	}
+	stat(dst, &st);
+
+	printf("file size:    %lld MB\n", (long long)size / CHUNK_SIZE);
+	printf("data extents: %d\n", extents);
+	printf("bytes read:   %lld KB\n", total / 1024);
+	printf("allocated:    %lld KB\n", (long long)st.st_blocks / 2);
+	printf("time:         %.3f s\n", elapsed);
+
+	unlink(src);
+	unlink(dst);
+	free(buf);
+	free(buf2);
+	return 0;
+}
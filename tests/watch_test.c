@@ -0,0 +1,109 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define FILE_SIZE (16 * 4096)
+
+/*
+ * --watch 测试：passthrough 以 --writeback --watch --timeout=60 挂载 source 到 dir，
+ * 1. 通过挂载点写入并 fsync 一个文件，写入的页留在页缓存中，守护进程自己的写入产生的 IN_MODIFY
+ *    不应该失效页缓存，等待监视线程处理完事件后，通过 mincore 检查文件的页仍然全部在页缓存中；
+ * 2. 关闭文件后在源目录中直接修改文件内容，监视线程失效页缓存，通过挂载点读到新的内容
+ */
+
+static void usage(char *name)
+{
+	printf("Usage: %s dir source\n", name);
+	exit(1);
+}
+
+// 文件在页缓存中的页数
+static int resident_pages(int fd)
+{
+	unsigned char vec[FILE_SIZE / 4096];
+	void *addr;
+	int n = 0;
+	int i;
+
+	addr = mmap(NULL, FILE_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		printf("mmap failed: %s\n", strerror(errno));
+		return -1;
+	}
+	if (mincore(addr, FILE_SIZE, vec) < 0) {
+		printf("mincore failed: %s\n", strerror(errno));
+		munmap(addr, FILE_SIZE);
+		return -1;
+	}
+	for (i = 0; i < FILE_SIZE / 4096; i++)
+		n += vec[i] & 1;
+	munmap(addr, FILE_SIZE);
+	return n;
+}
+
+int main(int argc, char *argv[])
+{
+	static char buf[FILE_SIZE];
+	static char data[FILE_SIZE];
+	char path[4096];
+	char src[4096];
+	int res = 1;
+	int fd;
+	int n;
+
+	if (argc < 3)
+		usage(argv[0]);
+	snprintf(path, sizeof(path), "%s/watch_test", argv[1]);
+	snprintf(src, sizeof(src), "%s/watch_test", argv[2]);
+
+	memset(data, 'a', sizeof(data));
+	fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0644);
+	if (fd < 0) {
+		printf("create %s failed: %s\n", path, strerror(errno));
+		return 1;
+	}
+	if (pwrite(fd, data, sizeof(data), 0) != sizeof(data) || fsync(fd) < 0) {
+		printf("write %s failed: %s\n", path, strerror(errno));
+		goto out;
+	}
+	usleep(300000);
+	n = resident_pages(fd);
+	if (n != FILE_SIZE / 4096) {
+		printf("own writes invalidated the page cache: %d of %d pages resident\n", n, FILE_SIZE / 4096);
+		goto out;
+	}
+	close(fd);
+	fd = -1;
+
+	// 同样大小的新内容，只有页缓存被失效时才能读到
+	memset(data, 'b', sizeof(data));
+	fd = open(src, O_WRONLY);
+	if (fd < 0 || pwrite(fd, data, sizeof(data), 0) != sizeof(data)) {
+		printf("write %s failed: %s\n", src, strerror(errno));
+		goto out;
+	}
+	close(fd);
+	usleep(300000);
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || pread(fd, buf, sizeof(buf), 0) != sizeof(buf)) {
+		printf("read %s failed: %s\n", path, strerror(errno));
+		goto out;
+	}
+	if (memcmp(buf, data, sizeof(data)) != 0) {
+		printf("changes in the source directory are not visible\n");
+		goto out;
+	}
+	printf("watch test passed\n");
+	res = 0;
+out:
+	if (fd >= 0)
+		close(fd);
+	unlink(path);
+	return res;
+}